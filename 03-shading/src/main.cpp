@@ -4,81 +4,123 @@
 #include <glad/gl.h>
 
 #include <GLFW/glfw3.h>
+#include <glm/common.hpp>
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/ext/vector_float3.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/trigonometric.hpp>
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <vector>
 
+#include <ofyaGl/asset.h>
+#include <ofyaGl/debug.h>
 #include <ofyaGl/gl.h>
+#include <ofyaGl/lights.h>
+#include <ofyaGl/loop.h>
+#include <ofyaGl/memory.h>
 #include <ofyaGl/obj.h>
+#include <ofyaGl/query.h>
+#include <ofyaGl/render_queue.h>
+#include <ofyaGl/scene.h>
 #include <ofyaGl/shader.h>
+#include <ofyaGl/shader_cache.h>
 #include <ofyaGl/window.h>
 
 int main(int argc, char *argv[]) {
-  if (argc != 2) {
-    std::cout << "Expected an obj file input\n";
+  if (argc < 2) {
+    std::cout << "Expected an obj file input, an optional light count and "
+                 "optional --prepass, --blinn, --ao, --memory, --adaptive, "
+                 "--uncapped and --fps=<limit>\n";
     return EXIT_FAILURE;
   }
+  int lightCount = 0;
+  bool prepass = false;
+  ofyaGl::ShaderDefines litDefines;
+  bool memoryReport = false;
+  ofyaGl::SwapMode swapMode = ofyaGl::SwapMode::VSync;
+  double frameLimit = 0.0;
+  for (int i = 2; i < argc; i++) {
+    if (std::strcmp(argv[i], "--prepass") == 0) {
+      prepass = true;
+    } else if (std::strcmp(argv[i], "--blinn") == 0) {
+      litDefines["BLINN"] = "";
+    } else if (std::strcmp(argv[i], "--ao") == 0) {
+      litDefines["BAKED_AO"] = "";
+    } else if (std::strcmp(argv[i], "--memory") == 0) {
+      memoryReport = true;
+    } else if (std::strcmp(argv[i], "--adaptive") == 0) {
+      swapMode = ofyaGl::SwapMode::Adaptive;
+    } else if (std::strcmp(argv[i], "--uncapped") == 0) {
+      swapMode = ofyaGl::SwapMode::Uncapped;
+    } else if (std::strncmp(argv[i], "--fps=", 6) == 0) {
+      frameLimit = std::atof(argv[i] + 6);
+    } else {
+      lightCount = std::max(0, std::atoi(argv[i]));
+    }
+  }
+  // Any extra lights switch to the clustered forward shader
+  const bool clustered = lightCount > 0;
 
   ofyaGl::Window window(640, 480, "03 Shading");
+  if (!window.setSwapMode(swapMode)) {
+    std::cout << "Adaptive vsync isn't supported, using vsync\n";
+  }
+  window.setFrameLimit(frameLimit);
 
   GL_CALL(glClearColor(0.2, 0.2, 0.2, 0.2));
 
   GL_CALL(glEnable(GL_DEPTH_TEST));
+  // What meshes without baked ambient occlusion read, nothing occluded
+  GL_CALL(glVertexAttrib1f(ofyaGl::AMBIENT_OCCLUSION_ATTRIBUTE, 1.f));
   GL_CALL(glFrontFace(GL_CCW));
 
-  ofyaGl::Shader shader = ofyaGl::Shader::fromFile("03.vert", "03.frag");
+  ofyaGl::ShaderCache shaderCache;
+  ofyaGl::Shader &shader =
+      clustered
+          ? shaderCache.get("03_clustered.vert", "03_clustered.frag",
+                            litDefines)
+          : shaderCache.get("03.vert", "03.frag", litDefines);
   if (!shader.isValid()) {
     window.terminate();
     return EXIT_FAILURE;
   }
 
-  // Load object
-  auto objData = ofyaGl::loadObjDataFromFile(argv[1]);
-  if (!objData.has_value()) {
-    std::cerr << "Failed to load object data\n";
+  // Only writes depth, so the lit pass shades each pixel once
+  ofyaGl::Shader &depthShader = shaderCache.get("depth.vert", "depth.frag");
+  if (!depthShader.isValid()) {
     window.terminate();
     return EXIT_FAILURE;
   }
+  const ofyaGl::ShaderCache::Stats &shaderStats = shaderCache.getStats();
+  std::cout << "Compiled " << shaderStats.compiles << " shader programs in "
+            << shaderStats.compileSeconds * 1000.0 << " ms\n";
 
-  const float *vertexData =
-      reinterpret_cast<const float *>(objData->verts.data());
-  const unsigned int *indicies = objData->indicies.data();
-  const unsigned int indexCount = objData->indicies.size();
-
-  // Create OpenGl buffers
-  GLuint vao;
-  GL_CALL(glGenVertexArrays(1, &vao));
-  GL_CALL(glBindVertexArray(vao));
-
-  GLuint vbo;
-  GL_CALL(glGenBuffers(1, &vbo));
-  GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
-  GL_CALL(glBufferData(GL_ARRAY_BUFFER,
-                       sizeof(ofyaGl::Vertex) * objData->verts.size(),
-                       vertexData, GL_STATIC_DRAW));
-  GL_CALL(glEnableVertexAttribArray(0));
-  GL_CALL(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
-                                sizeof(ofyaGl::Vertex), (GLvoid *)0));
-  GL_CALL(glEnableVertexAttribArray(1));
-  GL_CALL(glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
-                                sizeof(ofyaGl::Vertex),
-                                (GLvoid *)(sizeof(float) * 3)));
-  GL_CALL(glEnableVertexAttribArray(2));
-  GL_CALL(glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE,
-                                sizeof(ofyaGl::Vertex),
-                                (GLvoid *)(sizeof(float) * 6)));
-
-  GLuint ebo;
-  GL_CALL(glGenBuffers(1, &ebo));
-  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo));
-  GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                       sizeof(unsigned int) * objData->indicies.size(),
-                       indicies, GL_STATIC_DRAW));
+  // Counts the fragments the lit pass shades, to compare with and without
+  // the pre-pass
+  ofyaGl::FragmentCounter fragmentCounter;
+  double lastReport = glfwGetTime();
+
+  // Passes of the render queue, in drawing order
+  constexpr uint32_t DEPTH_PASS = 0;
+  constexpr uint32_t LIT_PASS = 1;
+  ofyaGl::RenderQueue renderQueue;
+
+  // Load object in the background, the window keeps rendering meanwhile
+  ofyaGl::AssetLoader assetLoader;
+  ofyaGl::MeshHandle meshHandle = assetLoader.loadMesh(argv[1]);
+  // Per material, requested once the mesh and its materials are in
+  std::vector<ofyaGl::TextureHandle> diffuseMaps;
+  // Texture units, the light buffers take the three units from
+  // LIGHTS_UNIT on, samplers of different types can't share one
+  constexpr GLuint DIFFUSE_MAP_UNIT = 0;
+  constexpr GLuint LIGHTS_UNIT = 1;
+  bool meshArrived = false;
 
   glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 3.0f);
   glm::vec3 lookAt = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -90,57 +132,264 @@ int main(int argc, char *argv[]) {
   glm::mat4 projection =
       glm::perspective(glm::radians(90.f), 800.f / 680.f, 0.1f, 500.f);
 
-  glm::mat4 base_model = glm::mat4(1.0f);
-  base_model = glm::translate(base_model, glm::vec3(0.f, 0.f, -2.f));
-  base_model = glm::scale(base_model, glm::vec3(.1f, .1f, .1f));
+  ofyaGl::ClusteredLighting lighting;
+  lighting.setProjection(projection, 0.1f, 500.f);
+
+  // Scatter the lights in a shell around the model, every fourth one is a
+  // spot light aimed at it
+  std::vector<ofyaGl::Light> lights;
+  std::vector<ofyaGl::Light> animatedLights;
+  std::srand(42);
+  auto random = []() { return std::rand() / static_cast<float>(RAND_MAX); };
+  for (int i = 0; i < lightCount; i++) {
+    glm::vec3 dir = glm::normalize(
+        glm::vec3(random() - .5f, random() - .5f, random() - .5f));
+    glm::vec3 position = glm::vec3(0.f, 0.f, -2.f) + dir * (.6f + random());
+    glm::vec3 color(random(), random(), random());
+    if (i % 4 == 3) {
+      lights.push_back(ofyaGl::Light::spot(position, -dir, 2.f,
+                                           glm::radians(10.f),
+                                           glm::radians(25.f), color, 2.f));
+    } else {
+      lights.push_back(ofyaGl::Light::point(position, .8f, color));
+    }
+  }
 
-  float yaw = 0.f, pitch = 0.f, roll = 0.f;
-  int yaw_dir = 1, pitch_dir = 1, roll_dir = 1;
+  ofyaGl::Scene scene;
+  ofyaGl::NodeId base = *scene.createNode();
+  scene.setPosition(base, glm::vec3(0.f, 0.f, -2.f));
+  scene.setScale(base, glm::vec3(.1f, .1f, .1f));
+  ofyaGl::NodeId spinner = *scene.createNode(base);
 
   shader.use();
   shader.setUniform("light_dir", glm::normalize(glm::vec3(.5f, -.6f, -.3f)));
   shader.setUniform("camera_forward_dir", glm::normalize(cameraForwardVec));
-  double last_time = glfwGetTime();
-  while (!window.shouldClose()) {
-    double time = glfwGetTime();
-    double delta = time - last_time;
-
-    GL_CALL(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
-
-    yaw += (30 * delta) * yaw_dir;
-    pitch += (40 * delta) * pitch_dir;
-    roll += (50 * delta) * roll_dir;
-    if (yaw > 360 * 20 || yaw < 0) {
-      yaw_dir *= -1;
-    }
-    if (pitch > 360 * 20 || pitch < 0) {
-      pitch_dir *= -1;
-    }
-    if (roll > 360 * 20 || roll < 0) {
-      roll_dir *= -1;
-    }
+  shader.setUniform("diffuseMap", static_cast<int>(DIFFUSE_MAP_UNIT));
+
+  struct State {
+    float yaw = 0.f, pitch = 0.f, roll = 0.f;
+    int yaw_dir = 1, pitch_dir = 1, roll_dir = 1;
+  };
+
+  ofyaGl::FrameLoop<State> loop(window, 120.0);
+  loop.run(
+      State{},
+      [](State &state, double delta) {
+        state.yaw += (30 * delta) * state.yaw_dir;
+        state.pitch += (40 * delta) * state.pitch_dir;
+        state.roll += (50 * delta) * state.roll_dir;
+        if (state.yaw > 360 * 20 || state.yaw < 0) {
+          state.yaw_dir *= -1;
+        }
+        if (state.pitch > 360 * 20 || state.pitch < 0) {
+          state.pitch_dir *= -1;
+        }
+        if (state.roll > 360 * 20 || state.roll < 0) {
+          state.roll_dir *= -1;
+        }
+      },
+      [](const State &prev, const State &curr, float alpha) {
+        State state = curr;
+        state.yaw = glm::mix(prev.yaw, curr.yaw, alpha);
+        state.pitch = glm::mix(prev.pitch, curr.pitch, alpha);
+        state.roll = glm::mix(prev.roll, curr.roll, alpha);
+        return state;
+      },
+      [&](const State &state) {
+        GL_CALL(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 
-    glm::mat4 model =
-        glm::rotate(base_model, glm::radians(yaw), glm::vec3(0.f, 1.f, 0.f));
-    model = glm::rotate(model, glm::radians(pitch), glm::vec3(1.f, 0.f, 0.f));
-    model = glm::rotate(model, glm::radians(roll), glm::vec3(0.f, 0.f, 1.f));
-    glm::mat4 mv = view * model; // Model View
-    glm::mat3 mv_n =
-        glm::transpose(glm::inverse(glm::mat3(mv))); // Model View for normal
-    glm::mat4 mvp = projection * mv;                 // Modal View Projection
+        scene.setRotation(
+            spinner,
+            glm::angleAxis(glm::radians(state.yaw), glm::vec3(0.f, 1.f, 0.f)) *
+                glm::angleAxis(glm::radians(state.pitch),
+                               glm::vec3(1.f, 0.f, 0.f)) *
+                glm::angleAxis(glm::radians(state.roll),
+                               glm::vec3(0.f, 0.f, 1.f)));
+        scene.update();
 
-    shader.use();
-    shader.setUniform("mvp", mvp);
-    shader.setUniform("mv_n", mv_n);
+        glm::mat4 mv = view * scene.getWorldMatrix(spinner); // Model View
+        // Model View for normal, the view is rigid so rotating the world
+        // normal matrix is enough
+        glm::mat3 mv_n = glm::mat3(view) * scene.getNormalMatrix(spinner);
+        glm::mat4 mvp = projection * mv; // Modal View Projection
 
-    // TODO draw model
-    glBindVertexArray(vao);
-    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+        assetLoader.update();
+        if (meshHandle->hasFailed()) {
+          window.close();
+          return;
+        }
+        if (!meshHandle->isReady()) {
+          return;
+        }
+        if (!meshArrived) {
+          meshArrived = true;
+          if (litDefines.count("BAKED_AO") != 0 &&
+              !meshHandle->hasAmbientOcclusion()) {
+            std::cout << argv[1] << " has no baked ambient occlusion, build "
+                      << "it with asset-build --ao\n";
+          }
+          const bool haveTextureDir = std::getenv("ICG_TEXTURE_DIR") != nullptr;
+          for (const ofyaGl::Material &material : meshHandle->getMaterials()) {
+            if (material.diffuseMap.empty()) {
+              diffuseMaps.emplace_back();
+            } else if (!haveTextureDir) {
+              std::cerr << "ICG_TEXTURE_DIR isn't set, skipping '"
+                        << material.diffuseMap << "'\n";
+              diffuseMaps.emplace_back();
+            } else {
+              diffuseMaps.push_back(assetLoader.loadTexture(
+                  material.diffuseMap.c_str(), ofyaGl::TextureFormat::BC1));
+            }
+          }
+        }
 
-    window.swapBuffers();
-    window.pollEvents();
+        if (clustered) {
+          // Orbit the lights around the model
+          glm::quat orbit = glm::angleAxis(static_cast<float>(glfwGetTime()),
+                                           glm::vec3(0.f, 1.f, 0.f));
+          animatedLights = lights;
+          for (auto &light : animatedLights) {
+            glm::vec3 offset = light.position - glm::vec3(0.f, 0.f, -2.f);
+            light.position = glm::vec3(0.f, 0.f, -2.f) + orbit * offset;
+            light.direction = orbit * light.direction;
+          }
+
+          lighting.setViewport(window.getWidth(), window.getHeight());
+          lighting.update(animatedLights, view);
+        }
+
+        // Record the frame, the queue orders it by pass, program and
+        // material
+        const ofyaGl::Mesh &mesh = meshHandle->getMesh();
+        const auto &materials = meshHandle->getMaterials();
+        glm::vec4 center = mvp * glm::vec4(0.f, 0.f, 0.f, 1.f);
+        float depth = center.z / center.w * .5f + .5f;
+        auto submit = [&](uint32_t pass, GLuint program, uint32_t material,
+                          uint32_t indexOffset, uint32_t indexCount) {
+          renderQueue.submit(
+              {ofyaGl::makeSortKey(pass, program, material, mesh.getVao(),
+                                   depth),
+               program, mesh.getVao(), material, indexOffset, indexCount, 0});
+        };
+        const auto indexCount = static_cast<uint32_t>(mesh.getIndexCount());
+        if (prepass) {
+          submit(DEPTH_PASS, depthShader.getId(), 0, 0, indexCount);
+        }
+        if (materials.empty()) {
+          submit(LIT_PASS, shader.getId(), 0, 0, indexCount);
+        } else {
+          for (const ofyaGl::SubMesh &subMesh : meshHandle->getSubMeshes()) {
+            submit(LIT_PASS, shader.getId(), subMesh.materialIndex,
+                   subMesh.indexOffset, subMesh.indexCount);
+          }
+        }
+
+        // One debug group per pass, so GL messages name the pass
+        ofyaGl::GlDebug &debug = ofyaGl::GlDebug::shared();
+        bool passGroupOpen = false;
+
+        ofyaGl::RenderQueue::Callbacks callbacks;
+        callbacks.onPass = [&](uint32_t pass) {
+          if (passGroupOpen) {
+            debug.popGroup();
+          }
+          debug.pushGroup(pass == DEPTH_PASS ? "depth pre-pass" : "lit pass");
+          passGroupOpen = true;
+
+          if (pass == DEPTH_PASS) {
+            GL_CALL(glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE));
+            return;
+          }
+          if (prepass) {
+            // Depth is final, only the front most fragment passes now
+            GL_CALL(glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE));
+            GL_CALL(glDepthMask(GL_FALSE));
+            GL_CALL(glDepthFunc(GL_EQUAL));
+          }
+          fragmentCounter.begin();
+        };
+        callbacks.onProgram = [&](GLuint program) {
+          if (program == depthShader.getId()) {
+            depthShader.setUniform("mvp", mvp);
+            return;
+          }
+          shader.setUniform("mvp", mvp);
+          shader.setUniform("mv_n", mv_n);
+          if (clustered) {
+            lighting.bind(shader, LIGHTS_UNIT);
+            shader.setUniform("mv", mv);
+          }
+        };
+        callbacks.onMaterial = [&](GLuint program, uint32_t materialIndex) {
+          if (program != shader.getId() || materials.empty()) {
+            return;
+          }
+          const ofyaGl::Material &material =
+              materialIndex == ofyaGl::NO_MATERIAL
+                  ? ofyaGl::getDefaultMaterial()
+                  : materials[materialIndex];
+          shader.setUniform("ambientColor", material.ambient);
+          shader.setUniform("diffuseColor", material.diffuse);
+          shader.setUniform("specularColor", material.specular);
+          shader.setUniform("shininess", material.shininess);
+          // Untextured until the map has arrived, or if it failed
+          const bool hasDiffuseMap = materialIndex < diffuseMaps.size() &&
+                                     diffuseMaps[materialIndex] != nullptr &&
+                                     diffuseMaps[materialIndex]->isReady();
+          if (hasDiffuseMap) {
+            diffuseMaps[materialIndex]->getTexture().bind(DIFFUSE_MAP_UNIT);
+          }
+          shader.setUniform("hasDiffuseMap", hasDiffuseMap ? 1 : 0);
+        };
+        renderQueue.execute(callbacks);
+        fragmentCounter.end();
+        if (passGroupOpen) {
+          debug.popGroup();
+        }
+
+        if (prepass) {
+          // glClear needs depth writes back on
+          GL_CALL(glDepthMask(GL_TRUE));
+          GL_CALL(glDepthFunc(GL_LESS));
+        }
+
+        double now = glfwGetTime();
+        if (now - lastReport >= 1.0) {
+          const ofyaGl::FrameStats frameStats = window.getFrameStats();
+          std::cout << "Frame time: " << frameStats.average * 1000.0
+                    << " ms average, " << frameStats.p99 * 1000.0
+                    << " ms p99, input to swap "
+                    << frameStats.averageInputLatency * 1000.0 << " ms\n";
+          if (fragmentCounter.getResultCount() > 0) {
+            const double pixels =
+                std::max(1, window.getWidth() * window.getHeight());
+            std::cout << "Shaded fragments: " << fragmentCounter.getLastCount()
+                      << " (" << fragmentCounter.getLastCount() / pixels
+                      << " per pixel" << (prepass ? ", pre-pass" : "")
+                      << ")\n";
+          }
+          lastReport = now;
+        }
+      });
+
+  if (meshHandle->hasFailed()) {
+    std::cerr << "Failed to load object data\n";
+    window.terminate();
+    return EXIT_FAILURE;
+  }
+  assetLoader.getMeshRegistry().destroy();
+  for (const ofyaGl::TextureHandle &diffuseMap : diffuseMaps) {
+    if (diffuseMap != nullptr) {
+      diffuseMap->getTexture().destroy();
+    }
+  }
+  lighting.destroy();
+  fragmentCounter.destroy();
+  shaderCache.destroy();
 
-    last_time = time;
+  if (memoryReport) {
+    // Peaks are the budget, anything still alive here leaked
+    ofyaGl::MemoryTracker::shared().snapshot().writeJson(std::cout);
   }
 
   window.terminate();
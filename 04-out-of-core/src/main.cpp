@@ -0,0 +1,154 @@
+#include <glad/gl.h>
+
+#include <GLFW/glfw3.h>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/trigonometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <optional>
+
+#include <ofyaGl/gl.h>
+#include <ofyaGl/loop.h>
+#include <ofyaGl/memory.h>
+#include <ofyaGl/paged_mesh.h>
+#include <ofyaGl/residency.h>
+#include <ofyaGl/shader_cache.h>
+#include <ofyaGl/window.h>
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cout << "Expected an .ofp file built with asset-build --paged, and "
+                 "optional --slots=<pages>, --error=<pixels> and --memory\n";
+    return EXIT_FAILURE;
+  }
+  ofyaGl::ResidencyParams residencyParams;
+  bool memoryReport = false;
+  for (int i = 2; i < argc; i++) {
+    if (std::strncmp(argv[i], "--slots=", 8) == 0) {
+      residencyParams.slotCount = std::max(1, std::atoi(argv[i] + 8));
+    } else if (std::strncmp(argv[i], "--error=", 8) == 0) {
+      residencyParams.maxScreenError =
+          std::max(.01f, static_cast<float>(std::atof(argv[i] + 8)));
+    } else if (std::strcmp(argv[i], "--memory") == 0) {
+      memoryReport = true;
+    }
+  }
+
+  std::optional<ofyaGl::PagedMesh> pagedMesh =
+      ofyaGl::PagedMesh::open(argv[1]);
+  if (!pagedMesh.has_value()) {
+    return EXIT_FAILURE;
+  }
+  std::cout << "Opened " << pagedMesh->getTriangleCount() << " triangles in "
+            << pagedMesh->getChunks().size() << " chunks, "
+            << pagedMesh->getPages().size() << " pages\n";
+
+  ofyaGl::Window window(640, 480, "04 Out of Core");
+
+  GL_CALL(glClearColor(0.2, 0.2, 0.2, 0.2));
+
+  GL_CALL(glEnable(GL_DEPTH_TEST));
+  GL_CALL(glFrontFace(GL_CCW));
+
+  ofyaGl::ShaderCache shaderCache;
+  ofyaGl::Shader &shader = shaderCache.get("03.vert", "03.frag");
+  if (!shader.isValid()) {
+    window.terminate();
+    return EXIT_FAILURE;
+  }
+
+  // Allocated once, whatever the size of the mesh
+  ofyaGl::ResidencyManager residency(*pagedMesh, residencyParams);
+  std::cout << "GPU pool: " << residency.getPoolBytes() / 1024 << " KiB\n";
+
+  const ofyaGl::Bounds &bounds = pagedMesh->getBounds();
+  const glm::vec3 center = (bounds.min + bounds.max) * .5f;
+  const float radius = std::max(glm::length(bounds.max - bounds.min) * .5f,
+                                1e-3f);
+  const float fovY = glm::radians(60.f);
+  double lastReport = glfwGetTime();
+
+  shader.use();
+  shader.setUniform("light_dir", glm::normalize(glm::vec3(.5f, -.6f, -.3f)));
+
+  struct State {
+    float orbit = 0.f;
+    float zoom = 0.f;
+  };
+
+  ofyaGl::FrameLoop<State> loop(window, 120.0);
+  loop.run(
+      State{},
+      [](State &state, double delta) {
+        state.orbit += static_cast<float>(20 * delta);
+        state.zoom += static_cast<float>(.25 * delta);
+      },
+      [](const State &prev, const State &curr, float alpha) {
+        State state;
+        state.orbit = glm::mix(prev.orbit, curr.orbit, alpha);
+        state.zoom = glm::mix(prev.zoom, curr.zoom, alpha);
+        return state;
+      },
+      [&](const State &state) {
+        GL_CALL(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+
+        // Swing from inside the bounds out to where the model is a few
+        // pixels, so every level gets streamed in and out
+        const float distance =
+            radius * .3f * std::pow(1000.f, .5f - .5f * std::cos(state.zoom));
+        const glm::vec3 direction(std::sin(glm::radians(state.orbit)), .3f,
+                                  std::cos(glm::radians(state.orbit)));
+        const glm::vec3 cameraPos =
+            center + glm::normalize(direction) * distance;
+        const glm::mat4 view =
+            glm::lookAt(cameraPos, center, glm::vec3(0.f, 1.f, 0.f));
+        const float aspect = static_cast<float>(window.getWidth()) /
+                             std::max(1, window.getHeight());
+        const glm::mat4 projection = glm::perspective(
+            fovY, aspect, radius * 1e-3f, distance + radius * 2.f);
+        const glm::mat4 mvp = projection * view;
+
+        const float projectionScale =
+            window.getHeight() / (2.f * std::tan(fovY * .5f));
+        residency.update(mvp, cameraPos, projectionScale);
+
+        shader.setUniform("mvp", mvp);
+        shader.setUniform("mv_n", glm::mat3(view));
+        shader.setUniform("camera_forward_dir",
+                          glm::normalize(center - cameraPos));
+        residency.draw();
+
+        double now = glfwGetTime();
+        if (now - lastReport >= 1.0) {
+          const ofyaGl::FrameStats frameStats = window.getFrameStats();
+          const ofyaGl::ResidencyManager::Stats &stats = residency.getStats();
+          std::cout << "Frame time: " << frameStats.average * 1000.0
+                    << " ms, chunks " << stats.visibleChunks << " visible "
+                    << stats.culledChunks << " culled "
+                    << stats.fallbackChunks << " waiting, "
+                    << stats.drawnTriangles << " tris, pages "
+                    << stats.residentPages << " resident "
+                    << stats.loadsInFlight << " loading "
+                    << stats.pagesLoaded << " loaded " << stats.pagesEvicted
+                    << " evicted\n";
+          lastReport = now;
+        }
+      });
+
+  residency.destroy();
+  shaderCache.destroy();
+
+  if (memoryReport) {
+    ofyaGl::MemoryTracker::shared().snapshot().writeJson(std::cout);
+  }
+
+  window.terminate();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <ofyaGl/job.h>
+#include <ofyaGl/obj.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ofyaGl {
+
+struct AmbientOcclusionParams {
+  /**
+   * Rays per vertex, spread over the hemisphere around its normal.
+   */
+  uint32_t rayCount = 64;
+  /**
+   * Hits farther away don't occlude, as a fraction of the diagonal of the
+   * mesh's bounding box.
+   */
+  float maxDistance = 0.25f;
+};
+
+struct AmbientOcclusionStats {
+  uint64_t rays;
+  size_t bvhNodes;
+  double buildSeconds;
+  double traceSeconds;
+
+  inline double getRaysPerSecond() const {
+    return traceSeconds > 0.0 ? rays / traceSeconds : 0.0;
+  }
+};
+
+/**
+ * Bakes how open the hemisphere above every vertex is into its
+ * `TexCoord::t`, from 1 with nothing in the way down to 0 when enclosed.
+ * Rays are cosine weighted, so it's the share of ambient light that reaches
+ * the vertex.
+ *
+ * Sets `ObjData::hasAmbientOcclusion`, which `.ofm` files keep and which
+ * has `Mesh` feed `t` to `AMBIENT_OCCLUSION_ATTRIBUTE`. Shaders built with
+ * `BAKED_AO` defined read it from there.
+ *
+ * Rays are traced in parallel against a bounding volume hierarchy whose
+ * leaves are tested four triangles at a time.
+ */
+AmbientOcclusionStats
+bakeAmbientOcclusion(ObjData &objData,
+                     const AmbientOcclusionParams &params = {},
+                     JobSystem &jobSystem = JobSystem::shared());
+} // namespace ofyaGl
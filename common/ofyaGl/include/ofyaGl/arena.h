@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+namespace ofyaGl {
+
+/**
+ * Monotonic bump allocator.
+ *
+ * Memory is carved out of large blocks and never freed individually.
+ * `reset` rewinds every block so the next user gets the same memory without
+ * going back to the heap, `release` hands the blocks back.
+ */
+class Arena {
+public:
+  struct Stats {
+    /**
+     * Number of blocks requested from the heap since construction. Stays flat
+     * across `reset` once the arena is warm. Only covers the arena's own
+     * blocks, tools/alloc-check counts every heap allocation.
+     */
+    size_t upstreamAllocations;
+    size_t bytesReserved;
+    size_t bytesUsed;
+    size_t highWaterMark;
+  };
+
+private:
+  struct Block {
+    Block *next;
+    size_t size;
+    size_t used;
+
+    inline char *data() { return reinterpret_cast<char *>(this + 1); }
+  };
+
+  Block *head = nullptr;
+  Block *current = nullptr;
+  const size_t blockSize;
+
+  Stats stats{};
+
+  Block *newBlock(size_t minSize);
+
+public:
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  explicit Arena(size_t blockSize = 1 << 20);
+  ~Arena();
+
+  /**
+   * Never returns nullptr, aborts if the heap is exhausted.
+   */
+  void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+  /**
+   * Uninitialized storage for `count` objects of `T`.
+   */
+  template <typename T> inline T *allocate(size_t count) {
+    static_assert(std::is_trivially_destructible_v<T>,
+                  "Arena never runs destructors");
+    return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+  }
+
+  /**
+   * Rewinds all blocks, everything allocated so far becomes invalid.
+   */
+  void reset();
+
+  /**
+   * Like `reset`, but also returns the blocks to the heap.
+   */
+  void release();
+
+  inline const Stats &getStats() const { return stats; }
+};
+
+/**
+ * Growable array for trivially copyable types backed by an `Arena`. Growing
+ * abandons the old storage inside the arena, so size it up front with
+ * `reserve` wherever the count is known.
+ */
+template <typename T> class ArenaVector {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "ArenaVector relocates with memcpy");
+
+private:
+  Arena *arena;
+  T *items = nullptr;
+  size_t count = 0;
+  size_t capacity = 0;
+
+public:
+  explicit ArenaVector(Arena &arena) : arena(&arena) {};
+
+  inline void reserve(size_t newCapacity) {
+    if (newCapacity <= capacity) {
+      return;
+    }
+    T *newItems = arena->allocate<T>(newCapacity);
+    if (count > 0) {
+      std::memcpy(newItems, items, sizeof(T) * count);
+    }
+    items = newItems;
+    capacity = newCapacity;
+  }
+
+  inline void push_back(const T &item) {
+    if (count == capacity) {
+      reserve(capacity == 0 ? 16 : capacity * 2);
+    }
+    items[count++] = item;
+  }
+
+  inline void clear() { count = 0; }
+
+  inline T &operator[](size_t i) { return items[i]; }
+  inline const T &operator[](size_t i) const { return items[i]; }
+  inline T *data() { return items; }
+  inline const T *data() const { return items; }
+  inline T *begin() { return items; }
+  inline T *end() { return items + count; }
+  inline const T *begin() const { return items; }
+  inline const T *end() const { return items + count; }
+  inline size_t size() const { return count; }
+  inline bool empty() const { return count == 0; }
+};
+} // namespace ofyaGl
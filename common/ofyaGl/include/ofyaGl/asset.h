@@ -0,0 +1,214 @@
+#pragma once
+
+#include <ofyaGl/job.h>
+#include <ofyaGl/mesh.h>
+#include <ofyaGl/mesh_registry.h>
+#include <ofyaGl/obj.h>
+#include <ofyaGl/texture.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ofyaGl {
+
+enum class AssetState { Queued, Parsing, Uploading, Ready, Failed };
+
+/**
+ * Shared state of a mesh requested through `AssetLoader::loadMesh`. Poll
+ * `isReady` from the render loop, `getMesh` is only valid once it returns
+ * true.
+ */
+class MeshAsset {
+private:
+  friend class AssetLoader;
+
+  std::string fileName;
+  std::atomic<AssetState> state{AssetState::Queued};
+
+  std::optional<ObjData> objData;
+  /**
+   * `MeshRegistry::hashGeometry` of `objData`, taken while parsing.
+   */
+  uint64_t geometryHash = 0;
+  /**
+   * Filled chunk by chunk, then handed to the registry.
+   */
+  Mesh mesh;
+  SharedMeshHandle sharedMesh;
+  std::vector<Material> materials;
+  std::vector<SubMesh> subMeshes;
+  bool ambientOcclusion = false;
+  size_t vertsUploaded = 0;
+  size_t indiciesUploaded = 0;
+  /**
+   * Reported as `MemoryCategory::MeshStaging` while `objData` is held.
+   */
+  size_t stagingBytes = 0;
+
+public:
+  MeshAsset(const char *fileName) : fileName(fileName) {};
+  MeshAsset(const MeshAsset &) = delete;
+  ~MeshAsset();
+
+  inline AssetState getState() const {
+    return state.load(std::memory_order_acquire);
+  }
+  inline bool isReady() const { return getState() == AssetState::Ready; }
+  inline bool hasFailed() const { return getState() == AssetState::Failed; }
+  inline const std::string &getFileName() const { return fileName; }
+
+  /**
+   * Possibly shared with other assets of the same geometry, destroyed by the
+   * loader's `MeshRegistry`.
+   */
+  inline const Mesh &getMesh() const {
+    return sharedMesh != nullptr ? sharedMesh->getMesh() : mesh;
+  }
+  inline const SharedMeshHandle &getSharedMesh() const { return sharedMesh; }
+
+  /**
+   * Kept from the `ObjData` once the mesh is ready.
+   */
+  inline const std::vector<Material> &getMaterials() const {
+    return materials;
+  }
+  inline const std::vector<SubMesh> &getSubMeshes() const {
+    return subMeshes;
+  }
+  /**
+   * Whether the mesh came with baked ambient occlusion.
+   */
+  inline bool hasAmbientOcclusion() const { return ambientOcclusion; }
+};
+
+using MeshHandle = std::shared_ptr<MeshAsset>;
+
+/**
+ * Shared state of a texture requested through `AssetLoader::loadTexture`,
+ * same rules as `MeshAsset`.
+ */
+class TextureAsset {
+private:
+  friend class AssetLoader;
+
+  std::string fileName;
+  TextureFormat format;
+  MipFilter filter;
+  std::atomic<AssetState> state{AssetState::Queued};
+
+  std::optional<TextureData> textureData;
+  Texture texture;
+  size_t levelsUploaded = 0;
+  size_t stagingBytes = 0;
+
+public:
+  TextureAsset(const char *fileName, TextureFormat format, MipFilter filter)
+      : fileName(fileName), format(format), filter(filter) {};
+  TextureAsset(const TextureAsset &) = delete;
+  ~TextureAsset();
+
+  inline AssetState getState() const {
+    return state.load(std::memory_order_acquire);
+  }
+  inline bool isReady() const { return getState() == AssetState::Ready; }
+  inline bool hasFailed() const { return getState() == AssetState::Failed; }
+  inline const std::string &getFileName() const { return fileName; }
+
+  inline const Texture &getTexture() const { return texture; }
+  inline Texture &getTexture() { return texture; }
+};
+
+using TextureHandle = std::shared_ptr<TextureAsset>;
+
+/**
+ * Loads meshes and textures in the background.
+ *
+ * Parsing and image decoding run as tasks on the job system. The GPU upload
+ * happens on the GL thread inside `update`, which streams at most
+ * `chunkBytes` per buffer write and one mip level per step, and stops once
+ * its time budget is used up, so a huge asset is spread over many frames
+ * instead of freezing one.
+ *
+ * Meshes are deduplicated twice: requesting a file that is still loaded
+ * returns the same asset, and assets whose parsed geometry matches share
+ * one upload through the `MeshRegistry`.
+ */
+class AssetLoader {
+private:
+  JobSystem &jobSystem;
+
+  std::mutex parseMutex;
+  std::vector<TaskHandle> parseTasks;
+  std::unordered_map<std::string, std::weak_ptr<MeshAsset>> meshesByName;
+
+  MeshRegistry meshRegistry;
+
+  std::mutex uploadMutex;
+  std::deque<MeshHandle> uploadQueue;
+  std::deque<TextureHandle> textureUploadQueue;
+
+  std::atomic<unsigned> pending{0};
+  const size_t chunkBytes;
+
+  void parse(const MeshHandle &handle);
+  void decode(const TextureHandle &handle);
+
+  /**
+   * Uploads the next chunk of `asset`. Returns true once it's complete.
+   */
+  bool uploadChunk(MeshAsset &asset);
+  bool uploadLevel(TextureAsset &asset);
+
+  /**
+   * One upload step of the oldest queued asset. Returns false if nothing is
+   * queued.
+   */
+  bool uploadStep(unsigned &readyCount);
+
+public:
+  AssetLoader(const AssetLoader &) = delete;
+
+  AssetLoader(size_t chunkBytes = 1 << 20,
+              JobSystem &jobSystem = JobSystem::shared());
+  ~AssetLoader();
+
+  /**
+   * Queues `fileName` (relative to `ICG_OBJ_DIR`) for loading and returns
+   * right away. While a handle to it is alive, asking again returns the
+   * same asset without parsing it twice.
+   */
+  MeshHandle loadMesh(const char *fileName);
+
+  /**
+   * Queues `fileName` (relative to `ICG_TEXTURE_DIR`) for loading as
+   * `format` and returns right away. See `loadTextureData` for the cache.
+   */
+  TextureHandle loadTexture(const char *fileName, TextureFormat format,
+                            MipFilter filter = MipFilter::Box);
+
+  /**
+   * Must be called on the GL thread, typically once per frame. Uploads
+   * parsed assets until `budgetSeconds` is used up and returns how many
+   * became ready. Meshes no asset uses anymore are destroyed.
+   */
+  unsigned update(double budgetSeconds = 0.002);
+
+  /**
+   * Number of requested assets that are neither ready nor failed.
+   */
+  inline unsigned getPendingCount() const {
+    return pending.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Owns the meshes of every loaded asset, `destroy` it on shutdown.
+   */
+  inline MeshRegistry &getMeshRegistry() { return meshRegistry; }
+};
+} // namespace ofyaGl
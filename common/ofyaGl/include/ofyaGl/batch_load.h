@@ -0,0 +1,140 @@
+#pragma once
+
+#include <ofyaGl/job.h>
+#include <ofyaGl/obj.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace ofyaGl {
+
+struct ObjLoadResult {
+  /**
+   * Returned by `ObjBatchLoader::submit`.
+   */
+  size_t id;
+  std::filesystem::path path;
+  /**
+   * Nothing if the file couldn't be read or parsed.
+   */
+  std::optional<ObjData> objData;
+};
+
+class IoRing;
+
+/**
+ * Loads many mesh files at once, handing each one back through a completion
+ * queue as soon as it's parsed, in whatever order they finish.
+ *
+ * On Linux the reads go through an io_uring owned by an I/O thread, which
+ * keeps up to `maxInFlight` of them outstanding and hands every file read to
+ * the job system for parsing. Disk latency is then paid once per batch
+ * rather than once per file. Where io_uring isn't available, or the kernel
+ * refuses it, every file becomes a job that reads and parses it, so reads
+ * overlap up to the number of workers.
+ *
+ * Compressed `.obj` files always take the job path, they stream through a
+ * `DecompressStream` of their own.
+ */
+class ObjBatchLoader {
+private:
+  struct Request;
+
+  JobSystem &jobSystem;
+  const size_t maxInFlight;
+  std::unique_ptr<IoRing> ring;
+
+  std::mutex mutex;
+  /**
+   * Read by the I/O thread, only used with `ring`.
+   */
+  std::deque<Request *> readQueue;
+  std::condition_variable ioWake;
+  /**
+   * Requests holding a read buffer, capped at `maxInFlight`.
+   */
+  size_t readsInFlight = 0;
+  bool stopping = false;
+  std::thread ioThread;
+
+  std::deque<ObjLoadResult> completions;
+  std::condition_variable completed;
+  size_t nextId = 0;
+  /**
+   * Submitted and not handed back yet, including `completions`.
+   */
+  size_t pending = 0;
+  /**
+   * Parse jobs that may not have finished yet. `wait` and the destructor run
+   * queued tasks while they wait, so a job system without workers works too.
+   */
+  std::deque<TaskHandle> jobs;
+  /**
+   * Set by the I/O thread once io_uring_enter keeps failing, the reads left
+   * then block on that thread.
+   */
+  bool ringFailed = false;
+
+  void ioMain();
+
+  /**
+   * Opens the file and queues its read, or fails the request.
+   */
+  bool startRead(Request *request);
+  /**
+   * Reads what's left of the file without the ring.
+   */
+  void readBlocking(Request *request);
+  void finishRead(Request *request, bool ok);
+
+  void submitJob(std::function<void()> fn);
+  void complete(size_t id, const std::filesystem::path &path,
+                std::optional<ObjData> objData, bool heldRead);
+
+public:
+  ObjBatchLoader(const ObjBatchLoader &) = delete;
+
+  /**
+   * `maxInFlight` bounds the files read but not parsed yet, and so the
+   * memory held by their contents.
+   */
+  explicit ObjBatchLoader(size_t maxInFlight = 64,
+                          JobSystem &jobSystem = JobSystem::shared());
+
+  /**
+   * Drops the reads not started yet and waits for the rest.
+   */
+  ~ObjBatchLoader();
+
+  /**
+   * Queues the file at `path` as given, see `loadObjDataFromPath`. Returns
+   * the id its result will carry.
+   */
+  size_t submit(const std::filesystem::path &path);
+
+  /**
+   * The next finished load, or nothing if none is finished right now.
+   */
+  std::optional<ObjLoadResult> poll();
+
+  /**
+   * Blocks until the next load finishes. Returns nothing once every
+   * submitted file was handed back. Runs queued tasks while it waits.
+   */
+  std::optional<ObjLoadResult> wait();
+
+  /**
+   * Submitted files not handed back yet.
+   */
+  size_t getPendingCount();
+
+  inline bool isUsingIoRing() const { return ring != nullptr; }
+};
+} // namespace ofyaGl
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <ofyaGl/image.h>
+#include <ofyaGl/job.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ofyaGl {
+
+/**
+ * Storage format of a texture level. The block formats work on 4x4 pixel
+ * blocks:
+ * - `BC1`: RGB at 4 bits per pixel, alpha is dropped
+ * - `BC3`: RGBA at 8 bits per pixel
+ * - `BC5`: two channels (R and G) at 8 bits per pixel, for normal maps
+ */
+enum class TextureFormat : uint32_t { RGBA8 = 0, BC1 = 1, BC3 = 2, BC5 = 3 };
+
+/**
+ * Bytes of one level of `format` at the given size.
+ */
+size_t getLevelSize(TextureFormat format, int width, int height);
+
+/**
+ * Encodes `image` into `format`, block rows are compressed in parallel on
+ * `jobSystem`. `RGBA8` copies the pixels as they are.
+ */
+std::vector<uint8_t> compressImage(const Image &image, TextureFormat format,
+                                   JobSystem &jobSystem = JobSystem::shared());
+
+/**
+ * Expands a level of `format` back to RGBA. Channels `format` doesn't store
+ * come back as 0, alpha as 255.
+ */
+Image decompressImage(const uint8_t *data, int width, int height,
+                      TextureFormat format);
+} // namespace ofyaGl
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// KHR_debug is core in 4.3 only, glad's 3.3 core header doesn't carry it
+#ifndef GL_DEBUG_OUTPUT
+#define GL_DEBUG_OUTPUT 0x92E0
+#endif
+#ifndef GL_DEBUG_OUTPUT_SYNCHRONOUS
+#define GL_DEBUG_OUTPUT_SYNCHRONOUS 0x8242
+#endif
+#ifndef GL_DEBUG_SOURCE_API
+#define GL_DEBUG_SOURCE_API 0x8246
+#define GL_DEBUG_SOURCE_WINDOW_SYSTEM 0x8247
+#define GL_DEBUG_SOURCE_SHADER_COMPILER 0x8248
+#define GL_DEBUG_SOURCE_THIRD_PARTY 0x8249
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+#define GL_DEBUG_SOURCE_OTHER 0x824B
+#endif
+#ifndef GL_DEBUG_TYPE_ERROR
+#define GL_DEBUG_TYPE_ERROR 0x824C
+#define GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR 0x824D
+#define GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR 0x824E
+#define GL_DEBUG_TYPE_PORTABILITY 0x824F
+#define GL_DEBUG_TYPE_PERFORMANCE 0x8250
+#define GL_DEBUG_TYPE_OTHER 0x8251
+#define GL_DEBUG_TYPE_MARKER 0x8268
+#define GL_DEBUG_TYPE_PUSH_GROUP 0x8269
+#define GL_DEBUG_TYPE_POP_GROUP 0x826A
+#endif
+#ifndef GL_DEBUG_SEVERITY_HIGH
+#define GL_DEBUG_SEVERITY_HIGH 0x9146
+#define GL_DEBUG_SEVERITY_MEDIUM 0x9147
+#define GL_DEBUG_SEVERITY_LOW 0x9148
+#define GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+#endif
+#ifndef GL_BUFFER
+#define GL_BUFFER 0x82E0
+#define GL_SHADER 0x82E1
+#define GL_PROGRAM 0x82E2
+#define GL_QUERY 0x82E3
+#endif
+#ifndef GL_VERTEX_ARRAY
+#define GL_VERTEX_ARRAY 0x8074
+#endif
+
+namespace ofyaGl {
+
+enum class DebugSeverity : uint32_t {
+  Notification = 0,
+  Low,
+  Medium,
+  High,
+  Count
+};
+
+constexpr size_t DEBUG_SEVERITY_COUNT =
+    static_cast<size_t>(DebugSeverity::Count);
+
+struct DebugMessage {
+  GLenum source;
+  GLenum type;
+  GLuint id;
+  DebugSeverity severity;
+  const char *text;
+  /**
+   * Innermost `DebugGroup` open on the GL thread, empty if none or if the
+   * message arrived asynchronously.
+   */
+  const char *group;
+};
+
+enum class ErrorCheckMode {
+  /**
+   * `glGetError` after every `GL_CALL`, the old behaviour. Debug builds
+   * only, it syncs with the GPU on every call.
+   */
+  EveryCall,
+  /**
+   * Only one frame in `interval` is checked: per `GL_CALL` in Debug builds,
+   * and in any build the error queue is drained around that frame, which
+   * also catches what the unchecked frames left behind. Cheap enough for
+   * soak tests of Release builds.
+   */
+  Sampled,
+  /**
+   * No `glGetError` at all, for when the debug callback reports instead.
+   */
+  Off
+};
+
+/**
+ * GL diagnostics: the `KHR_debug` message callback, debug groups and object
+ * labels, and how often `GL_CALL` falls back to `glGetError`.
+ *
+ * Messages from the driver and from `glGetError` both go through `report`,
+ * which hands them to the handler registered for their severity. Without
+ * `KHR_debug` groups and labels are no-ops apart from the CPU side group
+ * stack, which error reports still name.
+ */
+class GlDebug {
+public:
+  using Handler = std::function<void(const DebugMessage &message)>;
+
+private:
+  bool outputEnabled = false;
+  bool synchronous = false;
+  DebugSeverity minSeverity = DebugSeverity::Low;
+  ErrorCheckMode mode;
+  unsigned sampleInterval = 60;
+  unsigned long frame = 0;
+
+  Handler handlers[DEBUG_SEVERITY_COUNT];
+  std::atomic<size_t> messageCounts[DEBUG_SEVERITY_COUNT] = {};
+
+  std::vector<std::string> groups;
+
+  GlDebug();
+
+  inline bool isSampledFrame(unsigned long frame) const {
+    return frame % sampleInterval == 0;
+  }
+
+  /**
+   * Reports everything queued in `glGetError`.
+   */
+  void drainErrors(const char *when);
+  void updateCallChecks();
+
+public:
+  GlDebug(const GlDebug &) = delete;
+
+  static GlDebug &shared();
+
+  /**
+   * Loads the `KHR_debug` entry points through `load` and installs the
+   * message callback. Synchronous output delivers messages on the GL thread
+   * inside the offending call, so they carry the debug group and a break
+   * point in the handler shows the caller. Returns false if the context
+   * doesn't support `KHR_debug`.
+   */
+  bool enableOutput(GLADloadfunc load, bool synchronous = true);
+  inline bool isOutputEnabled() const { return outputEnabled; }
+
+  /**
+   * Drops driver messages below `severity`. Defaults to `Low`.
+   */
+  void setMinSeverity(DebugSeverity severity);
+
+  /**
+   * Drops driver messages with one of `ids` from `source` and `type`, for
+   * known noise like buffer placement notes.
+   */
+  void ignore(GLenum source, GLenum type, const std::vector<GLuint> &ids);
+
+  /**
+   * Replaces the handler for `severity`. By default high and medium go to
+   * `std::cerr`, low and notifications to `std::cout`. Set handlers before
+   * enabling asynchronous output, the callback may run on driver threads.
+   */
+  void setHandler(DebugSeverity severity, Handler handler);
+
+  void setErrorCheckMode(ErrorCheckMode mode, unsigned interval = 60);
+  inline ErrorCheckMode getErrorCheckMode() const { return mode; }
+
+  /**
+   * Called once per frame after the swap, `Window::swapBuffers` does it.
+   */
+  void endFrame();
+
+  /**
+   * Routes `message` to its handler. `group` is filled in if empty.
+   */
+  void report(DebugMessage message);
+
+  inline size_t getMessageCount(DebugSeverity severity) const {
+    return messageCounts[static_cast<size_t>(severity)].load(
+        std::memory_order_relaxed);
+  }
+
+  /**
+   * GL thread only, use `DebugGroup` to keep them balanced.
+   */
+  void pushGroup(const char *name);
+  void popGroup();
+  inline const char *getCurrentGroup() const {
+    return groups.empty() ? "" : groups.back().c_str();
+  }
+
+  /**
+   * Names a GL object in driver messages and in frame debuggers.
+   * `identifier` is e.g. `GL_BUFFER`, `GL_TEXTURE` or `GL_PROGRAM`.
+   */
+  void label(GLenum identifier, GLuint name, const std::string &label);
+};
+
+/**
+ * Scoped `GlDebug::pushGroup`.
+ */
+class DebugGroup {
+public:
+  DebugGroup(const DebugGroup &) = delete;
+
+  inline explicit DebugGroup(const char *name) {
+    GlDebug::shared().pushGroup(name);
+  }
+  inline ~DebugGroup() { GlDebug::shared().popGroup(); }
+};
+} // namespace ofyaGl
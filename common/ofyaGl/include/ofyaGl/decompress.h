@@ -0,0 +1,113 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ofyaGl {
+
+enum class Compression { None, Gzip, Zstd };
+
+/**
+ * Picked by the last extension of `path`, `.gz` or `.zst`.
+ */
+Compression getCompression(const std::filesystem::path &path);
+
+/**
+ * zlib and zstd are optional, builds without them can't read that format.
+ */
+bool isCompressionSupported(Compression compression);
+
+/**
+ * Decompresses a file on a thread of its own into a small ring of blocks
+ * that the reader takes in order. The reader works on one block while the
+ * next ones are being decompressed, so reading, decompressing and whatever
+ * the reader does with the data overlap, and memory stays at
+ * `BLOCK_COUNT` blocks whatever the file size.
+ */
+class DecompressStream {
+public:
+  static constexpr size_t BLOCK_SIZE = 1 << 20;
+  static constexpr size_t BLOCK_COUNT = 4;
+
+private:
+  /**
+   * Compressed bytes handed to the decoder per read.
+   */
+  static constexpr size_t INPUT_SIZE = 256 << 10;
+
+  std::FILE *file = nullptr;
+  Compression compression;
+  std::vector<char> blocks[BLOCK_COUNT];
+  size_t blockSizes[BLOCK_COUNT] = {};
+
+  std::mutex mutex;
+  std::condition_variable blockFilled;
+  std::condition_variable blockReleased;
+  /**
+   * Blocks published by the decompressor, taken and given back by the
+   * reader. The reader holds block `taken - 1` until its next `next`.
+   */
+  size_t filled = 0;
+  size_t taken = 0;
+  size_t released = 0;
+  bool finished = false;
+  bool failed = false;
+  bool cancelled = false;
+
+  size_t compressedBytes = 0;
+  size_t decompressedBytes = 0;
+  double decompressSeconds = 0.0;
+  /**
+   * Decompressor time spent waiting for the reader to give a block back.
+   */
+  double blockedSeconds = 0.0;
+
+  std::thread thread;
+
+  void run();
+  bool inflateGzip();
+  bool decompressZstd();
+
+  /**
+   * Waits for a free block, nullptr once the reader is gone.
+   */
+  char *acquireBlock();
+  void publishBlock(size_t size);
+
+public:
+  DecompressStream(const DecompressStream &) = delete;
+
+  /**
+   * Starts decompressing right away. Check `hasFailed` if the first `next`
+   * returns nothing.
+   */
+  DecompressStream(const std::filesystem::path &path, Compression compression);
+  ~DecompressStream();
+
+  /**
+   * Gives back the previous block and waits for the next one. Returns
+   * nullptr at the end of the data or on an error.
+   */
+  const char *next(size_t &size);
+
+  /**
+   * The file couldn't be opened, is truncated or is corrupt.
+   */
+  bool hasFailed();
+
+  /**
+   * Final once `next` returned nullptr.
+   */
+  inline size_t getCompressedBytes() const { return compressedBytes; }
+  inline size_t getDecompressedBytes() const { return decompressedBytes; }
+  /**
+   * Time the decompressor thread was busy, waiting for free blocks aside.
+   */
+  inline double getDecompressSeconds() const { return decompressSeconds; }
+};
+} // namespace ofyaGl
@@ -2,10 +2,32 @@
 
 void checkOpenGLError(const char *stmt, const char *file, int line);
 
+namespace ofyaGl {
+
+/**
+ * Whether `GL_CALL` checks `glGetError` right now. Driven by the
+ * `ErrorCheckMode` of `GlDebug`.
+ */
+extern bool glCallChecks;
+
+/**
+ * E.g. "GL_INVALID_ENUM" for a `glGetError` result.
+ */
+const char *getGlErrorName(unsigned int error);
+
+/**
+ * Whether the current context advertises `name`, e.g. "GL_KHR_debug".
+ * Walks the whole list, callers should cache the answer.
+ */
+bool hasGlExtension(const char *name);
+} // namespace ofyaGl
+
 #ifdef DEBUG
 #define GL_CALL(stmt)                                                          \
   stmt;                                                                        \
-  checkOpenGLError(#stmt, __FILE__, __LINE__);
+  if (ofyaGl::glCallChecks) {                                                  \
+    checkOpenGLError(#stmt, __FILE__, __LINE__);                               \
+  }
 #else
 #define GL_CALL(stmt) stmt;
 #endif
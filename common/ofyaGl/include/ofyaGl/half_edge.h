@@ -0,0 +1,116 @@
+#pragma once
+
+#include <ofyaGl/job.h>
+#include <ofyaGl/obj.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace ofyaGl {
+
+/**
+ * Index based half-edge connectivity of a triangle list, kept as flat arrays.
+ *
+ * Half-edge `h` belongs to triangle `h / 3` and runs from its corner `h % 3`
+ * to the next one, so `next`, `prev` and `getFace` are arithmetic and only
+ * origins, twins and flags are stored.
+ *
+ * Vertices at the same position are one point of the topology, even when
+ * their normals or texture coordinates differ. A point is named by the
+ * lowest index among its vertices, per point arrays are indexed by it.
+ */
+class HalfEdgeMesh {
+public:
+  static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+  /**
+   * No other triangle shares the edge.
+   */
+  static constexpr uint8_t EDGE_BOUNDARY = 1;
+  /**
+   * Shared by more than two triangles, or by two that disagree on which way
+   * it runs. Such edges get no twin.
+   */
+  static constexpr uint8_t EDGE_NON_MANIFOLD = 2;
+  /**
+   * Both ends are the same point.
+   */
+  static constexpr uint8_t EDGE_DEGENERATE = 4;
+
+  /**
+   * The triangles around the point form an open fan.
+   */
+  static constexpr uint8_t POINT_BOUNDARY = 1;
+  /**
+   * The triangles around the point don't form a single fan.
+   */
+  static constexpr uint8_t POINT_NON_MANIFOLD = 2;
+
+private:
+  std::vector<uint32_t> origins;
+  std::vector<uint32_t> twins;
+  std::vector<uint8_t> edgeFlags;
+  std::vector<uint32_t> points;
+  /**
+   * An outgoing half-edge per point, the one starting the fan on an open
+   * one. `NONE` for vertices that don't name a point or aren't used.
+   */
+  std::vector<uint32_t> pointHalfEdges;
+  std::vector<uint8_t> pointFlags;
+
+public:
+  /**
+   * Builds the connectivity of `indicies` on the job system, in time linear
+   * in the mesh size. Positions are welded through a concurrent hash table
+   * and twins found by radix sorting edge keys, so there is no map per edge.
+   */
+  static HalfEdgeMesh build(const std::vector<Vertex> &verts,
+                            const std::vector<unsigned int> &indicies,
+                            JobSystem &jobSystem = JobSystem::shared());
+  static HalfEdgeMesh build(const ObjData &objData,
+                            JobSystem &jobSystem = JobSystem::shared());
+
+  static inline uint32_t next(uint32_t h) { return h % 3 == 2 ? h - 2 : h + 1; }
+  static inline uint32_t prev(uint32_t h) { return h % 3 == 0 ? h + 2 : h - 1; }
+  static inline uint32_t getFace(uint32_t h) { return h / 3; }
+
+  inline size_t getHalfEdgeCount() const { return origins.size(); }
+  inline size_t getFaceCount() const { return origins.size() / 3; }
+
+  /**
+   * Vertex index, as in the source index buffer.
+   */
+  inline uint32_t getOrigin(uint32_t h) const { return origins[h]; }
+  inline uint32_t getTarget(uint32_t h) const { return origins[next(h)]; }
+  /**
+   * The opposite half-edge of the neighbouring triangle, `NONE` on
+   * boundary, non-manifold and degenerate edges.
+   */
+  inline uint32_t getTwin(uint32_t h) const { return twins[h]; }
+  inline uint8_t getEdgeFlags(uint32_t h) const { return edgeFlags[h]; }
+
+  inline uint32_t getPoint(uint32_t vertex) const { return points[vertex]; }
+  inline uint32_t getPointHalfEdge(uint32_t point) const {
+    return pointHalfEdges[point];
+  }
+  inline uint8_t getPointFlags(uint32_t point) const {
+    return pointFlags[point];
+  }
+
+  inline const std::vector<uint32_t> &getOrigins() const { return origins; }
+  inline const std::vector<uint32_t> &getTwins() const { return twins; }
+  inline const std::vector<uint8_t> &getEdgeFlags() const {
+    return edgeFlags;
+  }
+
+  /**
+   * Six indices per triangle for `GL_TRIANGLES_ADJACENCY`, in the source's
+   * triangle order, so sub mesh ranges carry over doubled. Where there is
+   * no twin the adjacent vertex is the triangle's own opposite corner.
+   */
+  std::vector<unsigned int>
+  buildAdjacencyIndices(JobSystem &jobSystem = JobSystem::shared()) const;
+};
+} // namespace ofyaGl
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ofyaGl {
+
+/**
+ * Fast 64 bit hash of `size` bytes for content keys, reading 32 bytes per
+ * step over four independent lanes. Not meant to withstand an adversary.
+ */
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 0);
+
+/**
+ * Order dependent mix of two hashes.
+ */
+uint64_t hashCombine(uint64_t hash, uint64_t value);
+} // namespace ofyaGl
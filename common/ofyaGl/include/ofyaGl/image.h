@@ -0,0 +1,56 @@
+#pragma once
+
+#include <ofyaGl/job.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace ofyaGl {
+
+/**
+ * 8 bit RGBA pixels, rows bottom first like OpenGL expects them.
+ */
+struct Image {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> pixels;
+
+  inline uint8_t *at(int x, int y) {
+    return &pixels[(static_cast<size_t>(y) * width + x) * 4];
+  }
+  inline const uint8_t *at(int x, int y) const {
+    return &pixels[(static_cast<size_t>(y) * width + x) * 4];
+  }
+};
+
+enum class MipFilter {
+  /**
+   * 2x2 average, cheap but a little blurry and prone to aliasing.
+   */
+  Box,
+  /**
+   * 8 tap Kaiser windowed sinc, keeps distant detail sharper.
+   */
+  Kaiser
+};
+
+/**
+ * Decodes binary PPM (P6) and uncompressed or RLE TGA (true colour and
+ * greyscale). Returns nothing for anything else.
+ */
+std::optional<Image> decodeImage(const uint8_t *data, size_t size);
+
+/**
+ * Loads `fileName` relative to `ICG_TEXTURE_DIR`.
+ */
+std::optional<Image> loadImageFromFile(const char *fileName);
+
+/**
+ * Every level from `base` down to 1x1, `base` included. Rows of each level
+ * are filtered in parallel on `jobSystem`.
+ */
+std::vector<Image> generateMipChain(Image base, MipFilter filter,
+                                    JobSystem &jobSystem = JobSystem::shared());
+} // namespace ofyaGl
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ofyaGl {
+
+struct Task;
+
+/**
+ * Reference to a submitted task. Cheap to copy, keeps the task alive so
+ * `isDone` and `JobSystem::wait` stay valid after it ran.
+ */
+class TaskHandle {
+private:
+  friend class JobSystem;
+
+  Task *task = nullptr;
+
+  explicit TaskHandle(Task *task);
+
+public:
+  TaskHandle() = default;
+  TaskHandle(const TaskHandle &other);
+  TaskHandle(TaskHandle &&other) noexcept;
+  TaskHandle &operator=(TaskHandle other) noexcept;
+  ~TaskHandle();
+
+  bool isDone() const;
+  inline bool isValid() const { return task != nullptr; }
+};
+
+/**
+ * Fixed capacity Chase-Lev deque. The owning worker pushes and pops at the
+ * bottom, any other thread may steal from the top.
+ */
+class WorkStealingQueue {
+private:
+  static constexpr int64_t CAPACITY = 4096;
+  static constexpr int64_t MASK = CAPACITY - 1;
+
+  alignas(64) std::atomic<int64_t> top{0};
+  alignas(64) std::atomic<int64_t> bottom{0};
+  std::unique_ptr<std::atomic<Task *>[]> buffer;
+
+public:
+  WorkStealingQueue();
+  WorkStealingQueue(const WorkStealingQueue &) = delete;
+
+  /**
+   * Owner only. Returns false if the deque is full.
+   */
+  bool push(Task *task);
+
+  /**
+   * Owner only. Returns nullptr if empty.
+   */
+  Task *pop();
+
+  /**
+   * Any thread. Returns nullptr if empty or the race was lost.
+   */
+  Task *steal();
+};
+
+/**
+ * Work-stealing task scheduler.
+ *
+ * Each worker owns a `WorkStealingQueue`, tasks spawned from a worker go to
+ * its own deque and idle workers steal from the others. Threads that aren't
+ * workers submit through a shared injection queue and can lend a hand while
+ * they `wait`.
+ *
+ * Subsystems should use `JobSystem::shared()` instead of spinning up their
+ * own threads.
+ */
+class JobSystem {
+public:
+  using RangeFn = std::function<void(size_t begin, size_t end)>;
+
+  struct Stats {
+    uint64_t executed;
+    uint64_t stolen;
+  };
+
+private:
+  struct alignas(64) Worker {
+    WorkStealingQueue queue;
+    std::atomic<uint64_t> executed{0};
+    std::atomic<uint64_t> stolen{0};
+    uint32_t rng = 0;
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::vector<std::thread> threads;
+
+  std::mutex injectMutex;
+  std::deque<Task *> injectQueue;
+  std::atomic<size_t> injectSize{0};
+
+  std::mutex sleepMutex;
+  std::condition_variable sleepCv;
+  std::atomic<uint64_t> workEpoch{0};
+  std::atomic<unsigned> sleeping{0};
+  std::atomic<bool> stopping{false};
+
+  std::atomic<uint64_t> externalExecuted{0};
+
+  void workerMain(unsigned index);
+
+  /**
+   * Index of the calling thread if it's one of our workers, -1 otherwise.
+   */
+  int currentWorker() const;
+
+  Task *findWork(int workerIndex);
+  void schedule(Task *task);
+  void execute(Task *task, int workerIndex);
+  void finish(Task *task);
+
+  /**
+   * Drops the launch guard of a task whose dependencies are registered.
+   */
+  void release(Task *task);
+
+  TaskHandle create(std::function<void()> fn, Task *parent);
+  void spawnRange(Task *parent, size_t begin, size_t end, size_t grain,
+                  const std::shared_ptr<const RangeFn> &fn);
+
+public:
+  /**
+   * One worker per hardware thread, minus one for the thread that creates
+   * the system.
+   */
+  static constexpr unsigned HARDWARE_WORKERS =
+      std::numeric_limits<unsigned>::max();
+
+  JobSystem(const JobSystem &) = delete;
+
+  /**
+   * With a `workerCount` of 0 all tasks run on threads that `wait` for them,
+   * serially.
+   */
+  explicit JobSystem(unsigned workerCount = HARDWARE_WORKERS);
+  ~JobSystem();
+
+  /**
+   * The process wide pool, created on first use.
+   */
+  static JobSystem &shared();
+
+  TaskHandle submit(std::function<void()> fn);
+
+  /**
+   * Runs `fn` once every task in `dependencies` has finished.
+   */
+  TaskHandle submitAfter(const std::vector<TaskHandle> &dependencies,
+                         std::function<void()> fn);
+  TaskHandle submitAfter(std::initializer_list<TaskHandle> dependencies,
+                         std::function<void()> fn);
+
+  /**
+   * Blocks until `handle` has finished, executing other tasks meanwhile.
+   */
+  void wait(const TaskHandle &handle);
+  void waitAll(const std::vector<TaskHandle> &handles);
+
+  /**
+   * Splits [begin, end) into pieces of at most `grain` elements and runs
+   * `fn` on them in parallel. Returns once every piece is done.
+   */
+  void parallelFor(size_t begin, size_t end, size_t grain, const RangeFn &fn);
+
+  /**
+   * Like `parallelFor`, but returns a handle instead of waiting.
+   */
+  TaskHandle submitRange(size_t begin, size_t end, size_t grain,
+                         const RangeFn &fn);
+
+  inline unsigned getWorkerCount() const {
+    return static_cast<unsigned>(workers.size());
+  }
+  Stats getStats() const;
+};
+} // namespace ofyaGl
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <ofyaGl/shader.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace ofyaGl {
+
+enum class LightType : uint32_t { Point = 0, Spot = 1 };
+
+/**
+ * World space light. Spot lights are culled by their bounding sphere, the
+ * cone is only applied while shading.
+ */
+struct Light {
+  LightType type;
+  glm::vec3 position;
+  float radius;
+  glm::vec3 color;
+  float intensity;
+  glm::vec3 direction;
+  float spotCosInner;
+  float spotCosOuter;
+
+  static Light point(const glm::vec3 &position, float radius,
+                     const glm::vec3 &color, float intensity = 1.f);
+  static Light spot(const glm::vec3 &position, const glm::vec3 &direction,
+                    float radius, float innerAngle, float outerAngle,
+                    const glm::vec3 &color, float intensity = 1.f);
+};
+
+/**
+ * Clustered forward light assignment.
+ *
+ * The view frustum is split into `dims.x` * `dims.y` screen tiles and
+ * `dims.z` exponentially spaced depth slices. Every frame `update` bins the
+ * lights into those clusters on the job system and uploads three texture
+ * buffers the fragment shader reads to loop over only the lights that can
+ * reach the fragment:
+ * - `lights`: 4 RGBA32F texels per light, in view space
+ * - `cluster_ranges`: RG32UI (offset, count) into `light_indices` per cluster
+ * - `light_indices`: R32UI light indices
+ *
+ * See `shaders/03_clustered.frag` for the consuming side.
+ */
+class ClusteredLighting {
+public:
+  struct Stats {
+    size_t lightCount;
+    size_t indexCount;
+    size_t maxLightsPerCluster;
+    size_t overflowedClusters;
+  };
+
+  /**
+   * Lights past this are dropped from a cluster.
+   */
+  static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 256;
+
+private:
+  struct Aabb {
+    glm::vec3 min;
+    glm::vec3 max;
+  };
+
+  struct ViewLight {
+    glm::vec3 position;
+    float radius;
+  };
+
+  const glm::ivec3 dims;
+
+  glm::mat4 projection{1.f};
+  float nearPlane = 0.1f;
+  float farPlane = 100.f;
+  glm::vec2 viewport{1.f, 1.f};
+  bool clustersStale = true;
+
+  std::vector<Aabb> clusterBounds;
+
+  // Per frame scratch, kept around to avoid reallocating
+  std::vector<ViewLight> viewLights;
+  std::vector<glm::vec4> lightTexels;
+  std::vector<std::vector<uint32_t>> sliceLights;
+  std::vector<uint32_t> clusterLights;
+  std::vector<uint32_t> clusterCounts;
+  std::vector<uint32_t> clusterRanges;
+  std::vector<uint32_t> lightIndices;
+
+  GLuint buffers[3] = {0, 0, 0};
+  GLuint textures[3] = {0, 0, 0};
+  size_t bufferSizes[3] = {0, 0, 0};
+
+  Stats stats{};
+
+  inline size_t clusterCount() const {
+    return static_cast<size_t>(dims.x) * dims.y * dims.z;
+  }
+
+  void buildClusterBounds();
+  void assignLights();
+  void upload();
+
+public:
+  ClusteredLighting(const ClusteredLighting &) = delete;
+
+  ClusteredLighting(glm::ivec3 dims = glm::ivec3(16, 9, 24));
+
+  /**
+   * Perspective projection the scene is rendered with and its clip planes.
+   */
+  void setProjection(const glm::mat4 &projection, float nearPlane,
+                     float farPlane);
+
+  /**
+   * Framebuffer size in pixels, needed to map `gl_FragCoord` to tiles.
+   */
+  void setViewport(int width, int height);
+
+  /**
+   * Bins `lights` for this frame's `view` and uploads the result. GL thread
+   * only.
+   */
+  void update(const std::vector<Light> &lights, const glm::mat4 &view);
+
+  /**
+   * Binds the texture buffers to `firstTextureUnit` and the two units after
+   * it and sets the uniforms `shader` needs. `shader` must be in use.
+   */
+  void bind(Shader &shader, GLuint firstTextureUnit = 0) const;
+
+  inline const Stats &getStats() const { return stats; }
+
+  void destroy();
+};
+} // namespace ofyaGl
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace ofyaGl {
+
+enum class LoadPhase : uint32_t {
+  /**
+   * Reading the file into memory.
+   */
+  Read = 0,
+  /**
+   * Counting records to size the staging arrays.
+   */
+  Scan,
+  Parse,
+  /**
+   * Reading `mtllib` files, not counted as part of `Parse`.
+   */
+  Materials,
+  /**
+   * Merging identical face vertices into the vertex and index buffers.
+   */
+  Weld,
+  SubMeshes,
+  /**
+   * Decoding an `.ofm` file.
+   */
+  Decode,
+  Count
+};
+
+constexpr size_t LOAD_PHASE_COUNT = static_cast<size_t>(LoadPhase::Count);
+
+/**
+ * Lower case name used in the JSON dump.
+ */
+const char *getLoadPhaseName(LoadPhase phase);
+
+struct LoadPhaseStats {
+  double seconds;
+  /**
+   * Bytes taken from the load's arena, and the blocks it had to get from
+   * the heap for them.
+   */
+  size_t arenaBytes;
+  size_t arenaBlocks;
+  /**
+   * Bytes of `ObjData` storage allocated on the heap.
+   */
+  size_t heapBytes;
+};
+
+/**
+ * Counts per record type, all zero for `.ofm` files.
+ */
+struct LoadLineCounts {
+  size_t total;
+  size_t vertPos;
+  size_t texCoord;
+  size_t vertNormal;
+  size_t face;
+  /**
+   * `o` and `g`.
+   */
+  size_t group;
+  size_t useMaterial;
+  size_t materialLibrary;
+  size_t comment;
+  size_t blank;
+  size_t other;
+};
+
+/**
+ * What one mesh load did, filled in by the `ObjData` loaders when they are
+ * handed one. Without it nothing is measured or counted.
+ */
+struct LoadStats {
+  /**
+   * The file plus any material libraries, compressed files count as stored.
+   */
+  size_t bytesRead;
+  /**
+   * Size of a compressed file once decompressed.
+   */
+  size_t bytesDecompressed;
+  /**
+   * Decompression runs on its own thread alongside parsing, so this isn't
+   * part of `totalSeconds`. Time `Read` spent waiting on it is.
+   */
+  double decompressSeconds;
+  LoadLineCounts lines;
+  size_t triangles;
+  size_t quads;
+  /**
+   * Faces with more than four corners.
+   */
+  size_t polygons;
+  /**
+   * Face corners after triangulation, before welding.
+   */
+  size_t inputVertices;
+  size_t uniqueVertices;
+  double totalSeconds;
+  LoadPhaseStats phases[LOAD_PHASE_COUNT];
+
+  inline const LoadPhaseStats &operator[](LoadPhase phase) const {
+    return phases[static_cast<size_t>(phase)];
+  }
+  inline LoadPhaseStats &operator[](LoadPhase phase) {
+    return phases[static_cast<size_t>(phase)];
+  }
+
+  void writeJson(std::ostream &out) const;
+};
+} // namespace ofyaGl
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <ofyaGl/window.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+namespace ofyaGl {
+
+/**
+ * Lock-free single producer / single consumer triple buffer.
+ *
+ * The writer always owns a private slot it can fill without waiting, the
+ * reader always owns the most recently published slot. The third slot sits
+ * in between and is swapped atomically on `publish` and `acquire`.
+ */
+template <typename T> class TripleBuffer {
+private:
+  static constexpr unsigned FRESH_BIT = 4;
+  static constexpr unsigned INDEX_MASK = 3;
+
+  T slots[3];
+  std::atomic<unsigned> middle{2};
+  unsigned writeIndex = 0;
+  unsigned readIndex = 1;
+
+public:
+  TripleBuffer() = default;
+  TripleBuffer(const TripleBuffer &) = delete;
+
+  /**
+   * Writer side. Fill the returned slot, then call `publish`.
+   */
+  inline T &writeSlot() { return slots[writeIndex]; }
+  inline void publish() {
+    writeIndex =
+        middle.exchange(writeIndex | FRESH_BIT, std::memory_order_acq_rel) &
+        INDEX_MASK;
+  }
+
+  /**
+   * Reader side. Returns true if a newer slot was published since the last
+   * call, after which `readSlot` refers to it.
+   */
+  inline bool acquire() {
+    if ((middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0) {
+      return false;
+    }
+    readIndex =
+        middle.exchange(readIndex, std::memory_order_acq_rel) & INDEX_MASK;
+    return true;
+  }
+  inline const T &readSlot() const { return slots[readIndex]; }
+};
+
+/**
+ * Runs `update` at a fixed tick rate on a dedicated simulation thread and
+ * renders on the calling thread, which must own the GL context.
+ *
+ * Every tick publishes the previous and current simulation state through a
+ * `TripleBuffer`, the render side blends the two with `interpolate` based on
+ * how far the frame is into the next tick. Neither side ever blocks the
+ * other, so a slow update doesn't stall submission and vice versa.
+ */
+template <typename State> class FrameLoop {
+public:
+  using UpdateFn = std::function<void(State &state, double dt)>;
+  using InterpolateFn =
+      std::function<State(const State &prev, const State &curr, float alpha)>;
+  using RenderFn = std::function<void(const State &state)>;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Snapshot {
+    State prev;
+    State curr;
+    Clock::time_point tickTime;
+  };
+
+  /**
+   * Upper bound for ticks simulated back to back after a hitch, anything
+   * beyond that is dropped instead of spiraling.
+   */
+  static constexpr int MAX_CATCH_UP_TICKS = 5;
+
+  Window &window;
+  const double tickDelta;
+
+  TripleBuffer<Snapshot> snapshots;
+  std::atomic<bool> running{false};
+  std::atomic<unsigned long> tickCount{0};
+  unsigned long frameCount = 0;
+
+  void simulate(State state, const UpdateFn &update) {
+    const auto tick = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(tickDelta));
+    auto nextTick = Clock::now() + tick;
+
+    while (running.load(std::memory_order_acquire)) {
+      std::this_thread::sleep_until(nextTick);
+
+      const auto now = Clock::now();
+      State prev = state;
+      int steps = 0;
+      while (nextTick <= now && steps < MAX_CATCH_UP_TICKS) {
+        prev = state;
+        update(state, tickDelta);
+        nextTick += tick;
+        steps++;
+      }
+      if (steps == 0) {
+        continue;
+      }
+      if (nextTick <= now) {
+        nextTick = now + tick;
+      }
+
+      Snapshot &snapshot = snapshots.writeSlot();
+      snapshot.prev = prev;
+      snapshot.curr = state;
+      snapshot.tickTime = now;
+      snapshots.publish();
+      tickCount.fetch_add(steps, std::memory_order_relaxed);
+    }
+  }
+
+public:
+  FrameLoop() = delete;
+  FrameLoop(const FrameLoop &) = delete;
+
+  FrameLoop(Window &window, double ticksPerSecond = 60.0)
+      : window(window), tickDelta(1.0 / ticksPerSecond) {}
+
+  /**
+   * Blocks until the window is closed.
+   */
+  void run(const State &initial, UpdateFn update, InterpolateFn interpolate,
+           RenderFn render) {
+    Snapshot &first = snapshots.writeSlot();
+    first.prev = initial;
+    first.curr = initial;
+    first.tickTime = Clock::now();
+    snapshots.publish();
+
+    running.store(true, std::memory_order_release);
+    std::thread simThread(&FrameLoop::simulate, this, initial,
+                          std::cref(update));
+
+    while (!window.shouldClose()) {
+      snapshots.acquire();
+      const Snapshot &snapshot = snapshots.readSlot();
+
+      const double sinceTick =
+          std::chrono::duration<double>(Clock::now() - snapshot.tickTime)
+              .count();
+      const float alpha =
+          static_cast<float>(std::clamp(sinceTick / tickDelta, 0.0, 1.0));
+
+      render(interpolate(snapshot.prev, snapshot.curr, alpha));
+      frameCount++;
+
+      window.swapBuffers();
+      window.pollEvents();
+    }
+
+    running.store(false, std::memory_order_release);
+    simThread.join();
+  }
+
+  inline double getTickDelta() const { return tickDelta; }
+  inline unsigned long getTickCount() const {
+    return tickCount.load(std::memory_order_relaxed);
+  }
+  inline unsigned long getFrameCount() const { return frameCount; }
+};
+} // namespace ofyaGl
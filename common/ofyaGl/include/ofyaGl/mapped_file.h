@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace ofyaGl {
+
+/**
+ * Read only view of a whole file.
+ *
+ * Memory maps the file where the platform allows it, so only the pages that
+ * are touched get read. Elsewhere the file is read into a heap buffer, which
+ * behaves the same apart from the up front cost.
+ */
+class MappedFile {
+private:
+  const uint8_t *bytes = nullptr;
+  size_t size = 0;
+  bool mapped = false;
+  std::vector<uint8_t> fallback;
+
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+  ~MappedFile();
+
+  /**
+   * Returns nothing if the file can't be opened or is empty.
+   */
+  static std::optional<MappedFile> open(const char *path);
+
+  inline const uint8_t *data() const { return bytes; }
+  inline size_t getSize() const { return size; }
+  inline bool isMapped() const { return mapped; }
+};
+} // namespace ofyaGl
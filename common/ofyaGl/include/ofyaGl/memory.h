@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace ofyaGl {
+
+enum class MemoryCategory : uint32_t {
+  /**
+   * Parsed `ObjData` waiting for its GPU upload.
+   */
+  MeshStaging = 0,
+  /**
+   * Encoded or mapped mip chains waiting for their GPU upload.
+   */
+  TextureStaging,
+  VertexBuffer,
+  IndexBuffer,
+  /**
+   * Any other GL buffer, e.g. the light lists.
+   */
+  OtherBuffer,
+  Texture,
+  /**
+   * The driver doesn't report program sizes, so this counts the source bytes
+   * that went into each linked program.
+   */
+  Shader,
+  Count
+};
+
+constexpr size_t MEMORY_CATEGORY_COUNT =
+    static_cast<size_t>(MemoryCategory::Count);
+
+/**
+ * Lower case name used in the JSON dump.
+ */
+const char *getMemoryCategoryName(MemoryCategory category);
+
+struct MemoryCounters {
+  size_t bytes;
+  size_t peakBytes;
+  /**
+   * Objects currently alive.
+   */
+  size_t objects;
+  /**
+   * Objects ever created.
+   */
+  size_t allocations;
+};
+
+struct MemorySnapshot {
+  MemoryCounters categories[MEMORY_CATEGORY_COUNT];
+  size_t totalBytes;
+  size_t peakTotalBytes;
+
+  inline const MemoryCounters &operator[](MemoryCategory category) const {
+    return categories[static_cast<size_t>(category)];
+  }
+
+  /**
+   * Live objects over all categories. Anything left at shutdown is a leak.
+   */
+  size_t getObjectCount() const;
+
+  void writeJson(std::ostream &out) const;
+};
+
+/**
+ * Process wide byte counters per `MemoryCategory`.
+ *
+ * Owners report what they create and release, so a snapshot shows what is
+ * alive right now and the high-water mark since start or the last
+ * `resetPeaks`. All counters are atomics, any thread may report.
+ */
+class MemoryTracker {
+private:
+  struct alignas(64) Counters {
+    std::atomic<size_t> bytes{0};
+    std::atomic<size_t> peakBytes{0};
+    std::atomic<size_t> objects{0};
+    std::atomic<size_t> allocations{0};
+  };
+
+  Counters counters[MEMORY_CATEGORY_COUNT];
+  alignas(64) std::atomic<size_t> totalBytes{0};
+  std::atomic<size_t> peakTotalBytes{0};
+
+public:
+  MemoryTracker() = default;
+  MemoryTracker(const MemoryTracker &) = delete;
+
+  static MemoryTracker &shared();
+
+  /**
+   * `objects` is 0 when an existing object grows, e.g. a texture level
+   * being filled.
+   */
+  void add(MemoryCategory category, size_t bytes, size_t objects = 1);
+  void remove(MemoryCategory category, size_t bytes, size_t objects = 1);
+
+  /**
+   * Counters are read one by one, so a snapshot taken while other threads
+   * report may be slightly inconsistent between categories.
+   */
+  MemorySnapshot snapshot() const;
+
+  /**
+   * Lowers every high-water mark to the current value.
+   */
+  void resetPeaks();
+};
+} // namespace ofyaGl
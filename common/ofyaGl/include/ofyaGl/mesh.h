@@ -0,0 +1,109 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <ofyaGl/gl.h>
+#include <ofyaGl/obj.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ofyaGl {
+
+/**
+ * Baked ambient occlusion, `TexCoord::t` of meshes that have it. For the
+ * others the array stays off and shaders read the attribute's current value
+ * as set with `glVertexAttrib1f`.
+ */
+constexpr GLuint AMBIENT_OCCLUSION_ATTRIBUTE = 3;
+
+/**
+ * GPU side of an `ObjData`: a VAO with an interleaved `Vertex` buffer bound to
+ * attributes 0 (pos), 1 (texCoord) and 2 (normal) plus an index buffer.
+ */
+class Mesh {
+private:
+  GLuint vao;
+  GLuint vbo;
+  GLuint ebo;
+  GLsizei vertCount;
+  GLsizei indexCount;
+
+  Mesh(GLuint vao, GLuint vbo, GLuint ebo, GLsizei vertCount,
+       GLsizei indexCount)
+      : vao(vao), vbo(vbo), ebo(ebo), vertCount(vertCount),
+        indexCount(indexCount) {};
+
+public:
+  Mesh() : Mesh(0, 0, 0, 0, 0) {};
+  Mesh(const Mesh &) = delete;
+  Mesh &operator=(const Mesh &) = delete;
+  Mesh(Mesh &&other) noexcept;
+  Mesh &operator=(Mesh &&other) noexcept;
+
+  /**
+   * Creates the buffers and uploads everything in one go.
+   */
+  static Mesh fromObjData(const ObjData &objData);
+
+  /**
+   * Creates the buffers with uninitialized storage. Fill them with
+   * `uploadVerts` and `uploadIndicies` before drawing.
+   */
+  static Mesh allocate(size_t vertCount, size_t indexCount);
+
+  /**
+   * Writes `count` elements starting at element `offset`. Meant for filling
+   * storage from `allocate` in chunks, the target range must not be in use by
+   * the GPU.
+   */
+  void uploadVerts(const Vertex *verts, size_t offset, size_t count);
+  void uploadIndicies(const unsigned int *indicies, size_t offset,
+                      size_t count);
+
+  /**
+   * Binds `TexCoord::t` to `AMBIENT_OCCLUSION_ATTRIBUTE`.
+   */
+  void enableAmbientOcclusion() const;
+
+  inline void bind() const { GL_CALL(glBindVertexArray(vao)); }
+  inline void draw() const {
+    GL_CALL(glBindVertexArray(vao));
+    GL_CALL(glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0));
+  }
+
+  /**
+   * Draws `count` indices starting at index `offset`.
+   */
+  inline void drawRange(size_t offset, size_t count) const {
+    GL_CALL(glBindVertexArray(vao));
+    GL_CALL(glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(count),
+                           GL_UNSIGNED_INT,
+                           (GLvoid *)(sizeof(unsigned int) * offset)));
+  }
+
+  /**
+   * Draws `subMeshes` in order. `bindMaterial` only runs when the material
+   * changes, and back to back ranges of one material go out as a single
+   * draw, so material sorted sub meshes cost one bind and one draw per
+   * material. Returns the number of draw calls.
+   */
+  size_t drawSubMeshes(
+      const std::vector<SubMesh> &subMeshes,
+      const std::function<void(uint32_t materialIndex)> &bindMaterial) const;
+
+  /**
+   * Names the VAO and its buffers in GL debug output.
+   */
+  void setLabel(const std::string &label) const;
+
+  inline GLuint getVao() const { return vao; }
+  inline GLsizei getVertCount() const { return vertCount; }
+  inline GLsizei getIndexCount() const { return indexCount; }
+  inline bool isValid() const { return vao != 0; }
+
+  void destroy();
+};
+} // namespace ofyaGl
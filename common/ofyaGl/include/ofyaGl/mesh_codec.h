@@ -0,0 +1,66 @@
+#pragma once
+
+#include <ofyaGl/obj.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace ofyaGl {
+
+/**
+ * Extension of encoded mesh files, `loadObjDataFromFile` reads them as well.
+ */
+constexpr const char *MESH_FILE_EXTENSION = ".ofm";
+
+/**
+ * Bumped whenever the `.ofm` layout or either codec changes.
+ */
+constexpr uint32_t MESH_FILE_VERSION = 2;
+
+/**
+ * Vertex codec.
+ *
+ * Vertices are handled in blocks of 256. Within a block every byte position
+ * of the vertex becomes a plane holding the difference to the same byte of
+ * the previous vertex, zigzag folded so small changes either way stay small.
+ * Each plane is stored as groups of 16 bytes packed at 0, 2, 4 or 8 bits per
+ * byte, chosen per group by a 2 bit header. Exponents and the high mantissa
+ * bytes of smooth attributes mostly shrink to 0 or 2 bits.
+ *
+ * Decoding unpacks, undoes the deltas with a prefix sum and transposes the
+ * planes back into vertices, 16 vertices at a time with SSE2.
+ *
+ * `stride` must be a multiple of 4 and at most 256.
+ */
+std::vector<uint8_t> encodeVertexBuffer(const void *vertices, size_t count,
+                                        size_t stride);
+
+/**
+ * Fills `count` vertices of `stride` bytes from `data`. Returns false if
+ * `data` is truncated or corrupt.
+ */
+bool decodeVertexBuffer(void *vertices, size_t count, size_t stride,
+                        const uint8_t *data, size_t size);
+
+/**
+ * Index codec: every index as its zigzag folded difference to the previous
+ * one, written as a LEB128 varint. Triangle lists of a cache optimized mesh
+ * mostly take one byte per index, and runs of those decode 16 at a time.
+ */
+std::vector<uint8_t> encodeIndexBuffer(const uint32_t *indices, size_t count);
+
+bool decodeIndexBuffer(uint32_t *indices, size_t count, const uint8_t *data,
+                       size_t size);
+
+/**
+ * Whole `ObjData` including materials and sub meshes, the `.ofm` layout.
+ */
+std::vector<uint8_t> encodeMesh(const ObjData &objData);
+
+/**
+ * Decodes straight into the vectors the loader uploads from.
+ */
+std::optional<ObjData> decodeMesh(const uint8_t *data, size_t size);
+} // namespace ofyaGl
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <ofyaGl/obj.h>
+
+#include <cstddef>
+
+namespace ofyaGl {
+
+/**
+ * Post-transform cache size the optimizations aim for, conservative for
+ * current GPUs.
+ */
+constexpr size_t VERTEX_CACHE_SIZE = 16;
+
+/**
+ * Reorders the triangles of every sub mesh for the post-transform vertex
+ * cache (Tipsify, Sander et al. 2007). Linear in the index count, sub mesh
+ * ranges stay as they are.
+ */
+void optimizeVertexCache(ObjData &objData,
+                         size_t cacheSize = VERTEX_CACHE_SIZE);
+
+/**
+ * Renumbers vertices in the order the index buffer first uses them so draws
+ * read the vertex buffer front to back, drops unreferenced vertices. Run it
+ * after `optimizeVertexCache`, it doesn't change the triangle order.
+ */
+void optimizeVertexFetch(ObjData &objData);
+
+/**
+ * Average cache misses per triangle of a FIFO cache, between 0.5 for the
+ * best meshes and 3.
+ */
+double getAverageCacheMissRatio(const ObjData &objData,
+                                size_t cacheSize = VERTEX_CACHE_SIZE);
+} // namespace ofyaGl
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <ofyaGl/mesh.h>
+#include <ofyaGl/obj.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ofyaGl {
+
+/**
+ * One uploaded vertex and index buffer pair, shared by everything whose
+ * geometry hashes the same.
+ */
+class SharedMesh {
+private:
+  friend class MeshRegistry;
+
+  uint64_t hash;
+  Mesh mesh;
+
+public:
+  SharedMesh(uint64_t hash, Mesh &&mesh) : hash(hash), mesh(std::move(mesh)) {}
+  SharedMesh(const SharedMesh &) = delete;
+
+  inline uint64_t getHash() const { return hash; }
+  inline const Mesh &getMesh() const { return mesh; }
+};
+
+using SharedMeshHandle = std::shared_ptr<const SharedMesh>;
+
+/**
+ * Deduplicates GPU meshes by the content of their vertex and index data.
+ *
+ * Handles are reference counted. A mesh nobody holds anymore stays cached
+ * until the next `collect`, so dropping and requesting the same geometry
+ * within a frame doesn't upload it again. GL thread only.
+ */
+class MeshRegistry {
+public:
+  struct Stats {
+    size_t meshCount;
+    /**
+     * GPU bytes of the registered meshes.
+     */
+    size_t bytes;
+    uint64_t lookups;
+    uint64_t hits;
+    /**
+     * GPU bytes that weren't uploaded because a hit shared an existing mesh.
+     */
+    uint64_t bytesSaved;
+  };
+
+private:
+  std::unordered_map<uint64_t, std::shared_ptr<SharedMesh>> meshes;
+  Stats stats{};
+
+  static size_t getByteSize(const Mesh &mesh);
+
+public:
+  MeshRegistry() = default;
+  MeshRegistry(const MeshRegistry &) = delete;
+
+  /**
+   * Content key of `verts` and `indicies`, cheap enough to compute on a
+   * worker right after parsing. Sub meshes and materials aren't part of it,
+   * they only select ranges of the buffers.
+   */
+  static uint64_t hashGeometry(const std::vector<Vertex> &verts,
+                               const std::vector<unsigned int> &indicies);
+
+  /**
+   * The registered mesh with this key, or nothing. The 64 bit key is trusted
+   * to tell meshes apart.
+   */
+  SharedMeshHandle find(uint64_t hash);
+
+  /**
+   * Takes ownership of `mesh`, which must have been uploaded from geometry
+   * hashing to `hash`. If an equal mesh got registered meanwhile `mesh` is
+   * destroyed and the existing one returned.
+   */
+  SharedMeshHandle insert(uint64_t hash, Mesh &&mesh);
+
+  /**
+   * `find` or upload `objData` in one go.
+   */
+  SharedMeshHandle acquire(const ObjData &objData, const std::string &label);
+
+  /**
+   * Destroys the meshes no handle refers to. Returns how many.
+   */
+  size_t collect();
+
+  /**
+   * Destroys every mesh, handles still held are left with invalid ones.
+   */
+  void destroy();
+
+  inline const Stats &getStats() const { return stats; }
+};
+} // namespace ofyaGl
@@ -1,7 +1,15 @@
 #pragma once
 
+#include <glm/vec3.hpp>
+#include <ofyaGl/arena.h>
+#include <ofyaGl/load_stats.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <limits>
 #include <optional>
 #include <ostream>
+#include <string>
 #include <vector>
 
 namespace ofyaGl {
@@ -81,11 +89,122 @@ struct VertexHash {
   }
 };
 
+#pragma pack(pop)
+
+constexpr uint32_t NO_MATERIAL = std::numeric_limits<uint32_t>::max();
+
+/**
+ * One `newmtl` entry of an `.mtl` file. Map paths are kept as written.
+ */
+struct Material {
+  std::string name;
+  glm::vec3 ambient{0.2f};
+  glm::vec3 diffuse{0.8f};
+  glm::vec3 specular{0.f};
+  float shininess = 0.f;
+  float opacity = 1.f;
+  std::string diffuseMap;
+  std::string normalMap;
+};
+
+/**
+ * Emerald, for faces without a material or whose `usemtl` names a missing
+ * one.
+ */
+inline const Material &getDefaultMaterial() {
+  static const Material material = [] {
+    Material emerald;
+    emerald.name = "default";
+    emerald.ambient = glm::vec3(0.0215f, 0.1745f, 0.0215f);
+    emerald.diffuse = glm::vec3(0.07568f, 0.61424f, 0.07568f);
+    emerald.specular = glm::vec3(0.633f, 0.727811f, 0.633f);
+    emerald.shininess = 40.f;
+    return emerald;
+  }();
+  return material;
+}
+
+/**
+ * Range of `ObjData::indicies` drawn with a single material. `name` is the
+ * latest `o` or `g` before it.
+ */
+struct SubMesh {
+  std::string name;
+  uint32_t materialIndex;
+  uint32_t indexOffset;
+  uint32_t indexCount;
+};
+
+/**
+ * `subMeshes` cover `indicies` completely and are ordered by material, so
+ * every material's triangles form one contiguous range.
+ */
 struct ObjData {
   std::vector<Vertex> verts;
   std::vector<unsigned int> indicies;
+  std::vector<Material> materials;
+  std::vector<SubMesh> subMeshes;
+  /**
+   * `TexCoord::t` holds baked ambient occlusion, see `bakeAmbientOcclusion`.
+   */
+  bool hasAmbientOcclusion = false;
 };
 
-std::optional<ObjData> loadObjDataFromFile(const char *fileName);
-#pragma pack(pop)
+/**
+ * Loads `fileName` relative to `ICG_OBJ_DIR`, along with the materials of
+ * any `mtllib` it references. Temporaries come from a per-thread arena that
+ * is reset after every load.
+ *
+ * Given `stats`, it is overwritten with what the load did, also when it
+ * fails.
+ */
+std::optional<ObjData> loadObjDataFromFile(const char *fileName,
+                                           LoadStats *stats = nullptr);
+
+/**
+ * Same as above, but every temporary comes from `arena`. Nothing allocated
+ * there is referenced by the result, `reset` it whenever convenient.
+ */
+std::optional<ObjData> loadObjDataFromFile(const char *fileName, Arena &arena,
+                                           LoadStats *stats = nullptr);
+
+/**
+ * Loads the file at `path` as given, for tools working outside
+ * `ICG_OBJ_DIR`. Errors go to stderr, nothing else is printed. Also reads
+ * `.ofm` files, see `mesh_codec.h`, and `.obj.gz` or `.obj.zst` files when
+ * built with zlib or zstd, which are parsed while they decompress.
+ */
+std::optional<ObjData> loadObjDataFromPath(const std::filesystem::path &path,
+                                           Arena &arena,
+                                           LoadStats *stats = nullptr);
+
+/**
+ * Same as above with the per-thread arena of `loadObjDataFromFile`.
+ */
+std::optional<ObjData> loadObjDataFromPath(const std::filesystem::path &path,
+                                           LoadStats *stats = nullptr);
+
+/**
+ * Parses an `.obj` or `.ofm` file that was read into memory elsewhere.
+ * `path` picks the format and locates `mtllib` files, which are still read
+ * from disk. `bytes[size]` must be a '\0', as the parser may look at it.
+ */
+std::optional<ObjData> loadObjDataFromMemory(const char *bytes, size_t size,
+                                             const std::filesystem::path &path,
+                                             Arena &arena,
+                                             LoadStats *stats = nullptr);
+
+/**
+ * Same as above with the per-thread arena of `loadObjDataFromFile`.
+ */
+std::optional<ObjData> loadObjDataFromMemory(const char *bytes, size_t size,
+                                             const std::filesystem::path &path,
+                                             LoadStats *stats = nullptr);
+
+/**
+ * Readies `arena` for the next load: resets it, or releases its blocks if an
+ * unusually large mesh grew it. What the overloads without an arena do with
+ * theirs after every load.
+ */
+void recycleLoadArena(Arena &arena);
 } // namespace ofyaGl
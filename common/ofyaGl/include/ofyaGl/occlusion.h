@@ -0,0 +1,119 @@
+#pragma once
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <ofyaGl/obj.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ofyaGl {
+
+/**
+ * World space axis aligned box.
+ */
+struct Bounds {
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+/**
+ * CPU occlusion culling against a low resolution depth buffer.
+ *
+ * Each frame the occluder meshes are rasterized into a small depth buffer
+ * (nearest depth wins), which is then reduced into a hierarchical Z pyramid
+ * where every texel holds the farthest depth below it. A box is hidden when
+ * its nearest projected depth is behind every pyramid texel its screen
+ * rectangle touches, picked at the level where that rectangle spans at most
+ * 2x2 texels.
+ *
+ * Coverage is sampled at pixel centers, so occluders should sit at or inside
+ * the surface they stand in for. Triangles crossing the near plane are not
+ * rasterized, which only makes the culler more conservative.
+ */
+class OcclusionCuller {
+public:
+  struct Stats {
+    size_t occluderTriangles;
+    size_t rasterizedTriangles;
+    size_t testedBounds;
+    size_t culledBounds;
+  };
+
+private:
+  int width;
+  int height;
+
+  glm::mat4 viewProjection{1.f};
+
+  /**
+   * Level 0 is the depth buffer itself, depth is window z in [0, 1].
+   */
+  std::vector<std::vector<float>> levels;
+  std::vector<int> levelWidths;
+  std::vector<int> levelHeights;
+
+  std::vector<glm::vec4> clipScratch;
+
+  Stats stats{};
+
+  void rasterizeTriangle(const glm::vec4 &a, const glm::vec4 &b,
+                         const glm::vec4 &c);
+
+public:
+  OcclusionCuller(const OcclusionCuller &) = delete;
+
+  /**
+   * `width` is rounded up to a multiple of 4.
+   */
+  OcclusionCuller(int width = 256, int height = 128);
+
+  /**
+   * Clears the depth buffer for a new frame seen through `viewProjection`.
+   */
+  void beginFrame(const glm::mat4 &viewProjection);
+
+  /**
+   * Rasterizes an indexed triangle list. `positions` points at the first
+   * vertex position, `stride` is in bytes. Only counter clockwise triangles
+   * are drawn.
+   */
+  void addOccluder(const float *positions, size_t stride, size_t vertCount,
+                   const uint32_t *indices, size_t indexCount,
+                   const glm::mat4 &model);
+
+  void addOccluder(const ObjData &data, const glm::mat4 &model);
+
+  /**
+   * Builds the pyramid, call after the last occluder and before testing.
+   */
+  void buildHierarchy();
+
+  /**
+   * Whether any part of `bounds` might be seen. Boxes outside the frustum
+   * are reported hidden, boxes crossing the near plane visible.
+   */
+  bool isVisible(const Bounds &bounds) const;
+
+  /**
+   * Tests `bounds` on the job system, `visible` gets 1 or 0 per box.
+   * Returns how many are visible.
+   */
+  size_t cull(const std::vector<Bounds> &bounds, std::vector<uint8_t> &visible);
+
+  inline int getWidth() const { return width; }
+  inline int getHeight() const { return height; }
+  inline size_t getLevelCount() const { return levels.size(); }
+
+  /**
+   * Depth buffer of `level`, row major with the bottom row first.
+   */
+  inline const std::vector<float> &getLevel(size_t level) const {
+    return levels[level];
+  }
+
+  inline const Stats &getStats() const { return stats; }
+};
+} // namespace ofyaGl
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <ofyaGl/mapped_file.h>
+#include <ofyaGl/obj.h>
+#include <ofyaGl/occlusion.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+namespace ofyaGl {
+
+constexpr const char *PAGED_MESH_FILE_EXTENSION = ".ofp";
+/**
+ * Bumped whenever the `.ofp` layout, the chunking or the simplification
+ * changes.
+ */
+constexpr uint32_t PAGED_MESH_FILE_VERSION = 2;
+
+/**
+ * Spatially coherent piece of a paged mesh with one page per level of
+ * detail, level 0 holding the original triangles.
+ */
+struct PagedChunk {
+  Bounds bounds;
+  uint32_t firstPage;
+  uint32_t lodCount;
+};
+
+/**
+ * Where a page lives in the file. Vertices and indices are stored with
+ * `encodeVertexBuffer` and `encodeIndexBuffer`, indices are local to the
+ * page.
+ */
+struct PageInfo {
+  uint64_t offset;
+  uint32_t vertexBytes;
+  uint32_t indexBytes;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  /**
+   * Largest distance, in mesh units, a surface point moved relative to
+   * level 0.
+   */
+  float error;
+  uint32_t chunk;
+};
+
+struct PagedMeshParams {
+  uint32_t maxChunkTriangles = 16384;
+  uint32_t lodCount = 4;
+  /**
+   * Most triangles `buildPagedMeshFile` holds in memory at once, bigger
+   * buckets are split first.
+   */
+  uint64_t maxBucketTriangles = 1 << 20;
+};
+
+/**
+ * What `buildPagedMeshFile` did.
+ */
+struct PagedBuildStats {
+  uint64_t triangleCount = 0;
+  uint64_t fileBytes = 0;
+  uint64_t bucketCount = 0;
+  /**
+   * Triangles of the largest bucket, the peak held in memory.
+   */
+  uint64_t largestBucket = 0;
+};
+
+/**
+ * Splits `objData` into chunks of at most `maxChunkTriangles` by recursive
+ * median cuts along the longest axis, and simplifies every chunk into
+ * `lodCount - 1` coarser levels by vertex clustering. Each level doubles the
+ * cell size of the one before. The grid is shared by every chunk, so
+ * neighbours at the same level meet without cracks.
+ *
+ * Materials and sub meshes are not kept.
+ */
+std::vector<uint8_t> buildPagedMesh(const ObjData &objData,
+                                    const PagedMeshParams &params = {});
+
+/**
+ * Same as `buildPagedMesh`, but streams the `.obj` at `objPath` into
+ * `outPath` without ever holding the whole mesh, for inputs larger than RAM.
+ *
+ * Attributes are staged in memory mapped files next to `outPath`, and the
+ * triangles in spatial buckets on an octree of level `lodCount - 1` cells,
+ * split until each has at most `maxBucketTriangles`. Buckets are then
+ * chunked and simplified one at a time and their pages appended to the
+ * output. Vertices a neighbouring bucket also uses are kept on every level,
+ * so buckets meet without cracks.
+ *
+ * Returns nothing if the input can't be parsed or the output written.
+ */
+std::optional<PagedBuildStats>
+buildPagedMeshFile(const std::filesystem::path &objPath,
+                   const std::filesystem::path &outPath,
+                   const PagedMeshParams &params = {});
+
+/**
+ * Read side of an `.ofp` file. The tables are copied out, page data stays in
+ * the memory mapping and is only read when a page is decoded.
+ */
+class PagedMesh {
+private:
+  MappedFile file;
+  Bounds bounds{};
+  uint64_t triangleCount = 0;
+  uint32_t lodCount = 0;
+  uint32_t maxPageVerts = 0;
+  uint32_t maxPageIndices = 0;
+  std::vector<PagedChunk> chunks;
+  std::vector<PageInfo> pages;
+
+public:
+  PagedMesh() = default;
+  PagedMesh(const PagedMesh &) = delete;
+  PagedMesh &operator=(const PagedMesh &) = delete;
+  PagedMesh(PagedMesh &&other) noexcept = default;
+  PagedMesh &operator=(PagedMesh &&other) noexcept = default;
+
+  /**
+   * Returns nothing if the file is missing or malformed.
+   */
+  static std::optional<PagedMesh> open(const char *path);
+
+  /**
+   * Fills at most `getMaxPageVerts` vertices and `getMaxPageIndices`
+   * indices. Safe to call from several threads at once.
+   */
+  bool decodePage(uint32_t page, Vertex *verts, uint32_t *indices) const;
+
+  inline const Bounds &getBounds() const { return bounds; }
+  /**
+   * Triangles of level 0 across every chunk.
+   */
+  inline uint64_t getTriangleCount() const { return triangleCount; }
+  inline uint32_t getLodCount() const { return lodCount; }
+  inline uint32_t getMaxPageVerts() const { return maxPageVerts; }
+  inline uint32_t getMaxPageIndices() const { return maxPageIndices; }
+  inline const std::vector<PagedChunk> &getChunks() const { return chunks; }
+  inline const std::vector<PageInfo> &getPages() const { return pages; }
+};
+} // namespace ofyaGl
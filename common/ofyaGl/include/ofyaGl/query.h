@@ -0,0 +1,52 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ofyaGl {
+
+/**
+ * Counts the samples that pass the depth test between `begin` and `end` with
+ * a `GL_SAMPLES_PASSED` query.
+ *
+ * Results are read back a few frames late from a small ring of queries so
+ * the CPU never waits on the GPU. If every query is still in flight the frame
+ * is not counted.
+ */
+class FragmentCounter {
+private:
+  static constexpr size_t QUERY_COUNT = 4;
+
+  GLuint queries[QUERY_COUNT] = {};
+  bool pending[QUERY_COUNT] = {};
+  size_t next = 0;
+  bool counting = false;
+
+  uint64_t lastCount = 0;
+  uint64_t resultCount = 0;
+
+  void poll();
+
+public:
+  FragmentCounter(const FragmentCounter &) = delete;
+
+  FragmentCounter();
+
+  void begin();
+  void end();
+
+  /**
+   * Samples passed in the most recent frame whose result has arrived.
+   */
+  inline uint64_t getLastCount() const { return lastCount; }
+
+  /**
+   * How many frames have been read back so far.
+   */
+  inline uint64_t getResultCount() const { return resultCount; }
+
+  void destroy();
+};
+} // namespace ofyaGl
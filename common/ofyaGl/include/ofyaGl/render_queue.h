@@ -0,0 +1,141 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ofyaGl {
+
+enum class DepthOrder { FrontToBack, BackToFront };
+
+/**
+ * Packs a draw's state into a key whose ascending order is the submission
+ * order. From the most significant bit down:
+ * - 4 bits pass
+ * - 12 bits program, 16 bits material, 12 bits VAO, 20 bits depth for
+ *   `FrontToBack`, which groups state changes and still draws roughly front
+ *   to back within a group
+ * - 20 bits inverted depth, then program, material and VAO for
+ *   `BackToFront`, which blending needs
+ *
+ * Program and VAO names are masked, a collision only costs a state change.
+ * `depth` is in [0, 1], typically window z.
+ */
+uint64_t makeSortKey(uint32_t pass, GLuint program, uint32_t material,
+                     GLuint vao, float depth,
+                     DepthOrder order = DepthOrder::FrontToBack);
+
+/**
+ * Pass bits of a key made by `makeSortKey`.
+ */
+inline uint32_t getSortKeyPass(uint64_t key) {
+  return static_cast<uint32_t>(key >> 60);
+}
+
+/**
+ * Everything needed to issue one indexed draw. `userIndex` is passed back
+ * when the packet is executed, e.g. to look up the object's transform.
+ */
+struct DrawPacket {
+  uint64_t key;
+  GLuint program;
+  GLuint vao;
+  uint32_t material;
+  uint32_t indexOffset;
+  uint32_t indexCount;
+  uint32_t userIndex;
+};
+
+/**
+ * Collects draw packets from any number of threads, sorts them by key and
+ * issues them on the GL thread with redundant state changes skipped.
+ *
+ * Every thread records into its own buffer, so recording takes no locks
+ * after a thread's first packet. `execute` merges the buffers and radix sorts
+ * the keys.
+ */
+class RenderQueue {
+public:
+  struct Callbacks {
+    /**
+     * A new pass starts, set up its fixed function state.
+     */
+    std::function<void(uint32_t pass)> onPass;
+    /**
+     * The program was just bound, set its per frame uniforms.
+     */
+    std::function<void(GLuint program)> onProgram;
+    /**
+     * The material changed or the program did, bind the material.
+     */
+    std::function<void(GLuint program, uint32_t material)> onMaterial;
+    /**
+     * Right before the draw, set per object uniforms.
+     */
+    std::function<void(const DrawPacket &packet)> onDraw;
+  };
+
+  struct Stats {
+    size_t packets;
+    size_t passChanges;
+    size_t programChanges;
+    size_t materialChanges;
+    size_t vaoChanges;
+  };
+
+private:
+  struct SortEntry {
+    uint64_t key;
+    uint32_t buffer;
+    uint32_t packet;
+  };
+
+  /**
+   * Tells queues apart across the thread local caches, even if one is
+   * created where another was destroyed.
+   */
+  const uint64_t id;
+
+  std::mutex buffersMutex;
+  std::vector<std::unique_ptr<std::vector<DrawPacket>>> buffers;
+
+  std::vector<SortEntry> entries;
+  std::vector<SortEntry> scratch;
+
+  Stats stats{};
+
+  std::vector<DrawPacket> &getThreadBuffer();
+  void sortEntries();
+
+public:
+  RenderQueue(const RenderQueue &) = delete;
+
+  RenderQueue();
+
+  /**
+   * Thread safe, but must not overlap with `execute` or `clear`.
+   */
+  void submit(const DrawPacket &packet);
+
+  /**
+   * Issues every packet recorded since the last `execute` or `clear` in key
+   * order, then empties the queue. GL thread only.
+   */
+  void execute(const Callbacks &callbacks);
+
+  /**
+   * Drops the recorded packets without drawing them.
+   */
+  void clear();
+
+  /**
+   * Counts of the last `execute`.
+   */
+  inline const Stats &getStats() const { return stats; }
+};
+} // namespace ofyaGl
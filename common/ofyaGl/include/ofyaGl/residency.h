@@ -0,0 +1,181 @@
+#pragma once
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <ofyaGl/job.h>
+#include <ofyaGl/mesh.h>
+#include <ofyaGl/paged_mesh.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace ofyaGl {
+
+struct ResidencyParams {
+  /**
+   * Pages the GPU pool holds, each slot fits the largest page. Together with
+   * `maxLoadsInFlight` this bounds the memory used, whatever the mesh size.
+   * Needs to exceed the number of chunks visible at once, otherwise every
+   * slot stays in use and chunks keep their stand-in levels.
+   */
+  size_t slotCount = 256;
+  /**
+   * Simplification error in pixels a chunk may show before a finer level is
+   * wanted.
+   */
+  float maxScreenError = 1.f;
+  size_t maxLoadsInFlight = 16;
+  /**
+   * Decoded pages written to the pool per `update`, the rest wait a frame.
+   */
+  size_t maxUploadsPerFrame = 8;
+};
+
+/**
+ * Streams the pages of a `PagedMesh` through a fixed pool of GPU slots.
+ *
+ * Every `update` culls the chunks against the frustum and picks for each the
+ * coarsest level whose error projects below `maxScreenError` pixels. Missing
+ * pages are decoded from the memory mapped file on the job system, nearest
+ * to the error budget first, and handed back through a completion queue;
+ * the GL thread uploads a few per frame into free slots or evicts the least
+ * recently drawn ones. Until its wanted page arrives a chunk is drawn with
+ * the closest level that is resident, so nothing pops out while loading.
+ */
+class ResidencyManager {
+public:
+  struct Stats {
+    size_t residentPages;
+    size_t loadsInFlight;
+    uint64_t pagesLoaded;
+    uint64_t pagesEvicted;
+    /**
+     * Loaded pages thrown away because every slot was still in use.
+     */
+    uint64_t pagesDropped;
+    size_t visibleChunks;
+    size_t culledChunks;
+    /**
+     * Visible chunks drawn at another level than wanted, or not at all.
+     */
+    size_t fallbackChunks;
+    size_t drawnTriangles;
+  };
+
+private:
+  static constexpr uint32_t NO_SLOT = ~0u;
+
+  struct Slot {
+    uint32_t page = NO_SLOT;
+    uint64_t lastUsed = 0;
+  };
+
+  struct LoadedPage {
+    uint32_t page;
+    bool valid;
+    std::vector<Vertex> verts;
+    std::vector<uint32_t> indices;
+  };
+
+  struct Request {
+    uint32_t page;
+    float priority;
+  };
+
+  struct Draw {
+    uint32_t slot;
+    uint32_t indexCount;
+  };
+
+  struct FrameFence {
+    uint64_t frame;
+    GLsync sync;
+  };
+
+  const PagedMesh &pagedMesh;
+  JobSystem &jobSystem;
+  const ResidencyParams params;
+
+  Mesh pool;
+  std::vector<Slot> slots;
+  std::vector<uint32_t> pageSlots;
+  std::vector<bool> pageLoading;
+
+  std::mutex completedMutex;
+  std::vector<LoadedPage> completed;
+  std::vector<LoadedPage> uploadQueue;
+  std::vector<TaskHandle> loads;
+
+  std::vector<Request> requests;
+  std::vector<Draw> draws;
+  uint64_t frame = 0;
+  /**
+   * Pool writes are unsynchronized, only slots last drawn in a frame the GPU
+   * has finished are rewritten.
+   */
+  std::deque<FrameFence> fences;
+  uint64_t completedFrame = 0;
+  Stats stats{};
+
+  void load(uint32_t page);
+
+  /**
+   * Forgets decoded pages that weren't uploaded. No load may be running.
+   */
+  void dropQueuedPages();
+
+  /**
+   * A free slot, or the least recently drawn one the GPU is done with.
+   * Returns `NO_SLOT` if every slot is in use.
+   */
+  uint32_t acquireSlot();
+  void upload(LoadedPage &loadedPage);
+
+  /**
+   * The resident level of `chunk` closest to `lod`, finer ones first.
+   * Returns `NO_SLOT` if none is resident.
+   */
+  uint32_t findResidentPage(const PagedChunk &chunk, uint32_t lod) const;
+
+public:
+  ResidencyManager(const ResidencyManager &) = delete;
+
+  /**
+   * Allocates the GPU pool, GL thread only. `pagedMesh` must outlive the
+   * manager.
+   */
+  ResidencyManager(const PagedMesh &pagedMesh,
+                   const ResidencyParams &params = {},
+                   JobSystem &jobSystem = JobSystem::shared());
+  ~ResidencyManager();
+
+  /**
+   * Selects what to draw this frame, requests missing pages and uploads
+   * finished ones. `modelViewProjection` and `cameraPosition` are in mesh
+   * space. `projectionScale` turns size over distance into pixels,
+   * `viewportHeight / (2 * tan(fovY / 2))`. GL thread only.
+   */
+  void update(const glm::mat4 &modelViewProjection,
+              const glm::vec3 &cameraPosition, float projectionScale);
+
+  /**
+   * Draws the pages selected by the last `update` with whatever program is
+   * bound.
+   */
+  void draw() const;
+
+  inline const Stats &getStats() const { return stats; }
+  inline size_t getPoolBytes() const {
+    return slots.size() * (sizeof(Vertex) * pagedMesh.getMaxPageVerts() +
+                           sizeof(uint32_t) * pagedMesh.getMaxPageIndices());
+  }
+
+  /**
+   * Waits for pending loads and frees the pool.
+   */
+  void destroy();
+};
+} // namespace ofyaGl
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+namespace ofyaGl {
+
+using NodeId = uint32_t;
+constexpr NodeId NO_PARENT = std::numeric_limits<NodeId>::max();
+
+/**
+ * Transform hierarchy stored as parallel arrays.
+ *
+ * A node can only be created after its parent, so the arrays are always in
+ * topological order. `update` batches the changed nodes by depth and resolves
+ * one depth at a time, every node of a batch in parallel. Setters only flag
+ * the node, `update` recomputes the flagged nodes and everything below them
+ * and leaves the rest alone.
+ */
+class Scene {
+private:
+  std::vector<NodeId> parents;
+  /**
+   * Roots are at depth 0.
+   */
+  std::vector<uint32_t> depths;
+  std::vector<glm::vec3> positions;
+  std::vector<glm::quat> rotations;
+  std::vector<glm::vec3> scales;
+
+  std::vector<glm::mat4> localMatrices;
+  std::vector<glm::mat4> worldMatrices;
+  std::vector<glm::mat3> normalMatrices;
+
+  /**
+   * Local transform changed since the last `update`.
+   */
+  std::vector<uint8_t> dirty;
+  NodeId firstDirty = NO_PARENT;
+
+  /**
+   * Nodes recomputed by the last `update`, sorted by depth and increasing
+   * within a depth.
+   */
+  std::vector<NodeId> updated;
+  /**
+   * Scratch for `update`: the changed nodes in index order, and the end of
+   * each depth's batch in `updated`.
+   */
+  std::vector<NodeId> changed;
+  std::vector<size_t> depthEnds;
+
+  inline void markDirty(NodeId node) {
+    dirty[node] = 1;
+    firstDirty = std::min(firstDirty, node);
+  }
+
+  /**
+   * Local, world and normal matrix of one changed node, its parent has to be
+   * up to date.
+   */
+  void updateNode(NodeId node);
+
+public:
+  Scene() = default;
+  Scene(const Scene &) = delete;
+
+  void reserve(size_t nodeCount);
+
+  /**
+   * Creates a node with an identity transform. Fails if `parent` isn't an
+   * existing node.
+   */
+  std::optional<NodeId> createNode(NodeId parent = NO_PARENT);
+
+  inline void setPosition(NodeId node, const glm::vec3 &position) {
+    positions[node] = position;
+    markDirty(node);
+  }
+  inline void setRotation(NodeId node, const glm::quat &rotation) {
+    rotations[node] = rotation;
+    markDirty(node);
+  }
+  inline void setScale(NodeId node, const glm::vec3 &scale) {
+    scales[node] = scale;
+    markDirty(node);
+  }
+
+  inline NodeId getParent(NodeId node) const { return parents[node]; }
+  inline const glm::vec3 &getPosition(NodeId node) const {
+    return positions[node];
+  }
+  inline const glm::quat &getRotation(NodeId node) const {
+    return rotations[node];
+  }
+  inline const glm::vec3 &getScale(NodeId node) const { return scales[node]; }
+
+  /**
+   * Valid after `update`.
+   */
+  inline const glm::mat4 &getWorldMatrix(NodeId node) const {
+    return worldMatrices[node];
+  }
+
+  /**
+   * Inverse transpose of the upper 3x3 of the world matrix, valid after
+   * `update`. For a rigid view matrix the model view normal matrix is
+   * `glm::mat3(view) * getNormalMatrix(node)`.
+   */
+  inline const glm::mat3 &getNormalMatrix(NodeId node) const {
+    return normalMatrices[node];
+  }
+
+  /**
+   * Recomputes the world and normal matrices of every changed node and its
+   * descendants. Returns how many nodes were touched.
+   */
+  size_t update();
+
+  inline const std::vector<NodeId> &getUpdatedNodes() const {
+    return updated;
+  }
+  inline size_t size() const { return parents.size(); }
+};
+} // namespace ofyaGl
@@ -4,16 +4,26 @@
 #include <glm/matrix.hpp>
 #include <ofyaGl/gl.h>
 
+#include <cstddef>
 #include <map>
+#include <string>
 
 namespace ofyaGl {
 
+/**
+ * `#define`s injected right after `#version`, name to value. Ordered, so
+ * equal sets always produce the same source.
+ */
+using ShaderDefines = std::map<std::string, std::string>;
+
 class Shader {
 private:
   GLuint programId;
+  size_t sourceBytes;
   std::map<const char *, GLuint> uniformToPos;
 
-  Shader(GLuint id) : programId(id) {};
+  Shader(GLuint id, size_t sourceBytes = 0)
+      : programId(id), sourceBytes(sourceBytes) {};
 
   /**
    * Returns 0 on failure
@@ -23,16 +33,25 @@ private:
 public:
   Shader() = delete;
   Shader(const Shader &) = delete;
+  Shader(Shader &&other) noexcept;
+  Shader &operator=(Shader &&other) noexcept;
 
   /**
-   * Check `Shader::isValid` afterwards.
+   * Check `Shader::isValid` afterwards. `label` names the program in GL
+   * debug output.
    */
-  static Shader fromSrc(const char *vertSrc, const char *fragSrc);
+  static Shader fromSrc(const char *vertSrc, const char *fragSrc,
+                        const std::string &label = "");
 
   /**
-   * Check `Shader::isValid` afterwards.
+   * Reads both stages relative to `ICG_SHADER_DIR` and expands
+   * `#include "file"` lines, relative to the including file first and
+   * `ICG_SHADER_DIR` second. A file is included at most once per stage.
+   * `defines` are inserted after the `#version` line. Check
+   * `Shader::isValid` afterwards.
    */
-  static Shader fromFile(const char *vertFile, const char *fragFile);
+  static Shader fromFile(const char *vertFile, const char *fragFile,
+                         const ShaderDefines &defines = {});
 
   inline void use() { GL_CALL(glUseProgram(programId)) }
   inline void stop_use() { GL_CALL(glUseProgram(0)); }
@@ -44,7 +63,18 @@ public:
   void setUniform(const char *uniformName, const glm::mat3 mat3);
   void setUniform(const GLuint uniformPosition, const glm::vec3 vec3) const;
   void setUniform(const char *uniformName, const glm::vec3 vec3);
+  void setUniform(const GLuint uniformPosition, const glm::vec2 vec2) const;
+  void setUniform(const char *uniformName, const glm::vec2 vec2);
+  void setUniform(const GLuint uniformPosition, const glm::ivec3 ivec3) const;
+  void setUniform(const char *uniformName, const glm::ivec3 ivec3);
+  void setUniform(const GLuint uniformPosition, const float value) const;
+  void setUniform(const char *uniformName, const float value);
+  void setUniform(const GLuint uniformPosition, const int value) const;
+  void setUniform(const char *uniformName, const int value);
 
+  inline GLuint getId() const { return programId; }
   inline bool isValid() { return programId != 0; }
+
+  void destroy();
 };
 } // namespace ofyaGl
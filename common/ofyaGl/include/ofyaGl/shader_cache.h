@@ -0,0 +1,63 @@
+#pragma once
+
+#include <ofyaGl/shader.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace ofyaGl {
+
+/**
+ * Programs built from the same pair of files with different `#define` sets,
+ * compiled the first time a set is asked for.
+ *
+ * Feature toggles become separate specialized programs instead of uniform
+ * branches or copies of a file. Permutations are keyed by a 64 bit hash of
+ * the file names and the define set; failures are cached too, so a broken
+ * permutation is reported once instead of being recompiled every frame.
+ */
+class ShaderCache {
+public:
+  struct Stats {
+    /**
+     * Permutations compiled, including the ones that failed.
+     */
+    uint64_t compiles;
+    uint64_t failures;
+    /**
+     * `get` calls answered without compiling.
+     */
+    uint64_t hits;
+    double compileSeconds;
+  };
+
+private:
+  std::unordered_map<uint64_t, Shader> permutations;
+  Stats stats{};
+
+public:
+  ShaderCache() = default;
+  ShaderCache(const ShaderCache &) = delete;
+  ShaderCache &operator=(const ShaderCache &) = delete;
+
+  static uint64_t getKey(const char *vertFile, const char *fragFile,
+                         const ShaderDefines &defines);
+
+  /**
+   * The program for `defines`, compiled through `Shader::fromFile` on first
+   * use. Check `Shader::isValid`. The reference stays valid until `destroy`.
+   */
+  Shader &get(const char *vertFile, const char *fragFile,
+              const ShaderDefines &defines = {});
+
+  inline size_t getPermutationCount() const { return permutations.size(); }
+  inline const Stats &getStats() const { return stats; }
+
+  /**
+   * Deletes every program.
+   */
+  void destroy();
+};
+} // namespace ofyaGl
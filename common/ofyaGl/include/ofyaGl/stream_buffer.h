@@ -0,0 +1,134 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace ofyaGl {
+
+/**
+ * Slice of a `StreamBuffer` handed out for this frame. Write through `data`,
+ * bind with `offset` and `size`.
+ */
+struct StreamRange {
+  uint8_t *data;
+  GLintptr offset;
+  GLsizeiptr size;
+};
+
+/**
+ * Ring buffer for data rewritten every frame, like uniforms, instance
+ * transforms or dynamic geometry.
+ *
+ * With `glBufferStorage` (4.4 or `ARB_buffer_storage`) the buffer holds
+ * `regionCount` frame regions in one persistently and coherently mapped
+ * store. Each frame writes the next region in place, and a fence placed at
+ * `endFrame` keeps the CPU from wrapping around onto a region the GPU still
+ * reads, so there is neither a copy nor a stall while the GPU keeps up.
+ *
+ * On plain 3.3 writes go to a CPU staging copy that `commit` uploads into
+ * freshly orphaned storage, which lets the driver do the renaming.
+ *
+ * Per frame: `beginFrame`, any number of `acquire`, `commit` before the
+ * first draw reading the data, `endFrame` after the last one.
+ */
+class StreamBuffer {
+public:
+  struct Stats {
+    /**
+     * Frames that had to wait for the GPU to release their region.
+     */
+    uint64_t stalls;
+    double stallSeconds;
+    /**
+     * `acquire` calls that didn't fit the region.
+     */
+    uint64_t overflows;
+    /**
+     * Bytes handed out in the current frame.
+     */
+    size_t frameBytes;
+  };
+
+  static constexpr int MAX_REGIONS = 4;
+
+private:
+  GLuint buffer;
+  GLenum target;
+  size_t regionSize;
+  int regionCount;
+  size_t alignment;
+  bool persistent;
+
+  uint8_t *mapped = nullptr;
+  std::vector<uint8_t> staging;
+  GLsync fences[MAX_REGIONS] = {};
+  int region = 0;
+  size_t cursor = 0;
+
+  Stats stats{};
+
+  StreamBuffer(GLuint buffer, GLenum target, size_t regionSize,
+               int regionCount, size_t alignment, bool persistent)
+      : buffer(buffer), target(target), regionSize(regionSize),
+        regionCount(regionCount), alignment(alignment),
+        persistent(persistent) {};
+
+  inline size_t getRegionOffset() const {
+    return persistent ? regionSize * region : 0;
+  }
+
+public:
+  StreamBuffer() : StreamBuffer(0, GL_ARRAY_BUFFER, 0, 0, 1, false) {};
+  StreamBuffer(const StreamBuffer &) = delete;
+  StreamBuffer &operator=(const StreamBuffer &) = delete;
+  StreamBuffer(StreamBuffer &&other) noexcept;
+  StreamBuffer &operator=(StreamBuffer &&other) noexcept;
+
+  /**
+   * `regionSize` bytes are available per frame. `load` looks up
+   * `glBufferStorage`, pass `glfwGetProcAddress`, or nullptr to always take
+   * the orphaning path. Check `isValid` afterwards.
+   */
+  static StreamBuffer allocate(GLenum target, size_t regionSize,
+                               int regionCount = 3,
+                               GLADloadfunc load = nullptr);
+
+  /**
+   * Moves to the next region, waiting for the GPU if it still reads it.
+   */
+  void beginFrame();
+
+  /**
+   * `size` bytes from this frame's region, aligned to `alignment` and to
+   * whatever the target demands, e.g. `GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT`.
+   * Empty if the region is used up.
+   */
+  std::optional<StreamRange> acquire(size_t size, size_t alignment = 16);
+
+  /**
+   * Makes this frame's writes visible to GL. Call before drawing with them.
+   */
+  void commit();
+
+  /**
+   * Fences the region, call after the last draw that reads it.
+   */
+  void endFrame();
+
+  /**
+   * `glBindBufferRange` for indexed targets like `GL_UNIFORM_BUFFER`.
+   */
+  void bindRange(GLuint index, const StreamRange &range) const;
+
+  inline GLuint getId() const { return buffer; }
+  inline bool isPersistent() const { return persistent; }
+  inline const Stats &getStats() const { return stats; }
+  inline bool isValid() const { return buffer != 0; }
+
+  void destroy();
+};
+} // namespace ofyaGl
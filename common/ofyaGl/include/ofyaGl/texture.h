@@ -0,0 +1,144 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <ofyaGl/bc.h>
+#include <ofyaGl/gl.h>
+#include <ofyaGl/image.h>
+#include <ofyaGl/job.h>
+#include <ofyaGl/mapped_file.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace ofyaGl {
+
+/**
+ * One mip level, `data` is `size` bytes of `TextureData::getFormat`.
+ */
+struct TextureLevel {
+  int width;
+  int height;
+  const uint8_t *data;
+  size_t size;
+};
+
+/**
+ * CPU side of a texture, a full mip chain in its final storage format.
+ *
+ * The level bytes either live in a memory mapped cache file or, right after
+ * the source image was encoded, in an owned buffer.
+ */
+class TextureData {
+private:
+  friend std::optional<TextureData>
+  loadTextureData(const char *fileName, TextureFormat format, MipFilter filter,
+                  JobSystem &jobSystem);
+
+  TextureFormat format = TextureFormat::RGBA8;
+  std::vector<TextureLevel> levels;
+  MappedFile mapping;
+  std::vector<uint8_t> storage;
+
+public:
+  TextureData() = default;
+  TextureData(const TextureData &) = delete;
+  TextureData(TextureData &&) = default;
+  TextureData &operator=(TextureData &&) = default;
+
+  inline TextureFormat getFormat() const { return format; }
+  inline const std::vector<TextureLevel> &getLevels() const { return levels; }
+  inline bool isFromCache() const { return mapping.data() != nullptr; }
+
+  /**
+   * Bytes of every level together.
+   */
+  size_t getByteSize() const;
+};
+
+/**
+ * Loads `fileName` relative to `ICG_TEXTURE_DIR` as `format`.
+ *
+ * With `ICG_CACHE_DIR` set the encoded mip chain is kept there and reused as
+ * long as the source file's size and modification time still match, so later
+ * runs skip decoding, filtering and compression and only map the file.
+ */
+std::optional<TextureData>
+loadTextureData(const char *fileName, TextureFormat format,
+                MipFilter filter = MipFilter::Box,
+                JobSystem &jobSystem = JobSystem::shared());
+
+/**
+ * GPU side of a `TextureData`, a 2D texture with trilinear filtering.
+ */
+class Texture {
+private:
+  GLuint id;
+  int width;
+  int height;
+  int levelCount;
+  TextureFormat format;
+  size_t byteSize = 0;
+
+  Texture(GLuint id, int width, int height, int levelCount,
+          TextureFormat format)
+      : id(id), width(width), height(height), levelCount(levelCount),
+        format(format) {};
+
+public:
+  Texture() : Texture(0, 0, 0, 0, TextureFormat::RGBA8) {};
+  Texture(const Texture &) = delete;
+  Texture &operator=(const Texture &) = delete;
+  Texture(Texture &&other) noexcept;
+  Texture &operator=(Texture &&other) noexcept;
+
+  /**
+   * Whether the driver takes `format` as is. Unsupported block formats are
+   * expanded to RGBA8 on upload.
+   */
+  static bool isFormatSupported(TextureFormat format);
+
+  /**
+   * Creates the texture object. Fill every level with `uploadLevel` before
+   * sampling from it.
+   */
+  static Texture allocate(TextureFormat format, int width, int height,
+                          int levelCount);
+
+  /**
+   * Uploads everything in one go.
+   */
+  static Texture fromData(const TextureData &data);
+
+  /**
+   * `data` must be in the format given to `allocate`.
+   */
+  void uploadLevel(int level, const TextureLevel &data);
+
+  inline void bind(GLuint unit) const {
+    GL_CALL(glActiveTexture(GL_TEXTURE0 + unit));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, id));
+  }
+
+  inline GLuint getId() const { return id; }
+  inline int getWidth() const { return width; }
+  inline int getHeight() const { return height; }
+  inline int getLevelCount() const { return levelCount; }
+
+  /**
+   * Video memory taken by the levels uploaded so far.
+   */
+  inline size_t getByteSize() const { return byteSize; }
+
+  /**
+   * Names the texture in GL debug output.
+   */
+  void setLabel(const std::string &label) const;
+
+  inline bool isValid() const { return id != 0; }
+
+  void destroy();
+};
+} // namespace ofyaGl
@@ -4,19 +4,90 @@
 
 #include <GLFW/glfw3.h>
 
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
 namespace ofyaGl {
+
+enum class SwapMode {
+  VSync,
+  /**
+   * Vsync that tears instead of waiting a whole extra refresh when a frame
+   * is late. Needs `*_EXT_swap_control_tear`, plain vsync otherwise.
+   */
+  Adaptive,
+  Uncapped
+};
+
+/**
+ * Summary of the recent frame history, in seconds.
+ */
+struct FrameStats {
+  size_t frameCount;
+  double average;
+  double min;
+  double max;
+  double p99;
+  /**
+   * Exponential moving average of the frame time, a delta that doesn't
+   * jump with every hitch.
+   */
+  double smoothed;
+
+  /**
+   * From GLFW delivering an input event to the swap of the first frame
+   * rendered after it, zero without input in the history.
+   */
+  size_t inputCount;
+  double averageInputLatency;
+  double maxInputLatency;
+};
+
 class Window {
 private:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Frames and input samples kept for `getFrameStats`.
+   */
+  static constexpr size_t FRAME_HISTORY = 256;
+
   GLFWwindow *window;
 
   struct WindowData {
     int width;
     int height;
+    bool inputPending = false;
+    Clock::time_point inputTime;
     // TODO introduce someway to specify an event function
   };
 
   WindowData windowData;
 
+  SwapMode swapMode = SwapMode::VSync;
+  Clock::duration framePeriod = Clock::duration::zero();
+  Clock::time_point nextFrame;
+  Clock::time_point lastSwap;
+  bool hasSwapped = false;
+
+  std::vector<float> frameTimes;
+  std::vector<float> inputLatencies;
+  size_t frameTimeCount = 0;
+  size_t inputLatencyCount = 0;
+  double smoothedFrameTime = 0.0;
+
+  /**
+   * Stamps the first input event since the last swap.
+   */
+  static void markInput(GLFWwindow *window);
+
+  /**
+   * Sleeps most of the way to `nextFrame` and spins the rest, sleeping
+   * alone overshoots by up to a scheduler quantum.
+   */
+  void waitForNextFrame(Clock::time_point now);
+
 public:
   Window() = delete;
   Window(const Window &) = delete;
@@ -24,9 +95,38 @@ public:
   Window(int widht, int height, const char *title);
 
   inline bool shouldClose() { return glfwWindowShouldClose(window); }
-  inline void swapBuffers() { return glfwSwapBuffers(window); }
+  inline void close() { glfwSetWindowShouldClose(window, GLFW_TRUE); }
+
+  /**
+   * Records the frame time and input latency, holds the frame limit and
+   * ends the frame for `GlDebug`'s sampled error checks. The limiter waits
+   * after the swap, so the next frame polls input as late as possible.
+   */
+  void swapBuffers();
   inline void pollEvents() { return glfwPollEvents(); }
 
+  /**
+   * Returns false if `mode` isn't available and vsync is used instead.
+   */
+  bool setSwapMode(SwapMode mode);
+  inline SwapMode getSwapMode() const { return swapMode; }
+
+  /**
+   * Caps the frame rate at `framesPerSecond`, 0 removes the cap. Works on
+   * top of any swap mode.
+   */
+  void setFrameLimit(double framesPerSecond);
+
+  FrameStats getFrameStats() const;
+
+  /**
+   * Smoothed duration of the recent frames, for animation deltas.
+   */
+  inline double getSmoothedFrameTime() const { return smoothedFrameTime; }
+
+  inline int getWidth() const { return windowData.width; }
+  inline int getHeight() const { return windowData.height; }
+
   void terminate();
 };
 } // namespace ofyaGl
@@ -0,0 +1,404 @@
+#include <ofyaGl/ambient_occlusion.h>
+
+#include <glm/geometric.hpp>
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define OFYAGL_AO_SSE
+#endif
+
+namespace ofyaGl {
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Vertices per task while tracing.
+ */
+constexpr size_t TRACE_GRAIN = 64;
+
+/**
+ * Triangles per leaf, one `TriangleBlock`.
+ */
+constexpr uint32_t LEAF_SIZE = 4;
+
+/**
+ * Median splits halve every level, so this covers far more triangles than
+ * fit in memory.
+ */
+constexpr size_t MAX_BVH_DEPTH = 64;
+
+/**
+ * Four triangles side by side, one per lane, as a corner and the edges to
+ * the other two. Unused lanes are all zero, which no ray hits.
+ */
+struct alignas(16) TriangleBlock {
+  float v0[3][4];
+  float edge1[3][4];
+  float edge2[3][4];
+};
+
+/**
+ * Leaves have a non zero `count` of triangles in block `first`. Inner nodes
+ * have their children at `first` and `first + 1`.
+ */
+struct BvhNode {
+  glm::vec3 min;
+  uint32_t first;
+  glm::vec3 max;
+  uint32_t count;
+};
+
+/**
+ * Ray with what the box tests need precomputed.
+ */
+struct Ray {
+  glm::vec3 origin;
+  glm::vec3 direction;
+  glm::vec3 inverseDirection;
+  float minDistance;
+  float maxDistance;
+};
+
+/**
+ * Median split bounding volume hierarchy, only answering whether anything
+ * is hit at all.
+ */
+class TriangleBvh {
+private:
+  std::vector<BvhNode> nodes;
+  std::vector<TriangleBlock> blocks;
+
+  static bool hitsBox(const BvhNode &node, const Ray &ray) {
+    float nearest = ray.minDistance;
+    float farthest = ray.maxDistance;
+    for (int axis = 0; axis < 3; axis++) {
+      float t0 = (node.min[axis] - ray.origin[axis]) *
+                 ray.inverseDirection[axis];
+      float t1 = (node.max[axis] - ray.origin[axis]) *
+                 ray.inverseDirection[axis];
+      if (t0 > t1) {
+        std::swap(t0, t1);
+      }
+      nearest = std::max(nearest, t0);
+      farthest = std::min(farthest, t1);
+    }
+    return nearest <= farthest;
+  }
+
+  /**
+   * Möller-Trumbore on all four lanes.
+   */
+  static bool hitsBlock(const TriangleBlock &block, const Ray &ray) {
+#ifdef OFYAGL_AO_SSE
+    const __m128 dx = _mm_set1_ps(ray.direction.x);
+    const __m128 dy = _mm_set1_ps(ray.direction.y);
+    const __m128 dz = _mm_set1_ps(ray.direction.z);
+    const __m128 e1x = _mm_load_ps(block.edge1[0]);
+    const __m128 e1y = _mm_load_ps(block.edge1[1]);
+    const __m128 e1z = _mm_load_ps(block.edge1[2]);
+    const __m128 e2x = _mm_load_ps(block.edge2[0]);
+    const __m128 e2y = _mm_load_ps(block.edge2[1]);
+    const __m128 e2z = _mm_load_ps(block.edge2[2]);
+
+    const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    const __m128 det =
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)),
+                   _mm_mul_ps(e1z, pz));
+    const __m128 zero = _mm_setzero_ps();
+    // Parallel rays and empty lanes, their garbage below is masked off
+    __m128 hit = _mm_cmpneq_ps(det, zero);
+    const __m128 inverseDet = _mm_div_ps(_mm_set1_ps(1.f), det);
+
+    const __m128 tx =
+        _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_load_ps(block.v0[0]));
+    const __m128 ty =
+        _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_load_ps(block.v0[1]));
+    const __m128 tz =
+        _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_load_ps(block.v0[2]));
+    const __m128 u = _mm_mul_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)),
+                   _mm_mul_ps(tz, pz)),
+        inverseDet);
+    hit = _mm_and_ps(hit, _mm_cmpge_ps(u, zero));
+
+    const __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+    const __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+    const __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+    const __m128 v = _mm_mul_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)),
+                   _mm_mul_ps(dz, qz)),
+        inverseDet);
+    hit = _mm_and_ps(hit, _mm_cmpge_ps(v, zero));
+    hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.f)));
+
+    const __m128 t = _mm_mul_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)),
+                   _mm_mul_ps(e2z, qz)),
+        inverseDet);
+    hit = _mm_and_ps(hit, _mm_cmpgt_ps(t, _mm_set1_ps(ray.minDistance)));
+    hit = _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_set1_ps(ray.maxDistance)));
+    return _mm_movemask_ps(hit) != 0;
+#else
+    for (int lane = 0; lane < 4; lane++) {
+      const glm::vec3 edge1(block.edge1[0][lane], block.edge1[1][lane],
+                            block.edge1[2][lane]);
+      const glm::vec3 edge2(block.edge2[0][lane], block.edge2[1][lane],
+                            block.edge2[2][lane]);
+      const glm::vec3 p = glm::cross(ray.direction, edge2);
+      const float det = glm::dot(edge1, p);
+      if (det == 0.f) {
+        continue;
+      }
+      const float inverseDet = 1.f / det;
+      const glm::vec3 toOrigin =
+          ray.origin - glm::vec3(block.v0[0][lane], block.v0[1][lane],
+                                 block.v0[2][lane]);
+      const float u = glm::dot(toOrigin, p) * inverseDet;
+      const glm::vec3 q = glm::cross(toOrigin, edge1);
+      const float v = glm::dot(ray.direction, q) * inverseDet;
+      const float t = glm::dot(edge2, q) * inverseDet;
+      if (u >= 0.f && v >= 0.f && u + v <= 1.f && t > ray.minDistance &&
+          t < ray.maxDistance) {
+        return true;
+      }
+    }
+    return false;
+#endif
+  }
+
+public:
+  TriangleBvh(const std::vector<Vertex> &verts,
+              const std::vector<unsigned int> &indicies) {
+    const size_t triangleCount = indicies.size() / 3;
+    if (triangleCount == 0) {
+      return;
+    }
+    auto getCorner = [&](size_t triangle, int corner) {
+      const VertPos &pos = verts[indicies[triangle * 3 + corner]].pos;
+      return glm::vec3(pos.x, pos.y, pos.z);
+    };
+    std::vector<glm::vec3> centroids(triangleCount);
+    for (size_t i = 0; i < triangleCount; i++) {
+      centroids[i] =
+          (getCorner(i, 0) + getCorner(i, 1) + getCorner(i, 2)) / 3.f;
+    }
+    std::vector<uint32_t> order(triangleCount);
+    std::iota(order.begin(), order.end(), 0);
+
+    struct Range {
+      uint32_t node;
+      size_t begin;
+      size_t end;
+    };
+    std::vector<Range> ranges{Range{0, 0, triangleCount}};
+    nodes.reserve(triangleCount / LEAF_SIZE * 2 + 1);
+    nodes.push_back(BvhNode{});
+    while (!ranges.empty()) {
+      const Range range = ranges.back();
+      ranges.pop_back();
+
+      glm::vec3 min(INFINITY), max(-INFINITY);
+      glm::vec3 centroidMin(INFINITY), centroidMax(-INFINITY);
+      for (size_t i = range.begin; i < range.end; i++) {
+        for (int corner = 0; corner < 3; corner++) {
+          min = glm::min(min, getCorner(order[i], corner));
+          max = glm::max(max, getCorner(order[i], corner));
+        }
+        centroidMin = glm::min(centroidMin, centroids[order[i]]);
+        centroidMax = glm::max(centroidMax, centroids[order[i]]);
+      }
+      nodes[range.node].min = min;
+      nodes[range.node].max = max;
+
+      const size_t count = range.end - range.begin;
+      if (count <= LEAF_SIZE) {
+        TriangleBlock block{};
+        for (size_t lane = 0; lane < count; lane++) {
+          const uint32_t triangle = order[range.begin + lane];
+          const glm::vec3 v0 = getCorner(triangle, 0);
+          const glm::vec3 edge1 = getCorner(triangle, 1) - v0;
+          const glm::vec3 edge2 = getCorner(triangle, 2) - v0;
+          for (int axis = 0; axis < 3; axis++) {
+            block.v0[axis][lane] = v0[axis];
+            block.edge1[axis][lane] = edge1[axis];
+            block.edge2[axis][lane] = edge2[axis];
+          }
+        }
+        nodes[range.node].first = static_cast<uint32_t>(blocks.size());
+        nodes[range.node].count = static_cast<uint32_t>(count);
+        blocks.push_back(block);
+        continue;
+      }
+
+      const glm::vec3 extent = centroidMax - centroidMin;
+      const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0
+                       : extent.y >= extent.z                       ? 1
+                                                                    : 2;
+      const size_t middle = range.begin + count / 2;
+      std::nth_element(order.begin() + range.begin, order.begin() + middle,
+                       order.begin() + range.end,
+                       [&](uint32_t a, uint32_t b) {
+                         return centroids[a][axis] < centroids[b][axis];
+                       });
+      const uint32_t children = static_cast<uint32_t>(nodes.size());
+      nodes[range.node].first = children;
+      nodes[range.node].count = 0;
+      nodes.push_back(BvhNode{});
+      nodes.push_back(BvhNode{});
+      ranges.push_back(Range{children, range.begin, middle});
+      ranges.push_back(Range{children + 1, middle, range.end});
+    }
+  }
+
+  inline size_t getNodeCount() const { return nodes.size(); }
+
+  bool isOccluded(const Ray &ray) const {
+    if (nodes.empty()) {
+      return false;
+    }
+    uint32_t stack[MAX_BVH_DEPTH];
+    size_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+      const BvhNode &node = nodes[stack[--stackSize]];
+      if (!hitsBox(node, ray)) {
+        continue;
+      }
+      if (node.count > 0) {
+        if (hitsBlock(blocks[node.first], ray)) {
+          return true;
+        }
+      } else {
+        stack[stackSize++] = node.first;
+        stack[stackSize++] = node.first + 1;
+      }
+    }
+    return false;
+  }
+};
+
+/**
+ * Area weighted normals for vertices that come without one.
+ */
+static std::vector<glm::vec3> getFaceNormals(const ObjData &objData) {
+  std::vector<glm::vec3> normals(objData.verts.size(), glm::vec3(0.f));
+  for (size_t i = 0; i + 2 < objData.indicies.size(); i += 3) {
+    glm::vec3 corners[3];
+    for (int corner = 0; corner < 3; corner++) {
+      const VertPos &pos = objData.verts[objData.indicies[i + corner]].pos;
+      corners[corner] = glm::vec3(pos.x, pos.y, pos.z);
+    }
+    const glm::vec3 normal =
+        glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+    for (int corner = 0; corner < 3; corner++) {
+      normals[objData.indicies[i + corner]] += normal;
+    }
+  }
+  return normals;
+}
+
+static inline float getRotation(size_t vertex) {
+  uint32_t hash = static_cast<uint32_t>(vertex) * 2654435761u;
+  hash ^= hash >> 16;
+  return static_cast<float>(hash >> 8) / 16777216.f;
+}
+
+AmbientOcclusionStats bakeAmbientOcclusion(ObjData &objData,
+                                           const AmbientOcclusionParams &params,
+                                           JobSystem &jobSystem) {
+  AmbientOcclusionStats stats{};
+  std::vector<Vertex> &verts = objData.verts;
+  if (verts.empty() || params.rayCount == 0) {
+    return stats;
+  }
+
+  auto start = Clock::now();
+  const TriangleBvh bvh(verts, objData.indicies);
+  glm::vec3 min(INFINITY), max(-INFINITY);
+  bool missingNormals = false;
+  for (const Vertex &vertex : verts) {
+    const glm::vec3 pos(vertex.pos.x, vertex.pos.y, vertex.pos.z);
+    min = glm::min(min, pos);
+    max = glm::max(max, pos);
+    missingNormals |= vertex.normal.x == 0.f && vertex.normal.y == 0.f &&
+                      vertex.normal.z == 0.f;
+  }
+  const std::vector<glm::vec3> faceNormals =
+      missingNormals ? getFaceNormals(objData) : std::vector<glm::vec3>();
+  const float diagonal = glm::length(max - min);
+  // Keeps rays from hitting the triangles around their own vertex
+  const float bias = diagonal * 1e-4f;
+  stats.bvhNodes = bvh.getNodeCount();
+  stats.buildSeconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  start = Clock::now();
+  const uint32_t rayCount = params.rayCount;
+  jobSystem.parallelFor(0, verts.size(), TRACE_GRAIN, [&](size_t begin,
+                                                          size_t end) {
+    for (size_t v = begin; v < end; v++) {
+      Vertex &vertex = verts[v];
+      glm::vec3 normal(vertex.normal.x, vertex.normal.y, vertex.normal.z);
+      if (glm::dot(normal, normal) == 0.f) {
+        normal = faceNormals[v];
+      }
+      if (glm::dot(normal, normal) == 0.f) {
+        vertex.texCoord.t = 1.f;
+        continue;
+      }
+      normal = glm::normalize(normal);
+
+      // Orthonormal basis around the normal (Duff et al. 2017)
+      const float sign = std::copysign(1.f, normal.z);
+      const float a = -1.f / (sign + normal.z);
+      const float b = normal.x * normal.y * a;
+      const glm::vec3 tangent(1.f + sign * normal.x * normal.x * a, sign * b,
+                              -sign * normal.x);
+      const glm::vec3 bitangent(b, sign + normal.y * normal.y * a,
+                                -normal.y);
+
+      Ray ray;
+      ray.origin = glm::vec3(vertex.pos.x, vertex.pos.y, vertex.pos.z) +
+                   normal * bias;
+      ray.minDistance = bias;
+      ray.maxDistance = diagonal * params.maxDistance;
+
+      // Stratified in the cosine, golden ratio steps around the normal,
+      // turned per vertex so neighbours don't band
+      const float rotation = getRotation(v);
+      uint32_t open = 0;
+      for (uint32_t i = 0; i < rayCount; i++) {
+        const float cosine2 = (i + .5f) / rayCount;
+        const float turn = (i * 0.618034f + rotation) * 6.2831853f;
+        const float radius = std::sqrt(1.f - cosine2);
+        ray.direction = tangent * (radius * std::cos(turn)) +
+                        bitangent * (radius * std::sin(turn)) +
+                        normal * std::sqrt(cosine2);
+        for (int axis = 0; axis < 3; axis++) {
+          // Infinities are fine in the slab test, except for 0 * inf
+          const float component = ray.direction[axis] != 0.f
+                                      ? ray.direction[axis]
+                                      : 1e-20f;
+          ray.inverseDirection[axis] = 1.f / component;
+        }
+        open += !bvh.isOccluded(ray);
+      }
+      vertex.texCoord.t = static_cast<float>(open) / rayCount;
+    }
+  });
+  stats.traceSeconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  stats.rays = static_cast<uint64_t>(verts.size()) * rayCount;
+  objData.hasAmbientOcclusion = true;
+  return stats;
+}
+} // namespace ofyaGl
@@ -0,0 +1,83 @@
+#include <ofyaGl/arena.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+namespace ofyaGl {
+
+Arena::Arena(size_t blockSize) : blockSize(blockSize) {}
+
+Arena::~Arena() { release(); }
+
+Arena::Block *Arena::newBlock(size_t minSize) {
+  // Room for the worst case alignment fix up inside the block
+  size_t size = std::max(blockSize, minSize + alignof(std::max_align_t));
+  void *memory = std::malloc(sizeof(Block) + size);
+  if (memory == nullptr) {
+    std::cerr << "Arena failed to allocate " << size << " bytes\n";
+    std::abort();
+  }
+
+  Block *block = static_cast<Block *>(memory);
+  block->next = nullptr;
+  block->size = size;
+  block->used = 0;
+
+  stats.upstreamAllocations++;
+  stats.bytesReserved += size;
+  return block;
+}
+
+void *Arena::allocate(size_t size, size_t alignment) {
+  while (true) {
+    if (current != nullptr) {
+      uintptr_t base = reinterpret_cast<uintptr_t>(current->data());
+      uintptr_t aligned =
+          (base + current->used + alignment - 1) & ~(uintptr_t)(alignment - 1);
+      size_t end = aligned - base + size;
+      if (end <= current->size) {
+        stats.bytesUsed += end - current->used;
+        stats.highWaterMark = std::max(stats.highWaterMark, stats.bytesUsed);
+        current->used = end;
+        return reinterpret_cast<void *>(aligned);
+      }
+
+      // Blocks kept around by `reset` get reused before asking the heap
+      if (current->next != nullptr) {
+        current = current->next;
+        continue;
+      }
+    }
+
+    Block *block = newBlock(size + alignment);
+    if (current == nullptr) {
+      head = block;
+    } else {
+      current->next = block;
+    }
+    current = block;
+  }
+}
+
+void Arena::reset() {
+  for (Block *block = head; block != nullptr; block = block->next) {
+    block->used = 0;
+  }
+  current = head;
+  stats.bytesUsed = 0;
+}
+
+void Arena::release() {
+  Block *block = head;
+  while (block != nullptr) {
+    Block *next = block->next;
+    std::free(block);
+    block = next;
+  }
+  head = current = nullptr;
+  stats.bytesReserved = 0;
+  stats.bytesUsed = 0;
+}
+} // namespace ofyaGl
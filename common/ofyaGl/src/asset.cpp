@@ -0,0 +1,235 @@
+#include <ofyaGl/asset.h>
+
+#include <ofyaGl/memory.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iterator>
+
+namespace ofyaGl {
+
+/**
+ * Moves the staging bytes of an asset out of the tracker, once its CPU copy
+ * is dropped or the asset dies before finishing the upload.
+ */
+static void releaseStaging(MemoryCategory category, size_t &stagingBytes) {
+  if (stagingBytes != 0) {
+    MemoryTracker::shared().remove(category, stagingBytes);
+    stagingBytes = 0;
+  }
+}
+
+MeshAsset::~MeshAsset() {
+  releaseStaging(MemoryCategory::MeshStaging, stagingBytes);
+}
+
+TextureAsset::~TextureAsset() {
+  releaseStaging(MemoryCategory::TextureStaging, stagingBytes);
+}
+
+AssetLoader::AssetLoader(size_t chunkBytes, JobSystem &jobSystem)
+    : jobSystem(jobSystem),
+      chunkBytes(std::max<size_t>(chunkBytes, sizeof(Vertex))) {}
+
+AssetLoader::~AssetLoader() {
+  // Parse tasks reference this loader, let them drain first
+  std::lock_guard<std::mutex> lock(parseMutex);
+  jobSystem.waitAll(parseTasks);
+}
+
+MeshHandle AssetLoader::loadMesh(const char *fileName) {
+  std::lock_guard<std::mutex> lock(parseMutex);
+  std::weak_ptr<MeshAsset> &loaded = meshesByName[fileName];
+  if (MeshHandle existing = loaded.lock()) {
+    // A failed load is retried, the file may have been fixed since
+    if (!existing->hasFailed()) {
+      return existing;
+    }
+  }
+  MeshHandle handle = std::make_shared<MeshAsset>(fileName);
+  loaded = handle;
+  pending.fetch_add(1, std::memory_order_relaxed);
+
+  parseTasks.push_back(jobSystem.submit([this, handle] { parse(handle); }));
+  return handle;
+}
+
+void AssetLoader::parse(const MeshHandle &handle) {
+  handle->state.store(AssetState::Parsing, std::memory_order_release);
+  handle->objData = loadObjDataFromFile(handle->fileName.c_str());
+  if (!handle->objData.has_value()) {
+    std::cerr << "Failed to load mesh '" << handle->fileName << "'\n";
+    handle->state.store(AssetState::Failed, std::memory_order_release);
+    pending.fetch_sub(1, std::memory_order_relaxed);
+    return;
+  }
+  const ObjData &objData = *handle->objData;
+  handle->geometryHash =
+      MeshRegistry::hashGeometry(objData.verts, objData.indicies);
+  handle->stagingBytes = sizeof(Vertex) * objData.verts.capacity() +
+                         sizeof(unsigned int) * objData.indicies.capacity();
+  MemoryTracker::shared().add(MemoryCategory::MeshStaging,
+                              handle->stagingBytes);
+
+  handle->state.store(AssetState::Uploading, std::memory_order_release);
+  std::lock_guard<std::mutex> lock(uploadMutex);
+  uploadQueue.push_back(handle);
+}
+
+TextureHandle AssetLoader::loadTexture(const char *fileName,
+                                       TextureFormat format, MipFilter filter) {
+  TextureHandle handle =
+      std::make_shared<TextureAsset>(fileName, format, filter);
+  pending.fetch_add(1, std::memory_order_relaxed);
+
+  std::lock_guard<std::mutex> lock(parseMutex);
+  parseTasks.push_back(jobSystem.submit([this, handle] { decode(handle); }));
+  return handle;
+}
+
+void AssetLoader::decode(const TextureHandle &handle) {
+  handle->state.store(AssetState::Parsing, std::memory_order_release);
+  handle->textureData = loadTextureData(handle->fileName.c_str(),
+                                        handle->format, handle->filter,
+                                        jobSystem);
+  if (!handle->textureData.has_value() ||
+      handle->textureData->getLevels().empty()) {
+    std::cerr << "Failed to load texture '" << handle->fileName << "'\n";
+    handle->state.store(AssetState::Failed, std::memory_order_release);
+    pending.fetch_sub(1, std::memory_order_relaxed);
+    return;
+  }
+  handle->stagingBytes = handle->textureData->getByteSize();
+  MemoryTracker::shared().add(MemoryCategory::TextureStaging,
+                              handle->stagingBytes);
+
+  handle->state.store(AssetState::Uploading, std::memory_order_release);
+  std::lock_guard<std::mutex> lock(uploadMutex);
+  textureUploadQueue.push_back(handle);
+}
+
+bool AssetLoader::uploadChunk(MeshAsset &asset) {
+  const ObjData &objData = *asset.objData;
+  if (!asset.mesh.isValid()) {
+    // Same geometry as a mesh that is already up, nothing to upload
+    asset.sharedMesh = meshRegistry.find(asset.geometryHash);
+    if (asset.sharedMesh != nullptr) {
+      return true;
+    }
+    asset.mesh = Mesh::allocate(objData.verts.size(), objData.indicies.size());
+    asset.mesh.setLabel(asset.fileName);
+    if (objData.hasAmbientOcclusion) {
+      asset.mesh.enableAmbientOcclusion();
+    }
+  }
+
+  if (asset.vertsUploaded < objData.verts.size()) {
+    size_t count = std::min(chunkBytes / sizeof(Vertex),
+                            objData.verts.size() - asset.vertsUploaded);
+    asset.mesh.uploadVerts(objData.verts.data() + asset.vertsUploaded,
+                           asset.vertsUploaded, count);
+    asset.vertsUploaded += count;
+  } else if (asset.indiciesUploaded < objData.indicies.size()) {
+    size_t count = std::min(chunkBytes / sizeof(unsigned int),
+                            objData.indicies.size() - asset.indiciesUploaded);
+    asset.mesh.uploadIndicies(objData.indicies.data() + asset.indiciesUploaded,
+                              asset.indiciesUploaded, count);
+    asset.indiciesUploaded += count;
+  }
+
+  return asset.vertsUploaded == objData.verts.size() &&
+         asset.indiciesUploaded == objData.indicies.size();
+}
+
+bool AssetLoader::uploadLevel(TextureAsset &asset) {
+  const std::vector<TextureLevel> &levels = asset.textureData->getLevels();
+  if (!asset.texture.isValid()) {
+    asset.texture =
+        Texture::allocate(asset.textureData->getFormat(), levels[0].width,
+                          levels[0].height, static_cast<int>(levels.size()));
+    asset.texture.setLabel(asset.fileName);
+  }
+
+  const size_t level = asset.levelsUploaded;
+  asset.texture.uploadLevel(static_cast<int>(level), levels[level]);
+  asset.levelsUploaded++;
+  return asset.levelsUploaded == levels.size();
+}
+
+bool AssetLoader::uploadStep(unsigned &readyCount) {
+  MeshHandle mesh;
+  TextureHandle texture;
+  {
+    std::lock_guard<std::mutex> lock(uploadMutex);
+    if (!uploadQueue.empty()) {
+      mesh = uploadQueue.front();
+    } else if (!textureUploadQueue.empty()) {
+      texture = textureUploadQueue.front();
+    } else {
+      return false;
+    }
+  }
+
+  if (mesh != nullptr) {
+    if (!uploadChunk(*mesh)) {
+      return true;
+    }
+    if (mesh->sharedMesh == nullptr) {
+      mesh->sharedMesh =
+          meshRegistry.insert(mesh->geometryHash, std::move(mesh->mesh));
+    }
+    // Done, the CPU copy isn't needed anymore
+    mesh->materials = std::move(mesh->objData->materials);
+    mesh->subMeshes = std::move(mesh->objData->subMeshes);
+    mesh->ambientOcclusion = mesh->objData->hasAmbientOcclusion;
+    mesh->objData.reset();
+    releaseStaging(MemoryCategory::MeshStaging, mesh->stagingBytes);
+    mesh->state.store(AssetState::Ready, std::memory_order_release);
+
+    std::lock_guard<std::mutex> lock(uploadMutex);
+    uploadQueue.pop_front();
+  } else {
+    if (!uploadLevel(*texture)) {
+      return true;
+    }
+    // Drops the mapping or the encoded copy
+    texture->textureData.reset();
+    releaseStaging(MemoryCategory::TextureStaging, texture->stagingBytes);
+    texture->state.store(AssetState::Ready, std::memory_order_release);
+
+    std::lock_guard<std::mutex> lock(uploadMutex);
+    textureUploadQueue.pop_front();
+  }
+
+  pending.fetch_sub(1, std::memory_order_relaxed);
+  readyCount++;
+  return true;
+}
+
+unsigned AssetLoader::update(double budgetSeconds) {
+  using Clock = std::chrono::steady_clock;
+  const auto deadline =
+      Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                         std::chrono::duration<double>(budgetSeconds));
+
+  {
+    std::lock_guard<std::mutex> lock(parseMutex);
+    parseTasks.erase(std::remove_if(parseTasks.begin(), parseTasks.end(),
+                                    [](const TaskHandle &task) {
+                                      return task.isDone();
+                                    }),
+                     parseTasks.end());
+    for (auto it = meshesByName.begin(); it != meshesByName.end();) {
+      it = it->second.expired() ? meshesByName.erase(it) : std::next(it);
+    }
+  }
+
+  unsigned readyCount = 0;
+  while (Clock::now() < deadline && uploadStep(readyCount)) {
+  }
+  meshRegistry.collect();
+
+  return readyCount;
+}
+} // namespace ofyaGl
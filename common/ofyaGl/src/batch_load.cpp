@@ -0,0 +1,479 @@
+#include <ofyaGl/batch_load.h>
+
+#include <ofyaGl/decompress.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define OFYAGL_HAVE_IO_URING
+#endif
+
+namespace ofyaGl {
+
+/**
+ * Kept well below the kernel's ring size limit.
+ */
+constexpr size_t MAX_IN_FLIGHT = 4096;
+
+struct ObjBatchLoader::Request {
+  size_t id;
+  std::filesystem::path path;
+  int file = -1;
+  std::unique_ptr<char[]> bytes;
+  size_t size = 0;
+  size_t offset = 0;
+#ifdef OFYAGL_HAVE_IO_URING
+  /**
+   * Read by the kernel until the read completes.
+   */
+  iovec target{};
+  /**
+   * Position in the I/O thread's list of reads in the ring.
+   */
+  size_t ringIndex = 0;
+#endif
+};
+
+#ifdef OFYAGL_HAVE_IO_URING
+/**
+ * Bare io_uring through its system calls, only what reading files takes.
+ * Used by a single thread.
+ */
+class IoRing {
+private:
+  int fd = -1;
+  void *sqMap = MAP_FAILED;
+  size_t sqMapSize = 0;
+  void *cqMap = MAP_FAILED;
+  size_t cqMapSize = 0;
+  void *sqeMap = MAP_FAILED;
+  size_t sqeMapSize = 0;
+
+  unsigned *sqHead = nullptr;
+  unsigned *sqTail = nullptr;
+  unsigned *sqArray = nullptr;
+  unsigned sqMask = 0;
+  unsigned sqEntries = 0;
+  io_uring_sqe *sqes = nullptr;
+  unsigned *cqHead = nullptr;
+  unsigned *cqTail = nullptr;
+  unsigned cqMask = 0;
+  io_uring_cqe *cqes = nullptr;
+  /**
+   * Queued entries the kernel hasn't been told about yet.
+   */
+  unsigned unsubmitted = 0;
+
+  IoRing() = default;
+
+public:
+  IoRing(const IoRing &) = delete;
+
+  /**
+   * Nothing if the kernel is too old or io_uring is disabled.
+   */
+  static std::unique_ptr<IoRing> create(unsigned entries) {
+    io_uring_params params{};
+    const int fd =
+        static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) {
+      return nullptr;
+    }
+    std::unique_ptr<IoRing> ring(new IoRing());
+    ring->fd = fd;
+
+    ring->sqMapSize =
+        params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqMapSize =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    ring->sqeMapSize = params.sq_entries * sizeof(io_uring_sqe);
+    ring->sqMap = mmap(nullptr, ring->sqMapSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    ring->cqMap = mmap(nullptr, ring->cqMapSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    ring->sqeMap = mmap(nullptr, ring->sqeMapSize, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqMap == MAP_FAILED || ring->cqMap == MAP_FAILED ||
+        ring->sqeMap == MAP_FAILED) {
+      return nullptr;
+    }
+
+    char *sq = static_cast<char *>(ring->sqMap);
+    ring->sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    ring->sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    ring->sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    ring->sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    ring->sqEntries = params.sq_entries;
+    ring->sqes = static_cast<io_uring_sqe *>(ring->sqeMap);
+
+    char *cq = static_cast<char *>(ring->cqMap);
+    ring->cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    ring->cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    ring->cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    ring->cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    return ring;
+  }
+
+  ~IoRing() {
+    if (sqeMap != MAP_FAILED) {
+      munmap(sqeMap, sqeMapSize);
+    }
+    if (cqMap != MAP_FAILED) {
+      munmap(cqMap, cqMapSize);
+    }
+    if (sqMap != MAP_FAILED) {
+      munmap(sqMap, sqMapSize);
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+
+  /**
+   * Queues a read into `target`, which must stay valid until it completes.
+   * Returns false if the submission queue is full.
+   */
+  bool queueRead(int file, const iovec *target, uint64_t offset,
+                 uint64_t userData) {
+    const unsigned tail = *sqTail;
+    if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+      return false;
+    }
+    const unsigned index = tail & sqMask;
+    io_uring_sqe &sqe = sqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    // READV rather than READ, it goes back to the first io_uring kernels
+    sqe.opcode = IORING_OP_READV;
+    sqe.fd = file;
+    sqe.addr = reinterpret_cast<uint64_t>(target);
+    sqe.len = 1;
+    sqe.off = offset;
+    sqe.user_data = userData;
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    unsubmitted++;
+    return true;
+  }
+
+  /**
+   * Submits the queued reads and waits for at least one completion. Returns
+   * false on an error that retrying won't fix.
+   */
+  bool submitAndWait() {
+    const long submitted =
+        syscall(__NR_io_uring_enter, fd, unsubmitted, 1,
+                IORING_ENTER_GETEVENTS, nullptr, 0);
+    if (submitted >= 0) {
+      unsubmitted -= static_cast<unsigned>(submitted);
+    } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      std::cerr << "io_uring_enter failed: " << std::strerror(errno) << "\n";
+      return false;
+    }
+    return true;
+  }
+
+  bool popCompletion(uint64_t &userData, int &result) {
+    const unsigned head = *cqHead;
+    if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+      return false;
+    }
+    const io_uring_cqe &cqe = cqes[head & cqMask];
+    userData = cqe.user_data;
+    result = cqe.res;
+    __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+};
+#else
+class IoRing {};
+#endif
+
+ObjBatchLoader::ObjBatchLoader(size_t maxInFlight, JobSystem &jobSystem)
+    : jobSystem(jobSystem),
+      maxInFlight(std::clamp<size_t>(maxInFlight, 1, MAX_IN_FLIGHT)) {
+#ifdef OFYAGL_HAVE_IO_URING
+  unsigned entries = 1;
+  while (entries < this->maxInFlight) {
+    entries *= 2;
+  }
+  ring = IoRing::create(entries);
+  if (ring != nullptr) {
+    ioThread = std::thread([this] { ioMain(); });
+  }
+#endif
+}
+
+ObjBatchLoader::~ObjBatchLoader() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    for (Request *request : readQueue) {
+      delete request;
+    }
+    readQueue.clear();
+  }
+  ioWake.notify_one();
+  if (ioThread.joinable()) {
+    ioThread.join();
+  }
+
+  // Jobs reference this loader, let them drain first. Nothing adds any now
+  // that the I/O thread is gone
+  for (const TaskHandle &job : jobs) {
+    jobSystem.wait(job);
+  }
+}
+
+size_t ObjBatchLoader::submit(const std::filesystem::path &path) {
+  size_t id;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    id = nextId++;
+    pending++;
+  }
+
+  if (ring == nullptr || getCompression(path) != Compression::None) {
+    submitJob([this, id, path] {
+      complete(id, path, loadObjDataFromPath(path), false);
+    });
+    return id;
+  }
+
+  Request *request = new Request{};
+  request->id = id;
+  request->path = path;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    readQueue.push_back(request);
+  }
+  ioWake.notify_one();
+  return id;
+}
+
+std::optional<ObjLoadResult> ObjBatchLoader::poll() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (completions.empty()) {
+    return {};
+  }
+  ObjLoadResult result = std::move(completions.front());
+  completions.pop_front();
+  pending--;
+  return result;
+}
+
+std::optional<ObjLoadResult> ObjBatchLoader::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (completions.empty() && pending != 0) {
+    while (!jobs.empty() && jobs.front().isDone()) {
+      jobs.pop_front();
+    }
+    if (jobs.empty()) {
+      // Only reads are outstanding, their jobs get submitted once they're in
+      completed.wait(lock);
+      continue;
+    }
+    TaskHandle job = jobs.front();
+    lock.unlock();
+    jobSystem.wait(job);
+    lock.lock();
+  }
+  if (completions.empty()) {
+    return {};
+  }
+  ObjLoadResult result = std::move(completions.front());
+  completions.pop_front();
+  pending--;
+  return result;
+}
+
+size_t ObjBatchLoader::getPendingCount() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return pending;
+}
+
+void ObjBatchLoader::submitJob(std::function<void()> fn) {
+  TaskHandle job = jobSystem.submit(std::move(fn));
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    while (!jobs.empty() && jobs.front().isDone()) {
+      jobs.pop_front();
+    }
+    jobs.push_back(std::move(job));
+  }
+  // A `wait` blocked on reads can help with this job now
+  completed.notify_all();
+}
+
+void ObjBatchLoader::complete(size_t id, const std::filesystem::path &path,
+                              std::optional<ObjData> objData, bool heldRead) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (heldRead) {
+      readsInFlight--;
+    }
+    completions.push_back(ObjLoadResult{id, path, std::move(objData)});
+  }
+  completed.notify_all();
+  if (heldRead) {
+    ioWake.notify_one();
+  }
+}
+
+#ifdef OFYAGL_HAVE_IO_URING
+void ObjBatchLoader::ioMain() {
+  std::vector<Request *> inRing;
+  std::vector<Request *> started;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      auto canStart = [this] {
+        return !stopping && !readQueue.empty() && readsInFlight < maxInFlight;
+      };
+      // With reads outstanding, new requests wait for the next completion
+      if (inRing.empty()) {
+        ioWake.wait(lock, [&] { return stopping || canStart(); });
+        if (stopping) {
+          return;
+        }
+      }
+      while (canStart()) {
+        started.push_back(readQueue.front());
+        readQueue.pop_front();
+        readsInFlight++;
+      }
+    }
+    for (Request *request : started) {
+      if (startRead(request)) {
+        request->ringIndex = inRing.size();
+        inRing.push_back(request);
+      }
+    }
+    started.clear();
+    if (inRing.empty()) {
+      continue;
+    }
+
+    if (!ring->submitAndWait()) {
+      // Finish what's in the ring without it, and every read after that
+      ringFailed = true;
+      for (Request *request : inRing) {
+        readBlocking(request);
+      }
+      inRing.clear();
+      continue;
+    }
+    uint64_t userData;
+    int result;
+    while (ring->popCompletion(userData, result)) {
+      Request *request = reinterpret_cast<Request *>(userData);
+      // 0 means the file got shorter since it was opened
+      if (result > 0) {
+        request->offset += static_cast<size_t>(result);
+        if (request->offset < request->size) {
+          // Short read, ask for the rest
+          request->target = {request->bytes.get() + request->offset,
+                             request->size - request->offset};
+          if (ring->queueRead(request->file, &request->target,
+                              request->offset, userData)) {
+            continue;
+          }
+        }
+      }
+      inRing[request->ringIndex] = inRing.back();
+      inRing[request->ringIndex]->ringIndex = request->ringIndex;
+      inRing.pop_back();
+      finishRead(request, request->offset == request->size);
+    }
+  }
+}
+
+bool ObjBatchLoader::startRead(Request *request) {
+  request->file = open(request->path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat info;
+  if (request->file < 0 || fstat(request->file, &info) != 0) {
+    finishRead(request, false);
+    return false;
+  }
+  request->size = static_cast<size_t>(info.st_size);
+  request->bytes.reset(new char[request->size + 1]);
+  request->bytes[request->size] = '\0';
+  if (request->size == 0) {
+    finishRead(request, true);
+    return false;
+  }
+
+  if (ringFailed) {
+    readBlocking(request);
+    return false;
+  }
+
+  request->target = {request->bytes.get(), request->size};
+  // The ring has room for every read in flight
+  if (!ring->queueRead(request->file, &request->target, 0,
+                       reinterpret_cast<uint64_t>(request))) {
+    finishRead(request, false);
+    return false;
+  }
+  return true;
+}
+
+void ObjBatchLoader::readBlocking(Request *request) {
+  while (request->offset < request->size) {
+    const ssize_t result =
+        pread(request->file, request->bytes.get() + request->offset,
+              request->size - request->offset,
+              static_cast<off_t>(request->offset));
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      break;
+    }
+    request->offset += static_cast<size_t>(result);
+  }
+  finishRead(request, request->offset == request->size);
+}
+
+void ObjBatchLoader::finishRead(Request *request, bool ok) {
+  if (request->file >= 0) {
+    close(request->file);
+    request->file = -1;
+  }
+  if (!ok) {
+    std::cerr << "Failed to read file '" << request->path.string() << "'\n";
+    complete(request->id, request->path, {}, true);
+    delete request;
+    return;
+  }
+
+  submitJob([this, request] {
+    std::unique_ptr<Request> owned(request);
+    std::optional<ObjData> objData =
+        loadObjDataFromMemory(owned->bytes.get(), owned->size, owned->path);
+    // The read's memory goes before the next read may start
+    owned->bytes.reset();
+    complete(owned->id, owned->path, std::move(objData), true);
+  });
+}
+#else
+void ObjBatchLoader::ioMain() {}
+
+bool ObjBatchLoader::startRead(Request *) { return false; }
+
+void ObjBatchLoader::readBlocking(Request *) {}
+
+void ObjBatchLoader::finishRead(Request *, bool) {}
+#endif
+} // namespace ofyaGl
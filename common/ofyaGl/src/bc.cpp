@@ -0,0 +1,291 @@
+#include <ofyaGl/bc.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace ofyaGl {
+
+/**
+ * Block rows per task while compressing.
+ */
+constexpr size_t BLOCK_ROW_GRAIN = 4;
+
+static inline size_t getBlockBytes(TextureFormat format) {
+  return format == TextureFormat::BC1 ? 8 : 16;
+}
+
+size_t getLevelSize(TextureFormat format, int width, int height) {
+  if (format == TextureFormat::RGBA8) {
+    return static_cast<size_t>(width) * height * 4;
+  }
+  const size_t blocksX = (width + 3) / 4;
+  const size_t blocksY = (height + 3) / 4;
+  return blocksX * blocksY * getBlockBytes(format);
+}
+
+/**
+ * Copies the 4x4 block at (`blockX`, `blockY`), repeating the last row and
+ * column past the image edge.
+ */
+static void fetchBlock(const Image &image, int blockX, int blockY,
+                       uint8_t block[64]) {
+  for (int y = 0; y < 4; y++) {
+    const int sy = std::min(blockY * 4 + y, image.height - 1);
+    for (int x = 0; x < 4; x++) {
+      const int sx = std::min(blockX * 4 + x, image.width - 1);
+      std::memcpy(block + (y * 4 + x) * 4, image.at(sx, sy), 4);
+    }
+  }
+}
+
+static inline uint16_t packRgb565(const int color[3]) {
+  return static_cast<uint16_t>(((color[0] >> 3) << 11) |
+                               ((color[1] >> 2) << 5) | (color[2] >> 3));
+}
+
+static inline void unpackRgb565(uint16_t packed, int color[3]) {
+  const int r = (packed >> 11) & 31;
+  const int g = (packed >> 5) & 63;
+  const int b = packed & 31;
+  color[0] = (r << 3) | (r >> 2);
+  color[1] = (g << 2) | (g >> 4);
+  color[2] = (b << 3) | (b >> 2);
+}
+
+static inline void writeLe16(uint8_t *out, uint16_t value) {
+  out[0] = value & 0xff;
+  out[1] = value >> 8;
+}
+
+/**
+ * Bounding box endpoints inset by 1/16 of the range, then every pixel picks
+ * the closest of the four palette entries. Always uses the four colour mode.
+ */
+static void encodeColorBlock(const uint8_t block[64], uint8_t out[8]) {
+  int minColor[3] = {255, 255, 255};
+  int maxColor[3] = {0, 0, 0};
+  for (int i = 0; i < 16; i++) {
+    for (int c = 0; c < 3; c++) {
+      minColor[c] = std::min<int>(minColor[c], block[i * 4 + c]);
+      maxColor[c] = std::max<int>(maxColor[c], block[i * 4 + c]);
+    }
+  }
+  for (int c = 0; c < 3; c++) {
+    const int inset = (maxColor[c] - minColor[c]) >> 4;
+    minColor[c] += inset;
+    maxColor[c] -= inset;
+  }
+
+  uint16_t color0 = packRgb565(maxColor);
+  uint16_t color1 = packRgb565(minColor);
+  if (color0 == color1) {
+    writeLe16(out, color0);
+    writeLe16(out + 2, color1);
+    std::memset(out + 4, 0, 4);
+    return;
+  }
+  if (color0 < color1) {
+    std::swap(color0, color1);
+  }
+
+  int palette[4][3];
+  unpackRgb565(color0, palette[0]);
+  unpackRgb565(color1, palette[1]);
+  for (int c = 0; c < 3; c++) {
+    palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+    palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+  }
+
+  uint32_t indices = 0;
+  for (int i = 0; i < 16; i++) {
+    int best = 0;
+    int bestDistance = 1 << 30;
+    for (int entry = 0; entry < 4; entry++) {
+      int distance = 0;
+      for (int c = 0; c < 3; c++) {
+        const int delta = block[i * 4 + c] - palette[entry][c];
+        distance += delta * delta;
+      }
+      if (distance < bestDistance) {
+        bestDistance = distance;
+        best = entry;
+      }
+    }
+    indices |= static_cast<uint32_t>(best) << (2 * i);
+  }
+
+  writeLe16(out, color0);
+  writeLe16(out + 2, color1);
+  for (int i = 0; i < 4; i++) {
+    out[4 + i] = (indices >> (8 * i)) & 0xff;
+  }
+}
+
+/**
+ * Single channel block (BC4) of channel `channel` in `block`, eight value
+ * mode between the channel's min and max.
+ */
+static void encodeChannelBlock(const uint8_t block[64], int channel,
+                               uint8_t out[8]) {
+  int minValue = 255, maxValue = 0;
+  for (int i = 0; i < 16; i++) {
+    minValue = std::min<int>(minValue, block[i * 4 + channel]);
+    maxValue = std::max<int>(maxValue, block[i * 4 + channel]);
+  }
+
+  out[0] = static_cast<uint8_t>(maxValue);
+  out[1] = static_cast<uint8_t>(minValue);
+  uint64_t indices = 0;
+  if (maxValue > minValue) {
+    const int range = maxValue - minValue;
+    for (int i = 0; i < 16; i++) {
+      // Step from the min (0) to the max (7), then map onto the palette
+      // order: max, min, then the six interpolated values from max to min
+      const int step =
+          ((block[i * 4 + channel] - minValue) * 7 + range / 2) / range;
+      const int index = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+      indices |= static_cast<uint64_t>(index) << (3 * i);
+    }
+  }
+  for (int i = 0; i < 6; i++) {
+    out[2 + i] = (indices >> (8 * i)) & 0xff;
+  }
+}
+
+static void decodeColorBlock(const uint8_t in[8], uint8_t block[64]) {
+  const uint16_t color0 = in[0] | (in[1] << 8);
+  const uint16_t color1 = in[2] | (in[3] << 8);
+  int palette[4][3];
+  unpackRgb565(color0, palette[0]);
+  unpackRgb565(color1, palette[1]);
+  for (int c = 0; c < 3; c++) {
+    if (color0 > color1) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    } else {
+      palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+      palette[3][c] = 0;
+    }
+  }
+
+  const uint32_t indices = in[4] | (in[5] << 8) | (in[6] << 16) |
+                           (static_cast<uint32_t>(in[7]) << 24);
+  for (int i = 0; i < 16; i++) {
+    const int entry = (indices >> (2 * i)) & 3;
+    for (int c = 0; c < 3; c++) {
+      block[i * 4 + c] = static_cast<uint8_t>(palette[entry][c]);
+    }
+  }
+}
+
+static void decodeChannelBlock(const uint8_t in[8], int channel,
+                               uint8_t block[64]) {
+  int palette[8];
+  palette[0] = in[0];
+  palette[1] = in[1];
+  for (int i = 2; i < 8; i++) {
+    palette[i] = in[0] > in[1] ? ((8 - i) * in[0] + (i - 1) * in[1]) / 7
+                 : i < 6       ? ((6 - i) * in[0] + (i - 1) * in[1]) / 5
+                 : i == 6      ? 0
+                               : 255;
+  }
+
+  uint64_t indices = 0;
+  for (int i = 0; i < 6; i++) {
+    indices |= static_cast<uint64_t>(in[2 + i]) << (8 * i);
+  }
+  for (int i = 0; i < 16; i++) {
+    block[i * 4 + channel] =
+        static_cast<uint8_t>(palette[(indices >> (3 * i)) & 7]);
+  }
+}
+
+std::vector<uint8_t> compressImage(const Image &image, TextureFormat format,
+                                   JobSystem &jobSystem) {
+  if (format == TextureFormat::RGBA8) {
+    return image.pixels;
+  }
+
+  const int blocksX = (image.width + 3) / 4;
+  const int blocksY = (image.height + 3) / 4;
+  const size_t blockBytes = getBlockBytes(format);
+  std::vector<uint8_t> result(getLevelSize(format, image.width, image.height));
+
+  jobSystem.parallelFor(
+      0, blocksY, BLOCK_ROW_GRAIN, [&](size_t begin, size_t end) {
+        uint8_t block[64];
+        for (size_t blockY = begin; blockY < end; blockY++) {
+          for (int blockX = 0; blockX < blocksX; blockX++) {
+            fetchBlock(image, blockX, static_cast<int>(blockY), block);
+            uint8_t *out = &result[(blockY * blocksX + blockX) * blockBytes];
+            switch (format) {
+            case TextureFormat::BC1:
+              encodeColorBlock(block, out);
+              break;
+            case TextureFormat::BC3:
+              encodeChannelBlock(block, 3, out);
+              encodeColorBlock(block, out + 8);
+              break;
+            case TextureFormat::BC5:
+              encodeChannelBlock(block, 0, out);
+              encodeChannelBlock(block, 1, out + 8);
+              break;
+            case TextureFormat::RGBA8:
+              break;
+            }
+          }
+        }
+      });
+  return result;
+}
+
+Image decompressImage(const uint8_t *data, int width, int height,
+                      TextureFormat format) {
+  Image image;
+  image.width = width;
+  image.height = height;
+  if (format == TextureFormat::RGBA8) {
+    image.pixels.assign(data, data + getLevelSize(format, width, height));
+    return image;
+  }
+  image.pixels.resize(static_cast<size_t>(width) * height * 4);
+
+  const int blocksX = (width + 3) / 4;
+  const int blocksY = (height + 3) / 4;
+  const size_t blockBytes = getBlockBytes(format);
+  uint8_t block[64];
+  for (int blockY = 0; blockY < blocksY; blockY++) {
+    for (int blockX = 0; blockX < blocksX; blockX++) {
+      const uint8_t *in =
+          data + (static_cast<size_t>(blockY) * blocksX + blockX) * blockBytes;
+      std::memset(block, 0, sizeof(block));
+      for (int i = 0; i < 16; i++) {
+        block[i * 4 + 3] = 255;
+      }
+      switch (format) {
+      case TextureFormat::BC1:
+        decodeColorBlock(in, block);
+        break;
+      case TextureFormat::BC3:
+        decodeChannelBlock(in, 3, block);
+        decodeColorBlock(in + 8, block);
+        break;
+      case TextureFormat::BC5:
+        decodeChannelBlock(in, 0, block);
+        decodeChannelBlock(in + 8, 1, block);
+        break;
+      case TextureFormat::RGBA8:
+        break;
+      }
+
+      for (int y = 0; y < 4 && blockY * 4 + y < height; y++) {
+        for (int x = 0; x < 4 && blockX * 4 + x < width; x++) {
+          std::memcpy(image.at(blockX * 4 + x, blockY * 4 + y),
+                      block + (y * 4 + x) * 4, 4);
+        }
+      }
+    }
+  }
+  return image;
+}
+} // namespace ofyaGl
@@ -0,0 +1,295 @@
+#include <ofyaGl/debug.h>
+
+#include <ofyaGl/gl.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+namespace ofyaGl {
+
+/**
+ * Errors drained per check. `glGetError` keeps one flag per error kind, so
+ * more than this only happens with a lost context that keeps reporting.
+ */
+constexpr int MAX_DRAINED_ERRORS = 16;
+
+using DebugMessageCallbackFn = void(GLAD_API_PTR *)(GLDEBUGPROC callback,
+                                                    const void *userParam);
+using DebugMessageControlFn = void(GLAD_API_PTR *)(GLenum source, GLenum type,
+                                                   GLenum severity,
+                                                   GLsizei count,
+                                                   const GLuint *ids,
+                                                   GLboolean enabled);
+using PushDebugGroupFn = void(GLAD_API_PTR *)(GLenum source, GLuint id,
+                                              GLsizei length,
+                                              const GLchar *message);
+using PopDebugGroupFn = void(GLAD_API_PTR *)();
+using ObjectLabelFn = void(GLAD_API_PTR *)(GLenum identifier, GLuint name,
+                                           GLsizei length, const GLchar *label);
+
+// One context per process, so the entry points can live here
+static DebugMessageCallbackFn debugMessageCallback = nullptr;
+static DebugMessageControlFn debugMessageControl = nullptr;
+static PushDebugGroupFn pushDebugGroup = nullptr;
+static PopDebugGroupFn popDebugGroup = nullptr;
+static ObjectLabelFn objectLabel = nullptr;
+
+static const GLenum SEVERITY_ENUMS[DEBUG_SEVERITY_COUNT] = {
+    GL_DEBUG_SEVERITY_NOTIFICATION, GL_DEBUG_SEVERITY_LOW,
+    GL_DEBUG_SEVERITY_MEDIUM, GL_DEBUG_SEVERITY_HIGH};
+
+static DebugSeverity toSeverity(GLenum severity) {
+  switch (severity) {
+  case GL_DEBUG_SEVERITY_HIGH:
+    return DebugSeverity::High;
+  case GL_DEBUG_SEVERITY_MEDIUM:
+    return DebugSeverity::Medium;
+  case GL_DEBUG_SEVERITY_LOW:
+    return DebugSeverity::Low;
+  default:
+    return DebugSeverity::Notification;
+  }
+}
+
+static const char *getSeverityName(DebugSeverity severity) {
+  switch (severity) {
+  case DebugSeverity::High:
+    return "high";
+  case DebugSeverity::Medium:
+    return "medium";
+  case DebugSeverity::Low:
+    return "low";
+  default:
+    return "notification";
+  }
+}
+
+static const char *getSourceName(GLenum source) {
+  switch (source) {
+  case GL_DEBUG_SOURCE_API:
+    return "api";
+  case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
+    return "window system";
+  case GL_DEBUG_SOURCE_SHADER_COMPILER:
+    return "shader compiler";
+  case GL_DEBUG_SOURCE_THIRD_PARTY:
+    return "third party";
+  case GL_DEBUG_SOURCE_APPLICATION:
+    return "application";
+  default:
+    return "other";
+  }
+}
+
+static const char *getTypeName(GLenum type) {
+  switch (type) {
+  case GL_DEBUG_TYPE_ERROR:
+    return "error";
+  case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
+    return "deprecated";
+  case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
+    return "undefined behaviour";
+  case GL_DEBUG_TYPE_PORTABILITY:
+    return "portability";
+  case GL_DEBUG_TYPE_PERFORMANCE:
+    return "performance";
+  case GL_DEBUG_TYPE_MARKER:
+    return "marker";
+  default:
+    return "other";
+  }
+}
+
+static void printMessage(std::ostream &out, const DebugMessage &message) {
+  out << "GL " << getSeverityName(message.severity) << " ("
+      << getSourceName(message.source) << ", " << getTypeName(message.type)
+      << ", " << message.id << ")";
+  if (message.group != nullptr && message.group[0] != '\0') {
+    out << " in '" << message.group << "'";
+  }
+  out << ": " << message.text << std::endl;
+}
+
+static void GLAD_API_PTR onDebugMessage(GLenum source, GLenum type, GLuint id,
+                                        GLenum severity, GLsizei,
+                                        const GLchar *message,
+                                        const void *userParam) {
+  GlDebug &debug = *static_cast<GlDebug *>(const_cast<void *>(userParam));
+  debug.report({source, type, id, toSeverity(severity), message, nullptr});
+}
+
+GlDebug::GlDebug() {
+#ifdef DEBUG
+  mode = ErrorCheckMode::EveryCall;
+#else
+  mode = ErrorCheckMode::Off;
+#endif
+  updateCallChecks();
+
+  auto toError = [](const DebugMessage &message) {
+    printMessage(std::cerr, message);
+  };
+  auto toOutput = [](const DebugMessage &message) {
+    printMessage(std::cout, message);
+  };
+  handlers[static_cast<size_t>(DebugSeverity::Notification)] = toOutput;
+  handlers[static_cast<size_t>(DebugSeverity::Low)] = toOutput;
+  handlers[static_cast<size_t>(DebugSeverity::Medium)] = toError;
+  handlers[static_cast<size_t>(DebugSeverity::High)] = toError;
+}
+
+GlDebug &GlDebug::shared() {
+  static GlDebug debug;
+  return debug;
+}
+
+bool GlDebug::enableOutput(GLADloadfunc load, bool synchronous) {
+  GLint major = 0;
+  GLint minor = 0;
+  GL_CALL(glGetIntegerv(GL_MAJOR_VERSION, &major));
+  GL_CALL(glGetIntegerv(GL_MINOR_VERSION, &minor));
+  const bool core = major > 4 || (major == 4 && minor >= 3);
+  if (!core && !hasGlExtension("GL_KHR_debug")) {
+    return false;
+  }
+
+  // Desktop KHR_debug uses the unsuffixed core names
+  debugMessageCallback =
+      reinterpret_cast<DebugMessageCallbackFn>(load("glDebugMessageCallback"));
+  debugMessageControl =
+      reinterpret_cast<DebugMessageControlFn>(load("glDebugMessageControl"));
+  pushDebugGroup =
+      reinterpret_cast<PushDebugGroupFn>(load("glPushDebugGroup"));
+  popDebugGroup = reinterpret_cast<PopDebugGroupFn>(load("glPopDebugGroup"));
+  objectLabel = reinterpret_cast<ObjectLabelFn>(load("glObjectLabel"));
+  if (debugMessageCallback == nullptr || debugMessageControl == nullptr ||
+      pushDebugGroup == nullptr || popDebugGroup == nullptr ||
+      objectLabel == nullptr) {
+    debugMessageCallback = nullptr;
+    debugMessageControl = nullptr;
+    pushDebugGroup = nullptr;
+    popDebugGroup = nullptr;
+    objectLabel = nullptr;
+    return false;
+  }
+
+  this->synchronous = synchronous;
+  GL_CALL(glEnable(GL_DEBUG_OUTPUT));
+  if (synchronous) {
+    GL_CALL(glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS));
+  } else {
+    GL_CALL(glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS));
+  }
+  GL_CALL(debugMessageCallback(onDebugMessage, this));
+  outputEnabled = true;
+  setMinSeverity(minSeverity);
+  return true;
+}
+
+void GlDebug::setMinSeverity(DebugSeverity severity) {
+  minSeverity = severity;
+  if (!outputEnabled) {
+    return;
+  }
+  for (size_t i = 0; i < DEBUG_SEVERITY_COUNT; i++) {
+    const GLboolean enabled =
+        i >= static_cast<size_t>(severity) ? GL_TRUE : GL_FALSE;
+    GL_CALL(debugMessageControl(GL_DONT_CARE, GL_DONT_CARE, SEVERITY_ENUMS[i],
+                                0, nullptr, enabled));
+  }
+}
+
+void GlDebug::ignore(GLenum source, GLenum type,
+                     const std::vector<GLuint> &ids) {
+  if (!outputEnabled || ids.empty()) {
+    return;
+  }
+  GL_CALL(debugMessageControl(source, type, GL_DONT_CARE,
+                              static_cast<GLsizei>(ids.size()), ids.data(),
+                              GL_FALSE));
+}
+
+void GlDebug::setHandler(DebugSeverity severity, Handler handler) {
+  handlers[static_cast<size_t>(severity)] = std::move(handler);
+}
+
+void GlDebug::updateCallChecks() {
+  glCallChecks = mode == ErrorCheckMode::EveryCall ||
+                 (mode == ErrorCheckMode::Sampled && isSampledFrame(frame));
+}
+
+void GlDebug::setErrorCheckMode(ErrorCheckMode mode, unsigned interval) {
+  this->mode = mode;
+  sampleInterval = std::max(interval, 1u);
+  updateCallChecks();
+}
+
+void GlDebug::drainErrors(const char *when) {
+  for (int i = 0; i < MAX_DRAINED_ERRORS; i++) {
+    const GLenum error = glGetError();
+    if (error == GL_NO_ERROR) {
+      return;
+    }
+    std::string text = std::string("OpenGL error (") +
+                       getGlErrorName(error) + ") " + when + " frame " +
+                       std::to_string(frame);
+    report({GL_DEBUG_SOURCE_API, GL_DEBUG_TYPE_ERROR, error,
+            DebugSeverity::High, text.c_str(), nullptr});
+  }
+}
+
+void GlDebug::endFrame() {
+  if (mode == ErrorCheckMode::Sampled) {
+    // Before the checked frame whatever the unchecked ones raised, after it
+    // whatever slipped past `GL_CALL`
+    if (isSampledFrame(frame)) {
+      drainErrors("during");
+    }
+    if (isSampledFrame(frame + 1)) {
+      drainErrors("in unchecked frames up to");
+    }
+  }
+  frame++;
+  updateCallChecks();
+}
+
+void GlDebug::report(DebugMessage message) {
+  if (message.severity < minSeverity) {
+    return;
+  }
+  if (message.group == nullptr) {
+    // Asynchronous messages come from driver threads, don't touch the stack
+    message.group = !outputEnabled || synchronous ? getCurrentGroup() : "";
+  }
+  const size_t index = static_cast<size_t>(message.severity);
+  messageCounts[index].fetch_add(1, std::memory_order_relaxed);
+  if (handlers[index]) {
+    handlers[index](message);
+  }
+}
+
+void GlDebug::pushGroup(const char *name) {
+  groups.emplace_back(name);
+  if (pushDebugGroup != nullptr) {
+    GL_CALL(pushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name));
+  }
+}
+
+void GlDebug::popGroup() {
+  if (groups.empty()) {
+    return;
+  }
+  groups.pop_back();
+  if (popDebugGroup != nullptr) {
+    GL_CALL(popDebugGroup());
+  }
+}
+
+void GlDebug::label(GLenum identifier, GLuint name, const std::string &label) {
+  if (objectLabel != nullptr && name != 0) {
+    GL_CALL(objectLabel(identifier, name, static_cast<GLsizei>(label.size()),
+                        label.c_str()));
+  }
+}
+} // namespace ofyaGl
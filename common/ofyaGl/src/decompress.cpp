@@ -0,0 +1,275 @@
+#include <ofyaGl/decompress.h>
+
+#include <chrono>
+#include <iostream>
+
+#ifdef OFYAGL_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef OFYAGL_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace ofyaGl {
+
+using Clock = std::chrono::steady_clock;
+
+Compression getCompression(const std::filesystem::path &path) {
+  const std::filesystem::path extension = path.extension();
+  if (extension == ".gz") {
+    return Compression::Gzip;
+  }
+  if (extension == ".zst") {
+    return Compression::Zstd;
+  }
+  return Compression::None;
+}
+
+bool isCompressionSupported(Compression compression) {
+  switch (compression) {
+  case Compression::None:
+    return true;
+  case Compression::Gzip:
+#ifdef OFYAGL_HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+  case Compression::Zstd:
+#ifdef OFYAGL_HAVE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+  }
+  return false;
+}
+
+DecompressStream::DecompressStream(const std::filesystem::path &path,
+                                   Compression compression)
+    : compression(compression) {
+  file = std::fopen(path.string().c_str(), "rb");
+  if (file == nullptr) {
+    failed = true;
+    finished = true;
+    return;
+  }
+  for (std::vector<char> &block : blocks) {
+    block.resize(BLOCK_SIZE);
+  }
+  thread = std::thread([this] { run(); });
+}
+
+DecompressStream::~DecompressStream() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    cancelled = true;
+  }
+  blockReleased.notify_one();
+  if (thread.joinable()) {
+    thread.join();
+  }
+  if (file != nullptr) {
+    std::fclose(file);
+  }
+}
+
+void DecompressStream::run() {
+  const Clock::time_point start = Clock::now();
+  bool ok = false;
+  switch (compression) {
+  case Compression::None:
+    break;
+  case Compression::Gzip:
+    ok = inflateGzip();
+    break;
+  case Compression::Zstd:
+    ok = decompressZstd();
+    break;
+  }
+  const double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    decompressSeconds = seconds - blockedSeconds;
+    finished = true;
+    failed = !ok;
+  }
+  blockFilled.notify_one();
+}
+
+char *DecompressStream::acquireBlock() {
+  const Clock::time_point start = Clock::now();
+  std::unique_lock<std::mutex> lock(mutex);
+  blockReleased.wait(
+      lock, [this] { return cancelled || filled - released < BLOCK_COUNT; });
+  blockedSeconds +=
+      std::chrono::duration<double>(Clock::now() - start).count();
+  if (cancelled) {
+    return nullptr;
+  }
+  return blocks[filled % BLOCK_COUNT].data();
+}
+
+void DecompressStream::publishBlock(size_t size) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    blockSizes[filled % BLOCK_COUNT] = size;
+    filled++;
+    decompressedBytes += size;
+  }
+  blockFilled.notify_one();
+}
+
+const char *DecompressStream::next(size_t &size) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (released < taken) {
+    released = taken;
+    blockReleased.notify_one();
+  }
+  blockFilled.wait(lock, [this] { return finished || taken < filled; });
+  if (failed || taken == filled) {
+    size = 0;
+    return nullptr;
+  }
+  const size_t index = taken % BLOCK_COUNT;
+  taken++;
+  size = blockSizes[index];
+  return blocks[index].data();
+}
+
+bool DecompressStream::hasFailed() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return failed;
+}
+
+bool DecompressStream::inflateGzip() {
+#ifdef OFYAGL_HAVE_ZLIB
+  z_stream stream{};
+  // 32 lets zlib detect the gzip header
+  if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+    return false;
+  }
+  std::vector<unsigned char> input(INPUT_SIZE);
+
+  char *block = acquireBlock();
+  stream.next_out = reinterpret_cast<Bytef *>(block);
+  stream.avail_out = BLOCK_SIZE;
+  bool ok = false;
+  bool memberDone = false;
+  bool endOfFile = false;
+  while (block != nullptr) {
+    if (stream.avail_in == 0 && !endOfFile) {
+      const size_t read = std::fread(input.data(), 1, INPUT_SIZE, file);
+      if (std::ferror(file)) {
+        break;
+      }
+      compressedBytes += read;
+      endOfFile = read == 0;
+      stream.next_in = input.data();
+      stream.avail_in = static_cast<uInt>(read);
+    }
+    if (memberDone) {
+      if (stream.avail_in == 0) {
+        ok = true;
+        break;
+      }
+      // `gzip` output may hold several members back to back
+      inflateReset(&stream);
+      memberDone = false;
+    }
+
+    const int result = inflate(&stream, Z_NO_FLUSH);
+    if (result == Z_STREAM_END) {
+      memberDone = true;
+    } else if (result == Z_BUF_ERROR && endOfFile) {
+      std::cerr << "Truncated gzip stream\n";
+      break;
+    } else if (result != Z_OK && result != Z_BUF_ERROR) {
+      std::cerr << "Corrupt gzip stream\n";
+      break;
+    }
+
+    if (stream.avail_out == 0) {
+      publishBlock(BLOCK_SIZE);
+      block = acquireBlock();
+      stream.next_out = reinterpret_cast<Bytef *>(block);
+      stream.avail_out = BLOCK_SIZE;
+    }
+  }
+  inflateEnd(&stream);
+
+  if (ok && stream.avail_out < BLOCK_SIZE) {
+    publishBlock(BLOCK_SIZE - stream.avail_out);
+  }
+  return ok;
+#else
+  std::cerr << "Built without zlib, can't read gzip files\n";
+  return false;
+#endif
+}
+
+bool DecompressStream::decompressZstd() {
+#ifdef OFYAGL_HAVE_ZSTD
+  ZSTD_DStream *stream = ZSTD_createDStream();
+  if (stream == nullptr) {
+    return false;
+  }
+  ZSTD_initDStream(stream);
+  std::vector<char> input(INPUT_SIZE);
+
+  char *block = acquireBlock();
+  ZSTD_inBuffer in{input.data(), 0, 0};
+  ZSTD_outBuffer out{block, BLOCK_SIZE, 0};
+  bool ok = false;
+  bool frameDone = false;
+  bool endOfFile = false;
+  while (block != nullptr) {
+    if (in.pos == in.size && !endOfFile) {
+      const size_t read = std::fread(input.data(), 1, INPUT_SIZE, file);
+      if (std::ferror(file)) {
+        break;
+      }
+      compressedBytes += read;
+      endOfFile = read == 0;
+      in = ZSTD_inBuffer{input.data(), read, 0};
+    }
+    // Frames may follow each other, the stream moves on by itself
+    if (endOfFile && frameDone) {
+      ok = true;
+      break;
+    }
+
+    const size_t written = out.pos;
+    const size_t result = ZSTD_decompressStream(stream, &out, &in);
+    if (ZSTD_isError(result)) {
+      std::cerr << "Corrupt zstd stream: " << ZSTD_getErrorName(result)
+                << "\n";
+      break;
+    }
+    // 0 once a frame is decoded and flushed completely
+    frameDone = result == 0;
+    if (endOfFile && !frameDone && out.pos == written) {
+      std::cerr << "Truncated zstd stream\n";
+      break;
+    }
+
+    if (out.pos == out.size) {
+      publishBlock(BLOCK_SIZE);
+      block = acquireBlock();
+      out = ZSTD_outBuffer{block, BLOCK_SIZE, 0};
+    }
+  }
+  ZSTD_freeDStream(stream);
+
+  if (ok && out.pos > 0) {
+    publishBlock(out.pos);
+  }
+  return ok;
+#else
+  std::cerr << "Built without zstd, can't read zstd files\n";
+  return false;
+#endif
+}
+} // namespace ofyaGl
@@ -1,36 +1,58 @@
 #include <ofyaGl/gl.h>
 
+#include <ofyaGl/debug.h>
+
+#include <cstring>
 #include <glad/gl.h>
-#include <iostream>
+#include <string>
 
 void checkOpenGLError(const char *stmt, const char *file, int line) {
   GLenum err = glGetError();
   if (err != GL_NO_ERROR) {
-    const char *error;
-    switch (err) {
-    case GL_INVALID_ENUM:
-      error = "GL_INVALID_ENUM";
-      break;
-    case GL_INVALID_VALUE:
-      error = "GL_INVALID_VALUE";
-      break;
-    case GL_INVALID_OPERATION:
-      error = "GL_INVALID_OPERATION";
-      break;
-    case GL_STACK_OVERFLOW:
-      error = "GL_STACK_OVERFLOW";
-      break;
-    case GL_STACK_UNDERFLOW:
-      error = "GL_STACK_UNDERFLOW";
-      break;
-    case GL_OUT_OF_MEMORY:
-      error = "GL_OUT_OF_MEMORY";
-      break;
-    default:
-      error = "Unknown Error";
-      break;
+    std::string text = std::string("OpenGL error (") +
+                       ofyaGl::getGlErrorName(err) + "): " + stmt + " in " +
+                       file + " at line " + std::to_string(line);
+    ofyaGl::GlDebug::shared().report({GL_DEBUG_SOURCE_API, GL_DEBUG_TYPE_ERROR,
+                                      err, ofyaGl::DebugSeverity::High,
+                                      text.c_str(), nullptr});
+  }
+}
+
+namespace ofyaGl {
+
+bool glCallChecks = true;
+
+const char *getGlErrorName(unsigned int error) {
+  switch (error) {
+  case GL_INVALID_ENUM:
+    return "GL_INVALID_ENUM";
+  case GL_INVALID_VALUE:
+    return "GL_INVALID_VALUE";
+  case GL_INVALID_OPERATION:
+    return "GL_INVALID_OPERATION";
+  case GL_INVALID_FRAMEBUFFER_OPERATION:
+    return "GL_INVALID_FRAMEBUFFER_OPERATION";
+  case GL_STACK_OVERFLOW:
+    return "GL_STACK_OVERFLOW";
+  case GL_STACK_UNDERFLOW:
+    return "GL_STACK_UNDERFLOW";
+  case GL_OUT_OF_MEMORY:
+    return "GL_OUT_OF_MEMORY";
+  default:
+    return "Unknown Error";
+  }
+}
+
+bool hasGlExtension(const char *name) {
+  GLint extensionCount = 0;
+  GL_CALL(glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount));
+  for (GLint i = 0; i < extensionCount; i++) {
+    const GLubyte *extension = GL_CALL(glGetStringi(GL_EXTENSIONS, i));
+    if (extension != nullptr &&
+        std::strcmp(reinterpret_cast<const char *>(extension), name) == 0) {
+      return true;
     }
-    std::cerr << "OpenGL error (" << error << "): " << stmt << " in " << file
-              << " at line " << line << std::endl;
   }
+  return false;
 }
+} // namespace ofyaGl
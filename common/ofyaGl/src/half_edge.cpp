@@ -0,0 +1,338 @@
+#include <ofyaGl/half_edge.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+namespace ofyaGl {
+
+/**
+ * Elements per job in the parallel loops.
+ */
+constexpr size_t GRAIN = 1 << 14;
+
+/**
+ * Radix sort passes split the input into at most this many chunks. Fixed
+ * rather than per worker so the result doesn't depend on the machine.
+ */
+constexpr size_t MAX_SORT_CHUNKS = 64;
+constexpr unsigned DIGIT_BITS = 11;
+constexpr size_t DIGIT_BUCKETS = size_t(1) << DIGIT_BITS;
+
+/**
+ * Positions are welded by bit pattern rather than `==`, so a NaN matches
+ * itself instead of probing forever. Adding 0 folds -0.0 into 0.0 first.
+ */
+static inline void getPositionBits(const VertPos &pos, uint32_t bits[3]) {
+  const float values[3] = {pos.x + 0.f, pos.y + 0.f, pos.z + 0.f};
+  std::memcpy(bits, values, sizeof(values));
+}
+
+static inline bool isSamePosition(const VertPos &a, const VertPos &b) {
+  uint32_t aBits[3], bBits[3];
+  getPositionBits(a, aBits);
+  getPositionBits(b, bBits);
+  return std::memcmp(aBits, bBits, sizeof(aBits)) == 0;
+}
+
+static inline uint32_t hashPosition(const VertPos &pos) {
+  uint32_t bits[3];
+  getPositionBits(pos, bits);
+  uint32_t hash = 2166136261u;
+  for (uint32_t value : bits) {
+    hash = (hash ^ value) * 16777619u;
+    hash ^= hash >> 15;
+  }
+  return hash;
+}
+
+/**
+ * Maps every vertex to the lowest index of a vertex at the same position.
+ * Vertices race to insert into an open addressing table, an entry only ever
+ * goes from empty to a vertex and then to a lower one at the same position,
+ * so the outcome doesn't depend on the order.
+ */
+static std::vector<uint32_t> weldPoints(const std::vector<Vertex> &verts,
+                                        JobSystem &jobSystem) {
+  const size_t vertCount = verts.size();
+  size_t tableSize = 16;
+  while (tableSize < vertCount * 2) {
+    tableSize *= 2;
+  }
+  const size_t tableMask = tableSize - 1;
+  const std::unique_ptr<std::atomic<uint32_t>[]> table(
+      new std::atomic<uint32_t>[tableSize]);
+  jobSystem.parallelFor(0, tableSize, GRAIN, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      table[i].store(HalfEdgeMesh::NONE, std::memory_order_relaxed);
+    }
+  });
+
+  auto findSlot = [&](uint32_t vertex, bool insert) {
+    const VertPos &pos = verts[vertex].pos;
+    size_t slot = hashPosition(pos) & tableMask;
+    while (true) {
+      uint32_t entry = table[slot].load(std::memory_order_acquire);
+      if (entry == HalfEdgeMesh::NONE) {
+        if (!insert) {
+          return size_t(HalfEdgeMesh::NONE);
+        }
+        if (table[slot].compare_exchange_strong(entry, vertex,
+                                                std::memory_order_acq_rel)) {
+          return slot;
+        }
+      }
+      if (entry != HalfEdgeMesh::NONE &&
+          isSamePosition(verts[entry].pos, pos)) {
+        while (insert && vertex < entry &&
+               !table[slot].compare_exchange_weak(entry, vertex,
+                                                  std::memory_order_acq_rel)) {
+        }
+        return slot;
+      }
+      slot = (slot + 1) & tableMask;
+    }
+  };
+
+  jobSystem.parallelFor(0, vertCount, GRAIN, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; v++) {
+      findSlot(static_cast<uint32_t>(v), true);
+    }
+  });
+  std::vector<uint32_t> points(vertCount);
+  jobSystem.parallelFor(0, vertCount, GRAIN, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; v++) {
+      // Every vertex was inserted, not finding it would be a bug, but one
+      // that shouldn't hang
+      const size_t slot = findSlot(static_cast<uint32_t>(v), false);
+      points[v] = slot == size_t(HalfEdgeMesh::NONE)
+                      ? static_cast<uint32_t>(v)
+                      : table[slot].load(std::memory_order_relaxed);
+    }
+  });
+  return points;
+}
+
+/**
+ * Stable LSD radix sort of `keys`, carrying `values` along. Only the low
+ * `keyBits` bits are looked at. Each pass counts and scatters chunks of the
+ * input in parallel, every chunk writing to its own slice of each bucket.
+ */
+static void radixSort(std::vector<uint64_t> &keys,
+                      std::vector<uint32_t> &values, unsigned keyBits,
+                      JobSystem &jobSystem) {
+  const size_t count = keys.size();
+  if (count == 0) {
+    return;
+  }
+  const size_t chunkCount =
+      std::min(MAX_SORT_CHUNKS, (count + GRAIN - 1) / GRAIN);
+  const size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+  std::vector<uint64_t> keyScratch(count);
+  std::vector<uint32_t> valueScratch(count);
+  std::vector<size_t> offsets(chunkCount * DIGIT_BUCKETS);
+
+  for (unsigned shift = 0; shift < keyBits; shift += DIGIT_BITS) {
+    auto getDigit = [shift](uint64_t key) {
+      return static_cast<size_t>(key >> shift) & (DIGIT_BUCKETS - 1);
+    };
+    jobSystem.parallelFor(0, chunkCount, 1, [&](size_t begin, size_t end) {
+      for (size_t chunk = begin; chunk < end; chunk++) {
+        size_t *bucketCounts = &offsets[chunk * DIGIT_BUCKETS];
+        std::fill(bucketCounts, bucketCounts + DIGIT_BUCKETS, 0);
+        const size_t last = std::min(count, (chunk + 1) * chunkSize);
+        for (size_t i = chunk * chunkSize; i < last; i++) {
+          bucketCounts[getDigit(keys[i])]++;
+        }
+      }
+    });
+
+    // Bucket major, so equal digits stay in input order across chunks
+    size_t offset = 0;
+    size_t largestBucket = 0;
+    for (size_t bucket = 0; bucket < DIGIT_BUCKETS; bucket++) {
+      const size_t bucketStart = offset;
+      for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+        size_t &entry = offsets[chunk * DIGIT_BUCKETS + bucket];
+        const size_t bucketSize = entry;
+        entry = offset;
+        offset += bucketSize;
+      }
+      largestBucket = std::max(largestBucket, offset - bucketStart);
+    }
+    // Every key has this digit in common
+    if (largestBucket == count) {
+      continue;
+    }
+
+    jobSystem.parallelFor(0, chunkCount, 1, [&](size_t begin, size_t end) {
+      for (size_t chunk = begin; chunk < end; chunk++) {
+        size_t *cursors = &offsets[chunk * DIGIT_BUCKETS];
+        const size_t last = std::min(count, (chunk + 1) * chunkSize);
+        for (size_t i = chunk * chunkSize; i < last; i++) {
+          const size_t target = cursors[getDigit(keys[i])]++;
+          keyScratch[target] = keys[i];
+          valueScratch[target] = values[i];
+        }
+      }
+    });
+    keys.swap(keyScratch);
+    values.swap(valueScratch);
+  }
+}
+
+HalfEdgeMesh HalfEdgeMesh::build(const ObjData &objData,
+                                 JobSystem &jobSystem) {
+  return build(objData.verts, objData.indicies, jobSystem);
+}
+
+HalfEdgeMesh HalfEdgeMesh::build(const std::vector<Vertex> &verts,
+                                 const std::vector<unsigned int> &indicies,
+                                 JobSystem &jobSystem) {
+  HalfEdgeMesh mesh;
+  const size_t halfEdgeCount = indicies.size() / 3 * 3;
+  mesh.origins.assign(indicies.begin(), indicies.begin() + halfEdgeCount);
+  mesh.points = weldPoints(verts, jobSystem);
+  const std::vector<uint32_t> &origins = mesh.origins;
+  const std::vector<uint32_t> &points = mesh.points;
+
+  // Edge key of the two end points, lower one first, so both directions of
+  // an edge sort next to each other
+  unsigned pointBits = 0;
+  while ((size_t(1) << pointBits) < verts.size()) {
+    pointBits++;
+  }
+  std::vector<uint64_t> keys(halfEdgeCount);
+  std::vector<uint32_t> halfEdges(halfEdgeCount);
+  jobSystem.parallelFor(0, halfEdgeCount, GRAIN, [&](size_t begin,
+                                                     size_t end) {
+    for (size_t h = begin; h < end; h++) {
+      const uint64_t a = points[origins[h]];
+      const uint64_t b = points[origins[next(static_cast<uint32_t>(h))]];
+      keys[h] = a < b ? (a << pointBits) | b : (b << pointBits) | a;
+      halfEdges[h] = static_cast<uint32_t>(h);
+    }
+  });
+  radixSort(keys, halfEdges, pointBits * 2, jobSystem);
+
+  // Runs of equal keys are the half-edges of one edge. Each range starts
+  // and ends on run boundaries, so runs are never split
+  mesh.twins.assign(halfEdgeCount, NONE);
+  mesh.edgeFlags.assign(halfEdgeCount, 0);
+  const uint64_t pointMask = (uint64_t(1) << pointBits) - 1;
+  jobSystem.parallelFor(0, halfEdgeCount, GRAIN, [&](size_t begin,
+                                                     size_t end) {
+    while (begin > 0 && begin < halfEdgeCount &&
+           keys[begin] == keys[begin - 1]) {
+      begin++;
+    }
+    while (end < halfEdgeCount && keys[end] == keys[end - 1]) {
+      end++;
+    }
+    for (size_t run = begin; run < end;) {
+      size_t runEnd = run + 1;
+      while (runEnd < halfEdgeCount && keys[runEnd] == keys[run]) {
+        runEnd++;
+      }
+
+      uint8_t flags = 0;
+      if ((keys[run] >> pointBits) == (keys[run] & pointMask)) {
+        flags = EDGE_DEGENERATE;
+      } else if (runEnd - run == 1) {
+        flags = EDGE_BOUNDARY;
+      } else if (runEnd - run == 2 &&
+                 points[origins[halfEdges[run]]] !=
+                     points[origins[halfEdges[run + 1]]]) {
+        mesh.twins[halfEdges[run]] = halfEdges[run + 1];
+        mesh.twins[halfEdges[run + 1]] = halfEdges[run];
+      } else {
+        flags = EDGE_NON_MANIFOLD;
+      }
+      for (size_t i = run; i < runEnd; i++) {
+        mesh.edgeFlags[halfEdges[i]] = flags;
+      }
+      run = runEnd;
+    }
+  });
+  keys = {};
+  halfEdges = {};
+
+  // Per point, the corners around it and the outgoing half-edge to walk its
+  // fan from: the lowest one without a twin, so an open fan is walked from
+  // its start, otherwise the lowest one
+  const size_t vertCount = verts.size();
+  const std::unique_ptr<std::atomic<uint32_t>[]> cornerCounts(
+      new std::atomic<uint32_t>[vertCount]);
+  const std::unique_ptr<std::atomic<uint64_t>[]> firstHalfEdges(
+      new std::atomic<uint64_t>[vertCount]);
+  jobSystem.parallelFor(0, vertCount, GRAIN, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; v++) {
+      cornerCounts[v].store(0, std::memory_order_relaxed);
+      firstHalfEdges[v].store(UINT64_MAX, std::memory_order_relaxed);
+    }
+  });
+  jobSystem.parallelFor(0, halfEdgeCount, GRAIN, [&](size_t begin,
+                                                     size_t end) {
+    for (size_t h = begin; h < end; h++) {
+      const uint32_t point = points[origins[h]];
+      cornerCounts[point].fetch_add(1, std::memory_order_relaxed);
+      const uint64_t candidate =
+          (uint64_t(mesh.twins[h] != NONE) << 32) | h;
+      uint64_t current = firstHalfEdges[point].load(std::memory_order_relaxed);
+      while (candidate < current &&
+             !firstHalfEdges[point].compare_exchange_weak(
+                 current, candidate, std::memory_order_relaxed)) {
+      }
+    }
+  });
+
+  mesh.pointHalfEdges.assign(vertCount, NONE);
+  mesh.pointFlags.assign(vertCount, 0);
+  jobSystem.parallelFor(0, vertCount, GRAIN, [&](size_t begin, size_t end) {
+    for (size_t point = begin; point < end; point++) {
+      const uint64_t first =
+          firstHalfEdges[point].load(std::memory_order_relaxed);
+      if (points[point] != point || first == UINT64_MAX) {
+        continue;
+      }
+      const uint32_t start = static_cast<uint32_t>(first);
+      const uint32_t corners =
+          cornerCounts[point].load(std::memory_order_relaxed);
+
+      // Around the fan through the twin of each incoming half-edge
+      uint32_t h = start;
+      uint32_t fanCorners = 0;
+      bool open = false;
+      do {
+        fanCorners++;
+        h = mesh.twins[prev(h)];
+        open = h == NONE;
+      } while (!open && h != start && fanCorners < corners);
+
+      mesh.pointHalfEdges[point] = start;
+      mesh.pointFlags[point] = (open ? POINT_BOUNDARY : 0) |
+                               (fanCorners < corners ? POINT_NON_MANIFOLD : 0);
+    }
+  });
+  return mesh;
+}
+
+std::vector<unsigned int>
+HalfEdgeMesh::buildAdjacencyIndices(JobSystem &jobSystem) const {
+  const size_t faceCount = getFaceCount();
+  std::vector<unsigned int> adjacency(faceCount * 6);
+  jobSystem.parallelFor(0, faceCount, GRAIN, [&](size_t begin, size_t end) {
+    for (size_t face = begin; face < end; face++) {
+      for (uint32_t corner = 0; corner < 3; corner++) {
+        const uint32_t h = static_cast<uint32_t>(face * 3 + corner);
+        const uint32_t twin = twins[h];
+        adjacency[face * 6 + corner * 2] = origins[h];
+        adjacency[face * 6 + corner * 2 + 1] =
+            twin != NONE ? origins[prev(twin)] : origins[prev(h)];
+      }
+    }
+  });
+  return adjacency;
+}
+} // namespace ofyaGl
@@ -0,0 +1,69 @@
+#include <ofyaGl/hash.h>
+
+#include <cstring>
+
+namespace ofyaGl {
+
+constexpr uint64_t PRIME_1 = 0x9e3779b97f4a7c15ull;
+constexpr uint64_t PRIME_2 = 0xbf58476d1ce4e5b9ull;
+constexpr uint64_t PRIME_3 = 0x94d049bb133111ebull;
+
+static inline uint64_t rotateLeft(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t readWord(const uint8_t *p) {
+  uint64_t word;
+  std::memcpy(&word, p, sizeof(word));
+  return word;
+}
+
+static inline uint64_t mixLane(uint64_t lane, uint64_t word) {
+  return rotateLeft(lane + word * PRIME_2, 31) * PRIME_1;
+}
+
+/**
+ * splitmix64 finalizer, every input bit affects every output bit.
+ */
+static inline uint64_t avalanche(uint64_t hash) {
+  hash = (hash ^ (hash >> 30)) * PRIME_2;
+  hash = (hash ^ (hash >> 27)) * PRIME_3;
+  return hash ^ (hash >> 31);
+}
+
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed) {
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  const uint8_t *const end = p + size;
+
+  uint64_t hash;
+  if (size >= 32) {
+    uint64_t lanes[4] = {seed + PRIME_1 + PRIME_2, seed + PRIME_2, seed,
+                         seed - PRIME_1};
+    for (; end - p >= 32; p += 32) {
+      for (int i = 0; i < 4; i++) {
+        lanes[i] = mixLane(lanes[i], readWord(p + 8 * i));
+      }
+    }
+    hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) +
+           rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+  } else {
+    hash = seed + PRIME_3;
+  }
+  hash += size;
+
+  for (; end - p >= 8; p += 8) {
+    hash = rotateLeft(hash ^ mixLane(0, readWord(p)), 27) * PRIME_1 + PRIME_3;
+  }
+  uint64_t tail = 0;
+  // `data` may be null when `size` is 0, memcpy must not see it even then
+  if (end != p) {
+    std::memcpy(&tail, p, end - p);
+  }
+  hash = rotateLeft(hash ^ (tail * PRIME_1), 23) * PRIME_2;
+  return avalanche(hash);
+}
+
+uint64_t hashCombine(uint64_t hash, uint64_t value) {
+  return avalanche(hash ^ (value + PRIME_1 + (hash << 6) + (hash >> 2)));
+}
+} // namespace ofyaGl
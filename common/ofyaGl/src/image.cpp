@@ -0,0 +1,419 @@
+#include <ofyaGl/image.h>
+
+#include <ofyaGl/mapped_file.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OFYAGL_IMAGE_SSE
+#endif
+
+namespace ofyaGl {
+
+/**
+ * Destination rows per task when filtering a mip level.
+ */
+constexpr size_t MIP_ROW_GRAIN = 16;
+
+constexpr int KAISER_TAPS = 8;
+
+static void flipRows(Image &image) {
+  const size_t rowBytes = static_cast<size_t>(image.width) * 4;
+  std::vector<uint8_t> row(rowBytes);
+  for (int y = 0; y < image.height / 2; y++) {
+    uint8_t *top = image.at(0, y);
+    uint8_t *bottom = image.at(0, image.height - 1 - y);
+    std::memcpy(row.data(), top, rowBytes);
+    std::memcpy(top, bottom, rowBytes);
+    std::memcpy(bottom, row.data(), rowBytes);
+  }
+}
+
+/**
+ * Next PPM header number, skipping whitespace and comments.
+ */
+static bool readPpmNumber(const uint8_t *&cursor, const uint8_t *end,
+                          int &value) {
+  while (cursor < end) {
+    if (*cursor == '#') {
+      while (cursor < end && *cursor != '\n') {
+        cursor++;
+      }
+    } else if (std::isspace(*cursor)) {
+      cursor++;
+    } else {
+      break;
+    }
+  }
+  if (cursor == end || !std::isdigit(*cursor)) {
+    return false;
+  }
+  value = 0;
+  while (cursor < end && std::isdigit(*cursor)) {
+    value = value * 10 + (*cursor - '0');
+    if (value > (1 << 16)) {
+      return false;
+    }
+    cursor++;
+  }
+  return true;
+}
+
+static std::optional<Image> decodePpm(const uint8_t *data, size_t size) {
+  const uint8_t *cursor = data + 2;
+  const uint8_t *end = data + size;
+  int width, height, maxValue;
+  if (!readPpmNumber(cursor, end, width) ||
+      !readPpmNumber(cursor, end, height) ||
+      !readPpmNumber(cursor, end, maxValue) || width == 0 || height == 0 ||
+      maxValue == 0 || maxValue > 255 || cursor == end) {
+    return {};
+  }
+  // Exactly one whitespace byte before the raster
+  cursor++;
+
+  const size_t pixelCount = static_cast<size_t>(width) * height;
+  if (static_cast<size_t>(end - cursor) < pixelCount * 3) {
+    return {};
+  }
+
+  Image image;
+  image.width = width;
+  image.height = height;
+  image.pixels.resize(pixelCount * 4);
+  for (size_t i = 0; i < pixelCount; i++) {
+    for (int c = 0; c < 3; c++) {
+      // Samples above the maximum are malformed, clamp rather than wrap
+      const int sample = std::min<int>(cursor[i * 3 + c], maxValue);
+      image.pixels[i * 4 + c] = static_cast<uint8_t>(sample * 255 / maxValue);
+    }
+    image.pixels[i * 4 + 3] = 255;
+  }
+  // PPM stores the top row first
+  flipRows(image);
+  return image;
+}
+
+static std::optional<Image> decodeTga(const uint8_t *data, size_t size) {
+  if (size < 18) {
+    return {};
+  }
+  const uint8_t idLength = data[0];
+  const uint8_t colorMapType = data[1];
+  const uint8_t imageType = data[2];
+  const size_t colorMapLength = data[5] | (data[6] << 8);
+  const size_t colorMapBytes =
+      colorMapType == 1 ? colorMapLength * ((data[7] + 7) / 8) : 0;
+  const int width = data[12] | (data[13] << 8);
+  const int height = data[14] | (data[15] << 8);
+  const int bitsPerPixel = data[16];
+  const uint8_t descriptor = data[17];
+
+  const bool grey = imageType == 3 || imageType == 11;
+  const bool rle = imageType == 10 || imageType == 11;
+  if ((imageType != 2 && imageType != 3 && imageType != 10 &&
+       imageType != 11) ||
+      width == 0 || height == 0) {
+    return {};
+  }
+  if (grey ? bitsPerPixel != 8 : bitsPerPixel != 24 && bitsPerPixel != 32) {
+    return {};
+  }
+  const size_t bytesPerPixel = bitsPerPixel / 8;
+
+  const uint8_t *cursor = data + 18 + idLength + colorMapBytes;
+  const uint8_t *end = data + size;
+  if (cursor > end) {
+    return {};
+  }
+
+  Image image;
+  image.width = width;
+  image.height = height;
+  const size_t pixelCount = static_cast<size_t>(width) * height;
+  image.pixels.resize(pixelCount * 4);
+
+  auto writePixel = [&](size_t i, const uint8_t *src) {
+    uint8_t *dst = &image.pixels[i * 4];
+    if (grey) {
+      dst[0] = dst[1] = dst[2] = src[0];
+      dst[3] = 255;
+    } else {
+      // Stored as BGR(A)
+      dst[0] = src[2];
+      dst[1] = src[1];
+      dst[2] = src[0];
+      dst[3] = bytesPerPixel == 4 ? src[3] : 255;
+    }
+  };
+
+  size_t i = 0;
+  while (i < pixelCount) {
+    size_t runLength = 1;
+    bool repeat = false;
+    if (rle) {
+      if (cursor == end) {
+        return {};
+      }
+      repeat = (*cursor & 0x80) != 0;
+      runLength = std::min<size_t>((*cursor & 0x7f) + 1, pixelCount - i);
+      cursor++;
+    } else {
+      runLength = pixelCount;
+    }
+
+    const size_t bytesNeeded =
+        repeat ? bytesPerPixel : runLength * bytesPerPixel;
+    if (static_cast<size_t>(end - cursor) < bytesNeeded) {
+      return {};
+    }
+    for (size_t j = 0; j < runLength; j++) {
+      writePixel(i + j, repeat ? cursor : cursor + j * bytesPerPixel);
+    }
+    cursor += bytesNeeded;
+    i += runLength;
+  }
+
+  // Bit 5 set means the top row comes first
+  if (descriptor & 0x20) {
+    flipRows(image);
+  }
+  return image;
+}
+
+std::optional<Image> decodeImage(const uint8_t *data, size_t size) {
+  if (size >= 2 && data[0] == 'P' && data[1] == '6') {
+    return decodePpm(data, size);
+  }
+  return decodeTga(data, size);
+}
+
+std::optional<Image> loadImageFromFile(const char *fileName) {
+  std::string textureDir = std::getenv("ICG_TEXTURE_DIR");
+  std::string fullFilePath = textureDir + "/" + fileName;
+
+  std::optional<MappedFile> file = MappedFile::open(fullFilePath.c_str());
+  if (!file.has_value()) {
+    std::cerr << "Failed to open file '" << fullFilePath << "'\n";
+    return {};
+  }
+
+  std::optional<Image> image = decodeImage(file->data(), file->getSize());
+  if (!image.has_value()) {
+    std::cerr << "Unsupported image format in '" << fullFilePath << "'\n";
+  }
+  return image;
+}
+
+#ifdef OFYAGL_IMAGE_SSE
+using Float4 = __m128;
+
+static inline Float4 zero4() { return _mm_setzero_ps(); }
+static inline Float4 load4(const uint8_t *pixel) {
+  int packed;
+  std::memcpy(&packed, pixel, 4);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i wide = _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero);
+  return _mm_cvtepi32_ps(_mm_unpacklo_epi16(wide, zero));
+}
+static inline Float4 load4(const float *pixel) { return _mm_loadu_ps(pixel); }
+static inline Float4 madd4(Float4 acc, float weight, Float4 value) {
+  return _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weight), value));
+}
+static inline void store4(float *pixel, Float4 value) {
+  _mm_storeu_ps(pixel, value);
+}
+static inline void store4(uint8_t *pixel, Float4 value) {
+  // Rounds, then saturates to [0, 255] while packing
+  __m128i wide = _mm_cvtps_epi32(value);
+  wide = _mm_packs_epi32(wide, wide);
+  int packed = _mm_cvtsi128_si32(_mm_packus_epi16(wide, wide));
+  std::memcpy(pixel, &packed, 4);
+}
+#else
+struct Float4 {
+  float v[4];
+};
+
+static inline Float4 zero4() { return Float4{{0.f, 0.f, 0.f, 0.f}}; }
+static inline Float4 load4(const uint8_t *pixel) {
+  return Float4{{static_cast<float>(pixel[0]), static_cast<float>(pixel[1]),
+                 static_cast<float>(pixel[2]), static_cast<float>(pixel[3])}};
+}
+static inline Float4 load4(const float *pixel) {
+  return Float4{{pixel[0], pixel[1], pixel[2], pixel[3]}};
+}
+static inline Float4 madd4(Float4 acc, float weight, Float4 value) {
+  for (int c = 0; c < 4; c++) {
+    acc.v[c] += weight * value.v[c];
+  }
+  return acc;
+}
+static inline void store4(float *pixel, Float4 value) {
+  std::memcpy(pixel, value.v, sizeof(value.v));
+}
+static inline void store4(uint8_t *pixel, Float4 value) {
+  for (int c = 0; c < 4; c++) {
+    pixel[c] =
+        static_cast<uint8_t>(std::clamp(std::lround(value.v[c]), 0L, 255L));
+  }
+}
+#endif
+
+static void downsampleBox(const Image &src, Image &dst, JobSystem &jobSystem) {
+  jobSystem.parallelFor(
+      0, dst.height, MIP_ROW_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; y++) {
+          const int y0 = std::min(static_cast<int>(2 * y), src.height - 1);
+          const int y1 = std::min(static_cast<int>(2 * y + 1), src.height - 1);
+          const uint8_t *row0 = src.at(0, y0);
+          const uint8_t *row1 = src.at(0, y1);
+          uint8_t *out = dst.at(0, static_cast<int>(y));
+
+          int x = 0;
+#ifdef OFYAGL_IMAGE_SSE
+          // Two output pixels from four input pixels of both rows
+          const __m128i zero = _mm_setzero_si128();
+          const __m128i rounding = _mm_set1_epi16(2);
+          for (; 2 * x + 4 <= src.width && x + 2 <= dst.width; x += 2) {
+            __m128i top = _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(row0 + 8 * x));
+            __m128i bottom = _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(row1 + 8 * x));
+            __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(top, zero),
+                                        _mm_unpacklo_epi8(bottom, zero));
+            __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(top, zero),
+                                         _mm_unpackhi_epi8(bottom, zero));
+            __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(low, high),
+                                        _mm_unpackhi_epi64(low, high));
+            sum = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + 4 * x),
+                             _mm_packus_epi16(sum, sum));
+          }
+#endif
+          for (; x < dst.width; x++) {
+            const int x0 = std::min(2 * x, src.width - 1);
+            const int x1 = std::min(2 * x + 1, src.width - 1);
+            for (int c = 0; c < 4; c++) {
+              out[4 * x + c] = static_cast<uint8_t>(
+                  (row0[4 * x0 + c] + row0[4 * x1 + c] + row1[4 * x0 + c] +
+                   row1[4 * x1 + c] + 2) >>
+                  2);
+            }
+          }
+        }
+      });
+}
+
+static double besselI0(double x) {
+  double sum = 1.0, term = 1.0;
+  for (int k = 1; k < 32; k++) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+/**
+ * Weights for source taps at offsets -3.5 to 3.5 around a destination
+ * pixel's center, normalized to sum to one.
+ */
+static const float *kaiserWeights() {
+  static const auto weights = [] {
+    constexpr double ALPHA = 4.0;
+    constexpr double PI = 3.14159265358979323846;
+    std::vector<float> result(KAISER_TAPS);
+    double sum = 0.0;
+    for (int i = 0; i < KAISER_TAPS; i++) {
+      const double offset = i - KAISER_TAPS / 2 + 0.5;
+      // Low pass at the destination's Nyquist frequency
+      const double x = PI * offset / 2.0;
+      const double sinc = std::sin(x) / x;
+      const double t = offset / (KAISER_TAPS / 2);
+      const double window =
+          besselI0(ALPHA * std::sqrt(std::max(0.0, 1.0 - t * t))) /
+          besselI0(ALPHA);
+      result[i] = static_cast<float>(sinc * window);
+      sum += result[i];
+    }
+    for (float &weight : result) {
+      weight = static_cast<float>(weight / sum);
+    }
+    return result;
+  }();
+  return weights.data();
+}
+
+static void downsampleKaiser(const Image &src, Image &dst,
+                             std::vector<float> &scratch,
+                             JobSystem &jobSystem) {
+  const float *weights = kaiserWeights();
+  const int firstTap = -KAISER_TAPS / 2 + 1;
+
+  // Horizontal pass into `scratch`, dst.width x src.height float pixels
+  scratch.resize(static_cast<size_t>(dst.width) * src.height * 4);
+  jobSystem.parallelFor(
+      0, src.height, MIP_ROW_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; y++) {
+          const uint8_t *row = src.at(0, static_cast<int>(y));
+          float *out = &scratch[y * dst.width * 4];
+          for (int x = 0; x < dst.width; x++) {
+            Float4 acc = zero4();
+            for (int tap = 0; tap < KAISER_TAPS; tap++) {
+              const int sx =
+                  std::clamp(2 * x + firstTap + tap, 0, src.width - 1);
+              acc = madd4(acc, weights[tap], load4(row + 4 * sx));
+            }
+            store4(out + 4 * x, acc);
+          }
+        }
+      });
+
+  jobSystem.parallelFor(
+      0, dst.height, MIP_ROW_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; y++) {
+          uint8_t *out = dst.at(0, static_cast<int>(y));
+          for (int x = 0; x < dst.width; x++) {
+            Float4 acc = zero4();
+            for (int tap = 0; tap < KAISER_TAPS; tap++) {
+              const int sy = std::clamp(
+                  static_cast<int>(2 * y) + firstTap + tap, 0, src.height - 1);
+              const size_t pixel = static_cast<size_t>(sy) * dst.width + x;
+              acc = madd4(acc, weights[tap], load4(&scratch[pixel * 4]));
+            }
+            store4(out + 4 * x, acc);
+          }
+        }
+      });
+}
+
+std::vector<Image> generateMipChain(Image base, MipFilter filter,
+                                    JobSystem &jobSystem) {
+  std::vector<Image> levels;
+  levels.push_back(std::move(base));
+  std::vector<float> scratch;
+
+  while (levels.back().width > 1 || levels.back().height > 1) {
+    const Image &src = levels.back();
+    Image dst;
+    dst.width = std::max(1, src.width / 2);
+    dst.height = std::max(1, src.height / 2);
+    dst.pixels.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+
+    if (filter == MipFilter::Kaiser) {
+      downsampleKaiser(src, dst, scratch, jobSystem);
+    } else {
+      downsampleBox(src, dst, jobSystem);
+    }
+    levels.push_back(std::move(dst));
+  }
+  return levels;
+}
+} // namespace ofyaGl
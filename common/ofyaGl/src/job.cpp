@@ -0,0 +1,416 @@
+#include <ofyaGl/job.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace ofyaGl {
+
+struct Task {
+  std::function<void()> fn;
+  Task *parent = nullptr;
+
+  /**
+   * The task itself plus every child still running. The task is done once
+   * this drops to 0.
+   */
+  std::atomic<int> unfinished{1};
+
+  /**
+   * Unfinished dependencies plus a launch guard, the task is scheduled once
+   * this drops to 0.
+   */
+  std::atomic<int> dependencies{1};
+
+  std::atomic<int> refs{1};
+
+  std::mutex continuationMutex;
+  std::vector<Task *> continuations;
+  bool finished = false;
+};
+
+static inline void retain(Task *task) {
+  task->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+static inline void drop(Task *task) {
+  if (task->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    if (task->parent != nullptr) {
+      drop(task->parent);
+    }
+    delete task;
+  }
+}
+
+static thread_local const JobSystem *tlsOwner = nullptr;
+static thread_local int tlsWorkerIndex = -1;
+
+TaskHandle::TaskHandle(Task *task) : task(task) {
+  if (task != nullptr) {
+    retain(task);
+  }
+}
+
+TaskHandle::TaskHandle(const TaskHandle &other) : TaskHandle(other.task) {}
+
+TaskHandle::TaskHandle(TaskHandle &&other) noexcept
+    : task(std::exchange(other.task, nullptr)) {}
+
+TaskHandle &TaskHandle::operator=(TaskHandle other) noexcept {
+  std::swap(task, other.task);
+  return *this;
+}
+
+TaskHandle::~TaskHandle() {
+  if (task != nullptr) {
+    drop(task);
+  }
+}
+
+bool TaskHandle::isDone() const {
+  return task == nullptr ||
+         task->unfinished.load(std::memory_order_acquire) == 0;
+}
+
+WorkStealingQueue::WorkStealingQueue()
+    : buffer(new std::atomic<Task *>[CAPACITY]) {}
+
+bool WorkStealingQueue::push(Task *task) {
+  int64_t b = bottom.load(std::memory_order_relaxed);
+  int64_t t = top.load(std::memory_order_acquire);
+  if (b - t >= CAPACITY) {
+    return false;
+  }
+  buffer[b & MASK].store(task, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  bottom.store(b + 1, std::memory_order_relaxed);
+  return true;
+}
+
+Task *WorkStealingQueue::pop() {
+  int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+  bottom.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t t = top.load(std::memory_order_relaxed);
+
+  if (t > b) {
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  Task *task = buffer[b & MASK].load(std::memory_order_relaxed);
+  if (t == b) {
+    // Last element, race the thieves for it
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed)) {
+      task = nullptr;
+    }
+    bottom.store(b + 1, std::memory_order_relaxed);
+  }
+  return task;
+}
+
+Task *WorkStealingQueue::steal() {
+  int64_t t = top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t b = bottom.load(std::memory_order_acquire);
+  if (t >= b) {
+    return nullptr;
+  }
+
+  Task *task = buffer[t & MASK].load(std::memory_order_relaxed);
+  if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                   std::memory_order_relaxed)) {
+    return nullptr;
+  }
+  return task;
+}
+
+JobSystem::JobSystem(unsigned workerCount) {
+  if (workerCount == HARDWARE_WORKERS) {
+    workerCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+  }
+  for (unsigned i = 0; i < workerCount; i++) {
+    workers.push_back(std::make_unique<Worker>());
+    workers.back()->rng = 0x9E3779B9u * (i + 1);
+  }
+  for (unsigned i = 0; i < workerCount; i++) {
+    threads.emplace_back(&JobSystem::workerMain, this, i);
+  }
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    stopping.store(true);
+  }
+  sleepCv.notify_all();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+JobSystem &JobSystem::shared() {
+  static JobSystem jobSystem;
+  return jobSystem;
+}
+
+int JobSystem::currentWorker() const {
+  return tlsOwner == this ? tlsWorkerIndex : -1;
+}
+
+void JobSystem::workerMain(unsigned index) {
+  tlsOwner = this;
+  tlsWorkerIndex = static_cast<int>(index);
+
+  unsigned spins = 0;
+  while (!stopping.load(std::memory_order_relaxed)) {
+    const uint64_t epoch = workEpoch.load();
+
+    Task *task = findWork(index);
+    if (task != nullptr) {
+      execute(task, index);
+      spins = 0;
+      continue;
+    }
+
+    if (++spins < 64) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    sleeping.fetch_add(1);
+    sleepCv.wait(lock, [&] {
+      return stopping.load() || workEpoch.load() != epoch;
+    });
+    sleeping.fetch_sub(1);
+    spins = 0;
+  }
+}
+
+Task *JobSystem::findWork(int workerIndex) {
+  Worker *self = nullptr;
+  if (workerIndex >= 0) {
+    self = workers[workerIndex].get();
+    if (Task *task = self->queue.pop()) {
+      return task;
+    }
+  }
+
+  if (injectSize.load(std::memory_order_relaxed) > 0) {
+    std::lock_guard<std::mutex> lock(injectMutex);
+    if (!injectQueue.empty()) {
+      Task *task = injectQueue.front();
+      injectQueue.pop_front();
+      injectSize.store(injectQueue.size(), std::memory_order_relaxed);
+      return task;
+    }
+  }
+
+  const size_t count = workers.size();
+  size_t start = 0;
+  if (self != nullptr) {
+    // xorshift, so thieves don't all hammer the same victim
+    self->rng ^= self->rng << 13;
+    self->rng ^= self->rng >> 17;
+    self->rng ^= self->rng << 5;
+    start = self->rng % count;
+  }
+  for (size_t i = 0; i < count; i++) {
+    size_t victim = (start + i) % count;
+    if (static_cast<int>(victim) == workerIndex) {
+      continue;
+    }
+    if (Task *task = workers[victim]->queue.steal()) {
+      if (self != nullptr) {
+        self->stolen.fetch_add(1, std::memory_order_relaxed);
+      }
+      return task;
+    }
+  }
+  return nullptr;
+}
+
+void JobSystem::schedule(Task *task) {
+  int workerIndex = currentWorker();
+  if (workerIndex >= 0) {
+    if (!workers[workerIndex]->queue.push(task)) {
+      // Deque is full, running it right away is as good as anything
+      execute(task, workerIndex);
+      return;
+    }
+  } else {
+    std::lock_guard<std::mutex> lock(injectMutex);
+    injectQueue.push_back(task);
+    injectSize.store(injectQueue.size(), std::memory_order_relaxed);
+  }
+
+  workEpoch.fetch_add(1);
+  if (sleeping.load() > 0) {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    sleepCv.notify_one();
+  }
+}
+
+void JobSystem::execute(Task *task, int workerIndex) {
+  if (task->fn) {
+    task->fn();
+  }
+  if (workerIndex >= 0) {
+    workers[workerIndex]->executed.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    externalExecuted.fetch_add(1, std::memory_order_relaxed);
+  }
+  finish(task);
+  // The scheduler's reference, taken in `create`
+  drop(task);
+}
+
+void JobSystem::finish(Task *task) {
+  if (task->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+    return;
+  }
+
+  std::vector<Task *> continuations;
+  {
+    std::lock_guard<std::mutex> lock(task->continuationMutex);
+    task->finished = true;
+    continuations.swap(task->continuations);
+  }
+  for (Task *continuation : continuations) {
+    release(continuation);
+  }
+
+  if (task->parent != nullptr) {
+    finish(task->parent);
+  }
+}
+
+void JobSystem::release(Task *task) {
+  if (task->dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    schedule(task);
+  }
+}
+
+TaskHandle JobSystem::create(std::function<void()> fn, Task *parent) {
+  // Starts with one reference owned by the scheduler
+  Task *task = new Task();
+  task->fn = std::move(fn);
+  if (parent != nullptr) {
+    retain(parent);
+    parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+    task->parent = parent;
+  }
+  return TaskHandle(task);
+}
+
+TaskHandle JobSystem::submit(std::function<void()> fn) {
+  TaskHandle handle = create(std::move(fn), nullptr);
+  release(handle.task);
+  return handle;
+}
+
+TaskHandle JobSystem::submitAfter(const std::vector<TaskHandle> &dependencies,
+                                  std::function<void()> fn) {
+  TaskHandle handle = create(std::move(fn), nullptr);
+  Task *task = handle.task;
+
+  for (const TaskHandle &dependency : dependencies) {
+    if (!dependency.isValid()) {
+      continue;
+    }
+    Task *dep = dependency.task;
+    std::lock_guard<std::mutex> lock(dep->continuationMutex);
+    if (!dep->finished) {
+      task->dependencies.fetch_add(1, std::memory_order_relaxed);
+      dep->continuations.push_back(task);
+    }
+  }
+
+  release(task);
+  return handle;
+}
+
+TaskHandle
+JobSystem::submitAfter(std::initializer_list<TaskHandle> dependencies,
+                       std::function<void()> fn) {
+  return submitAfter(std::vector<TaskHandle>(dependencies), std::move(fn));
+}
+
+void JobSystem::wait(const TaskHandle &handle) {
+  const int workerIndex = currentWorker();
+  while (!handle.isDone()) {
+    Task *task = findWork(workerIndex);
+    if (task != nullptr) {
+      execute(task, workerIndex);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void JobSystem::waitAll(const std::vector<TaskHandle> &handles) {
+  for (const TaskHandle &handle : handles) {
+    wait(handle);
+  }
+}
+
+void JobSystem::spawnRange(Task *parent, size_t begin, size_t end,
+                           size_t grain, const std::shared_ptr<const RangeFn> &fn) {
+  // Hand the upper halves out as stealable tasks and keep the lowest piece,
+  // so thieves get big chunks and the spawner stays busy
+  while (end - begin > grain) {
+    size_t mid = begin + (end - begin) / 2;
+    TaskHandle child = create(
+        [this, parent, mid, end, grain, fn] {
+          spawnRange(parent, mid, end, grain, fn);
+        },
+        parent);
+    release(child.task);
+    end = mid;
+  }
+  (*fn)(begin, end);
+}
+
+TaskHandle JobSystem::submitRange(size_t begin, size_t end, size_t grain,
+                                  const RangeFn &fn) {
+  grain = std::max<size_t>(grain, 1);
+  auto sharedFn = std::make_shared<const RangeFn>(fn);
+
+  TaskHandle root = create({}, nullptr);
+  Task *rootTask = root.task;
+  TaskHandle first = create(
+      [this, rootTask, begin, end, grain, sharedFn] {
+        if (begin < end) {
+          spawnRange(rootTask, begin, end, grain, sharedFn);
+        }
+      },
+      rootTask);
+  release(first.task);
+
+  // The root has no work of its own, it just completes with its children.
+  // Dropping its own count plus the scheduler reference stands in for
+  // running it.
+  finish(rootTask);
+  drop(rootTask);
+  return root;
+}
+
+void JobSystem::parallelFor(size_t begin, size_t end, size_t grain,
+                            const RangeFn &fn) {
+  if (end - begin <= grain || workers.empty()) {
+    fn(begin, end);
+    return;
+  }
+  wait(submitRange(begin, end, grain, fn));
+}
+
+JobSystem::Stats JobSystem::getStats() const {
+  Stats stats{externalExecuted.load(std::memory_order_relaxed), 0};
+  for (const auto &worker : workers) {
+    stats.executed += worker->executed.load(std::memory_order_relaxed);
+    stats.stolen += worker->stolen.load(std::memory_order_relaxed);
+  }
+  return stats;
+}
+} // namespace ofyaGl
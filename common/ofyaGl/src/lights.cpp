@@ -0,0 +1,285 @@
+#include <ofyaGl/lights.h>
+
+#include <ofyaGl/gl.h>
+#include <ofyaGl/job.h>
+#include <ofyaGl/memory.h>
+
+#include <algorithm>
+#include <cmath>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+
+namespace ofyaGl {
+
+/**
+ * Clusters per task during light assignment.
+ */
+constexpr size_t CLUSTER_GRAIN = 64;
+
+/**
+ * RGBA32F texels per light in the `lights` buffer.
+ */
+constexpr size_t TEXELS_PER_LIGHT = 4;
+
+Light Light::point(const glm::vec3 &position, float radius,
+                   const glm::vec3 &color, float intensity) {
+  return Light{LightType::Point,
+               position,
+               radius,
+               color,
+               intensity,
+               glm::vec3(0.f, 0.f, -1.f),
+               -1.f,
+               -1.f};
+}
+
+Light Light::spot(const glm::vec3 &position, const glm::vec3 &direction,
+                  float radius, float innerAngle, float outerAngle,
+                  const glm::vec3 &color, float intensity) {
+  return Light{LightType::Spot,
+               position,
+               radius,
+               color,
+               intensity,
+               glm::normalize(direction),
+               std::cos(innerAngle),
+               std::cos(outerAngle)};
+}
+
+ClusteredLighting::ClusteredLighting(glm::ivec3 dims)
+    : dims(dims), clusterBounds(clusterCount()),
+      sliceLights(static_cast<size_t>(dims.z)),
+      clusterLights(clusterCount() * MAX_LIGHTS_PER_CLUSTER),
+      clusterCounts(clusterCount()), clusterRanges(clusterCount() * 2) {
+  const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+  GL_CALL(glGenBuffers(3, buffers));
+  GL_CALL(glGenTextures(3, textures));
+  for (int i = 0; i < 3; i++) {
+    GL_CALL(glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]));
+    GL_CALL(glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW));
+    GL_CALL(glBindTexture(GL_TEXTURE_BUFFER, textures[i]));
+    GL_CALL(glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]));
+    bufferSizes[i] = 16;
+  }
+  MemoryTracker::shared().add(MemoryCategory::OtherBuffer, 3 * 16, 3);
+  GL_CALL(glBindTexture(GL_TEXTURE_BUFFER, 0));
+  GL_CALL(glBindBuffer(GL_TEXTURE_BUFFER, 0));
+}
+
+void ClusteredLighting::setProjection(const glm::mat4 &projection,
+                                      float nearPlane, float farPlane) {
+  this->projection = projection;
+  this->nearPlane = nearPlane;
+  this->farPlane = farPlane;
+  clustersStale = true;
+}
+
+void ClusteredLighting::setViewport(int width, int height) {
+  glm::vec2 size(static_cast<float>(std::max(width, 1)),
+                 static_cast<float>(std::max(height, 1)));
+  if (size.x != viewport.x || size.y != viewport.y) {
+    viewport = size;
+    clustersStale = true;
+  }
+}
+
+void ClusteredLighting::buildClusterBounds() {
+  const glm::mat4 inverseProjection = glm::inverse(projection);
+  const float depthRatio = farPlane / nearPlane;
+
+  for (int z = 0; z < dims.z; z++) {
+    const float sliceNear =
+        nearPlane * std::pow(depthRatio, static_cast<float>(z) / dims.z);
+    const float sliceFar =
+        nearPlane * std::pow(depthRatio, static_cast<float>(z + 1) / dims.z);
+
+    for (int y = 0; y < dims.y; y++) {
+      for (int x = 0; x < dims.x; x++) {
+        const float ndcX[2] = {2.f * x / dims.x - 1.f,
+                               2.f * (x + 1) / dims.x - 1.f};
+        const float ndcY[2] = {2.f * y / dims.y - 1.f,
+                               2.f * (y + 1) / dims.y - 1.f};
+
+        Aabb bounds{glm::vec3(INFINITY), glm::vec3(-INFINITY)};
+        for (float cornerX : ndcX) {
+          for (float cornerY : ndcY) {
+            // Point on the near plane, then slide along the eye ray to the
+            // slice's planes
+            glm::vec4 onNear =
+                inverseProjection * glm::vec4(cornerX, cornerY, -1.f, 1.f);
+            glm::vec3 ray = glm::vec3(onNear) / onNear.w;
+            for (float depth : {sliceNear, sliceFar}) {
+              glm::vec3 corner = ray * (depth / -ray.z);
+              bounds.min = glm::min(bounds.min, corner);
+              bounds.max = glm::max(bounds.max, corner);
+            }
+          }
+        }
+
+        clusterBounds[x + dims.x * (y + dims.y * z)] = bounds;
+      }
+    }
+  }
+
+  clustersStale = false;
+}
+
+void ClusteredLighting::assignLights() {
+  // Bucket lights by depth slice first, so each cluster only tests the
+  // lights that can reach its slice
+  const float logRatio = std::log(farPlane / nearPlane);
+  for (auto &slice : sliceLights) {
+    slice.clear();
+  }
+  for (uint32_t i = 0; i < viewLights.size(); i++) {
+    const ViewLight &light = viewLights[i];
+    const float depth = -light.position.z;
+    const float minDepth = std::max(depth - light.radius, nearPlane);
+    const float maxDepth = std::min(depth + light.radius, farPlane);
+    if (minDepth > maxDepth) {
+      continue;
+    }
+    int firstSlice = static_cast<int>(std::log(minDepth / nearPlane) /
+                                      logRatio * dims.z);
+    int lastSlice = static_cast<int>(std::log(maxDepth / nearPlane) /
+                                     logRatio * dims.z);
+    firstSlice = std::clamp(firstSlice, 0, dims.z - 1);
+    lastSlice = std::clamp(lastSlice, 0, dims.z - 1);
+    for (int z = firstSlice; z <= lastSlice; z++) {
+      sliceLights[z].push_back(i);
+    }
+  }
+
+  const size_t tilesPerSlice = static_cast<size_t>(dims.x) * dims.y;
+  JobSystem::shared().parallelFor(
+      0, clusterCount(), CLUSTER_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t cluster = begin; cluster < end; cluster++) {
+          const Aabb &bounds = clusterBounds[cluster];
+          const auto &candidates = sliceLights[cluster / tilesPerSlice];
+          uint32_t *out = &clusterLights[cluster * MAX_LIGHTS_PER_CLUSTER];
+
+          uint32_t count = 0;
+          for (uint32_t index : candidates) {
+            const ViewLight &light = viewLights[index];
+            glm::vec3 closest =
+                glm::clamp(light.position, bounds.min, bounds.max);
+            glm::vec3 delta = closest - light.position;
+            if (glm::dot(delta, delta) > light.radius * light.radius) {
+              continue;
+            }
+            if (count < MAX_LIGHTS_PER_CLUSTER) {
+              out[count] = index;
+            }
+            count++;
+          }
+          clusterCounts[cluster] = count;
+        }
+      });
+
+  // Compact the fixed size per cluster lists into one index buffer
+  lightIndices.clear();
+  stats.maxLightsPerCluster = 0;
+  stats.overflowedClusters = 0;
+  for (size_t cluster = 0; cluster < clusterCount(); cluster++) {
+    uint32_t count = clusterCounts[cluster];
+    stats.maxLightsPerCluster =
+        std::max<size_t>(stats.maxLightsPerCluster, count);
+    if (count > MAX_LIGHTS_PER_CLUSTER) {
+      stats.overflowedClusters++;
+      count = MAX_LIGHTS_PER_CLUSTER;
+    }
+    clusterRanges[cluster * 2] = static_cast<uint32_t>(lightIndices.size());
+    clusterRanges[cluster * 2 + 1] = count;
+    const uint32_t *first = &clusterLights[cluster * MAX_LIGHTS_PER_CLUSTER];
+    lightIndices.insert(lightIndices.end(), first, first + count);
+  }
+  stats.indexCount = lightIndices.size();
+}
+
+void ClusteredLighting::upload() {
+  const void *data[3] = {lightTexels.data(), clusterRanges.data(),
+                         lightIndices.data()};
+  const size_t sizes[3] = {sizeof(glm::vec4) * lightTexels.size(),
+                           sizeof(uint32_t) * clusterRanges.size(),
+                           sizeof(uint32_t) * lightIndices.size()};
+  MemoryTracker &memoryTracker = MemoryTracker::shared();
+  for (int i = 0; i < 3; i++) {
+    if (sizes[i] == 0) {
+      continue;
+    }
+    // Orphan first, the GPU may still be reading last frame's lists
+    GL_CALL(glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]));
+    GL_CALL(glBufferData(GL_TEXTURE_BUFFER, sizes[i], nullptr, GL_STREAM_DRAW));
+    GL_CALL(glBufferSubData(GL_TEXTURE_BUFFER, 0, sizes[i], data[i]));
+    if (sizes[i] != bufferSizes[i]) {
+      memoryTracker.remove(MemoryCategory::OtherBuffer, bufferSizes[i], 0);
+      memoryTracker.add(MemoryCategory::OtherBuffer, sizes[i], 0);
+      bufferSizes[i] = sizes[i];
+    }
+  }
+  GL_CALL(glBindBuffer(GL_TEXTURE_BUFFER, 0));
+}
+
+void ClusteredLighting::update(const std::vector<Light> &lights,
+                               const glm::mat4 &view) {
+  if (clustersStale) {
+    buildClusterBounds();
+  }
+
+  viewLights.resize(lights.size());
+  lightTexels.resize(lights.size() * TEXELS_PER_LIGHT);
+  for (size_t i = 0; i < lights.size(); i++) {
+    const Light &light = lights[i];
+    glm::vec3 position = glm::vec3(view * glm::vec4(light.position, 1.f));
+    glm::vec3 direction = glm::vec3(view * glm::vec4(light.direction, 0.f));
+    viewLights[i] = {position, light.radius};
+
+    glm::vec4 *texels = &lightTexels[i * TEXELS_PER_LIGHT];
+    texels[0] = glm::vec4(position, light.radius);
+    texels[1] = glm::vec4(light.color * light.intensity,
+                          static_cast<float>(light.type));
+    texels[2] = glm::vec4(direction, light.spotCosOuter);
+    texels[3] = glm::vec4(light.spotCosInner, 0.f, 0.f, 0.f);
+  }
+  stats.lightCount = lights.size();
+
+  assignLights();
+  upload();
+}
+
+void ClusteredLighting::bind(Shader &shader, GLuint firstTextureUnit) const {
+  const char *samplers[3] = {"lights", "cluster_ranges", "light_indices"};
+  for (GLuint i = 0; i < 3; i++) {
+    GL_CALL(glActiveTexture(GL_TEXTURE0 + firstTextureUnit + i));
+    GL_CALL(glBindTexture(GL_TEXTURE_BUFFER, textures[i]));
+    shader.setUniform(samplers[i], static_cast<int>(firstTextureUnit + i));
+  }
+  GL_CALL(glActiveTexture(GL_TEXTURE0));
+
+  // slice = log(depth) * scale + bias
+  const float logRatio = std::log(farPlane / nearPlane);
+  const float scale = dims.z / logRatio;
+  const float bias = -dims.z * std::log(nearPlane) / logRatio;
+
+  shader.setUniform("cluster_dims", dims);
+  shader.setUniform("cluster_tile_size",
+                    glm::vec2(viewport.x / dims.x, viewport.y / dims.y));
+  shader.setUniform("cluster_z_params", glm::vec2(scale, bias));
+}
+
+void ClusteredLighting::destroy() {
+  if (buffers[0] == 0) {
+    return;
+  }
+  GL_CALL(glDeleteTextures(3, textures));
+  GL_CALL(glDeleteBuffers(3, buffers));
+  MemoryTracker::shared().remove(
+      MemoryCategory::OtherBuffer,
+      bufferSizes[0] + bufferSizes[1] + bufferSizes[2], 3);
+  for (int i = 0; i < 3; i++) {
+    textures[i] = buffers[i] = 0;
+    bufferSizes[i] = 0;
+  }
+}
+} // namespace ofyaGl
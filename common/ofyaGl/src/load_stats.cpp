@@ -0,0 +1,49 @@
+#include <ofyaGl/load_stats.h>
+
+#include <iomanip>
+
+namespace ofyaGl {
+
+static const char *const PHASE_NAMES[LOAD_PHASE_COUNT] = {
+    "read", "scan", "parse", "materials", "weld", "sub_meshes", "decode"};
+
+const char *getLoadPhaseName(LoadPhase phase) {
+  return PHASE_NAMES[static_cast<size_t>(phase)];
+}
+
+void LoadStats::writeJson(std::ostream &out) const {
+  // Phases take microseconds, whatever format the caller left behind
+  const std::ios::fmtflags flags = out.flags();
+  const std::streamsize precision = out.precision();
+  out << std::defaultfloat << std::setprecision(6);
+
+  out << "{\n  \"bytes_read\": " << bytesRead
+      << ",\n  \"bytes_decompressed\": " << bytesDecompressed
+      << ",\n  \"decompress_seconds\": " << decompressSeconds
+      << ",\n  \"total_seconds\": " << totalSeconds
+      << ",\n  \"lines\": {\"total\": " << lines.total
+      << ", \"v\": " << lines.vertPos << ", \"vt\": " << lines.texCoord
+      << ", \"vn\": " << lines.vertNormal << ", \"f\": " << lines.face
+      << ", \"o_g\": " << lines.group << ", \"usemtl\": " << lines.useMaterial
+      << ", \"mtllib\": " << lines.materialLibrary
+      << ", \"comment\": " << lines.comment << ", \"blank\": " << lines.blank
+      << ", \"other\": " << lines.other << "}"
+      << ",\n  \"faces\": {\"triangles\": " << triangles
+      << ", \"quads\": " << quads << ", \"polygons\": " << polygons << "}"
+      << ",\n  \"vertices\": {\"input\": " << inputVertices
+      << ", \"unique\": " << uniqueVertices << "}"
+      << ",\n  \"phases\": {";
+  for (size_t i = 0; i < LOAD_PHASE_COUNT; i++) {
+    const LoadPhaseStats &phase = phases[i];
+    out << (i == 0 ? "\n" : ",\n") << "    \"" << PHASE_NAMES[i]
+        << "\": {\"seconds\": " << phase.seconds
+        << ", \"arena_bytes\": " << phase.arenaBytes
+        << ", \"arena_blocks\": " << phase.arenaBlocks
+        << ", \"heap_bytes\": " << phase.heapBytes << "}";
+  }
+  out << "\n  }\n}\n";
+
+  out.flags(flags);
+  out.precision(precision);
+}
+} // namespace ofyaGl
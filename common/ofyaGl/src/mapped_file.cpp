@@ -0,0 +1,84 @@
+#include <ofyaGl/mapped_file.h>
+
+#include <cstdio>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define OFYAGL_HAVE_MMAP
+#endif
+
+namespace ofyaGl {
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : bytes(std::exchange(other.bytes, nullptr)),
+      size(std::exchange(other.size, 0)),
+      mapped(std::exchange(other.mapped, false)),
+      fallback(std::move(other.fallback)) {}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+  std::swap(bytes, other.bytes);
+  std::swap(size, other.size);
+  std::swap(mapped, other.mapped);
+  std::swap(fallback, other.fallback);
+  return *this;
+}
+
+MappedFile::~MappedFile() {
+#ifdef OFYAGL_HAVE_MMAP
+  if (mapped) {
+    munmap(const_cast<uint8_t *>(bytes), size);
+  }
+#endif
+}
+
+std::optional<MappedFile> MappedFile::open(const char *path) {
+  MappedFile file;
+
+#ifdef OFYAGL_HAVE_MMAP
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    return {};
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+    close(fd);
+    return {};
+  }
+  void *address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ,
+                       MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (address != MAP_FAILED) {
+    file.bytes = static_cast<const uint8_t *>(address);
+    file.size = static_cast<size_t>(info.st_size);
+    file.mapped = true;
+    return file;
+  }
+#endif
+
+  std::FILE *stream = std::fopen(path, "rb");
+  if (stream == nullptr) {
+    return {};
+  }
+  std::fseek(stream, 0, SEEK_END);
+  long length = std::ftell(stream);
+  std::fseek(stream, 0, SEEK_SET);
+  if (length <= 0) {
+    std::fclose(stream);
+    return {};
+  }
+  file.fallback.resize(static_cast<size_t>(length));
+  size_t read =
+      std::fread(file.fallback.data(), 1, file.fallback.size(), stream);
+  std::fclose(stream);
+  if (read != file.fallback.size()) {
+    return {};
+  }
+  file.bytes = file.fallback.data();
+  file.size = file.fallback.size();
+  return file;
+}
+} // namespace ofyaGl
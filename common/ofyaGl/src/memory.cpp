@@ -0,0 +1,97 @@
+#include <ofyaGl/memory.h>
+
+namespace ofyaGl {
+
+static const char *const CATEGORY_NAMES[MEMORY_CATEGORY_COUNT] = {
+    "mesh_staging",  "texture_staging", "vertex_buffer", "index_buffer",
+    "other_buffer",  "texture",         "shader"};
+
+/**
+ * Raises `peak` to `value` unless another thread already went higher.
+ */
+static inline void raisePeak(std::atomic<size_t> &peak, size_t value) {
+  size_t current = peak.load(std::memory_order_relaxed);
+  while (current < value &&
+         !peak.compare_exchange_weak(current, value,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+const char *getMemoryCategoryName(MemoryCategory category) {
+  return CATEGORY_NAMES[static_cast<size_t>(category)];
+}
+
+size_t MemorySnapshot::getObjectCount() const {
+  size_t count = 0;
+  for (const MemoryCounters &counters : categories) {
+    count += counters.objects;
+  }
+  return count;
+}
+
+void MemorySnapshot::writeJson(std::ostream &out) const {
+  out << "{\n  \"total_bytes\": " << totalBytes
+      << ",\n  \"peak_total_bytes\": " << peakTotalBytes
+      << ",\n  \"categories\": {";
+  for (size_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+    const MemoryCounters &counters = categories[i];
+    out << (i == 0 ? "\n" : ",\n") << "    \"" << CATEGORY_NAMES[i]
+        << "\": {\"bytes\": " << counters.bytes
+        << ", \"peak_bytes\": " << counters.peakBytes
+        << ", \"objects\": " << counters.objects
+        << ", \"allocations\": " << counters.allocations << "}";
+  }
+  out << "\n  }\n}\n";
+}
+
+MemoryTracker &MemoryTracker::shared() {
+  static MemoryTracker memoryTracker;
+  return memoryTracker;
+}
+
+void MemoryTracker::add(MemoryCategory category, size_t bytes,
+                        size_t objects) {
+  Counters &entry = counters[static_cast<size_t>(category)];
+  const size_t categoryBytes =
+      entry.bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  raisePeak(entry.peakBytes, categoryBytes);
+  entry.objects.fetch_add(objects, std::memory_order_relaxed);
+  entry.allocations.fetch_add(objects, std::memory_order_relaxed);
+
+  const size_t total =
+      totalBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  raisePeak(peakTotalBytes, total);
+}
+
+void MemoryTracker::remove(MemoryCategory category, size_t bytes,
+                           size_t objects) {
+  Counters &entry = counters[static_cast<size_t>(category)];
+  entry.bytes.fetch_sub(bytes, std::memory_order_relaxed);
+  entry.objects.fetch_sub(objects, std::memory_order_relaxed);
+  totalBytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+MemorySnapshot MemoryTracker::snapshot() const {
+  MemorySnapshot snapshot{};
+  for (size_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+    const Counters &entry = counters[i];
+    snapshot.categories[i] = {
+        entry.bytes.load(std::memory_order_relaxed),
+        entry.peakBytes.load(std::memory_order_relaxed),
+        entry.objects.load(std::memory_order_relaxed),
+        entry.allocations.load(std::memory_order_relaxed)};
+  }
+  snapshot.totalBytes = totalBytes.load(std::memory_order_relaxed);
+  snapshot.peakTotalBytes = peakTotalBytes.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+void MemoryTracker::resetPeaks() {
+  for (Counters &entry : counters) {
+    entry.peakBytes.store(entry.bytes.load(std::memory_order_relaxed),
+                          std::memory_order_relaxed);
+  }
+  peakTotalBytes.store(totalBytes.load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+}
+} // namespace ofyaGl
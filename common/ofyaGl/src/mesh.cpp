@@ -0,0 +1,168 @@
+#include <ofyaGl/mesh.h>
+
+#include <ofyaGl/debug.h>
+#include <ofyaGl/memory.h>
+
+#include <cstring>
+#include <utility>
+
+namespace ofyaGl {
+
+/**
+ * Copies `size` bytes into the currently bound `target` buffer at `offset`.
+ * Maps the range unsynchronized since it's freshly allocated storage, falls
+ * back to `glBufferSubData` if the driver refuses the mapping.
+ */
+static void writeBufferRange(GLenum target, size_t offset, size_t size,
+                             const void *data) {
+  void *dst = GL_CALL(glMapBufferRange(target, offset, size,
+                                       GL_MAP_WRITE_BIT |
+                                           GL_MAP_INVALIDATE_RANGE_BIT |
+                                           GL_MAP_UNSYNCHRONIZED_BIT));
+  if (dst == nullptr) {
+    GL_CALL(glBufferSubData(target, offset, size, data));
+    return;
+  }
+  std::memcpy(dst, data, size);
+  GL_CALL(glUnmapBuffer(target));
+}
+
+Mesh::Mesh(Mesh &&other) noexcept
+    : vao(std::exchange(other.vao, 0)), vbo(std::exchange(other.vbo, 0)),
+      ebo(std::exchange(other.ebo, 0)),
+      vertCount(std::exchange(other.vertCount, 0)),
+      indexCount(std::exchange(other.indexCount, 0)) {}
+
+Mesh &Mesh::operator=(Mesh &&other) noexcept {
+  std::swap(vao, other.vao);
+  std::swap(vbo, other.vbo);
+  std::swap(ebo, other.ebo);
+  std::swap(vertCount, other.vertCount);
+  std::swap(indexCount, other.indexCount);
+  return *this;
+}
+
+Mesh Mesh::allocate(size_t vertCount, size_t indexCount) {
+  GLuint vao;
+  GL_CALL(glGenVertexArrays(1, &vao));
+  GL_CALL(glBindVertexArray(vao));
+
+  GLuint vbo;
+  GL_CALL(glGenBuffers(1, &vbo));
+  GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
+  GL_CALL(glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertCount, nullptr,
+                       GL_STATIC_DRAW));
+  GL_CALL(glEnableVertexAttribArray(0));
+  GL_CALL(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                                (GLvoid *)0));
+  GL_CALL(glEnableVertexAttribArray(1));
+  GL_CALL(glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                                (GLvoid *)(sizeof(float) * 3)));
+  GL_CALL(glEnableVertexAttribArray(2));
+  GL_CALL(glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                                (GLvoid *)(sizeof(float) * 6)));
+
+  GLuint ebo;
+  GL_CALL(glGenBuffers(1, &ebo));
+  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo));
+  GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                       sizeof(unsigned int) * indexCount, nullptr,
+                       GL_STATIC_DRAW));
+
+  GL_CALL(glBindVertexArray(0));
+
+  MemoryTracker &memoryTracker = MemoryTracker::shared();
+  memoryTracker.add(MemoryCategory::VertexBuffer, sizeof(Vertex) * vertCount);
+  memoryTracker.add(MemoryCategory::IndexBuffer,
+                    sizeof(unsigned int) * indexCount);
+
+  return Mesh(vao, vbo, ebo, vertCount, indexCount);
+}
+
+Mesh Mesh::fromObjData(const ObjData &objData) {
+  Mesh mesh = allocate(objData.verts.size(), objData.indicies.size());
+  if (objData.hasAmbientOcclusion) {
+    mesh.enableAmbientOcclusion();
+  }
+  mesh.uploadVerts(objData.verts.data(), 0, objData.verts.size());
+  mesh.uploadIndicies(objData.indicies.data(), 0, objData.indicies.size());
+  return mesh;
+}
+
+void Mesh::uploadVerts(const Vertex *verts, size_t offset, size_t count) {
+  if (count == 0) {
+    return;
+  }
+  GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
+  writeBufferRange(GL_ARRAY_BUFFER, sizeof(Vertex) * offset,
+                   sizeof(Vertex) * count, verts);
+}
+
+void Mesh::enableAmbientOcclusion() const {
+  GL_CALL(glBindVertexArray(vao));
+  GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
+  GL_CALL(glEnableVertexAttribArray(AMBIENT_OCCLUSION_ATTRIBUTE));
+  GL_CALL(glVertexAttribPointer(AMBIENT_OCCLUSION_ATTRIBUTE, 1, GL_FLOAT,
+                                GL_FALSE, sizeof(Vertex),
+                                (GLvoid *)(sizeof(float) * 5)));
+  GL_CALL(glBindVertexArray(0));
+}
+
+void Mesh::uploadIndicies(const unsigned int *indicies, size_t offset,
+                          size_t count) {
+  if (count == 0) {
+    return;
+  }
+  // The element buffer binding is VAO state, so go through our own VAO
+  GL_CALL(glBindVertexArray(vao));
+  writeBufferRange(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * offset,
+                   sizeof(unsigned int) * count, indicies);
+  GL_CALL(glBindVertexArray(0));
+}
+
+size_t Mesh::drawSubMeshes(
+    const std::vector<SubMesh> &subMeshes,
+    const std::function<void(uint32_t materialIndex)> &bindMaterial) const {
+  size_t drawCount = 0;
+  size_t i = 0;
+  while (i < subMeshes.size()) {
+    const uint32_t materialIndex = subMeshes[i].materialIndex;
+    const size_t offset = subMeshes[i].indexOffset;
+    size_t end = offset + subMeshes[i].indexCount;
+    for (i++; i < subMeshes.size() &&
+              subMeshes[i].materialIndex == materialIndex &&
+              subMeshes[i].indexOffset == end;
+         i++) {
+      end += subMeshes[i].indexCount;
+    }
+
+    bindMaterial(materialIndex);
+    drawRange(offset, end - offset);
+    drawCount++;
+  }
+  return drawCount;
+}
+
+void Mesh::setLabel(const std::string &label) const {
+  GlDebug &debug = GlDebug::shared();
+  debug.label(GL_VERTEX_ARRAY, vao, label);
+  debug.label(GL_BUFFER, vbo, label + " vertices");
+  debug.label(GL_BUFFER, ebo, label + " indices");
+}
+
+void Mesh::destroy() {
+  if (vao == 0) {
+    return;
+  }
+  GL_CALL(glDeleteBuffers(1, &ebo));
+  GL_CALL(glDeleteBuffers(1, &vbo));
+  GL_CALL(glDeleteVertexArrays(1, &vao));
+  MemoryTracker &memoryTracker = MemoryTracker::shared();
+  memoryTracker.remove(MemoryCategory::VertexBuffer,
+                       sizeof(Vertex) * vertCount);
+  memoryTracker.remove(MemoryCategory::IndexBuffer,
+                       sizeof(unsigned int) * indexCount);
+  vao = vbo = ebo = 0;
+  vertCount = indexCount = 0;
+}
+} // namespace ofyaGl
@@ -0,0 +1,580 @@
+#include <ofyaGl/mesh_codec.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OFYAGL_CODEC_SSE
+#endif
+
+namespace ofyaGl {
+
+static_assert(sizeof(unsigned int) == sizeof(uint32_t),
+              "ObjData indices are decoded as uint32_t");
+
+constexpr size_t BLOCK_VERTS = 256;
+constexpr size_t GROUP_SIZE = 16;
+constexpr size_t MAX_STRIDE = 256;
+
+/**
+ * Payload bytes of a 16 byte group for each 2 bit header value.
+ */
+constexpr size_t GROUP_BYTES[4] = {0, 4, 8, 16};
+
+constexpr char MESH_MAGIC[4] = {'O', 'F', 'M', 'C'};
+
+/**
+ * Start of an `.ofm` file. The encoded vertices follow, then the encoded
+ * indices, then the materials and sub meshes. Little endian throughout.
+ */
+struct MeshHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t vertexStride;
+  uint32_t materialCount;
+  uint32_t subMeshCount;
+  uint32_t flags;
+  uint64_t vertexBytes;
+  uint64_t indexBytes;
+};
+
+/**
+ * `ObjData::hasAmbientOcclusion`.
+ */
+constexpr uint32_t MESH_FLAG_AMBIENT_OCCLUSION = 1;
+
+static inline bool isValidStride(size_t stride) {
+  return stride != 0 && stride % 4 == 0 && stride <= MAX_STRIDE;
+}
+
+static inline size_t roundUpToGroup(size_t count) {
+  return (count + GROUP_SIZE - 1) / GROUP_SIZE * GROUP_SIZE;
+}
+
+static inline uint8_t zigzag8(uint8_t delta) {
+  return static_cast<uint8_t>((delta << 1) ^
+                              (static_cast<int8_t>(delta) >> 7));
+}
+
+static inline uint8_t unzigzag8(uint8_t value) {
+  return static_cast<uint8_t>((value >> 1) ^ -(value & 1));
+}
+
+static inline uint32_t zigzag32(uint32_t delta) {
+  return (delta << 1) ^
+         static_cast<uint32_t>(static_cast<int32_t>(delta) >> 31);
+}
+
+static inline uint32_t unzigzag32(uint32_t value) {
+  return (value >> 1) ^ (0u - (value & 1));
+}
+
+static void encodeGroup(const uint8_t *values, int mode,
+                        std::vector<uint8_t> &out) {
+  if (mode == 1) {
+    for (size_t j = 0; j < 4; j++) {
+      out.push_back(static_cast<uint8_t>(
+          values[4 * j] | values[4 * j + 1] << 2 | values[4 * j + 2] << 4 |
+          values[4 * j + 3] << 6));
+    }
+  } else if (mode == 2) {
+    for (size_t j = 0; j < 8; j++) {
+      out.push_back(
+          static_cast<uint8_t>(values[2 * j] | values[2 * j + 1] << 4));
+    }
+  } else if (mode == 3) {
+    out.insert(out.end(), values, values + GROUP_SIZE);
+  }
+}
+
+static int chooseGroupMode(const uint8_t *values) {
+  const uint8_t largest = *std::max_element(values, values + GROUP_SIZE);
+  if (largest == 0) {
+    return 0;
+  }
+  if (largest < 4) {
+    return 1;
+  }
+  return largest < 16 ? 2 : 3;
+}
+
+std::vector<uint8_t> encodeVertexBuffer(const void *vertices, size_t count,
+                                        size_t stride) {
+  std::vector<uint8_t> out;
+  if (!isValidStride(stride)) {
+    return out;
+  }
+  const uint8_t *bytes = static_cast<const uint8_t *>(vertices);
+  out.reserve(count * stride / 2);
+
+  uint8_t prev[MAX_STRIDE] = {};
+  uint8_t deltas[BLOCK_VERTS];
+  for (size_t first = 0; first < count; first += BLOCK_VERTS) {
+    const size_t blockCount = std::min(BLOCK_VERTS, count - first);
+    const size_t padded = roundUpToGroup(blockCount);
+    const size_t groupCount = padded / GROUP_SIZE;
+    const uint8_t *block = bytes + first * stride;
+
+    for (size_t k = 0; k < stride; k++) {
+      uint8_t last = prev[k];
+      for (size_t i = 0; i < blockCount; i++) {
+        const uint8_t value = block[i * stride + k];
+        deltas[i] = zigzag8(static_cast<uint8_t>(value - last));
+        last = value;
+      }
+      std::fill(deltas + blockCount, deltas + padded, 0);
+
+      const size_t header = out.size();
+      out.resize(out.size() + (groupCount + 3) / 4, 0);
+      for (size_t group = 0; group < groupCount; group++) {
+        const uint8_t *values = deltas + group * GROUP_SIZE;
+        const int mode = chooseGroupMode(values);
+        out[header + group / 4] |=
+            static_cast<uint8_t>(mode << (group % 4 * 2));
+        encodeGroup(values, mode, out);
+      }
+      prev[k] = last;
+    }
+  }
+  return out;
+}
+
+static inline void decodeGroup(const uint8_t *in, int mode, uint8_t *out) {
+#ifdef OFYAGL_CODEC_SSE
+  __m128i values;
+  if (mode == 0) {
+    values = _mm_setzero_si128();
+  } else if (mode == 1) {
+    int bits;
+    std::memcpy(&bits, in, sizeof(bits));
+    const __m128i packed = _mm_cvtsi32_si128(bits);
+    const __m128i mask = _mm_set1_epi8(3);
+    const __m128i x0 = _mm_and_si128(packed, mask);
+    const __m128i x1 = _mm_and_si128(_mm_srli_epi16(packed, 2), mask);
+    const __m128i x2 = _mm_and_si128(_mm_srli_epi16(packed, 4), mask);
+    const __m128i x3 = _mm_and_si128(_mm_srli_epi16(packed, 6), mask);
+    values = _mm_unpacklo_epi16(_mm_unpacklo_epi8(x0, x1),
+                                _mm_unpacklo_epi8(x2, x3));
+  } else if (mode == 2) {
+    const __m128i packed =
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in));
+    const __m128i mask = _mm_set1_epi8(15);
+    values = _mm_unpacklo_epi8(_mm_and_si128(packed, mask),
+                               _mm_and_si128(_mm_srli_epi16(packed, 4), mask));
+  } else {
+    values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(out), values);
+#else
+  if (mode == 0) {
+    std::memset(out, 0, GROUP_SIZE);
+  } else if (mode == 1) {
+    for (size_t i = 0; i < GROUP_SIZE; i++) {
+      out[i] = (in[i / 4] >> (i % 4 * 2)) & 3;
+    }
+  } else if (mode == 2) {
+    for (size_t i = 0; i < GROUP_SIZE; i++) {
+      out[i] = (in[i / 2] >> (i % 2 * 4)) & 15;
+    }
+  } else {
+    std::memcpy(out, in, GROUP_SIZE);
+  }
+#endif
+}
+
+static bool decodePlane(const uint8_t *&p, const uint8_t *end,
+                        size_t groupCount, uint8_t *plane) {
+  const size_t headerBytes = (groupCount + 3) / 4;
+  if (static_cast<size_t>(end - p) < headerBytes) {
+    return false;
+  }
+  const uint8_t *header = p;
+  p += headerBytes;
+  for (size_t group = 0; group < groupCount; group++) {
+    const int mode = (header[group / 4] >> (group % 4 * 2)) & 3;
+    if (static_cast<size_t>(end - p) < GROUP_BYTES[mode]) {
+      return false;
+    }
+    decodeGroup(p, mode, plane + group * GROUP_SIZE);
+    p += GROUP_BYTES[mode];
+  }
+  return true;
+}
+
+/**
+ * Turns the zigzag deltas of a plane back into values, a running sum that
+ * starts at `last`. Padding deltas are 0, so the final value is also the one
+ * of the last real vertex.
+ */
+static void undoDeltas(uint8_t *plane, size_t padded, uint8_t &last) {
+#ifdef OFYAGL_CODEC_SSE
+  const __m128i one = _mm_set1_epi8(1);
+  const __m128i lowBits = _mm_set1_epi8(0x7f);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i running = _mm_set1_epi8(static_cast<char>(last));
+  for (size_t i = 0; i < padded; i += GROUP_SIZE) {
+    __m128i *at = reinterpret_cast<__m128i *>(plane + i);
+    const __m128i zigzag = _mm_loadu_si128(at);
+    __m128i values =
+        _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(zigzag, 1), lowBits),
+                      _mm_sub_epi8(zero, _mm_and_si128(zigzag, one)));
+    values = _mm_add_epi8(values, _mm_slli_si128(values, 1));
+    values = _mm_add_epi8(values, _mm_slli_si128(values, 2));
+    values = _mm_add_epi8(values, _mm_slli_si128(values, 4));
+    values = _mm_add_epi8(values, _mm_slli_si128(values, 8));
+    values = _mm_add_epi8(values, running);
+    _mm_storeu_si128(at, values);
+
+    // Broadcast byte 15 for the next group
+    running = _mm_unpackhi_epi8(values, values);
+    running = _mm_shufflehi_epi16(running, 0xff);
+    running = _mm_shuffle_epi32(running, 0xff);
+  }
+#else
+  uint8_t value = last;
+  for (size_t i = 0; i < padded; i++) {
+    value = static_cast<uint8_t>(value + unzigzag8(plane[i]));
+    plane[i] = value;
+  }
+#endif
+  last = plane[padded - 1];
+}
+
+/**
+ * Interleaves `stride` planes back into `count` vertices.
+ */
+static void transposePlanes(const uint8_t *planes, size_t stride,
+                            size_t count, uint8_t *out) {
+#ifdef OFYAGL_CODEC_SSE
+  alignas(16) uint8_t lanes[4 * GROUP_SIZE];
+  for (size_t i = 0; i < count; i += GROUP_SIZE) {
+    const size_t vertCount = std::min(GROUP_SIZE, count - i);
+    for (size_t k = 0; k < stride; k += 4) {
+      const uint8_t *plane = planes + k * BLOCK_VERTS + i;
+      const __m128i a = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(plane));
+      const __m128i b = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(plane + BLOCK_VERTS));
+      const __m128i c = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(plane + 2 * BLOCK_VERTS));
+      const __m128i d = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(plane + 3 * BLOCK_VERTS));
+      const __m128i abLow = _mm_unpacklo_epi8(a, b);
+      const __m128i abHigh = _mm_unpackhi_epi8(a, b);
+      const __m128i cdLow = _mm_unpacklo_epi8(c, d);
+      const __m128i cdHigh = _mm_unpackhi_epi8(c, d);
+      __m128i *lane = reinterpret_cast<__m128i *>(lanes);
+      _mm_store_si128(lane, _mm_unpacklo_epi16(abLow, cdLow));
+      _mm_store_si128(lane + 1, _mm_unpackhi_epi16(abLow, cdLow));
+      _mm_store_si128(lane + 2, _mm_unpacklo_epi16(abHigh, cdHigh));
+      _mm_store_si128(lane + 3, _mm_unpackhi_epi16(abHigh, cdHigh));
+
+      uint8_t *vertex = out + i * stride + k;
+      for (size_t v = 0; v < vertCount; v++) {
+        std::memcpy(vertex + v * stride, lanes + 4 * v, 4);
+      }
+    }
+  }
+#else
+  for (size_t i = 0; i < count; i++) {
+    for (size_t k = 0; k < stride; k++) {
+      out[i * stride + k] = planes[k * BLOCK_VERTS + i];
+    }
+  }
+#endif
+}
+
+bool decodeVertexBuffer(void *vertices, size_t count, size_t stride,
+                        const uint8_t *data, size_t size) {
+  if (!isValidStride(stride)) {
+    return false;
+  }
+  uint8_t *out = static_cast<uint8_t *>(vertices);
+  const uint8_t *p = data;
+  const uint8_t *const end = data + size;
+
+  std::vector<uint8_t> planes(stride * BLOCK_VERTS);
+  uint8_t prev[MAX_STRIDE] = {};
+  for (size_t first = 0; first < count; first += BLOCK_VERTS) {
+    const size_t blockCount = std::min(BLOCK_VERTS, count - first);
+    const size_t padded = roundUpToGroup(blockCount);
+    for (size_t k = 0; k < stride; k++) {
+      uint8_t *plane = planes.data() + k * BLOCK_VERTS;
+      if (!decodePlane(p, end, padded / GROUP_SIZE, plane)) {
+        return false;
+      }
+      undoDeltas(plane, padded, prev[k]);
+    }
+    transposePlanes(planes.data(), stride, blockCount, out + first * stride);
+  }
+  return p == end;
+}
+
+std::vector<uint8_t> encodeIndexBuffer(const uint32_t *indices, size_t count) {
+  std::vector<uint8_t> out;
+  out.reserve(count + count / 4);
+  uint32_t prev = 0;
+  for (size_t i = 0; i < count; i++) {
+    uint32_t value = zigzag32(indices[i] - prev);
+    prev = indices[i];
+    while (value >= 0x80) {
+      out.push_back(static_cast<uint8_t>(value | 0x80));
+      value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+  }
+  return out;
+}
+
+bool decodeIndexBuffer(uint32_t *indices, size_t count, const uint8_t *data,
+                       size_t size) {
+  const uint8_t *p = data;
+  const uint8_t *const end = data + size;
+  uint32_t prev = 0;
+  size_t i = 0;
+
+  while (i < count) {
+#ifdef OFYAGL_CODEC_SSE
+    // 16 single byte varints in a row, the common case
+    if (count - i >= 16 && end - p >= 16) {
+      const __m128i bytes =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      if (_mm_movemask_epi8(bytes) == 0) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi32(1);
+        const __m128i low = _mm_unpacklo_epi8(bytes, zero);
+        const __m128i high = _mm_unpackhi_epi8(bytes, zero);
+        const __m128i quads[4] = {
+            _mm_unpacklo_epi16(low, zero), _mm_unpackhi_epi16(low, zero),
+            _mm_unpacklo_epi16(high, zero), _mm_unpackhi_epi16(high, zero)};
+        __m128i running = _mm_set1_epi32(static_cast<int>(prev));
+        for (int q = 0; q < 4; q++) {
+          __m128i deltas = _mm_xor_si128(
+              _mm_srli_epi32(quads[q], 1),
+              _mm_sub_epi32(zero, _mm_and_si128(quads[q], one)));
+          deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 4));
+          deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 8));
+          deltas = _mm_add_epi32(deltas, running);
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(indices + i + 4 * q),
+                           deltas);
+          running = _mm_shuffle_epi32(deltas, 0xff);
+        }
+        prev = static_cast<uint32_t>(_mm_cvtsi128_si32(running));
+        p += 16;
+        i += 16;
+        continue;
+      }
+    }
+#endif
+    uint32_t value = 0;
+    for (int shift = 0;; shift += 7) {
+      if (p == end) {
+        return false;
+      }
+      const uint8_t byte = *p++;
+      // The fifth byte holds the top 4 bits and ends the value
+      if (shift == 28 && (byte & 0xf0) != 0) {
+        return false;
+      }
+      value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        break;
+      }
+    }
+    prev += unzigzag32(value);
+    indices[i++] = prev;
+  }
+  return p == end;
+}
+
+static void writeBytes(std::vector<uint8_t> &out, const void *data,
+                       size_t size) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  out.insert(out.end(), bytes, bytes + size);
+}
+
+template <typename T>
+static void writeValue(std::vector<uint8_t> &out, T value) {
+  writeBytes(out, &value, sizeof(value));
+}
+
+static void writeString(std::vector<uint8_t> &out, const std::string &value) {
+  writeValue(out, static_cast<uint32_t>(value.size()));
+  writeBytes(out, value.data(), value.size());
+}
+
+static void writeVec3(std::vector<uint8_t> &out, const glm::vec3 &value) {
+  writeValue(out, value.x);
+  writeValue(out, value.y);
+  writeValue(out, value.z);
+}
+
+/**
+ * Bounds checked reads, `ok` turns false on the first one past the end and
+ * every later read returns zeros.
+ */
+struct ByteReader {
+  const uint8_t *p;
+  const uint8_t *end;
+  bool ok = true;
+
+  bool read(void *out, size_t size) {
+    if (!ok || static_cast<size_t>(end - p) < size) {
+      ok = false;
+      std::memset(out, 0, size);
+      return false;
+    }
+    std::memcpy(out, p, size);
+    p += size;
+    return true;
+  }
+
+  template <typename T> T value() {
+    T out;
+    read(&out, sizeof(out));
+    return out;
+  }
+
+  std::string string() {
+    const uint32_t size = value<uint32_t>();
+    if (!ok || static_cast<size_t>(end - p) < size) {
+      ok = false;
+      return {};
+    }
+    std::string out(reinterpret_cast<const char *>(p), size);
+    p += size;
+    return out;
+  }
+
+  glm::vec3 vec3() {
+    const float x = value<float>();
+    const float y = value<float>();
+    const float z = value<float>();
+    return glm::vec3(x, y, z);
+  }
+};
+
+std::vector<uint8_t> encodeMesh(const ObjData &objData) {
+  const std::vector<uint8_t> vertexData = encodeVertexBuffer(
+      objData.verts.data(), objData.verts.size(), sizeof(Vertex));
+  const std::vector<uint8_t> indexData =
+      encodeIndexBuffer(objData.indicies.data(), objData.indicies.size());
+
+  MeshHeader header{};
+  std::memcpy(header.magic, MESH_MAGIC, sizeof(MESH_MAGIC));
+  header.version = MESH_FILE_VERSION;
+  header.vertexCount = static_cast<uint32_t>(objData.verts.size());
+  header.indexCount = static_cast<uint32_t>(objData.indicies.size());
+  header.vertexStride = sizeof(Vertex);
+  header.materialCount = static_cast<uint32_t>(objData.materials.size());
+  header.subMeshCount = static_cast<uint32_t>(objData.subMeshes.size());
+  header.flags =
+      objData.hasAmbientOcclusion ? MESH_FLAG_AMBIENT_OCCLUSION : 0;
+  header.vertexBytes = vertexData.size();
+  header.indexBytes = indexData.size();
+
+  std::vector<uint8_t> out;
+  out.reserve(sizeof(header) + vertexData.size() + indexData.size());
+  writeValue(out, header);
+  writeBytes(out, vertexData.data(), vertexData.size());
+  writeBytes(out, indexData.data(), indexData.size());
+
+  for (const Material &material : objData.materials) {
+    writeString(out, material.name);
+    writeVec3(out, material.ambient);
+    writeVec3(out, material.diffuse);
+    writeVec3(out, material.specular);
+    writeValue(out, material.shininess);
+    writeValue(out, material.opacity);
+    writeString(out, material.diffuseMap);
+    writeString(out, material.normalMap);
+  }
+  for (const SubMesh &subMesh : objData.subMeshes) {
+    writeString(out, subMesh.name);
+    writeValue(out, subMesh.materialIndex);
+    writeValue(out, subMesh.indexOffset);
+    writeValue(out, subMesh.indexCount);
+  }
+  return out;
+}
+
+std::optional<ObjData> decodeMesh(const uint8_t *data, size_t size) {
+  ByteReader reader{data, data + size};
+  const MeshHeader header = reader.value<MeshHeader>();
+  if (!reader.ok ||
+      std::memcmp(header.magic, MESH_MAGIC, sizeof(MESH_MAGIC)) != 0 ||
+      header.version != MESH_FILE_VERSION ||
+      header.vertexStride != sizeof(Vertex)) {
+    return {};
+  }
+  const size_t remaining = static_cast<size_t>(reader.end - reader.p);
+  if (header.vertexBytes > remaining ||
+      header.indexBytes > remaining - header.vertexBytes) {
+    return {};
+  }
+  // Every block stores at least one header byte per plane and every index
+  // at least one byte, which bounds the counts a corrupt header can claim
+  const uint64_t maxVerts =
+      header.vertexBytes / header.vertexStride * BLOCK_VERTS;
+  if (header.vertexCount > maxVerts || header.indexCount > header.indexBytes) {
+    return {};
+  }
+
+  ObjData objData;
+  objData.hasAmbientOcclusion =
+      (header.flags & MESH_FLAG_AMBIENT_OCCLUSION) != 0;
+  objData.verts.resize(header.vertexCount);
+  objData.indicies.resize(header.indexCount);
+  if (!decodeVertexBuffer(objData.verts.data(), header.vertexCount,
+                          sizeof(Vertex), reader.p, header.vertexBytes)) {
+    return {};
+  }
+  reader.p += header.vertexBytes;
+  if (!decodeIndexBuffer(objData.indicies.data(), header.indexCount,
+                         reader.p, header.indexBytes)) {
+    return {};
+  }
+  reader.p += header.indexBytes;
+  for (unsigned int index : objData.indicies) {
+    if (index >= header.vertexCount) {
+      return {};
+    }
+  }
+
+  for (uint32_t i = 0; i < header.materialCount && reader.ok; i++) {
+    Material material;
+    material.name = reader.string();
+    material.ambient = reader.vec3();
+    material.diffuse = reader.vec3();
+    material.specular = reader.vec3();
+    material.shininess = reader.value<float>();
+    material.opacity = reader.value<float>();
+    material.diffuseMap = reader.string();
+    material.normalMap = reader.string();
+    objData.materials.push_back(std::move(material));
+  }
+  for (uint32_t i = 0; i < header.subMeshCount && reader.ok; i++) {
+    SubMesh subMesh;
+    subMesh.name = reader.string();
+    subMesh.materialIndex = reader.value<uint32_t>();
+    subMesh.indexOffset = reader.value<uint32_t>();
+    subMesh.indexCount = reader.value<uint32_t>();
+    const bool inRange =
+        static_cast<uint64_t>(subMesh.indexOffset) + subMesh.indexCount <=
+        header.indexCount;
+    if (!inRange || (subMesh.materialIndex != NO_MATERIAL &&
+                     subMesh.materialIndex >= header.materialCount)) {
+      return {};
+    }
+    objData.subMeshes.push_back(std::move(subMesh));
+  }
+  if (!reader.ok) {
+    return {};
+  }
+  return objData;
+}
+} // namespace ofyaGl
@@ -0,0 +1,203 @@
+#include <ofyaGl/mesh_optimize.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace ofyaGl {
+
+constexpr uint32_t UNUSED_VERTEX = ~0u;
+
+/**
+ * Buffers reused across the sub meshes of one mesh.
+ */
+struct TipsifyScratch {
+  std::vector<uint32_t> liveCount;
+  std::vector<uint32_t> adjacencyOffsets;
+  std::vector<uint32_t> adjacency;
+  std::vector<size_t> cacheTime;
+  std::vector<bool> emitted;
+  std::vector<uint32_t> deadEnds;
+  std::vector<uint32_t> candidates;
+  /**
+   * Mesh vertex to sub mesh vertex, `UNUSED_VERTEX` between sub meshes.
+   */
+  std::vector<uint32_t> localVertex;
+  std::vector<uint32_t> meshVertex;
+  std::vector<unsigned int> localIndices;
+};
+
+/**
+ * Reorders the `indexCount / 3` triangles of `indices` into `out`.
+ */
+static void tipsify(const unsigned int *indices, size_t indexCount,
+                    size_t vertexCount, size_t cacheSize,
+                    TipsifyScratch &scratch, unsigned int *out) {
+  const size_t triangleCount = indexCount / 3;
+  if (triangleCount == 0) {
+    return;
+  }
+
+  // Triangles around every vertex, counting sort by vertex
+  std::vector<uint32_t> &liveCount = scratch.liveCount;
+  std::vector<uint32_t> &offsets = scratch.adjacencyOffsets;
+  liveCount.assign(vertexCount, 0);
+  for (size_t i = 0; i < triangleCount * 3; i++) {
+    liveCount[indices[i]]++;
+  }
+  offsets.resize(vertexCount + 1);
+  offsets[0] = 0;
+  for (size_t v = 0; v < vertexCount; v++) {
+    offsets[v + 1] = offsets[v] + liveCount[v];
+  }
+  scratch.adjacency.resize(triangleCount * 3);
+  // The candidate list doubles as fill cursors until fanning starts
+  std::vector<uint32_t> &cursors = scratch.candidates;
+  cursors.assign(offsets.begin(), offsets.end() - 1);
+  for (size_t i = 0; i < triangleCount * 3; i++) {
+    scratch.adjacency[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+  }
+
+  // Timestamps start far enough back that nothing counts as cached
+  std::vector<size_t> &cacheTime = scratch.cacheTime;
+  cacheTime.assign(vertexCount, 0);
+  size_t time = cacheSize + 1;
+  scratch.emitted.assign(triangleCount, false);
+  scratch.deadEnds.clear();
+  std::vector<uint32_t> &candidates = scratch.candidates;
+
+  size_t scan = 0;
+  size_t written = 0;
+  int64_t fanning = indices[0];
+  while (fanning >= 0) {
+    candidates.clear();
+    const uint32_t center = static_cast<uint32_t>(fanning);
+    for (uint32_t i = offsets[center]; i < offsets[center + 1]; i++) {
+      const uint32_t triangle = scratch.adjacency[i];
+      if (scratch.emitted[triangle]) {
+        continue;
+      }
+      for (size_t corner = 0; corner < 3; corner++) {
+        const uint32_t v = indices[triangle * 3 + corner];
+        out[written++] = v;
+        scratch.deadEnds.push_back(v);
+        candidates.push_back(v);
+        liveCount[v]--;
+        if (time - cacheTime[v] > cacheSize) {
+          cacheTime[v] = time++;
+        }
+      }
+      scratch.emitted[triangle] = true;
+    }
+
+    // Prefer the candidate longest in the cache that will still be there
+    // once its remaining triangles are emitted
+    fanning = -1;
+    int64_t bestPriority = -1;
+    for (uint32_t v : candidates) {
+      if (liveCount[v] == 0) {
+        continue;
+      }
+      int64_t priority = 0;
+      if (time - cacheTime[v] + 2 * liveCount[v] <= cacheSize) {
+        priority = static_cast<int64_t>(time - cacheTime[v]);
+      }
+      if (priority > bestPriority) {
+        bestPriority = priority;
+        fanning = v;
+      }
+    }
+    // Dead end, back up through recently used vertices, then scan
+    while (fanning < 0 && !scratch.deadEnds.empty()) {
+      const uint32_t v = scratch.deadEnds.back();
+      scratch.deadEnds.pop_back();
+      if (liveCount[v] > 0) {
+        fanning = v;
+      }
+    }
+    for (; fanning < 0 && scan < vertexCount; scan++) {
+      if (liveCount[scan] > 0) {
+        fanning = static_cast<int64_t>(scan);
+      }
+    }
+  }
+}
+
+/**
+ * Runs `tipsify` on one sub mesh numbered from 0, so its per vertex work
+ * scales with the vertices it uses instead of the whole mesh's.
+ */
+static void tipsifySubMesh(const unsigned int *indices, size_t indexCount,
+                           size_t cacheSize, TipsifyScratch &scratch,
+                           unsigned int *out) {
+  std::vector<uint32_t> &localVertex = scratch.localVertex;
+  std::vector<uint32_t> &meshVertex = scratch.meshVertex;
+  meshVertex.clear();
+  scratch.localIndices.resize(indexCount);
+  for (size_t i = 0; i < indexCount; i++) {
+    const unsigned int v = indices[i];
+    if (localVertex[v] == UNUSED_VERTEX) {
+      localVertex[v] = static_cast<uint32_t>(meshVertex.size());
+      meshVertex.push_back(v);
+    }
+    scratch.localIndices[i] = localVertex[v];
+  }
+
+  tipsify(scratch.localIndices.data(), indexCount, meshVertex.size(),
+          cacheSize, scratch, out);
+  for (size_t i = 0; i < indexCount / 3 * 3; i++) {
+    out[i] = meshVertex[out[i]];
+  }
+  for (uint32_t v : meshVertex) {
+    localVertex[v] = UNUSED_VERTEX;
+  }
+}
+
+void optimizeVertexCache(ObjData &objData, size_t cacheSize) {
+  std::vector<unsigned int> &indicies = objData.indicies;
+  std::vector<unsigned int> reordered(indicies.size());
+  TipsifyScratch scratch;
+  scratch.localVertex.assign(objData.verts.size(), UNUSED_VERTEX);
+
+  if (objData.subMeshes.empty()) {
+    tipsifySubMesh(indicies.data(), indicies.size(), cacheSize, scratch,
+                   reordered.data());
+  }
+  for (const SubMesh &subMesh : objData.subMeshes) {
+    tipsifySubMesh(indicies.data() + subMesh.indexOffset, subMesh.indexCount,
+                   cacheSize, scratch, reordered.data() + subMesh.indexOffset);
+  }
+  indicies = std::move(reordered);
+}
+
+void optimizeVertexFetch(ObjData &objData) {
+  std::vector<unsigned int> remap(objData.verts.size(), UNUSED_VERTEX);
+  std::vector<Vertex> verts;
+  verts.reserve(objData.verts.size());
+  for (unsigned int &index : objData.indicies) {
+    if (remap[index] == UNUSED_VERTEX) {
+      remap[index] = static_cast<unsigned int>(verts.size());
+      verts.push_back(objData.verts[index]);
+    }
+    index = remap[index];
+  }
+  objData.verts = std::move(verts);
+}
+
+double getAverageCacheMissRatio(const ObjData &objData, size_t cacheSize) {
+  const size_t triangleCount = objData.indicies.size() / 3;
+  if (triangleCount == 0) {
+    return 0.0;
+  }
+  std::vector<size_t> cacheTime(objData.verts.size(), 0);
+  size_t time = cacheSize + 1;
+  size_t misses = 0;
+  for (unsigned int index : objData.indicies) {
+    // FIFO, only misses advance the clock
+    if (time - cacheTime[index] > cacheSize) {
+      cacheTime[index] = time++;
+      misses++;
+    }
+  }
+  return static_cast<double>(misses) / triangleCount;
+}
+} // namespace ofyaGl
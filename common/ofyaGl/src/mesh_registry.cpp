@@ -0,0 +1,84 @@
+#include <ofyaGl/mesh_registry.h>
+
+#include <ofyaGl/hash.h>
+
+namespace ofyaGl {
+
+size_t MeshRegistry::getByteSize(const Mesh &mesh) {
+  return sizeof(Vertex) * static_cast<size_t>(mesh.getVertCount()) +
+         sizeof(unsigned int) * static_cast<size_t>(mesh.getIndexCount());
+}
+
+uint64_t MeshRegistry::hashGeometry(const std::vector<Vertex> &verts,
+                                    const std::vector<unsigned int> &indicies) {
+  const uint64_t hash = hashBytes(verts.data(), sizeof(Vertex) * verts.size());
+  // Seeded with the vertex count, so moving data between the two buffers
+  // changes the key
+  return hashCombine(hash, hashBytes(indicies.data(),
+                                     sizeof(unsigned int) * indicies.size(),
+                                     verts.size()));
+}
+
+SharedMeshHandle MeshRegistry::find(uint64_t hash) {
+  stats.lookups++;
+  const auto found = meshes.find(hash);
+  if (found == meshes.end()) {
+    return nullptr;
+  }
+  stats.hits++;
+  stats.bytesSaved += getByteSize(found->second->mesh);
+  return found->second;
+}
+
+SharedMeshHandle MeshRegistry::insert(uint64_t hash, Mesh &&mesh) {
+  const auto found = meshes.find(hash);
+  if (found != meshes.end()) {
+    stats.bytesSaved += getByteSize(mesh);
+    mesh.destroy();
+    return found->second;
+  }
+
+  stats.meshCount++;
+  stats.bytes += getByteSize(mesh);
+  auto shared = std::make_shared<SharedMesh>(hash, std::move(mesh));
+  meshes.emplace(hash, shared);
+  return shared;
+}
+
+SharedMeshHandle MeshRegistry::acquire(const ObjData &objData,
+                                       const std::string &label) {
+  const uint64_t hash = hashGeometry(objData.verts, objData.indicies);
+  if (SharedMeshHandle found = find(hash)) {
+    return found;
+  }
+  Mesh mesh = Mesh::fromObjData(objData);
+  mesh.setLabel(label);
+  return insert(hash, std::move(mesh));
+}
+
+size_t MeshRegistry::collect() {
+  size_t count = 0;
+  for (auto it = meshes.begin(); it != meshes.end();) {
+    // Only the registry holds it
+    if (it->second.use_count() == 1) {
+      stats.meshCount--;
+      stats.bytes -= getByteSize(it->second->mesh);
+      it->second->mesh.destroy();
+      it = meshes.erase(it);
+      count++;
+    } else {
+      ++it;
+    }
+  }
+  return count;
+}
+
+void MeshRegistry::destroy() {
+  for (auto &[hash, shared] : meshes) {
+    shared->mesh.destroy();
+  }
+  meshes.clear();
+  stats.meshCount = 0;
+  stats.bytes = 0;
+}
+} // namespace ofyaGl
@@ -1,12 +1,17 @@
 #include <ofyaGl/obj.h>
 
+#include <ofyaGl/decompress.h>
+#include <ofyaGl/mesh_codec.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <filesystem>
-#include <fstream>
 #include <iostream>
 #include <optional>
-#include <sstream>
 #include <string>
 #include <unordered_map>
 
@@ -23,269 +28,1042 @@ struct FaceVertexData {
   }
 };
 
-struct FaceData {
-  FaceVertexData v1;
-  FaceVertexData v2;
-  FaceVertexData v3;
+/**
+ * Sub mesh while parsing, materials are resolved by name once every
+ * `mtllib` has been read.
+ */
+struct SubMeshStart {
+  std::string name;
+  std::string material;
+  size_t firstCorner;
+};
 
-  friend std::ostream &operator<<(std::ostream &os, const FaceData &fd) {
-    os << "FaceData(" << fd.v1 << " " << fd.v2 << " " << fd.v3 << ")";
-    return os;
+/**
+ * Record counts from a quick scan over the whole file, used to size the
+ * staging arrays exactly.
+ */
+struct RecordCounts {
+  size_t vertPoses = 0;
+  size_t texCoords = 0;
+  size_t vertNormals = 0;
+  size_t faceCorners = 0;
+};
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Charges consecutive phases of one load to its `LoadStats`. Without stats
+ * every call returns right away, so an unmeasured load pays a branch per
+ * phase and never reads the clock.
+ */
+class PhaseTimer {
+private:
+  LoadStats *stats;
+  const Arena &arena;
+  Clock::time_point start;
+  Arena::Stats arenaStart{};
+  /**
+   * Charged to nested phases since the last `finish`, so it isn't counted
+   * twice.
+   */
+  LoadPhaseStats nested{};
+
+  void restart() {
+    start = Clock::now();
+    arenaStart = arena.getStats();
+    nested = {};
+  }
+
+public:
+  PhaseTimer(LoadStats *stats, const Arena &arena)
+      : stats(stats), arena(arena) {
+    if (stats != nullptr) {
+      restart();
+    }
+  }
+
+  /**
+   * Charges everything since the last call to `phase`.
+   */
+  void finish(LoadPhase phase) {
+    if (stats == nullptr) {
+      return;
+    }
+    const double seconds =
+        std::chrono::duration<double>(Clock::now() - start).count() -
+        nested.seconds;
+    const Arena::Stats &arenaNow = arena.getStats();
+    LoadPhaseStats &entry = (*stats)[phase];
+    entry.seconds += seconds;
+    entry.arenaBytes +=
+        arenaNow.bytesUsed - arenaStart.bytesUsed - nested.arenaBytes;
+    entry.arenaBlocks += arenaNow.upstreamAllocations -
+                         arenaStart.upstreamAllocations - nested.arenaBlocks;
+    stats->totalSeconds += seconds;
+    restart();
+  }
+
+  /**
+   * Runs `work` as `phase`, inside the phase currently measured.
+   */
+  template <typename Fn> void nest(LoadPhase phase, Fn &&work) {
+    if (stats == nullptr) {
+      work();
+      return;
+    }
+    const LoadPhaseStats before = (*stats)[phase];
+    PhaseTimer timer(stats, arena);
+    work();
+    timer.finish(phase);
+    const LoadPhaseStats &after = (*stats)[phase];
+    nested.seconds += after.seconds - before.seconds;
+    nested.arenaBytes += after.arenaBytes - before.arenaBytes;
+    nested.arenaBlocks += after.arenaBlocks - before.arenaBlocks;
   }
 };
 
-std::optional<VertPos> parseVertPos(const std::string &input) {
-  VertPos vertPos{};
-  std::stringstream ss(input);
+static inline bool isSpace(char c) { return c == ' ' || c == '\t'; }
 
-  // Skip 'v'
-  std::string prefix;
-  ss >> prefix;
+static inline const char *skipSpaces(const char *p, const char *end) {
+  while (p < end && isSpace(*p)) {
+    p++;
+  }
+  return p;
+}
+
+/**
+ * Parses a float starting at `p` and moves `p` past it. Doesn't look past
+ * `end`, the buffer must be terminated by a non-numeric character.
+ */
+static inline bool parseFloat(const char *&p, const char *end, float &out) {
+  p = skipSpaces(p, end);
+  if (p == end) {
+    return false;
+  }
+  char *numEnd;
+  out = std::strtof(p, &numEnd);
+  if (numEnd == p || numEnd > end) {
+    return false;
+  }
+  p = numEnd;
+  return true;
+}
+
+static inline bool parseInt(const char *&p, const char *end, long &out) {
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  if (p == end || *p < '0' || *p > '9') {
+    return false;
+  }
+  long value = 0;
+  while (p < end && *p >= '0' && *p <= '9') {
+    value = value * 10 + (*p - '0');
+    p++;
+  }
+  out = negative ? -value : value;
+  return true;
+}
 
-  float x, y, z;
+/**
+ * Nothing but whitespace or a comment left on the line.
+ */
+static inline bool isLineDone(const char *p, const char *end) {
+  p = skipSpaces(p, end);
+  return p == end || *p == '#';
+}
 
-  if (!(ss >> x >> y >> z)) {
+std::optional<VertPos> parseVertPos(const char *p, const char *end) {
+  // Skip 'v'
+  p += 1;
+
+  VertPos vertPos{};
+  if (!parseFloat(p, end, vertPos.x) || !parseFloat(p, end, vertPos.y) ||
+      !parseFloat(p, end, vertPos.z)) {
     std::cout << "Expected 3 numbers, but parsed less\n";
     return {};
   }
 
-  std::string leftover;
-  if (ss >> leftover) {
-    if (leftover[0] != '#') {
-      std::cout << "Expected 3 numbers, but parsed more\n";
-      return {};
-    }
+  if (!isLineDone(p, end)) {
+    std::cout << "Expected 3 numbers, but parsed more\n";
+    return {};
   }
 
-  vertPos.x = x;
-  vertPos.y = y;
-  vertPos.z = z;
   return vertPos;
 }
 
-std::optional<TexCoord> parseTexCoord(const std::string &input) {
-  TexCoord texCoord{};
-  std::stringstream ss(input);
-
+std::optional<TexCoord> parseTexCoord(const char *p, const char *end) {
   // Skip 'vt'
-  std::string prefix;
-  ss >> prefix;
+  p += 2;
 
   // TODO handle the case when 3rd value is present
-  float u, v, t = 0;
-  if (!(ss >> u >> v)) {
+  TexCoord texCoord{};
+  if (!parseFloat(p, end, texCoord.u) || !parseFloat(p, end, texCoord.v)) {
     std::cout << "Got less then 2 numbers\n";
     return {};
   }
 
-  texCoord.u = u;
-  texCoord.v = v;
-  texCoord.t = t;
   return texCoord;
 }
 
-std::optional<VertNormal> parseVertNormal(const std::string &input) {
-  VertNormal vert{};
-  std::stringstream ss(input);
-
+std::optional<VertNormal> parseVertNormal(const char *p, const char *end) {
   // Skip 'vn'
-  std::string prefix;
-  ss >> prefix;
-
-  float x, y, z;
+  p += 2;
 
-  if (!(ss >> x >> y >> z)) {
+  VertNormal vert{};
+  if (!parseFloat(p, end, vert.x) || !parseFloat(p, end, vert.y) ||
+      !parseFloat(p, end, vert.z)) {
     std::cout << "Expected 3 numbers, but parsed less\n";
     return {};
   }
 
-  std::string leftover;
-  if (ss >> leftover) {
-    if (leftover[0] != '#') {
-      std::cout << "Expected 3 numbers, but parsed more\n";
-      return {};
-    }
+  if (!isLineDone(p, end)) {
+    std::cout << "Expected 3 numbers, but parsed more\n";
+    return {};
   }
 
-  vert.x = x;
-  vert.y = y;
-  vert.z = z;
   return vert;
 }
 
-int extractNumbers(const std::string &input, float &x, float &y, float &z) {
-  std::istringstream iss(input);
+/**
+ * OBJ indices are 1 based, negative ones count back from the latest element.
+ * Returns 0 for a missing or out of range index.
+ */
+static inline unsigned int resolveIndex(long index, size_t count) {
+  if (index < 0) {
+    index += static_cast<long>(count) + 1;
+  }
+  if (index <= 0 || static_cast<size_t>(index) > count) {
+    return 0;
+  }
+  return static_cast<unsigned int>(index);
+}
 
-  std::string prefix;
-  iss >> prefix;
+/**
+ * Parses one `v`, `v/vt`, `v//vn` or `v/vt/vn` token.
+ */
+static bool parseFaceVertex(const char *&p, const char *end,
+                            const RecordCounts &counts, FaceVertexData &data) {
+  data = {};
+  long value;
+  if (!parseInt(p, end, value) ||
+      (data.v = resolveIndex(value, counts.vertPoses)) == 0) {
+    return false;
+  }
 
-  if (!(iss >> x >> y >> z)) {
-    std::cout << "Expected 3 numbers, but parsed less\n";
-    return 1;
+  if (p < end && *p == '/') {
+    p++;
+    if (p < end && *p != '/') {
+      if (!parseInt(p, end, value) ||
+          (data.vt = resolveIndex(value, counts.texCoords)) == 0) {
+        return false;
+      }
+    }
   }
 
-  std::string leftover;
-  if (iss >> leftover) {
-    if (leftover[0] == '#') {
-      return 0;
+  if (p < end && *p == '/') {
+    p++;
+    if (!parseInt(p, end, value) ||
+        (data.vn = resolveIndex(value, counts.vertNormals)) == 0) {
+      return false;
     }
-    std::cout << "Expected 3 numbers, but parsed more\n";
-    return 1;
   }
 
-  return 0;
+  return p == end || isSpace(*p) || *p == '#';
 }
 
-FaceVertexData parseFaceVertex(const std::string &vertex) {
-  FaceVertexData data{};
-
-  std::stringstream ss(vertex);
-  std::string token;
-  int idx = 0;
+/**
+ * Triangulates the face as a fan and appends its corners to `corners`.
+ * `scratch` only holds the polygon while it's being parsed.
+ */
+static bool parseFace(const char *p, const char *end,
+                      const RecordCounts &counts,
+                      ArenaVector<FaceVertexData> &scratch,
+                      ArenaVector<FaceVertexData> &corners) {
+  // Skip 'f'
+  p += 1;
 
-  while (std::getline(ss, token, '/')) {
-    if (!token.empty()) {
-      unsigned int value = std::stoi(token);
-      if (idx % 3 == 0) {
-        data.v = value;
-      } else if (idx % 3 == 1) {
-        data.vt = value;
-      } else if (idx % 3 == 2) {
-        data.vn = value;
-      }
+  scratch.clear();
+  while (!isLineDone(p, end)) {
+    p = skipSpaces(p, end);
+    FaceVertexData vertex;
+    if (!parseFaceVertex(p, end, counts, vertex)) {
+      std::cerr << "Invalid face vertex\n";
+      return false;
     }
-    idx++;
+    scratch.push_back(vertex);
+  }
+
+  if (scratch.size() < 3) {
+    std::cerr << "Expected at least 3 verticies for the face\n";
+    return false;
+  }
+
+  for (size_t i = 1; i < scratch.size() - 1; i++) {
+    corners.push_back(scratch[0]);
+    corners.push_back(scratch[i]);
+    corners.push_back(scratch[i + 1]);
   }
 
-  return data;
+  return true;
 }
 
-std::vector<FaceData> parseFace(const std::string &line) {
-  std::vector<FaceData> result = {};
-  std::stringstream ss(line);
-  std::string token;
+/**
+ * Whether the line starts with `keyword` followed by whitespace.
+ */
+static inline bool isKeyword(const char *p, const char *end,
+                             const char *keyword) {
+  const size_t length = std::strlen(keyword);
+  return static_cast<size_t>(end - p) > length &&
+         std::memcmp(p, keyword, length) == 0 && isSpace(p[length]);
+}
 
-  // Skip 'f'
-  ss >> token;
+/**
+ * Rest of the line after the keyword with surrounding whitespace trimmed.
+ */
+static std::string parseName(const char *p, const char *end,
+                             size_t keywordLength) {
+  p = skipSpaces(p + keywordLength, end);
+  while (end > p && isSpace(end[-1])) {
+    end--;
+  }
+  return std::string(p, end);
+}
 
-  std::vector<FaceVertexData> verticies;
-  while (ss >> token) {
-    verticies.push_back(parseFaceVertex(token));
+/**
+ * Last token on the line after the keyword, texture map statements put their
+ * options first.
+ */
+static std::string parseMapPath(const char *p, const char *end,
+                                size_t keywordLength) {
+  p += keywordLength;
+  while (end > p && isSpace(end[-1])) {
+    end--;
   }
+  const char *start = end;
+  while (start > p && !isSpace(start[-1])) {
+    start--;
+  }
+  return std::string(start, end);
+}
 
-  if (verticies.size() < 3) {
-    std::cerr << "Expected at least 3 verticies for the face\n";
-    return {};
+static bool parseColor(const char *p, const char *end, glm::vec3 &color) {
+  // Skip the two letter keyword
+  p += 2;
+  if (!parseFloat(p, end, color.x)) {
+    return false;
   }
+  // A single value is grey
+  if (isLineDone(p, end)) {
+    color.y = color.z = color.x;
+    return true;
+  }
+  return parseFloat(p, end, color.y) && parseFloat(p, end, color.z);
+}
 
-  for (size_t i = 1; i < verticies.size() - 1; i++) {
-    result.push_back({verticies[0], verticies[i], verticies[i + 1]});
+static inline const char *findLineEnd(const char *p, const char *end) {
+  const char *newline =
+      static_cast<const char *>(std::memchr(p, '\n', end - p));
+  return newline == nullptr ? end : newline;
+}
+
+/**
+ * Number of vertex tokens on an `f` line.
+ */
+static size_t countFaceTokens(const char *p, const char *lineEnd) {
+  size_t tokens = 0;
+  const char *q = p + 1;
+  while (!isLineDone(q, lineEnd)) {
+    q = skipSpaces(q, lineEnd);
+    tokens++;
+    while (q < lineEnd && !isSpace(*q)) {
+      q++;
+    }
   }
+  return tokens;
+}
 
-  return result;
+/**
+ * Files one line under its record type.
+ */
+static void countLine(const char *p, const char *lineEnd, LoadStats &stats) {
+  LoadLineCounts &lines = stats.lines;
+  lines.total++;
+  if (isLineDone(p, lineEnd)) {
+    const char *first = skipSpaces(p, lineEnd);
+    (first < lineEnd ? lines.comment : lines.blank)++;
+  } else if (isKeyword(p, lineEnd, "v")) {
+    lines.vertPos++;
+  } else if (isKeyword(p, lineEnd, "vt")) {
+    lines.texCoord++;
+  } else if (isKeyword(p, lineEnd, "vn")) {
+    lines.vertNormal++;
+  } else if (isKeyword(p, lineEnd, "f")) {
+    lines.face++;
+    const size_t tokens = countFaceTokens(p, lineEnd);
+    if (tokens == 3) {
+      stats.triangles++;
+    } else if (tokens == 4) {
+      stats.quads++;
+    } else if (tokens > 4) {
+      stats.polygons++;
+    }
+  } else if (isKeyword(p, lineEnd, "o") || isKeyword(p, lineEnd, "g")) {
+    lines.group++;
+  } else if (isKeyword(p, lineEnd, "usemtl")) {
+    lines.useMaterial++;
+  } else if (isKeyword(p, lineEnd, "mtllib")) {
+    lines.materialLibrary++;
+  } else {
+    lines.other++;
+  }
 }
-std::optional<ObjData> loadObjDataFromFile(const char *fileName) {
-  std::string objDir = std::getenv("ICG_OBJ_DIR");
-  std::string s_fileName = fileName;
-  std::filesystem::path fullFilePath = objDir + "/" + fileName;
 
-  auto extention = fullFilePath.extension();
-  if (fullFilePath.extension() != ".obj") {
-    std::cerr << "There is no support for '" << extention << "' file formats\n";
-    return {};
+/**
+ * `Detailed` also fills the line and face counts of `stats`, the plain scan
+ * doesn't look at it.
+ */
+template <bool Detailed>
+static RecordCounts countRecords(const char *p, const char *end,
+                                 LoadStats *stats) {
+  RecordCounts counts;
+  while (p < end) {
+    const char *lineEnd = findLineEnd(p, end);
+    const char *next = lineEnd + 1;
+    if (lineEnd > p && lineEnd[-1] == '\r') {
+      lineEnd--;
+    }
+    if constexpr (Detailed) {
+      countLine(p, lineEnd, *stats);
+    }
+    if (lineEnd - p >= 2) {
+      if (p[0] == 'v') {
+        if (p[1] == ' ') {
+          counts.vertPoses++;
+        } else if (p[1] == 't') {
+          counts.texCoords++;
+        } else if (p[1] == 'n') {
+          counts.vertNormals++;
+        }
+      } else if (p[0] == 'f') {
+        const size_t tokens = countFaceTokens(p, lineEnd);
+        if (tokens >= 3) {
+          counts.faceCorners += (tokens - 2) * 3;
+        }
+      }
+    }
+    p = next;
   }
+  return counts;
+}
 
-  std::cout << "Loading obj data from file '" << fullFilePath << "'\n";
+/**
+ * Reads the whole file into arena memory, terminated by a '\0' so number
+ * parsing never runs off the end.
+ */
+static const char *readFile(const std::filesystem::path &path, Arena &arena,
+                            size_t &size) {
+  std::error_code error;
+  size = std::filesystem::file_size(path, error);
+  if (error) {
+    return nullptr;
+  }
 
-  std::ifstream file(fullFilePath);
-  if (!file.is_open()) {
-    std::cerr << "Failed to open file '" << fullFilePath << "'\n";
-    return {};
+  std::FILE *file = std::fopen(path.string().c_str(), "rb");
+  if (file == nullptr) {
+    return nullptr;
+  }
+  char *buffer = arena.allocate<char>(size + 1);
+  size_t read = std::fread(buffer, 1, size, file);
+  std::fclose(file);
+  if (read != size) {
+    return nullptr;
   }
+  buffer[size] = '\0';
+  return buffer;
+}
 
-  std::vector<VertPos> vertPoses;
-  std::vector<TexCoord> texCoords;
-  std::vector<VertNormal> vertNormals;
-  std::vector<FaceData> faceDatas;
+/**
+ * Appends every material in the `.mtl` file at `path` to `materials`.
+ */
+static bool loadMaterials(const std::filesystem::path &path, Arena &arena,
+                          std::vector<Material> &materials,
+                          LoadStats *stats) {
+  size_t fileSize;
+  const char *buffer = readFile(path, arena, fileSize);
+  if (buffer == nullptr) {
+    std::cerr << "Failed to open file '" << path.string() << "'\n";
+    return false;
+  }
+  if (stats != nullptr) {
+    stats->bytesRead += fileSize;
+  }
+  const char *const bufferEnd = buffer + fileSize;
 
+  Material *material = nullptr;
   unsigned int lineNumber = 0;
-  std::string line;
-  while (getline(file, line)) {
+  const char *line = buffer;
+  while (line < bufferEnd) {
+    const char *lineEnd = findLineEnd(line, bufferEnd);
+    const char *next = lineEnd + 1;
+    if (lineEnd > line && lineEnd[-1] == '\r') {
+      lineEnd--;
+    }
     lineNumber++;
-    if (line.length() == 0) {
+    line = skipSpaces(line, lineEnd);
+
+    if (isKeyword(line, lineEnd, "newmtl")) {
+      materials.push_back(Material{});
+      material = &materials.back();
+      material->name = parseName(line, lineEnd, 6);
+      line = next;
+      continue;
+    }
+    if (material == nullptr || isLineDone(line, lineEnd)) {
+      line = next;
+      continue;
+    }
+
+    bool ok = true;
+    const char *p = line;
+    if (isKeyword(line, lineEnd, "Ka")) {
+      ok = parseColor(line, lineEnd, material->ambient);
+    } else if (isKeyword(line, lineEnd, "Kd")) {
+      ok = parseColor(line, lineEnd, material->diffuse);
+    } else if (isKeyword(line, lineEnd, "Ks")) {
+      ok = parseColor(line, lineEnd, material->specular);
+    } else if (isKeyword(line, lineEnd, "Ns")) {
+      p += 2;
+      ok = parseFloat(p, lineEnd, material->shininess);
+    } else if (isKeyword(line, lineEnd, "d")) {
+      p += 1;
+      ok = parseFloat(p, lineEnd, material->opacity);
+    } else if (isKeyword(line, lineEnd, "Tr")) {
+      p += 2;
+      float transparency;
+      ok = parseFloat(p, lineEnd, transparency);
+      material->opacity = 1.f - transparency;
+    } else if (isKeyword(line, lineEnd, "map_Kd")) {
+      material->diffuseMap = parseMapPath(line, lineEnd, 6);
+    } else if (isKeyword(line, lineEnd, "map_Bump") ||
+               isKeyword(line, lineEnd, "map_bump")) {
+      material->normalMap = parseMapPath(line, lineEnd, 8);
+    } else if (isKeyword(line, lineEnd, "bump") ||
+               isKeyword(line, lineEnd, "norm")) {
+      material->normalMap = parseMapPath(line, lineEnd, 4);
+    }
+    // Ignore anything else
+
+    if (!ok) {
+      std::cerr << "Invalid material statement in '" << path.string()
+                << "' at line: " << lineNumber << std::endl;
+      return false;
+    }
+    line = next;
+  }
+  return true;
+}
+
+/**
+ * Turns the parse time sub meshes into `objData.subMeshes`, reordering
+ * `objData.indicies` so each material's ranges end up next to each other.
+ */
+static void buildSubMeshes(const std::vector<SubMeshStart> &starts,
+                           size_t cornerCount, ObjData &objData) {
+  std::unordered_map<std::string, uint32_t> materialIndices;
+  for (uint32_t i = 0; i < objData.materials.size(); i++) {
+    materialIndices.emplace(objData.materials[i].name, i);
+  }
+
+  std::vector<SubMesh> subMeshes;
+  for (size_t i = 0; i < starts.size(); i++) {
+    const size_t end =
+        i + 1 < starts.size() ? starts[i + 1].firstCorner : cornerCount;
+    if (end == starts[i].firstCorner) {
       continue;
     }
 
+    uint32_t materialIndex = NO_MATERIAL;
+    if (!starts[i].material.empty()) {
+      auto entry = materialIndices.find(starts[i].material);
+      if (entry == materialIndices.end()) {
+        std::cerr << "Unknown material '" << starts[i].material
+                  << "', using defaults\n";
+        Material material = getDefaultMaterial();
+        material.name = starts[i].material;
+        objData.materials.push_back(material);
+        const auto index = static_cast<uint32_t>(objData.materials.size() - 1);
+        entry = materialIndices.emplace(material.name, index).first;
+      }
+      materialIndex = entry->second;
+    }
+
+    const size_t first = starts[i].firstCorner;
+    subMeshes.push_back(SubMesh{starts[i].name, materialIndex,
+                                static_cast<uint32_t>(first),
+                                static_cast<uint32_t>(end - first)});
+  }
+
+  auto byMaterial = [](const SubMesh &a, const SubMesh &b) {
+    return a.materialIndex < b.materialIndex;
+  };
+  if (!std::is_sorted(subMeshes.begin(), subMeshes.end(), byMaterial)) {
+    std::stable_sort(subMeshes.begin(), subMeshes.end(), byMaterial);
+    std::vector<unsigned int> sorted;
+    sorted.reserve(objData.indicies.size());
+    for (SubMesh &subMesh : subMeshes) {
+      const auto first = objData.indicies.begin() + subMesh.indexOffset;
+      subMesh.indexOffset = static_cast<uint32_t>(sorted.size());
+      sorted.insert(sorted.end(), first, first + subMesh.indexCount);
+    }
+    objData.indicies = std::move(sorted);
+  }
+  objData.subMeshes = std::move(subMeshes);
+}
+
+static inline uint32_t hashVertex(const Vertex &vertex) {
+  // Adding 0 folds -0.0 into 0.0, they compare equal so they must hash equal
+  const float values[9] = {vertex.pos.x + 0.f,      vertex.pos.y + 0.f,
+                           vertex.pos.z + 0.f,      vertex.texCoord.u + 0.f,
+                           vertex.texCoord.v + 0.f, vertex.texCoord.t + 0.f,
+                           vertex.normal.x + 0.f,   vertex.normal.y + 0.f,
+                           vertex.normal.z + 0.f};
+  uint32_t hash = 2166136261u;
+  for (float value : values) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    hash = (hash ^ bits) * 16777619u;
+    hash ^= hash >> 15;
+  }
+  return hash;
+}
+
+/**
+ * State of one `.obj` parse. Lines can be fed in any number of calls, so the
+ * file may arrive in one buffer or block by block.
+ */
+class ObjParser {
+private:
+  const std::filesystem::path &path;
+  Arena &arena;
+  LoadStats *stats;
+  PhaseTimer &timer;
+
+  ArenaVector<VertPos> vertPoses;
+  ArenaVector<TexCoord> texCoords;
+  ArenaVector<VertNormal> vertNormals;
+  ArenaVector<FaceVertexData> corners;
+  ArenaVector<FaceVertexData> scratch;
+  // Elements seen so far, faces may only reference those
+  RecordCounts counts;
+
+  std::vector<Material> materials;
+  std::vector<SubMeshStart> subMeshStarts{SubMeshStart{"", "", 0}};
+  unsigned int lineNumber = 0;
+
+  void startSubMesh(std::string name, std::string material) {
+    if (subMeshStarts.back().firstCorner != corners.size()) {
+      subMeshStarts.push_back(SubMeshStart{"", "", corners.size()});
+    }
+    subMeshStarts.back().name = std::move(name);
+    subMeshStarts.back().material = std::move(material);
+  }
+
+  bool parseLine(const char *line, const char *lineEnd) {
+    if (lineEnd - line < 2) {
+      return true;
+    }
+
     // Comment
     if (line[0] == '#') {
-      continue;
+      return true;
     }
 
     if (line[0] == 'v') {
       if (line[1] == ' ') { // Vertex
-        auto vertPos = parseVertPos(line);
+        auto vertPos = parseVertPos(line, lineEnd);
         if (!vertPos.has_value()) {
-          std::cerr << "Error at line: " << lineNumber << std::endl;
-          return {};
+          return false;
         }
         vertPoses.push_back(vertPos.value());
+        counts.vertPoses++;
       } else if (line[1] == 't') { // Texture coordinate
-        auto texCoord = parseTexCoord(line);
+        auto texCoord = parseTexCoord(line, lineEnd);
         if (!texCoord.has_value()) {
-          std::cerr << "Error at line: " << lineNumber << std::endl;
-          return {};
+          return false;
         }
         texCoords.push_back(texCoord.value());
+        counts.texCoords++;
       } else if (line[1] == 'n') { // Vertex normal
-        auto vertNormal = parseVertNormal(line);
+        auto vertNormal = parseVertNormal(line, lineEnd);
         if (!vertNormal.has_value()) {
-          std::cerr << "Error at line: " << lineNumber << std::endl;
-          return {};
+          return false;
         }
         vertNormals.push_back(vertNormal.value());
+        counts.vertNormals++;
       }
-    } else if (line[0] == 'f') { // face
-      auto parsedDatas = parseFace(line);
-      if (parsedDatas.size() == 0) {
+    } else if (line[0] == 'f' && isSpace(line[1])) { // face
+      return parseFace(line, lineEnd, counts, scratch, corners);
+    } else if ((line[0] == 'o' || line[0] == 'g') && isSpace(line[1])) {
+      startSubMesh(parseName(line, lineEnd, 1),
+                   subMeshStarts.back().material);
+    } else if (isKeyword(line, lineEnd, "usemtl")) {
+      startSubMesh(subMeshStarts.back().name, parseName(line, lineEnd, 6));
+    } else if (isKeyword(line, lineEnd, "mtllib")) {
+      // Relative to the obj file, a missing library only loses the colours
+      timer.nest(LoadPhase::Materials, [&] {
+        loadMaterials(path.parent_path() / parseName(line, lineEnd, 6),
+                      arena, materials, stats);
+      });
+    }
+
+    // Ignore anything else
+    return true;
+  }
+
+public:
+  ObjParser(const std::filesystem::path &path, Arena &arena, LoadStats *stats,
+            PhaseTimer &timer)
+      : path(path), arena(arena), stats(stats), timer(timer),
+        vertPoses(arena), texCoords(arena), vertNormals(arena),
+        corners(arena), scratch(arena) {}
+
+  void reserve(const RecordCounts &expected) {
+    vertPoses.reserve(expected.vertPoses);
+    texCoords.reserve(expected.texCoords);
+    vertNormals.reserve(expected.vertNormals);
+    corners.reserve(expected.faceCorners);
+  }
+
+  /**
+   * Parses every line in `[p, end)`, the last one doesn't need a newline.
+   * Numbers may be parsed up to the character at `end`, which must not be
+   * part of one. `CountLines` also files each line in `stats`, for when
+   * no scan did that beforehand.
+   */
+  template <bool CountLines> bool parseLines(const char *p, const char *end) {
+    while (p < end) {
+      const char *lineEnd = findLineEnd(p, end);
+      const char *next = lineEnd + 1;
+      if (lineEnd > p && lineEnd[-1] == '\r') {
+        lineEnd--;
+      }
+      lineNumber++;
+      if constexpr (CountLines) {
+        countLine(p, lineEnd, *stats);
+      }
+      if (!parseLine(p, lineEnd)) {
         std::cerr << "Error at line: " << lineNumber << std::endl;
-        return {};
+        return false;
       }
-      for (auto parsedData : parsedDatas) {
-        faceDatas.push_back(parsedData);
+      p = next;
+    }
+    return true;
+  }
+
+  /**
+   * Welds the parsed corners and builds the sub meshes.
+   */
+  ObjData finish() {
+    // Weld identical verticies through an open addressing table of
+    // `index + 1` into `uniqueVerts`, 0 marks an empty slot
+    size_t tableSize = 16;
+    while (tableSize < corners.size() * 2) {
+      tableSize *= 2;
+    }
+    const size_t tableMask = tableSize - 1;
+    uint32_t *table = arena.allocate<uint32_t>(tableSize);
+    std::memset(table, 0, sizeof(uint32_t) * tableSize);
+
+    ArenaVector<Vertex> uniqueVerts(arena);
+    uniqueVerts.reserve(corners.size());
+    std::vector<unsigned int> indicies(corners.size());
+
+    for (size_t i = 0; i < corners.size(); i++) {
+      const FaceVertexData &fvd = corners[i];
+      Vertex vertex = {vertPoses[fvd.v - 1],
+                       fvd.vt != 0 ? texCoords[fvd.vt - 1] : TexCoord{},
+                       fvd.vn != 0 ? vertNormals[fvd.vn - 1] : VertNormal{}};
+
+      size_t slot = hashVertex(vertex) & tableMask;
+      while (table[slot] != 0 && !(uniqueVerts[table[slot] - 1] == vertex)) {
+        slot = (slot + 1) & tableMask;
+      }
+      if (table[slot] == 0) {
+        uniqueVerts.push_back(vertex);
+        table[slot] = static_cast<uint32_t>(uniqueVerts.size());
       }
+      indicies[i] = table[slot] - 1;
     }
 
-    // Ignore anything else
+    std::vector<Vertex> verts(uniqueVerts.begin(), uniqueVerts.end());
+    timer.finish(LoadPhase::Weld);
+    if (stats != nullptr) {
+      stats->inputVertices = corners.size();
+      stats->uniqueVertices = verts.size();
+      (*stats)[LoadPhase::Weld].heapBytes =
+          sizeof(Vertex) * verts.size() +
+          sizeof(unsigned int) * corners.size();
+    }
+
+    ObjData objData{std::move(verts), std::move(indicies),
+                    std::move(materials), {}};
+    buildSubMeshes(subMeshStarts, corners.size(), objData);
+    timer.finish(LoadPhase::SubMeshes);
+    return objData;
+  }
+};
+
+/**
+ * Parses a `.obj` held in memory in one go. A scan first sizes every
+ * staging array exactly.
+ */
+static std::optional<ObjData> parseObjBuffer(const char *buffer,
+                                             size_t size,
+                                             const std::filesystem::path &path,
+                                             Arena &arena, LoadStats *stats,
+                                             PhaseTimer &timer) {
+  const char *const bufferEnd = buffer + size;
+  const RecordCounts expected =
+      stats != nullptr ? countRecords<true>(buffer, bufferEnd, stats)
+                       : countRecords<false>(buffer, bufferEnd, nullptr);
+  timer.finish(LoadPhase::Scan);
+
+  ObjParser parser(path, arena, stats, timer);
+  parser.reserve(expected);
+  if (!parser.parseLines<false>(buffer, bufferEnd)) {
+    return {};
+  }
+  timer.finish(LoadPhase::Parse);
+  return parser.finish();
+}
+
+static std::optional<ObjData> decodeMeshBuffer(
+    const char *buffer, size_t size, const std::filesystem::path &path,
+    LoadStats *stats, PhaseTimer &timer) {
+  std::optional<ObjData> objData =
+      decodeMesh(reinterpret_cast<const uint8_t *>(buffer), size);
+  timer.finish(LoadPhase::Decode);
+  if (!objData.has_value()) {
+    std::cerr << "Corrupt mesh file '" << path.string() << "'\n";
+    return objData;
   }
+  if (stats != nullptr) {
+    stats->triangles = objData->indicies.size() / 3;
+    stats->inputVertices = objData->indicies.size();
+    stats->uniqueVertices = objData->verts.size();
+    (*stats)[LoadPhase::Decode].heapBytes =
+        sizeof(Vertex) * objData->verts.size() +
+        sizeof(unsigned int) * objData->indicies.size();
+  }
+  return objData;
+}
 
-  file.close();
+/**
+ * `.obj` and `.ofm` files are read whole, then parsed or decoded by this.
+ */
+static bool isReadWhole(const std::filesystem::path &path) {
+  const std::filesystem::path extension = path.extension();
+  return extension == ".obj" || extension == MESH_FILE_EXTENSION;
+}
 
-  std::vector<Vertex> verts;
-  std::vector<unsigned int> indicies;
+static std::optional<ObjData> parseBuffer(const char *buffer, size_t size,
+                                          const std::filesystem::path &path,
+                                          Arena &arena, LoadStats *stats,
+                                          PhaseTimer &timer) {
+  if (stats != nullptr) {
+    stats->bytesRead = size;
+  }
+  if (path.extension() == MESH_FILE_EXTENSION) {
+    return decodeMeshBuffer(buffer, size, path, stats, timer);
+  }
+  return parseObjBuffer(buffer, size, path, arena, stats, timer);
+}
 
-  std::unordered_map<Vertex, unsigned int, VertexHash> vertexToIndex;
+static inline void appendChars(ArenaVector<char> &chars, const char *p,
+                               const char *end) {
+  chars.reserve(chars.size() + (end - p));
+  for (; p < end; p++) {
+    chars.push_back(*p);
+  }
+}
 
-  for (const auto &faceData : faceDatas) {
-    FaceVertexData faceVertexData[3] = {faceData.v1, faceData.v2, faceData.v3};
-    for (const auto &fvd : faceVertexData) {
-      Vertex vertex = {vertPoses[fvd.v - 1], texCoords[fvd.vt - 1],
-                       vertNormals[fvd.vn - 1]};
+/**
+ * Parses a compressed `.obj` while it's being decompressed. There is no
+ * scan, the whole file is never in memory, so the staging arrays grow as
+ * they go. Each block's complete lines are parsed in place and the partial
+ * last one carried over to the next block.
+ */
+static std::optional<ObjData>
+parseCompressedObjFile(const std::filesystem::path &path,
+                       Compression compression, Arena &arena,
+                       LoadStats *stats, PhaseTimer &timer) {
+  DecompressStream stream(path, compression);
+  ObjParser parser(path, arena, stats, timer);
+  auto parseLines = [&](const char *p, const char *end) {
+    return stats != nullptr ? parser.parseLines<true>(p, end)
+                            : parser.parseLines<false>(p, end);
+  };
 
-      auto it = vertexToIndex.find(vertex);
-      if (it != vertexToIndex.end()) {
-        indicies.push_back(it->second);
-      } else {
-        unsigned int newIndex = verts.size();
-        vertexToIndex[vertex] = newIndex;
-        verts.push_back(vertex);
-        indicies.push_back(newIndex);
+  // '\0' terminated before parsing, so numbers at its end stop there
+  ArenaVector<char> carry(arena);
+  bool ok = true;
+  size_t size;
+  while (const char *block = stream.next(size)) {
+    timer.finish(LoadPhase::Read);
+    const char *const end = block + size;
+    const char *p = block;
+    if (!carry.empty()) {
+      const char *newline =
+          static_cast<const char *>(std::memchr(p, '\n', size));
+      const char *rest = newline == nullptr ? end : newline + 1;
+      appendChars(carry, p, rest);
+      p = rest;
+      if (newline != nullptr) {
+        carry.push_back('\0');
+        ok = parseLines(carry.data(), carry.end() - 1);
+        carry.clear();
       }
     }
+    // Complete lines end in a newline, which stops number parsing too
+    const char *lastLine = end;
+    while (lastLine > p && lastLine[-1] != '\n') {
+      lastLine--;
+    }
+    ok = ok && parseLines(p, lastLine);
+    appendChars(carry, lastLine, end);
+    timer.finish(LoadPhase::Parse);
+    if (!ok) {
+      return {};
+    }
+  }
+  if (stream.hasFailed()) {
+    std::cerr << "Failed to decompress file '" << path.string() << "'\n";
+    return {};
+  }
+  if (!carry.empty()) {
+    carry.push_back('\0');
+    if (!parseLines(carry.data(), carry.end() - 1)) {
+      return {};
+    }
+    timer.finish(LoadPhase::Parse);
+  }
+  if (stats != nullptr) {
+    stats->bytesRead += stream.getCompressedBytes();
+    stats->bytesDecompressed = stream.getDecompressedBytes();
+    stats->decompressSeconds = stream.getDecompressSeconds();
+  }
+  return parser.finish();
+}
+
+std::optional<ObjData>
+loadObjDataFromPath(const std::filesystem::path &fullFilePath, Arena &arena,
+                    LoadStats *stats) {
+  if (stats != nullptr) {
+    *stats = {};
+  }
+  PhaseTimer timer(stats, arena);
+
+  if (isReadWhole(fullFilePath)) {
+    size_t fileSize;
+    const char *buffer = readFile(fullFilePath, arena, fileSize);
+    timer.finish(LoadPhase::Read);
+    if (buffer == nullptr) {
+      std::cerr << "Failed to open file '" << fullFilePath.string() << "'\n";
+      return {};
+    }
+    return parseBuffer(buffer, fileSize, fullFilePath, arena, stats, timer);
+  }
+
+  auto extention = fullFilePath.extension();
+  const Compression compression = getCompression(fullFilePath);
+  if (compression != Compression::None &&
+      fullFilePath.stem().extension() == ".obj") {
+    if (!isCompressionSupported(compression)) {
+      std::cerr << "Built without support for '" << extention
+                << "' compressed files\n";
+      return {};
+    }
+    return parseCompressedObjFile(fullFilePath, compression, arena, stats,
+                                  timer);
+  }
+
+  std::cerr << "There is no support for '" << extention << "' file formats\n";
+  return {};
+}
+
+std::optional<ObjData> loadObjDataFromMemory(const char *bytes, size_t size,
+                                             const std::filesystem::path &path,
+                                             Arena &arena, LoadStats *stats) {
+  if (stats != nullptr) {
+    *stats = {};
   }
+  PhaseTimer timer(stats, arena);
 
-  std::cout << "Loaded obj\n";
+  if (!isReadWhole(path)) {
+    std::cerr << "Can't parse '" << path.extension().string()
+              << "' files from memory\n";
+    return {};
+  }
+  return parseBuffer(bytes, size, path, arena, stats, timer);
+}
+
+// Keep the arena per thread so back to back loads reuse its blocks, but
+// don't sit on the memory of an unusually large mesh forever
+static constexpr size_t MAX_RETAINED_BYTES = 64 << 20;
+
+static Arena &getThreadArena() {
+  thread_local Arena arena(4 << 20);
+  return arena;
+}
+
+void recycleLoadArena(Arena &arena) {
+  if (arena.getStats().bytesReserved > MAX_RETAINED_BYTES) {
+    arena.release();
+  } else {
+    arena.reset();
+  }
+}
+
+std::optional<ObjData> loadObjDataFromPath(const std::filesystem::path &path,
+                                           LoadStats *stats) {
+  std::optional<ObjData> objData =
+      loadObjDataFromPath(path, getThreadArena(), stats);
+  recycleLoadArena(getThreadArena());
+  return objData;
+}
+
+std::optional<ObjData> loadObjDataFromMemory(const char *bytes, size_t size,
+                                             const std::filesystem::path &path,
+                                             LoadStats *stats) {
+  std::optional<ObjData> objData =
+      loadObjDataFromMemory(bytes, size, path, getThreadArena(), stats);
+  recycleLoadArena(getThreadArena());
+  return objData;
+}
+
+std::optional<ObjData> loadObjDataFromFile(const char *fileName, Arena &arena,
+                                           LoadStats *stats) {
+  std::string objDir = std::getenv("ICG_OBJ_DIR");
+  std::filesystem::path fullFilePath = objDir + "/" + fileName;
+
+  std::cout << "Loading obj data from file '" << fullFilePath.string() << "'\n";
+  std::optional<ObjData> objData =
+      loadObjDataFromPath(fullFilePath, arena, stats);
+  if (objData.has_value()) {
+    std::cout << "Loaded obj\n";
+  }
+  return objData;
+}
 
-  return ObjData{verts, indicies};
+std::optional<ObjData> loadObjDataFromFile(const char *fileName,
+                                           LoadStats *stats) {
+  std::optional<ObjData> objData =
+      loadObjDataFromFile(fileName, getThreadArena(), stats);
+  recycleLoadArena(getThreadArena());
+  return objData;
 }
 
 } // namespace ofyaGl
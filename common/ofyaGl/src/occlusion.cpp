@@ -0,0 +1,323 @@
+#include <ofyaGl/occlusion.h>
+
+#include <ofyaGl/job.h>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define OFYAGL_OCCLUSION_SSE
+#endif
+
+namespace ofyaGl {
+
+/**
+ * Boxes per task in `cull`.
+ */
+constexpr size_t CULL_GRAIN = 256;
+
+/**
+ * Plane `a * x + b * y + c` over the window.
+ */
+struct Plane {
+  float a;
+  float b;
+  float c;
+};
+
+OcclusionCuller::OcclusionCuller(int width, int height)
+    : width((std::max(width, 4) + 3) & ~3), height(std::max(height, 1)) {
+  int levelWidth = this->width;
+  int levelHeight = this->height;
+  while (true) {
+    levels.emplace_back(static_cast<size_t>(levelWidth) * levelHeight, 1.f);
+    levelWidths.push_back(levelWidth);
+    levelHeights.push_back(levelHeight);
+    if (levelWidth == 1 && levelHeight == 1) {
+      break;
+    }
+    levelWidth = (levelWidth + 1) / 2;
+    levelHeight = (levelHeight + 1) / 2;
+  }
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4 &viewProjection) {
+  this->viewProjection = viewProjection;
+  std::fill(levels[0].begin(), levels[0].end(), 1.f);
+  stats = Stats{};
+}
+
+void OcclusionCuller::addOccluder(const float *positions, size_t stride,
+                                  size_t vertCount, const uint32_t *indices,
+                                  size_t indexCount, const glm::mat4 &model) {
+  const glm::mat4 mvp = viewProjection * model;
+  clipScratch.resize(vertCount);
+  const char *bytes = reinterpret_cast<const char *>(positions);
+  for (size_t i = 0; i < vertCount; i++) {
+    const float *p = reinterpret_cast<const float *>(bytes + i * stride);
+    clipScratch[i] = mvp * glm::vec4(p[0], p[1], p[2], 1.f);
+  }
+
+  for (size_t i = 0; i + 2 < indexCount; i += 3) {
+    if (indices[i] >= vertCount || indices[i + 1] >= vertCount ||
+        indices[i + 2] >= vertCount) {
+      continue;
+    }
+    stats.occluderTriangles++;
+    rasterizeTriangle(clipScratch[indices[i]], clipScratch[indices[i + 1]],
+                      clipScratch[indices[i + 2]]);
+  }
+}
+
+void OcclusionCuller::addOccluder(const ObjData &data,
+                                  const glm::mat4 &model) {
+  if (data.verts.empty()) {
+    return;
+  }
+  addOccluder(&data.verts[0].pos.x, sizeof(Vertex), data.verts.size(),
+              data.indicies.data(), data.indicies.size(), model);
+}
+
+void OcclusionCuller::rasterizeTriangle(const glm::vec4 &a, const glm::vec4 &b,
+                                        const glm::vec4 &c) {
+  const glm::vec4 *clip[3] = {&a, &b, &c};
+  for (const glm::vec4 *v : clip) {
+    // Crossing the near plane, would need clipping
+    if (v->w <= 0.f || v->z < -v->w) {
+      return;
+    }
+  }
+  if ((a.x > a.w && b.x > b.w && c.x > c.w) ||
+      (a.x < -a.w && b.x < -b.w && c.x < -c.w) ||
+      (a.y > a.w && b.y > b.w && c.y > c.w) ||
+      (a.y < -a.w && b.y < -b.w && c.y < -c.w) ||
+      (a.z > a.w && b.z > b.w && c.z > c.w)) {
+    return;
+  }
+
+  float x[3], y[3], z[3];
+  for (int i = 0; i < 3; i++) {
+    const float invW = 1.f / clip[i]->w;
+    x[i] = (clip[i]->x * invW * .5f + .5f) * width;
+    y[i] = (clip[i]->y * invW * .5f + .5f) * height;
+    z[i] = clip[i]->z * invW * .5f + .5f;
+  }
+
+  const float area =
+      (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+  if (!(area > 0.f)) {
+    // Back facing or degenerate
+    return;
+  }
+
+  // Pixels whose center can be inside
+  int x0 = static_cast<int>(std::ceil(std::min({x[0], x[1], x[2]}) - .5f));
+  int x1 = static_cast<int>(std::floor(std::max({x[0], x[1], x[2]}) - .5f));
+  int y0 = static_cast<int>(std::ceil(std::min({y[0], y[1], y[2]}) - .5f));
+  int y1 = static_cast<int>(std::floor(std::max({y[0], y[1], y[2]}) - .5f));
+  x0 = std::max(x0, 0) & ~3;
+  x1 = std::min(x1, width - 1);
+  y0 = std::max(y0, 0);
+  y1 = std::min(y1, height - 1);
+  if (x0 > x1 || y0 > y1) {
+    return;
+  }
+  stats.rasterizedTriangles++;
+
+  // Edge k runs from vertex k to k + 1 and is positive inside, it weighs the
+  // vertex opposite to it
+  Plane edges[3];
+  for (int k = 0; k < 3; k++) {
+    const int j = (k + 1) % 3;
+    edges[k].a = y[k] - y[j];
+    edges[k].b = x[j] - x[k];
+    edges[k].c = -(edges[k].a * x[k] + edges[k].b * y[k]);
+  }
+  const float invArea = 1.f / area;
+  Plane depth{
+      (edges[1].a * z[0] + edges[2].a * z[1] + edges[0].a * z[2]) * invArea,
+      (edges[1].b * z[0] + edges[2].b * z[1] + edges[0].b * z[2]) * invArea,
+      (edges[1].c * z[0] + edges[2].c * z[1] + edges[0].c * z[2]) * invArea};
+
+  std::vector<float> &buffer = levels[0];
+
+#ifdef OFYAGL_OCCLUSION_SSE
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 offsets = _mm_setr_ps(.5f, 1.5f, 2.5f, 3.5f);
+  __m128 edgeA[3], depthA = _mm_set1_ps(depth.a);
+  for (int k = 0; k < 3; k++) {
+    edgeA[k] = _mm_set1_ps(edges[k].a);
+  }
+
+  for (int py = y0; py <= y1; py++) {
+    const float centerY = py + .5f;
+    __m128 edgeRow[3];
+    for (int k = 0; k < 3; k++) {
+      edgeRow[k] = _mm_set1_ps(edges[k].b * centerY + edges[k].c);
+    }
+    const __m128 depthRow = _mm_set1_ps(depth.b * centerY + depth.c);
+    float *row = &buffer[static_cast<size_t>(py) * width];
+
+    for (int px = x0; px <= x1; px += 4) {
+      const __m128 centerX =
+          _mm_add_ps(_mm_set1_ps(static_cast<float>(px)), offsets);
+      __m128 inside = _mm_cmpge_ps(
+          _mm_add_ps(_mm_mul_ps(edgeA[0], centerX), edgeRow[0]), zero);
+      inside = _mm_and_ps(
+          inside, _mm_cmpge_ps(
+                      _mm_add_ps(_mm_mul_ps(edgeA[1], centerX), edgeRow[1]),
+                      zero));
+      inside = _mm_and_ps(
+          inside, _mm_cmpge_ps(
+                      _mm_add_ps(_mm_mul_ps(edgeA[2], centerX), edgeRow[2]),
+                      zero));
+      if (_mm_movemask_ps(inside) == 0) {
+        continue;
+      }
+      const __m128 old = _mm_loadu_ps(row + px);
+      const __m128 nearest = _mm_min_ps(
+          old, _mm_add_ps(_mm_mul_ps(depthA, centerX), depthRow));
+      _mm_storeu_ps(row + px, _mm_or_ps(_mm_and_ps(inside, nearest),
+                                        _mm_andnot_ps(inside, old)));
+    }
+  }
+#else
+  for (int py = y0; py <= y1; py++) {
+    const float centerY = py + .5f;
+    float *row = &buffer[static_cast<size_t>(py) * width];
+    for (int px = x0; px <= x1; px++) {
+      const float centerX = px + .5f;
+      bool inside = true;
+      for (const Plane &edge : edges) {
+        inside &= edge.a * centerX + edge.b * centerY + edge.c >= 0.f;
+      }
+      if (inside) {
+        row[px] = std::min(row[px], depth.a * centerX + depth.b * centerY +
+                                        depth.c);
+      }
+    }
+  }
+#endif
+}
+
+void OcclusionCuller::buildHierarchy() {
+  for (size_t level = 1; level < levels.size(); level++) {
+    const std::vector<float> &src = levels[level - 1];
+    std::vector<float> &dst = levels[level];
+    const int srcWidth = levelWidths[level - 1];
+    const int srcHeight = levelHeights[level - 1];
+    const int dstWidth = levelWidths[level];
+
+    for (int y = 0; y < levelHeights[level]; y++) {
+      // Odd sizes clamp to the last row and column
+      const float *row0 = &src[static_cast<size_t>(2 * y) * srcWidth];
+      const float *row1 =
+          &src[static_cast<size_t>(std::min(2 * y + 1, srcHeight - 1)) *
+               srcWidth];
+      float *out = &dst[static_cast<size_t>(y) * dstWidth];
+
+      int x = 0;
+#ifdef OFYAGL_OCCLUSION_SSE
+      for (; 2 * x + 8 <= srcWidth; x += 4) {
+        const __m128 left = _mm_max_ps(_mm_loadu_ps(row0 + 2 * x),
+                                       _mm_loadu_ps(row1 + 2 * x));
+        const __m128 right = _mm_max_ps(_mm_loadu_ps(row0 + 2 * x + 4),
+                                        _mm_loadu_ps(row1 + 2 * x + 4));
+        const __m128 even =
+            _mm_shuffle_ps(left, right, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 odd =
+            _mm_shuffle_ps(left, right, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(out + x, _mm_max_ps(even, odd));
+      }
+#endif
+      for (; x < dstWidth; x++) {
+        const int x0 = 2 * x;
+        const int x1 = std::min(2 * x + 1, srcWidth - 1);
+        out[x] = std::max(std::max(row0[x0], row0[x1]),
+                          std::max(row1[x0], row1[x1]));
+      }
+    }
+  }
+}
+
+bool OcclusionCuller::isVisible(const Bounds &bounds) const {
+  float minX = INFINITY, maxX = -INFINITY;
+  float minY = INFINITY, maxY = -INFINITY;
+  float minZ = INFINITY;
+  int behindNear = 0;
+  for (int corner = 0; corner < 8; corner++) {
+    const glm::vec4 clip =
+        viewProjection *
+        glm::vec4(corner & 1 ? bounds.max.x : bounds.min.x,
+                  corner & 2 ? bounds.max.y : bounds.min.y,
+                  corner & 4 ? bounds.max.z : bounds.min.z, 1.f);
+    if (clip.w <= 0.f || clip.z < -clip.w) {
+      behindNear++;
+      continue;
+    }
+    const float invW = 1.f / clip.w;
+    const float x = (clip.x * invW * .5f + .5f) * width;
+    const float y = (clip.y * invW * .5f + .5f) * height;
+    minX = std::min(minX, x);
+    maxX = std::max(maxX, x);
+    minY = std::min(minY, y);
+    maxY = std::max(maxY, y);
+    minZ = std::min(minZ, clip.z * invW * .5f + .5f);
+  }
+
+  if (behindNear == 8) {
+    return false;
+  }
+  if (behindNear > 0) {
+    // Crosses the near plane, nothing can be said cheaply
+    return true;
+  }
+  if (maxX < 0.f || minX > width || maxY < 0.f || minY > height ||
+      minZ > 1.f) {
+    return false;
+  }
+
+  const int x0 = std::clamp(static_cast<int>(std::floor(minX)), 0, width - 1);
+  const int x1 = std::clamp(static_cast<int>(std::floor(maxX)), 0, width - 1);
+  const int y0 = std::clamp(static_cast<int>(std::floor(minY)), 0, height - 1);
+  const int y1 = std::clamp(static_cast<int>(std::floor(maxY)), 0, height - 1);
+
+  // Coarsest level at which the rectangle still spans at most 2x2 texels
+  size_t level = 0;
+  while ((x1 >> level) - (x0 >> level) > 1 ||
+         (y1 >> level) - (y0 >> level) > 1) {
+    level++;
+  }
+
+  const std::vector<float> &depth = levels[level];
+  const int levelWidth = levelWidths[level];
+  for (int y = y0 >> level; y <= y1 >> level; y++) {
+    for (int x = x0 >> level; x <= x1 >> level; x++) {
+      if (depth[static_cast<size_t>(y) * levelWidth + x] >= minZ) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+size_t OcclusionCuller::cull(const std::vector<Bounds> &bounds,
+                             std::vector<uint8_t> &visible) {
+  visible.resize(bounds.size());
+  JobSystem::shared().parallelFor(
+      0, bounds.size(), CULL_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+          visible[i] = isVisible(bounds[i]) ? 1 : 0;
+        }
+      });
+
+  size_t visibleCount = 0;
+  for (uint8_t flag : visible) {
+    visibleCount += flag;
+  }
+  stats.testedBounds += bounds.size();
+  stats.culledBounds += bounds.size() - visibleCount;
+  return visibleCount;
+}
+} // namespace ofyaGl
@@ -0,0 +1,1152 @@
+#include <ofyaGl/paged_mesh.h>
+
+#include <ofyaGl/hash.h>
+#include <ofyaGl/mesh_codec.h>
+#include <ofyaGl/mesh_optimize.h>
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ofyaGl {
+
+namespace fs = std::filesystem;
+
+constexpr char PAGED_MAGIC[4] = {'O', 'F', 'P', 'G'};
+constexpr size_t PAGE_ALIGNMENT = 16;
+
+/**
+ * Cells per axis a cluster key can address, 21 bits each.
+ */
+constexpr int64_t MAX_CELL = (1 << 21) - 1;
+
+/**
+ * Set on a vertex id that is an index into the bucket's vertices rather
+ * than a cell key, for vertices a level keeps as they are.
+ */
+constexpr uint64_t ORIGINAL_VERTEX = uint64_t(1) << 63;
+
+/**
+ * Bytes `buildPagedMeshFile` reads from the input or copies per call.
+ */
+constexpr size_t STREAM_BLOCK_SIZE = 1 << 20;
+
+/**
+ * Triangles `buildPagedMeshFile` moves per read while splitting a bucket.
+ */
+constexpr size_t SPLIT_BLOCK_TRIANGLES = 4096;
+
+/**
+ * Start of an `.ofp` file, followed by the chunk table, the page table and
+ * the page data.
+ */
+struct PagedMeshHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t chunkCount;
+  uint32_t pageCount;
+  uint32_t lodCount;
+  uint32_t maxPageVerts;
+  uint32_t maxPageIndices;
+  uint32_t reserved;
+  uint64_t triangleCount;
+  Bounds bounds;
+};
+
+static_assert(std::is_trivially_copyable_v<PagedChunk> &&
+                  std::is_trivially_copyable_v<PageInfo>,
+              "Tables are copied to and from the file as is");
+
+/**
+ * Running sums of the vertices inside one cell, `vertex` is their average
+ * once every vertex has been added.
+ */
+struct Cluster {
+  glm::vec3 position{0.f};
+  glm::vec3 texCoord{0.f};
+  glm::vec3 normal{0.f};
+  uint32_t count = 0;
+  Vertex vertex;
+};
+
+/**
+ * Level cell sizes on a grid shared by the whole mesh, level 0 keeps the
+ * original vertices and has none. Buckets are boxes of coarsest level
+ * cells, which every finer cell nests in.
+ */
+struct LodGrid {
+  glm::vec3 origin;
+  std::vector<float> cellSizes;
+  float bucketCellSize;
+};
+
+/**
+ * Box of bucket cells, `max` is exclusive.
+ */
+struct CellBox {
+  int64_t min[3];
+  int64_t max[3];
+
+  bool contains(const int64_t cell[3]) const {
+    for (int axis = 0; axis < 3; axis++) {
+      if (cell[axis] < min[axis] || cell[axis] >= max[axis]) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+/**
+ * Compares by bytes, so the hash agrees with the comparison for -0 and NaN.
+ */
+template <typename T> struct BytesHash {
+  size_t operator()(const T &value) const {
+    return hashBytes(&value, sizeof(value));
+  }
+};
+
+template <typename T> struct BytesEqual {
+  bool operator()(const T &a, const T &b) const {
+    return std::memcmp(&a, &b, sizeof(T)) == 0;
+  }
+};
+
+static inline glm::vec3 toVec3(const VertPos &pos) {
+  return glm::vec3(pos.x, pos.y, pos.z);
+}
+
+static inline size_t alignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+static inline uint32_t getLodCount(const PagedMeshParams &params) {
+  return std::max<uint32_t>(params.lodCount, 1);
+}
+
+static inline int64_t getCell(float coordinate, float origin, float cellSize) {
+  const float cell = std::floor((coordinate - origin) / cellSize);
+  // Also catches NaN
+  if (!(cell > 0.f)) {
+    return 0;
+  }
+  return cell < float(MAX_CELL) ? static_cast<int64_t>(cell) : MAX_CELL;
+}
+
+static inline uint64_t getCellKey(const glm::vec3 &position,
+                                  const glm::vec3 &origin, float cellSize) {
+  uint64_t key = 0;
+  for (int axis = 0; axis < 3; axis++) {
+    const int64_t cell = getCell(position[axis], origin[axis], cellSize);
+    key |= static_cast<uint64_t>(cell) << (21 * axis);
+  }
+  return key;
+}
+
+static inline void getBucketCell(const LodGrid &grid,
+                                 const glm::vec3 &position, int64_t cell[3]) {
+  for (int axis = 0; axis < 3; axis++) {
+    cell[axis] =
+        getCell(position[axis], grid.origin[axis], grid.bucketCellSize);
+  }
+}
+
+static void growBounds(Bounds &bounds, const glm::vec3 &point) {
+  bounds.min = glm::min(bounds.min, point);
+  bounds.max = glm::max(bounds.max, point);
+}
+
+static Bounds emptyBounds() {
+  return Bounds{glm::vec3(INFINITY), glm::vec3(-INFINITY)};
+}
+
+static double getEdgeLength(const glm::vec3 &a, const glm::vec3 &b,
+                            const glm::vec3 &c) {
+  return glm::length(b - a) + glm::length(c - b) + glm::length(a - c);
+}
+
+static LodGrid makeLodGrid(const Bounds &bounds, double edgeLength,
+                           uint64_t triangleCount, uint32_t lodCount) {
+  // Level 1 cells span about two average edges, each level doubles that
+  float cellSize = triangleCount > 0
+                       ? static_cast<float>(edgeLength / (3.0 * triangleCount))
+                       : 1.f;
+  cellSize = std::max(cellSize, 1e-6f);
+
+  LodGrid grid;
+  grid.origin = bounds.min;
+  grid.cellSizes.assign(lodCount, 0.f);
+  for (uint32_t lod = 1; lod < lodCount; lod++) {
+    grid.cellSizes[lod] = cellSize * static_cast<float>(1u << lod);
+  }
+  grid.bucketCellSize = cellSize * static_cast<float>(1u << (lodCount - 1));
+  return grid;
+}
+
+/**
+ * Triangle ranges of `order` holding at most `maxTriangles` each, found by
+ * splitting at the median centroid along the longest axis.
+ */
+static std::vector<std::pair<size_t, size_t>>
+splitChunks(const std::vector<glm::vec3> &centroids,
+            std::vector<uint32_t> &order, size_t maxTriangles) {
+  std::vector<std::pair<size_t, size_t>> chunks;
+  std::vector<std::pair<size_t, size_t>> stack{{0, order.size()}};
+  while (!stack.empty()) {
+    const auto [begin, end] = stack.back();
+    stack.pop_back();
+    if (end - begin <= maxTriangles) {
+      chunks.push_back({begin, end});
+      continue;
+    }
+
+    Bounds bounds = emptyBounds();
+    for (size_t i = begin; i < end; i++) {
+      growBounds(bounds, centroids[order[i]]);
+    }
+    const glm::vec3 extent = bounds.max - bounds.min;
+    const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0
+                     : extent.y >= extent.z                       ? 1
+                                                                  : 2;
+    const size_t middle = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + middle,
+                     order.begin() + end, [&](uint32_t a, uint32_t b) {
+                       return centroids[a][axis] < centroids[b][axis];
+                     });
+    // Second half first, so chunks come out in traversal order
+    stack.push_back({middle, end});
+    stack.push_back({begin, middle});
+  }
+  return chunks;
+}
+
+/**
+ * Chunks and pages of the buckets added so far. Page offsets count from the
+ * start of the page data until `writeTables` puts the tables before it.
+ */
+class PagedMeshWriter {
+private:
+  const LodGrid &grid;
+  const uint32_t lodCount;
+  const size_t maxChunkTriangles;
+  std::vector<PagedChunk> chunks;
+  std::vector<PageInfo> pages;
+  uint64_t dataSize = 0;
+  uint64_t triangleCount = 0;
+  uint32_t maxPageVerts = 0;
+  uint32_t maxPageIndices = 0;
+
+public:
+  PagedMeshWriter(const LodGrid &grid, uint32_t lodCount,
+                  size_t maxChunkTriangles)
+      : grid(grid), lodCount(lodCount),
+        maxChunkTriangles(maxChunkTriangles) {}
+
+  /**
+   * Splits `bucket` into chunks and simplifies them, the page data replaces
+   * `data`. Vertices flagged in `locked` stay as they are on every level, an
+   * empty `locked` flags none. Fails once page ids would no longer fit 32
+   * bits.
+   */
+  bool addBucket(const ObjData &bucket, const std::vector<uint8_t> &locked,
+                 std::vector<uint8_t> &data);
+
+  /**
+   * Header, chunk table and page table, padded so the page data can follow.
+   */
+  std::vector<uint8_t> writeTables(const Bounds &bounds) const;
+
+  inline uint64_t getDataSize() const { return dataSize; }
+};
+
+bool PagedMeshWriter::addBucket(const ObjData &bucket,
+                                const std::vector<uint8_t> &locked,
+                                std::vector<uint8_t> &data) {
+  const std::vector<Vertex> &verts = bucket.verts;
+  const std::vector<unsigned int> &indicies = bucket.indicies;
+  const size_t bucketTriangles = indicies.size() / 3;
+  auto isLocked = [&](unsigned int index, uint32_t lod) {
+    return lod == 0 || (!locked.empty() && locked[index] != 0);
+  };
+
+  std::vector<glm::vec3> centroids(bucketTriangles);
+  for (size_t t = 0; t < bucketTriangles; t++) {
+    centroids[t] = (toVec3(verts[indicies[t * 3]].pos) +
+                    toVec3(verts[indicies[t * 3 + 1]].pos) +
+                    toVec3(verts[indicies[t * 3 + 2]].pos)) /
+                   3.f;
+  }
+  std::vector<uint32_t> order(bucketTriangles);
+  std::iota(order.begin(), order.end(), 0);
+  const auto chunkRanges = splitChunks(centroids, order, maxChunkTriangles);
+  if (pages.size() + uint64_t(chunkRanges.size()) * lodCount >
+      std::numeric_limits<uint32_t>::max()) {
+    std::cerr << "Paged mesh needs more than 2^32 pages\n";
+    return false;
+  }
+
+  std::vector<std::unordered_map<uint64_t, Cluster>> clusters(lodCount);
+  for (uint32_t lod = 1; lod < lodCount; lod++) {
+    auto &lodClusters = clusters[lod];
+    for (unsigned int i = 0; i < verts.size(); i++) {
+      if (isLocked(i, lod)) {
+        continue;
+      }
+      const Vertex &vertex = verts[i];
+      const glm::vec3 position = toVec3(vertex.pos);
+      Cluster &cluster = lodClusters[getCellKey(position, grid.origin,
+                                                grid.cellSizes[lod])];
+      cluster.position += position;
+      cluster.texCoord += glm::vec3(vertex.texCoord.u, vertex.texCoord.v,
+                                    vertex.texCoord.t);
+      cluster.normal +=
+          glm::vec3(vertex.normal.x, vertex.normal.y, vertex.normal.z);
+      cluster.count++;
+    }
+    for (auto &[key, cluster] : lodClusters) {
+      const glm::vec3 position = cluster.position / float(cluster.count);
+      const glm::vec3 texCoord = cluster.texCoord / float(cluster.count);
+      const float normalLength = glm::length(cluster.normal);
+      const glm::vec3 normal = normalLength > 0.f
+                                   ? cluster.normal / normalLength
+                                   : glm::vec3(0.f, 1.f, 0.f);
+      cluster.vertex = Vertex{{position.x, position.y, position.z},
+                              {texCoord.x, texCoord.y, texCoord.z},
+                              {normal.x, normal.y, normal.z}};
+    }
+  }
+
+  data.clear();
+  ObjData page;
+  std::unordered_map<uint64_t, uint32_t> localIndex;
+  for (const auto &[begin, end] : chunkRanges) {
+    PagedChunk chunk;
+    chunk.bounds = emptyBounds();
+    chunk.firstPage = static_cast<uint32_t>(pages.size());
+    chunk.lodCount = lodCount;
+
+    for (uint32_t lod = 0; lod < lodCount; lod++) {
+      page.verts.clear();
+      page.indicies.clear();
+      localIndex.clear();
+      for (size_t i = begin; i < end; i++) {
+        uint64_t ids[3];
+        for (int corner = 0; corner < 3; corner++) {
+          const unsigned int index = indicies[order[i] * 3 + corner];
+          ids[corner] = isLocked(index, lod)
+                            ? index | ORIGINAL_VERTEX
+                            : getCellKey(toVec3(verts[index].pos),
+                                         grid.origin, grid.cellSizes[lod]);
+        }
+        // Collapsed into a line or a point
+        if (ids[0] == ids[1] || ids[1] == ids[2] || ids[0] == ids[2]) {
+          continue;
+        }
+        for (uint64_t id : ids) {
+          const auto [found, inserted] = localIndex.try_emplace(
+              id, static_cast<uint32_t>(page.verts.size()));
+          if (inserted) {
+            page.verts.push_back((id & ORIGINAL_VERTEX) != 0
+                                     ? verts[id & ~ORIGINAL_VERTEX]
+                                     : clusters[lod].at(id).vertex);
+          }
+          page.indicies.push_back(found->second);
+        }
+      }
+      if (lod == 0) {
+        for (const Vertex &vertex : page.verts) {
+          growBounds(chunk.bounds, toVec3(vertex.pos));
+        }
+        triangleCount += page.indicies.size() / 3;
+      }
+      optimizeVertexCache(page);
+      optimizeVertexFetch(page);
+
+      const std::vector<uint8_t> vertexData = encodeVertexBuffer(
+          page.verts.data(), page.verts.size(), sizeof(Vertex));
+      const std::vector<uint8_t> indexData =
+          encodeIndexBuffer(page.indicies.data(), page.indicies.size());
+
+      PageInfo info;
+      info.offset = dataSize + data.size();
+      info.vertexBytes = static_cast<uint32_t>(vertexData.size());
+      info.indexBytes = static_cast<uint32_t>(indexData.size());
+      info.vertexCount = static_cast<uint32_t>(page.verts.size());
+      info.indexCount = static_cast<uint32_t>(page.indicies.size());
+      info.error = lod == 0 ? 0.f : grid.cellSizes[lod] * std::sqrt(3.f);
+      info.chunk = static_cast<uint32_t>(chunks.size());
+      maxPageVerts = std::max(maxPageVerts, info.vertexCount);
+      maxPageIndices = std::max(maxPageIndices, info.indexCount);
+      pages.push_back(info);
+
+      data.insert(data.end(), vertexData.begin(), vertexData.end());
+      data.insert(data.end(), indexData.begin(), indexData.end());
+      data.resize(alignUp(data.size(), PAGE_ALIGNMENT), 0);
+    }
+    chunks.push_back(chunk);
+  }
+  dataSize += data.size();
+  return true;
+}
+
+std::vector<uint8_t> PagedMeshWriter::writeTables(const Bounds &bounds) const {
+  PagedMeshHeader header{};
+  std::memcpy(header.magic, PAGED_MAGIC, sizeof(PAGED_MAGIC));
+  header.version = PAGED_MESH_FILE_VERSION;
+  header.chunkCount = static_cast<uint32_t>(chunks.size());
+  header.pageCount = static_cast<uint32_t>(pages.size());
+  header.lodCount = lodCount;
+  header.maxPageVerts = maxPageVerts;
+  header.maxPageIndices = maxPageIndices;
+  header.triangleCount = triangleCount;
+  header.bounds = bounds;
+
+  const size_t tablesEnd = sizeof(PagedMeshHeader) +
+                           sizeof(PagedChunk) * chunks.size() +
+                           sizeof(PageInfo) * pages.size();
+  std::vector<uint8_t> out(alignUp(tablesEnd, PAGE_ALIGNMENT), 0);
+  uint8_t *tables = out.data();
+  std::memcpy(tables, &header, sizeof(header));
+  tables += sizeof(header);
+  std::memcpy(tables, chunks.data(), sizeof(PagedChunk) * chunks.size());
+  tables += sizeof(PagedChunk) * chunks.size();
+  for (PageInfo info : pages) {
+    info.offset += out.size();
+    std::memcpy(tables, &info, sizeof(info));
+    tables += sizeof(info);
+  }
+  return out;
+}
+
+std::vector<uint8_t> buildPagedMesh(const ObjData &objData,
+                                    const PagedMeshParams &params) {
+  const std::vector<Vertex> &verts = objData.verts;
+  const std::vector<unsigned int> &indicies = objData.indicies;
+  const size_t triangleCount = indicies.size() / 3;
+  const uint32_t lodCount = getLodCount(params);
+
+  Bounds meshBounds = emptyBounds();
+  for (const Vertex &vertex : verts) {
+    growBounds(meshBounds, toVec3(vertex.pos));
+  }
+  if (verts.empty()) {
+    meshBounds = Bounds{glm::vec3(0.f), glm::vec3(0.f)};
+  }
+  double edgeLength = 0.0;
+  for (size_t t = 0; t < triangleCount; t++) {
+    edgeLength += getEdgeLength(toVec3(verts[indicies[t * 3]].pos),
+                                toVec3(verts[indicies[t * 3 + 1]].pos),
+                                toVec3(verts[indicies[t * 3 + 2]].pos));
+  }
+
+  const LodGrid grid =
+      makeLodGrid(meshBounds, edgeLength, triangleCount, lodCount);
+  PagedMeshWriter writer(grid, lodCount,
+                         std::max<size_t>(params.maxChunkTriangles, 1));
+  std::vector<uint8_t> data;
+  if (!writer.addBucket(objData, {}, data)) {
+    return {};
+  }
+  std::vector<uint8_t> out = writer.writeTables(meshBounds);
+  out.insert(out.end(), data.begin(), data.end());
+  return out;
+}
+
+/**
+ * Staging file of `buildPagedMeshFile`, written first and then read back
+ * from the start. Removed again when it goes out of scope.
+ */
+class ScratchFile {
+private:
+  fs::path path;
+  std::FILE *file;
+
+public:
+  explicit ScratchFile(fs::path path)
+      : path(std::move(path)),
+        file(std::fopen(this->path.string().c_str(), "w+b")) {}
+  ScratchFile(const ScratchFile &) = delete;
+  ScratchFile &operator=(const ScratchFile &) = delete;
+  ~ScratchFile() {
+    if (file != nullptr) {
+      std::fclose(file);
+    }
+    std::error_code error;
+    fs::remove(path, error);
+  }
+
+  inline bool isOpen() const { return file != nullptr; }
+  inline const fs::path &getPath() const { return path; }
+
+  template <typename T> void write(const T *values, size_t count) {
+    std::fwrite(values, sizeof(T), count, file);
+  }
+
+  /**
+   * Switches to reading from the start, false if a write failed.
+   */
+  bool rewind() {
+    return std::fflush(file) == 0 && std::ferror(file) == 0 &&
+           std::fseek(file, 0, SEEK_SET) == 0;
+  }
+
+  template <typename T> size_t read(T *values, size_t count) {
+    return std::fread(values, sizeof(T), count, file);
+  }
+};
+
+/**
+ * Triangles, three corners each, whose centroid falls into `cells`, and the
+ * positions of vertices inside `cells` that triangles of other buckets use.
+ */
+struct Bucket {
+  CellBox cells;
+  uint64_t triangleCount = 0;
+  uint64_t sharedCount = 0;
+  std::unique_ptr<ScratchFile> triangles;
+  std::unique_ptr<ScratchFile> shared;
+};
+
+static std::unique_ptr<Bucket> createBucket(const fs::path &scratchDir,
+                                            uint64_t &nextId) {
+  const std::string name = std::to_string(nextId++);
+  auto bucket = std::make_unique<Bucket>();
+  bucket->triangles = std::make_unique<ScratchFile>(scratchDir / (name + ".t"));
+  bucket->shared = std::make_unique<ScratchFile>(scratchDir / (name + ".s"));
+  if (!bucket->triangles->isOpen() || !bucket->shared->isOpen()) {
+    std::cerr << "Failed to create scratch files in '" << scratchDir.string()
+              << "'\n";
+    return nullptr;
+  }
+  return bucket;
+}
+
+static inline bool isBlank(char c) { return c == ' ' || c == '\t'; }
+
+static inline const char *skipBlanks(const char *p, const char *end) {
+  while (p < end && isBlank(*p)) {
+    p++;
+  }
+  return p;
+}
+
+/**
+ * Calls `parseLine(line, lineEnd)` for every line of the file at `path`,
+ * reading it a block at a time. The character at `lineEnd` is never part of
+ * a number. Stops at the first line it returns false for.
+ */
+template <typename Fn>
+static bool forEachLine(const fs::path &path, Fn &&parseLine) {
+  std::FILE *file = std::fopen(path.string().c_str(), "rb");
+  if (file == nullptr) {
+    std::cerr << "Failed to open file '" << path.string() << "'\n";
+    return false;
+  }
+
+  // One spare byte for the '\0' after the last line
+  std::vector<char> buffer(STREAM_BLOCK_SIZE + 1);
+  size_t kept = 0;
+  bool ok = true;
+  bool done = false;
+  while (ok && !done) {
+    // A line longer than the whole buffer
+    if (kept == buffer.size() - 1) {
+      buffer.resize(buffer.size() * 2);
+    }
+    const size_t read =
+        std::fread(buffer.data() + kept, 1, buffer.size() - 1 - kept, file);
+    done = read == 0;
+    char *const begin = buffer.data();
+    char *const end = begin + kept + read;
+    char *complete = end;
+    if (done) {
+      *end = '\0';
+    } else {
+      while (complete > begin && complete[-1] != '\n') {
+        complete--;
+      }
+    }
+
+    for (char *p = begin; ok && p < complete;) {
+      char *lineEnd =
+          static_cast<char *>(std::memchr(p, '\n', complete - p));
+      char *next = lineEnd == nullptr ? complete : lineEnd + 1;
+      if (lineEnd == nullptr) {
+        lineEnd = complete;
+      }
+      if (lineEnd > p && lineEnd[-1] == '\r') {
+        lineEnd--;
+      }
+      ok = parseLine(p, lineEnd);
+      p = next;
+    }
+    kept = end - complete;
+    std::memmove(begin, complete, kept);
+  }
+
+  const bool failed = std::ferror(file) != 0;
+  std::fclose(file);
+  if (failed) {
+    std::cerr << "Failed to read file '" << path.string() << "'\n";
+  }
+  return ok && !failed;
+}
+
+/**
+ * Which attribute a line holds, 0 for `v`, 1 for `vt`, 2 for `vn` and -1
+ * for anything else.
+ */
+static inline int getAttribute(const char *line, const char *lineEnd) {
+  if (lineEnd - line < 2 || line[0] != 'v') {
+    return -1;
+  }
+  if (isBlank(line[1])) {
+    return 0;
+  }
+  if (lineEnd - line < 3 || !isBlank(line[2])) {
+    return -1;
+  }
+  return line[1] == 't' ? 1 : line[1] == 'n' ? 2 : -1;
+}
+
+/**
+ * Parses up to `count` floats, returns how many there were.
+ */
+static int parseFloats(const char *p, const char *end, float *values,
+                       int count) {
+  int parsed = 0;
+  for (; parsed < count; parsed++) {
+    p = skipBlanks(p, end);
+    if (p == end) {
+      break;
+    }
+    char *numEnd;
+    values[parsed] = std::strtof(p, &numEnd);
+    if (numEnd == p || numEnd > end) {
+      break;
+    }
+    p = numEnd;
+  }
+  return parsed;
+}
+
+/**
+ * 1 based `v`, `vt` and `vn` indices of one face corner, 0 when missing.
+ */
+struct FaceCorner {
+  uint64_t indices[3];
+};
+
+/**
+ * OBJ indices are 1 based, negative ones count back from the latest element.
+ * Returns 0 for an out of range index.
+ */
+static inline uint64_t resolveIndex(long long index, uint64_t count) {
+  if (index < 0) {
+    index += static_cast<long long>(count) + 1;
+  }
+  if (index <= 0 || static_cast<uint64_t>(index) > count) {
+    return 0;
+  }
+  return static_cast<uint64_t>(index);
+}
+
+/**
+ * Parses the `v`, `v/vt`, `v//vn` or `v/vt/vn` corners of an `f` line.
+ * `counts` are the attributes seen before the line.
+ */
+static bool parseFaceCorners(const char *p, const char *end,
+                             const uint64_t counts[3],
+                             std::vector<FaceCorner> &corners) {
+  corners.clear();
+  // Skip 'f'
+  p += 1;
+  for (p = skipBlanks(p, end); p < end && *p != '#'; p = skipBlanks(p, end)) {
+    FaceCorner corner{};
+    for (int attribute = 0; attribute < 3; attribute++) {
+      if (attribute > 0) {
+        if (p == end || *p != '/') {
+          break;
+        }
+        p++;
+        if (attribute == 1 && p < end && *p == '/') {
+          continue;
+        }
+      }
+      char *numEnd;
+      const long long index = std::strtoll(p, &numEnd, 10);
+      if (numEnd == p || numEnd > end) {
+        return false;
+      }
+      corner.indices[attribute] = resolveIndex(index, counts[attribute]);
+      if (corner.indices[attribute] == 0) {
+        return false;
+      }
+      p = numEnd;
+    }
+    if (p < end && !isBlank(*p) && *p != '#') {
+      return false;
+    }
+    corners.push_back(corner);
+  }
+  return corners.size() >= 3;
+}
+
+/**
+ * Maps a staged attribute file, nothing for an empty one.
+ */
+static bool mapAttribute(ScratchFile &file, uint64_t count, size_t stride,
+                         std::optional<MappedFile> &mapping) {
+  if (!file.rewind()) {
+    return false;
+  }
+  if (count == 0) {
+    return true;
+  }
+  mapping = MappedFile::open(file.getPath().string().c_str());
+  return mapping.has_value() && mapping->getSize() == count * stride;
+}
+
+/**
+ * Moves the triangles and shared positions of `bucket` into its octants,
+ * halving every axis wider than one cell. Where a triangle of one octant
+ * uses a vertex inside another, that octant records it as shared.
+ */
+static bool splitBucket(Bucket &bucket, const LodGrid &grid,
+                        const fs::path &scratchDir, uint64_t &nextId,
+                        std::vector<std::unique_ptr<Bucket>> &stack) {
+  const CellBox &cells = bucket.cells;
+  int64_t middle[3];
+  for (int axis = 0; axis < 3; axis++) {
+    middle[axis] = cells.max[axis] - cells.min[axis] > 1
+                       ? (cells.min[axis] + cells.max[axis]) / 2
+                       : cells.max[axis];
+  }
+  auto getOctant = [&](const int64_t cell[3]) {
+    int octant = 0;
+    for (int axis = 0; axis < 3; axis++) {
+      octant |= (cell[axis] >= middle[axis] ? 1 : 0) << axis;
+    }
+    return octant;
+  };
+
+  std::unique_ptr<Bucket> octants[8];
+  for (int octant = 0; octant < 8; octant++) {
+    CellBox box;
+    bool empty = false;
+    for (int axis = 0; axis < 3; axis++) {
+      const bool upper = (octant >> axis & 1) != 0;
+      box.min[axis] = upper ? middle[axis] : cells.min[axis];
+      box.max[axis] = upper ? cells.max[axis] : middle[axis];
+      empty = empty || box.min[axis] == box.max[axis];
+    }
+    if (empty) {
+      continue;
+    }
+    octants[octant] = createBucket(scratchDir, nextId);
+    if (octants[octant] == nullptr) {
+      return false;
+    }
+    octants[octant]->cells = box;
+  }
+
+  if (!bucket.triangles->rewind() || !bucket.shared->rewind()) {
+    std::cerr << "Failed to write scratch files\n";
+    return false;
+  }
+  std::vector<Vertex> block(3 * SPLIT_BLOCK_TRIANGLES);
+  uint64_t moved = 0;
+  while (size_t read = bucket.triangles->read(block.data(), block.size())) {
+    for (size_t t = 0; t + 3 <= read; t += 3) {
+      const Vertex *triangle = &block[t];
+      const glm::vec3 centroid =
+          (toVec3(triangle[0].pos) + toVec3(triangle[1].pos) +
+           toVec3(triangle[2].pos)) /
+          3.f;
+      int64_t cell[3];
+      getBucketCell(grid, centroid, cell);
+      for (int axis = 0; axis < 3; axis++) {
+        cell[axis] =
+            std::clamp(cell[axis], cells.min[axis], cells.max[axis] - 1);
+      }
+      const int owner = getOctant(cell);
+      octants[owner]->triangles->write(triangle, 3);
+      octants[owner]->triangleCount++;
+
+      for (int corner = 0; corner < 3; corner++) {
+        getBucketCell(grid, toVec3(triangle[corner].pos), cell);
+        const int octant = getOctant(cell);
+        if (cells.contains(cell) && octant != owner) {
+          octants[octant]->shared->write(&triangle[corner].pos, 1);
+          octants[octant]->sharedCount++;
+        }
+      }
+    }
+    moved += read / 3;
+  }
+
+  std::vector<VertPos> positions(SPLIT_BLOCK_TRIANGLES);
+  while (size_t read = bucket.shared->read(positions.data(),
+                                           positions.size())) {
+    for (size_t i = 0; i < read; i++) {
+      int64_t cell[3];
+      getBucketCell(grid, toVec3(positions[i]), cell);
+      if (cells.contains(cell)) {
+        octants[getOctant(cell)]->shared->write(&positions[i], 1);
+        octants[getOctant(cell)]->sharedCount++;
+      }
+    }
+  }
+  if (moved != bucket.triangleCount) {
+    std::cerr << "Failed to read scratch files\n";
+    return false;
+  }
+
+  // Reversed, so the first octant comes off the stack first
+  for (int octant = 7; octant >= 0; octant--) {
+    if (octants[octant] != nullptr && octants[octant]->triangleCount > 0) {
+      stack.push_back(std::move(octants[octant]));
+    }
+  }
+  return true;
+}
+
+/**
+ * Welds the triangles of `bucket` and adds them to `writer`. Vertices
+ * outside its cells or at a shared position are locked, so both sides of a
+ * seam between buckets keep the same original vertices.
+ */
+static bool buildBucket(Bucket &bucket, const LodGrid &grid,
+                        PagedMeshWriter &writer, std::vector<uint8_t> &data) {
+  std::vector<Vertex> corners(bucket.triangleCount * 3);
+  std::vector<VertPos> shared(bucket.sharedCount);
+  if (!bucket.triangles->rewind() || !bucket.shared->rewind() ||
+      bucket.triangles->read(corners.data(), corners.size()) !=
+          corners.size() ||
+      bucket.shared->read(shared.data(), shared.size()) != shared.size()) {
+    std::cerr << "Failed to read scratch files\n";
+    return false;
+  }
+
+  const std::unordered_set<VertPos, BytesHash<VertPos>, BytesEqual<VertPos>>
+      sharedPositions(shared.begin(), shared.end());
+  shared = {};
+
+  ObjData objData;
+  std::unordered_map<Vertex, uint32_t, BytesHash<Vertex>, BytesEqual<Vertex>>
+      uniqueVerts;
+  objData.indicies.reserve(corners.size());
+  for (const Vertex &vertex : corners) {
+    const auto [found, inserted] = uniqueVerts.try_emplace(
+        vertex, static_cast<uint32_t>(objData.verts.size()));
+    if (inserted) {
+      objData.verts.push_back(vertex);
+    }
+    objData.indicies.push_back(found->second);
+  }
+  corners = {};
+  uniqueVerts = {};
+
+  std::vector<uint8_t> locked(objData.verts.size(), 0);
+  for (size_t i = 0; i < objData.verts.size(); i++) {
+    const VertPos &position = objData.verts[i].pos;
+    int64_t cell[3];
+    getBucketCell(grid, toVec3(position), cell);
+    locked[i] =
+        !bucket.cells.contains(cell) || sharedPositions.count(position) != 0;
+  }
+  return writer.addBucket(objData, locked, data);
+}
+
+std::optional<PagedBuildStats>
+buildPagedMeshFile(const fs::path &objPath, const fs::path &outPath,
+                   const PagedMeshParams &params) {
+  const uint32_t lodCount = getLodCount(params);
+  const uint64_t maxBucketTriangles =
+      std::max<uint64_t>(params.maxBucketTriangles, 1);
+  PagedBuildStats stats;
+
+  // Staged next to the output, which has to have room for it anyway
+  const fs::path scratchDir = fs::path(outPath).concat(".parts");
+  std::error_code error;
+  fs::create_directories(scratchDir, error);
+  if (error) {
+    std::cerr << "Failed to create '" << scratchDir.string() << "'\n";
+    return {};
+  }
+  struct RemoveOnExit {
+    const fs::path &path;
+    ~RemoveOnExit() {
+      std::error_code error;
+      fs::remove_all(path, error);
+    }
+  } removeScratchDir{scratchDir};
+
+  uint64_t nextId = 0;
+  std::unique_ptr<Bucket> root = createBucket(scratchDir, nextId);
+  if (root == nullptr) {
+    return {};
+  }
+  Bounds bounds = emptyBounds();
+  double edgeLength = 0.0;
+  {
+    // Faces may use any attribute before them, so the first pass stages
+    // every attribute in a file and the second maps them
+    ScratchFile attributeFiles[3] = {ScratchFile(scratchDir / "v"),
+                                     ScratchFile(scratchDir / "vt"),
+                                     ScratchFile(scratchDir / "vn")};
+    const size_t strides[3] = {sizeof(VertPos), sizeof(TexCoord),
+                               sizeof(VertNormal)};
+    uint64_t counts[3] = {};
+    uint64_t lineNumber = 0;
+    auto reportLine = [&] {
+      std::cerr << "Error at line " << lineNumber << " of '"
+                << objPath.string() << "'\n";
+      return false;
+    };
+    bool ok = forEachLine(objPath, [&](const char *line, const char *end) {
+      lineNumber++;
+      const int attribute = getAttribute(line, end);
+      if (attribute < 0) {
+        return true;
+      }
+      // Texture coordinates have an optional third value, ignored like the
+      // in memory loader does
+      float values[3] = {};
+      const int expected = attribute == 1 ? 2 : 3;
+      if (parseFloats(line + (attribute == 0 ? 1 : 2), end, values,
+                      expected) != expected) {
+        return reportLine();
+      }
+      attributeFiles[attribute].write(values, 3);
+      counts[attribute]++;
+      return true;
+    });
+
+    std::optional<MappedFile> mappings[3];
+    for (int attribute = 0; ok && attribute < 3; attribute++) {
+      if (!mapAttribute(attributeFiles[attribute], counts[attribute],
+                        strides[attribute], mappings[attribute])) {
+        std::cerr << "Failed to stage attributes in '" << scratchDir.string()
+                  << "'\n";
+        ok = false;
+      }
+    }
+    if (!ok) {
+      return {};
+    }
+    auto getAttributeData = [&](int attribute) -> const uint8_t * {
+      return mappings[attribute].has_value() ? mappings[attribute]->data()
+                                             : nullptr;
+    };
+    const VertPos *positions =
+        reinterpret_cast<const VertPos *>(getAttributeData(0));
+    const TexCoord *texCoords =
+        reinterpret_cast<const TexCoord *>(getAttributeData(1));
+    const VertNormal *normals =
+        reinterpret_cast<const VertNormal *>(getAttributeData(2));
+
+    uint64_t seen[3] = {};
+    lineNumber = 0;
+    std::vector<FaceCorner> corners;
+    ok = forEachLine(objPath, [&](const char *line, const char *end) {
+      lineNumber++;
+      const int attribute = getAttribute(line, end);
+      if (attribute >= 0) {
+        seen[attribute]++;
+        return true;
+      }
+      if (end - line < 2 || line[0] != 'f' || !isBlank(line[1])) {
+        return true;
+      }
+      if (!parseFaceCorners(line, end, seen, corners)) {
+        return reportLine();
+      }
+      for (size_t i = 1; i + 1 < corners.size(); i++) {
+        const FaceCorner *fan[3] = {&corners[0], &corners[i],
+                                    &corners[i + 1]};
+        Vertex triangle[3];
+        for (int corner = 0; corner < 3; corner++) {
+          const uint64_t *indices = fan[corner]->indices;
+          triangle[corner] = Vertex{
+              positions[indices[0] - 1],
+              indices[1] != 0 ? texCoords[indices[1] - 1] : TexCoord{},
+              indices[2] != 0 ? normals[indices[2] - 1] : VertNormal{}};
+          growBounds(bounds, toVec3(triangle[corner].pos));
+        }
+        edgeLength += getEdgeLength(toVec3(triangle[0].pos),
+                                    toVec3(triangle[1].pos),
+                                    toVec3(triangle[2].pos));
+        root->triangles->write(triangle, 3);
+        root->triangleCount++;
+      }
+      return true;
+    });
+    if (!ok) {
+      return {};
+    }
+  }
+  stats.triangleCount = root->triangleCount;
+  if (root->triangleCount == 0) {
+    bounds = Bounds{glm::vec3(0.f), glm::vec3(0.f)};
+  }
+
+  const LodGrid grid =
+      makeLodGrid(bounds, edgeLength, root->triangleCount, lodCount);
+  int64_t lastCell[3];
+  getBucketCell(grid, bounds.max, lastCell);
+  for (int axis = 0; axis < 3; axis++) {
+    root->cells.min[axis] = 0;
+    root->cells.max[axis] = lastCell[axis] + 1;
+  }
+
+  PagedMeshWriter writer(grid, lodCount,
+                         std::max<size_t>(params.maxChunkTriangles, 1));
+  ScratchFile pageFile(scratchDir / "pages");
+  if (!pageFile.isOpen()) {
+    std::cerr << "Failed to create scratch files in '" << scratchDir.string()
+              << "'\n";
+    return {};
+  }
+  std::vector<std::unique_ptr<Bucket>> stack;
+  if (root->triangleCount > 0) {
+    stack.push_back(std::move(root));
+  }
+  std::vector<uint8_t> data;
+  while (!stack.empty()) {
+    std::unique_ptr<Bucket> bucket = std::move(stack.back());
+    stack.pop_back();
+    const CellBox &cells = bucket->cells;
+    const bool splittable = cells.max[0] - cells.min[0] > 1 ||
+                            cells.max[1] - cells.min[1] > 1 ||
+                            cells.max[2] - cells.min[2] > 1;
+    if (bucket->triangleCount > maxBucketTriangles && splittable) {
+      if (!splitBucket(*bucket, grid, scratchDir, nextId, stack)) {
+        return {};
+      }
+      continue;
+    }
+    if (!buildBucket(*bucket, grid, writer, data)) {
+      return {};
+    }
+    pageFile.write(data.data(), data.size());
+    stats.bucketCount++;
+    stats.largestBucket = std::max(stats.largestBucket, bucket->triangleCount);
+  }
+
+  // Readers never see a half written file
+  const std::vector<uint8_t> tables = writer.writeTables(bounds);
+  const fs::path temporary = fs::path(outPath).concat(".tmp");
+  std::FILE *out = std::fopen(temporary.string().c_str(), "wb");
+  bool written = out != nullptr && pageFile.rewind();
+  if (out != nullptr) {
+    written = written && std::fwrite(tables.data(), 1, tables.size(), out) ==
+                             tables.size();
+    std::vector<uint8_t> block(STREAM_BLOCK_SIZE);
+    uint64_t copied = 0;
+    while (size_t read = pageFile.read(block.data(), block.size())) {
+      written = written && std::fwrite(block.data(), 1, read, out) == read;
+      copied += read;
+    }
+    written = written && copied == writer.getDataSize();
+    written = std::fclose(out) == 0 && written;
+  }
+  if (written) {
+    fs::rename(temporary, outPath, error);
+  }
+  if (!written || error) {
+    std::cerr << "Failed to write '" << outPath.string() << "'\n";
+    fs::remove(temporary, error);
+    return {};
+  }
+  stats.fileBytes = tables.size() + writer.getDataSize();
+  return stats;
+}
+
+std::optional<PagedMesh> PagedMesh::open(const char *path) {
+  std::optional<MappedFile> file = MappedFile::open(path);
+  if (!file.has_value() || file->getSize() < sizeof(PagedMeshHeader)) {
+    return {};
+  }
+  const uint8_t *bytes = file->data();
+  const size_t size = file->getSize();
+
+  PagedMeshHeader header;
+  std::memcpy(&header, bytes, sizeof(header));
+  if (std::memcmp(header.magic, PAGED_MAGIC, sizeof(PAGED_MAGIC)) != 0 ||
+      header.version != PAGED_MESH_FILE_VERSION || header.lodCount == 0) {
+    return {};
+  }
+  const uint64_t tablesEnd =
+      sizeof(header) + uint64_t(sizeof(PagedChunk)) * header.chunkCount +
+      uint64_t(sizeof(PageInfo)) * header.pageCount;
+  if (tablesEnd > size) {
+    return {};
+  }
+
+  PagedMesh pagedMesh;
+  pagedMesh.bounds = header.bounds;
+  pagedMesh.triangleCount = header.triangleCount;
+  pagedMesh.lodCount = header.lodCount;
+  pagedMesh.maxPageVerts = header.maxPageVerts;
+  pagedMesh.maxPageIndices = header.maxPageIndices;
+  pagedMesh.chunks.resize(header.chunkCount);
+  pagedMesh.pages.resize(header.pageCount);
+  const uint8_t *tables = bytes + sizeof(header);
+  std::memcpy(pagedMesh.chunks.data(), tables,
+              sizeof(PagedChunk) * header.chunkCount);
+  tables += sizeof(PagedChunk) * header.chunkCount;
+  std::memcpy(pagedMesh.pages.data(), tables,
+              sizeof(PageInfo) * header.pageCount);
+
+  // Every chunk has at least one page, residency picks one of them
+  for (const PagedChunk &chunk : pagedMesh.chunks) {
+    if (chunk.lodCount == 0 || chunk.lodCount > header.lodCount ||
+        uint64_t(chunk.firstPage) + chunk.lodCount > header.pageCount) {
+      return {};
+    }
+  }
+  for (const PageInfo &page : pagedMesh.pages) {
+    const bool fits = page.offset <= size &&
+                      uint64_t(page.vertexBytes) + page.indexBytes <=
+                          size - page.offset;
+    if (!fits || page.vertexCount > header.maxPageVerts ||
+        page.indexCount > header.maxPageIndices) {
+      return {};
+    }
+  }
+
+  pagedMesh.file = std::move(*file);
+  return pagedMesh;
+}
+
+bool PagedMesh::decodePage(uint32_t page, Vertex *verts,
+                           uint32_t *indices) const {
+  if (page >= pages.size()) {
+    return false;
+  }
+  const PageInfo &info = pages[page];
+  const uint8_t *data = file.data() + info.offset;
+  if (!decodeVertexBuffer(verts, info.vertexCount, sizeof(Vertex), data,
+                          info.vertexBytes) ||
+      !decodeIndexBuffer(indices, info.indexCount, data + info.vertexBytes,
+                         info.indexBytes)) {
+    return false;
+  }
+  // The indices go straight to the GPU
+  return std::all_of(indices, indices + info.indexCount,
+                     [&](uint32_t index) { return index < info.vertexCount; });
+}
+} // namespace ofyaGl
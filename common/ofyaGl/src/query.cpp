@@ -0,0 +1,61 @@
+#include <ofyaGl/query.h>
+
+#include <ofyaGl/gl.h>
+
+namespace ofyaGl {
+
+FragmentCounter::FragmentCounter() {
+  GL_CALL(glGenQueries(QUERY_COUNT, queries));
+}
+
+void FragmentCounter::poll() {
+  // `next` is the oldest in flight, going from it reads them in order and
+  // `lastCount` ends on the newest finished frame
+  for (size_t i = 0; i < QUERY_COUNT; i++) {
+    size_t slot = (next + i) % QUERY_COUNT;
+    if (!pending[slot]) {
+      continue;
+    }
+    GLuint available = GL_FALSE;
+    GL_CALL(glGetQueryObjectuiv(queries[slot], GL_QUERY_RESULT_AVAILABLE,
+                                &available));
+    if (available == GL_FALSE) {
+      // Queries finish in order, the later ones are not ready either
+      break;
+    }
+    GLuint64 samples = 0;
+    GL_CALL(glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &samples));
+    lastCount = samples;
+    resultCount++;
+    pending[slot] = false;
+  }
+}
+
+void FragmentCounter::begin() {
+  poll();
+  if (pending[next]) {
+    // GPU is more than a ring behind, skip this frame instead of stalling
+    return;
+  }
+  GL_CALL(glBeginQuery(GL_SAMPLES_PASSED, queries[next]));
+  counting = true;
+}
+
+void FragmentCounter::end() {
+  if (!counting) {
+    return;
+  }
+  GL_CALL(glEndQuery(GL_SAMPLES_PASSED));
+  pending[next] = true;
+  next = (next + 1) % QUERY_COUNT;
+  counting = false;
+}
+
+void FragmentCounter::destroy() {
+  GL_CALL(glDeleteQueries(QUERY_COUNT, queries));
+  for (size_t i = 0; i < QUERY_COUNT; i++) {
+    queries[i] = 0;
+    pending[i] = false;
+  }
+}
+} // namespace ofyaGl
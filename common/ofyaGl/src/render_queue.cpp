@@ -0,0 +1,182 @@
+#include <ofyaGl/render_queue.h>
+
+#include <ofyaGl/gl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+
+namespace ofyaGl {
+
+constexpr uint64_t DEPTH_MAX = (1u << 20) - 1;
+
+static std::atomic<uint64_t> nextQueueId{1};
+
+/**
+ * Last buffer the thread recorded into, most threads only ever record into
+ * one queue so this skips the lookup.
+ */
+struct ThreadBufferCache {
+  uint64_t queueId = 0;
+  std::vector<DrawPacket> *buffer = nullptr;
+};
+
+static thread_local ThreadBufferCache tlsBuffer;
+
+/**
+ * Buffer index per thread and queue, only touched on a cache miss.
+ */
+static thread_local std::unordered_map<uint64_t, std::vector<DrawPacket> *>
+    tlsBuffers;
+
+uint64_t makeSortKey(uint32_t pass, GLuint program, uint32_t material,
+                     GLuint vao, float depth, DepthOrder order) {
+  const uint64_t depthBits =
+      static_cast<uint64_t>(std::clamp(depth, 0.f, 1.f) * DEPTH_MAX);
+  const uint64_t passBits = static_cast<uint64_t>(pass & 0xf) << 60;
+  const uint64_t programBits = program & 0xfff;
+  const uint64_t materialBits = material & 0xffff;
+  const uint64_t vaoBits = vao & 0xfff;
+
+  if (order == DepthOrder::BackToFront) {
+    return passBits | (DEPTH_MAX - depthBits) << 40 | programBits << 28 |
+           materialBits << 12 | vaoBits;
+  }
+  return passBits | programBits << 48 | materialBits << 32 | vaoBits << 20 |
+         depthBits;
+}
+
+RenderQueue::RenderQueue() : id(nextQueueId.fetch_add(1)) {}
+
+std::vector<DrawPacket> &RenderQueue::getThreadBuffer() {
+  if (tlsBuffer.queueId == id) {
+    return *tlsBuffer.buffer;
+  }
+
+  std::vector<DrawPacket> *&buffer = tlsBuffers[id];
+  if (buffer == nullptr) {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    buffers.push_back(std::make_unique<std::vector<DrawPacket>>());
+    buffer = buffers.back().get();
+  }
+  tlsBuffer = ThreadBufferCache{id, buffer};
+  return *buffer;
+}
+
+void RenderQueue::submit(const DrawPacket &packet) {
+  getThreadBuffer().push_back(packet);
+}
+
+void RenderQueue::sortEntries() {
+  // Least significant digit first, one byte at a time. All eight histograms
+  // come out of one read, and digits every key shares are skipped, which
+  // typically drops the pass and some program bits.
+  constexpr int DIGITS = 8;
+  size_t counts[DIGITS][256] = {};
+  for (const SortEntry &entry : entries) {
+    for (int digit = 0; digit < DIGITS; digit++) {
+      counts[digit][(entry.key >> (8 * digit)) & 0xff]++;
+    }
+  }
+
+  scratch.resize(entries.size());
+  for (int digit = 0; digit < DIGITS; digit++) {
+    size_t *count = counts[digit];
+    if (count[(entries[0].key >> (8 * digit)) & 0xff] == entries.size()) {
+      continue;
+    }
+
+    size_t offset = 0;
+    for (int bucket = 0; bucket < 256; bucket++) {
+      const size_t bucketSize = count[bucket];
+      count[bucket] = offset;
+      offset += bucketSize;
+    }
+    for (const SortEntry &entry : entries) {
+      scratch[count[(entry.key >> (8 * digit)) & 0xff]++] = entry;
+    }
+    entries.swap(scratch);
+  }
+}
+
+void RenderQueue::execute(const Callbacks &callbacks) {
+  stats = Stats{};
+
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  entries.clear();
+  for (uint32_t buffer = 0; buffer < buffers.size(); buffer++) {
+    const std::vector<DrawPacket> &packets = *buffers[buffer];
+    for (uint32_t packet = 0; packet < packets.size(); packet++) {
+      entries.push_back(SortEntry{packets[packet].key, buffer, packet});
+    }
+  }
+  if (entries.empty()) {
+    return;
+  }
+  sortEntries();
+
+  bool first = true;
+  uint32_t pass = 0;
+  GLuint program = 0;
+  uint32_t material = 0;
+  GLuint vao = 0;
+  for (const SortEntry &entry : entries) {
+    const DrawPacket &packet = (*buffers[entry.buffer])[entry.packet];
+
+    const uint32_t packetPass = getSortKeyPass(packet.key);
+    if (first || packetPass != pass) {
+      pass = packetPass;
+      stats.passChanges++;
+      if (callbacks.onPass) {
+        callbacks.onPass(pass);
+      }
+    }
+
+    const bool programChanged = first || packet.program != program;
+    if (programChanged) {
+      program = packet.program;
+      stats.programChanges++;
+      GL_CALL(glUseProgram(program));
+      if (callbacks.onProgram) {
+        callbacks.onProgram(program);
+      }
+    }
+
+    // Material uniforms live in the program, a new program needs them again
+    if (programChanged || packet.material != material) {
+      material = packet.material;
+      stats.materialChanges++;
+      if (callbacks.onMaterial) {
+        callbacks.onMaterial(program, material);
+      }
+    }
+
+    if (first || packet.vao != vao) {
+      vao = packet.vao;
+      stats.vaoChanges++;
+      GL_CALL(glBindVertexArray(vao));
+    }
+
+    if (callbacks.onDraw) {
+      callbacks.onDraw(packet);
+    }
+    GL_CALL(glDrawElements(
+        GL_TRIANGLES, static_cast<GLsizei>(packet.indexCount), GL_UNSIGNED_INT,
+        (GLvoid *)(sizeof(unsigned int) * packet.indexOffset)));
+    first = false;
+  }
+  stats.packets = entries.size();
+
+  for (auto &buffer : buffers) {
+    buffer->clear();
+  }
+}
+
+void RenderQueue::clear() {
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  for (auto &buffer : buffers) {
+    buffer->clear();
+  }
+}
+} // namespace ofyaGl
@@ -0,0 +1,291 @@
+#include <ofyaGl/residency.h>
+
+#include <ofyaGl/memory.h>
+
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <iterator>
+#include <limits>
+
+namespace ofyaGl {
+
+/**
+ * True if `bounds` lies completely behind one of the frustum planes of
+ * `modelViewProjection`.
+ */
+static bool isOutsideFrustum(const glm::mat4 &modelViewProjection,
+                             const Bounds &bounds) {
+  const glm::mat4 rows = glm::transpose(modelViewProjection);
+  const glm::vec4 planes[6] = {rows[3] + rows[0], rows[3] - rows[0],
+                               rows[3] + rows[1], rows[3] - rows[1],
+                               rows[3] + rows[2], rows[3] - rows[2]};
+  for (const glm::vec4 &plane : planes) {
+    // The corner furthest along the plane normal
+    const glm::vec3 corner(plane.x > 0.f ? bounds.max.x : bounds.min.x,
+                           plane.y > 0.f ? bounds.max.y : bounds.min.y,
+                           plane.z > 0.f ? bounds.max.z : bounds.min.z);
+    if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.f) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static float getDistance(const Bounds &bounds, const glm::vec3 &point) {
+  const glm::vec3 outside = glm::max(
+      glm::max(bounds.min - point, point - bounds.max), glm::vec3(0.f));
+  return glm::length(outside);
+}
+
+ResidencyManager::ResidencyManager(const PagedMesh &pagedMesh,
+                                   const ResidencyParams &params,
+                                   JobSystem &jobSystem)
+    : pagedMesh(pagedMesh), jobSystem(jobSystem), params(params),
+      slots(std::max<size_t>(params.slotCount, 1)),
+      pageSlots(pagedMesh.getPages().size(), NO_SLOT),
+      pageLoading(pagedMesh.getPages().size(), false) {
+  pool = Mesh::allocate(slots.size() * pagedMesh.getMaxPageVerts(),
+                        slots.size() * pagedMesh.getMaxPageIndices());
+  pool.setLabel("paged geometry pool");
+}
+
+ResidencyManager::~ResidencyManager() {
+  // Loads reference this manager, let them drain first
+  jobSystem.waitAll(loads);
+  dropQueuedPages();
+}
+
+void ResidencyManager::dropQueuedPages() {
+  std::lock_guard<std::mutex> lock(completedMutex);
+  for (auto *queue : {&completed, &uploadQueue}) {
+    for (const LoadedPage &loadedPage : *queue) {
+      MemoryTracker::shared().remove(
+          MemoryCategory::MeshStaging,
+          sizeof(Vertex) * loadedPage.verts.size() +
+              sizeof(uint32_t) * loadedPage.indices.size());
+      pageLoading[loadedPage.page] = false;
+    }
+    queue->clear();
+  }
+  stats.loadsInFlight = 0;
+}
+
+void ResidencyManager::load(uint32_t page) {
+  pageLoading[page] = true;
+  stats.loadsInFlight++;
+  loads.push_back(jobSystem.submit([this, page] {
+    const PageInfo &info = pagedMesh.getPages()[page];
+    LoadedPage loadedPage{page, false, std::vector<Vertex>(info.vertexCount),
+                          std::vector<uint32_t>(info.indexCount)};
+    loadedPage.valid = pagedMesh.decodePage(page, loadedPage.verts.data(),
+                                            loadedPage.indices.data());
+    MemoryTracker::shared().add(MemoryCategory::MeshStaging,
+                                sizeof(Vertex) * info.vertexCount +
+                                    sizeof(uint32_t) * info.indexCount);
+
+    std::lock_guard<std::mutex> lock(completedMutex);
+    completed.push_back(std::move(loadedPage));
+  }));
+}
+
+uint32_t ResidencyManager::acquireSlot() {
+  uint32_t oldest = NO_SLOT;
+  for (uint32_t i = 0; i < slots.size(); i++) {
+    if (slots[i].page == NO_SLOT) {
+      return i;
+    }
+    if (slots[i].lastUsed <= completedFrame &&
+        (oldest == NO_SLOT || slots[i].lastUsed < slots[oldest].lastUsed)) {
+      oldest = i;
+    }
+  }
+  if (oldest != NO_SLOT) {
+    pageSlots[slots[oldest].page] = NO_SLOT;
+    slots[oldest].page = NO_SLOT;
+    stats.pagesEvicted++;
+    stats.residentPages--;
+  }
+  return oldest;
+}
+
+void ResidencyManager::upload(LoadedPage &loadedPage) {
+  stats.loadsInFlight--;
+  MemoryTracker::shared().remove(
+      MemoryCategory::MeshStaging,
+      sizeof(Vertex) * loadedPage.verts.size() +
+          sizeof(uint32_t) * loadedPage.indices.size());
+  if (!loadedPage.valid) {
+    // Stays marked as loading, so a corrupt page is only tried once
+    std::cerr << "Failed to decode page " << loadedPage.page << "\n";
+    return;
+  }
+  pageLoading[loadedPage.page] = false;
+
+  const uint32_t slot = acquireSlot();
+  if (slot == NO_SLOT) {
+    stats.pagesDropped++;
+    return;
+  }
+  pool.uploadVerts(loadedPage.verts.data(),
+                   slot * size_t(pagedMesh.getMaxPageVerts()),
+                   loadedPage.verts.size());
+  pool.uploadIndicies(loadedPage.indices.data(),
+                      slot * size_t(pagedMesh.getMaxPageIndices()),
+                      loadedPage.indices.size());
+  slots[slot] = Slot{loadedPage.page, frame};
+  pageSlots[loadedPage.page] = slot;
+  stats.residentPages++;
+  stats.pagesLoaded++;
+}
+
+uint32_t ResidencyManager::findResidentPage(const PagedChunk &chunk,
+                                            uint32_t lod) const {
+  for (uint32_t step = 1; step < chunk.lodCount; step++) {
+    if (lod >= step && pageSlots[chunk.firstPage + lod - step] != NO_SLOT) {
+      return chunk.firstPage + lod - step;
+    }
+    if (lod + step < chunk.lodCount &&
+        pageSlots[chunk.firstPage + lod + step] != NO_SLOT) {
+      return chunk.firstPage + lod + step;
+    }
+  }
+  return NO_SLOT;
+}
+
+void ResidencyManager::update(const glm::mat4 &modelViewProjection,
+                              const glm::vec3 &cameraPosition,
+                              float projectionScale) {
+  // Covers every draw issued so far
+  if (frame > 0) {
+    GLsync sync = GL_CALL(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+    fences.push_back(FrameFence{frame, sync});
+  }
+  while (!fences.empty()) {
+    const GLenum status =
+        GL_CALL(glClientWaitSync(fences.front().sync, 0, 0));
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+      break;
+    }
+    completedFrame = fences.front().frame;
+    GL_CALL(glDeleteSync(fences.front().sync));
+    fences.pop_front();
+  }
+  frame++;
+  stats.visibleChunks = 0;
+  stats.culledChunks = 0;
+  stats.fallbackChunks = 0;
+  stats.drawnTriangles = 0;
+  draws.clear();
+  requests.clear();
+  loads.erase(std::remove_if(loads.begin(), loads.end(),
+                             [](const TaskHandle &load) {
+                               return load.isDone();
+                             }),
+              loads.end());
+
+  const std::vector<PageInfo> &pages = pagedMesh.getPages();
+  for (const PagedChunk &chunk : pagedMesh.getChunks()) {
+    if (isOutsideFrustum(modelViewProjection, chunk.bounds)) {
+      stats.culledChunks++;
+      continue;
+    }
+    stats.visibleChunks++;
+
+    // Coarsest level that still looks right, errors grow with the level
+    const float pixelsPerUnit =
+        projectionScale /
+        std::max(getDistance(chunk.bounds, cameraPosition), 1e-4f);
+    uint32_t lod = 0;
+    for (uint32_t coarser = chunk.lodCount; coarser-- > 0;) {
+      if (pages[chunk.firstPage + coarser].error * pixelsPerUnit <=
+          params.maxScreenError) {
+        lod = coarser;
+        break;
+      }
+    }
+
+    const uint32_t wanted = chunk.firstPage + lod;
+    uint32_t page = wanted;
+    if (pageSlots[wanted] == NO_SLOT) {
+      page = findResidentPage(chunk, lod);
+      stats.fallbackChunks++;
+      // The worse the stand-in looks, the sooner the real page is loaded
+      if (!pageLoading[wanted]) {
+        const float priority =
+            page == NO_SLOT ? std::numeric_limits<float>::max()
+                            : pages[page].error * pixelsPerUnit;
+        requests.push_back(Request{wanted, priority});
+      }
+    }
+    if (page != NO_SLOT) {
+      const uint32_t slot = pageSlots[page];
+      slots[slot].lastUsed = frame;
+      draws.push_back(Draw{slot, pages[page].indexCount});
+      stats.drawnTriangles += pages[page].indexCount / 3;
+    }
+  }
+
+  std::sort(requests.begin(), requests.end(),
+            [](const Request &a, const Request &b) {
+              return a.priority > b.priority;
+            });
+  // Don't decode pages that would have no slot to go to
+  const size_t reusableSlots = static_cast<size_t>(
+      std::count_if(slots.begin(), slots.end(), [&](const Slot &slot) {
+        return slot.page == NO_SLOT || slot.lastUsed <= completedFrame;
+      }));
+  const size_t maxLoads = std::min(params.maxLoadsInFlight, reusableSlots);
+  for (const Request &request : requests) {
+    if (stats.loadsInFlight >= maxLoads) {
+      break;
+    }
+    load(request.page);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(completedMutex);
+    std::move(completed.begin(), completed.end(),
+              std::back_inserter(uploadQueue));
+    completed.clear();
+  }
+  const size_t uploadCount =
+      std::min(uploadQueue.size(), params.maxUploadsPerFrame);
+  for (size_t i = 0; i < uploadCount; i++) {
+    upload(uploadQueue[i]);
+  }
+  uploadQueue.erase(uploadQueue.begin(), uploadQueue.begin() + uploadCount);
+}
+
+void ResidencyManager::draw() const {
+  if (draws.empty()) {
+    return;
+  }
+  pool.bind();
+  for (const Draw &draw : draws) {
+    const size_t firstIndex = draw.slot * size_t(pagedMesh.getMaxPageIndices());
+    GL_CALL(glDrawElementsBaseVertex(
+        GL_TRIANGLES, static_cast<GLsizei>(draw.indexCount), GL_UNSIGNED_INT,
+        (GLvoid *)(sizeof(uint32_t) * firstIndex),
+        static_cast<GLint>(draw.slot * pagedMesh.getMaxPageVerts())));
+  }
+}
+
+void ResidencyManager::destroy() {
+  jobSystem.waitAll(loads);
+  loads.clear();
+  dropQueuedPages();
+  pool.destroy();
+  for (const FrameFence &fence : fences) {
+    GL_CALL(glDeleteSync(fence.sync));
+  }
+  fences.clear();
+  std::fill(pageSlots.begin(), pageSlots.end(), NO_SLOT);
+  std::fill(slots.begin(), slots.end(), Slot{});
+  draws.clear();
+  stats.residentPages = 0;
+}
+} // namespace ofyaGl
@@ -0,0 +1,166 @@
+#include <ofyaGl/scene.h>
+
+#include <ofyaGl/job.h>
+
+#include <glm/geometric.hpp>
+
+#include <iostream>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define OFYAGL_SCENE_SSE
+#endif
+
+namespace ofyaGl {
+
+/**
+ * Nodes per task within a depth batch.
+ */
+constexpr size_t SCENE_GRAIN = 4096;
+
+/**
+ * out = a * b for column major 4x4 matrices. `out` may not alias `b`.
+ */
+static inline void multiplyMat4(const float *a, const float *b, float *out) {
+#ifdef OFYAGL_SCENE_SSE
+  const __m128 a0 = _mm_loadu_ps(a);
+  const __m128 a1 = _mm_loadu_ps(a + 4);
+  const __m128 a2 = _mm_loadu_ps(a + 8);
+  const __m128 a3 = _mm_loadu_ps(a + 12);
+  for (int i = 0; i < 4; i++) {
+    __m128 column = _mm_mul_ps(a0, _mm_set1_ps(b[4 * i]));
+    column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(b[4 * i + 1])));
+    column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(b[4 * i + 2])));
+    column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(b[4 * i + 3])));
+    _mm_storeu_ps(out + 4 * i, column);
+  }
+#else
+  for (int i = 0; i < 4; i++) {
+    for (int row = 0; row < 4; row++) {
+      out[4 * i + row] = a[row] * b[4 * i] + a[4 + row] * b[4 * i + 1] +
+                         a[8 + row] * b[4 * i + 2] + a[12 + row] * b[4 * i + 3];
+    }
+  }
+#endif
+}
+
+void Scene::reserve(size_t nodeCount) {
+  parents.reserve(nodeCount);
+  depths.reserve(nodeCount);
+  positions.reserve(nodeCount);
+  rotations.reserve(nodeCount);
+  scales.reserve(nodeCount);
+  localMatrices.reserve(nodeCount);
+  worldMatrices.reserve(nodeCount);
+  normalMatrices.reserve(nodeCount);
+  dirty.reserve(nodeCount);
+}
+
+std::optional<NodeId> Scene::createNode(NodeId parent) {
+  // A new node takes the next index, so an existing parent always comes first
+  if (parent != NO_PARENT && parent >= parents.size()) {
+    std::cerr << "Scene has no node " << parent << " to parent to\n";
+    return std::nullopt;
+  }
+  NodeId node = static_cast<NodeId>(parents.size());
+  parents.push_back(parent);
+  depths.push_back(parent == NO_PARENT ? 0 : depths[parent] + 1);
+  positions.push_back(glm::vec3(0.f));
+  rotations.push_back(glm::quat(1.f, 0.f, 0.f, 0.f));
+  scales.push_back(glm::vec3(1.f));
+  localMatrices.push_back(glm::mat4(1.f));
+  worldMatrices.push_back(glm::mat4(1.f));
+  normalMatrices.push_back(glm::mat3(1.f));
+  dirty.push_back(0);
+  markDirty(node);
+  return node;
+}
+
+size_t Scene::update() {
+  updated.clear();
+  if (firstDirty == NO_PARENT) {
+    return 0;
+  }
+
+  // Parents come first, so one forward pass pulls the flag down every
+  // subtree. Inherited nodes get a 2, their local matrix is still valid.
+  // depthEnds[d + 1] counts the changed nodes at depth d.
+  changed.clear();
+  depthEnds.assign(1, 0);
+  const size_t count = parents.size();
+  for (size_t i = firstDirty; i < count; i++) {
+    if (dirty[i] == 0 && parents[i] != NO_PARENT && dirty[parents[i]] != 0) {
+      dirty[i] = 2;
+    }
+    if (dirty[i] != 0) {
+      changed.push_back(static_cast<NodeId>(i));
+      const size_t slot = depths[i] + 1;
+      if (slot >= depthEnds.size()) {
+        depthEnds.resize(slot + 1, 0);
+      }
+      depthEnds[slot]++;
+    }
+  }
+
+  // Counting sort by depth. After the scatter depthEnds[d] is the end of
+  // depth d's batch, which is also where depth d + 1 starts.
+  for (size_t d = 1; d < depthEnds.size(); d++) {
+    depthEnds[d] += depthEnds[d - 1];
+  }
+  updated.resize(changed.size());
+  for (NodeId node : changed) {
+    updated[depthEnds[depths[node]]++] = node;
+  }
+  depthEnds.pop_back();
+
+  // Every parent is in an earlier batch, so the nodes of a batch are
+  // independent of each other
+  JobSystem &jobSystem = JobSystem::shared();
+  size_t batchBegin = 0;
+  for (size_t batchEnd : depthEnds) {
+    jobSystem.parallelFor(
+        batchBegin, batchEnd, SCENE_GRAIN, [this](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; i++) {
+            updateNode(updated[i]);
+          }
+        });
+    batchBegin = batchEnd;
+  }
+
+  firstDirty = NO_PARENT;
+  return updated.size();
+}
+
+void Scene::updateNode(NodeId node) {
+  glm::mat4 &local = localMatrices[node];
+  if (dirty[node] == 1) {
+    const glm::mat3 rotation = glm::mat3_cast(rotations[node]);
+    const glm::vec3 &scale = scales[node];
+    local[0] = glm::vec4(rotation[0] * scale.x, 0.f);
+    local[1] = glm::vec4(rotation[1] * scale.y, 0.f);
+    local[2] = glm::vec4(rotation[2] * scale.z, 0.f);
+    local[3] = glm::vec4(positions[node], 1.f);
+  }
+  dirty[node] = 0;
+
+  glm::mat4 &world = worldMatrices[node];
+  const NodeId parent = parents[node];
+  if (parent == NO_PARENT) {
+    world = local;
+  } else {
+    multiplyMat4(&worldMatrices[parent][0][0], &local[0][0], &world[0][0]);
+  }
+
+  const glm::vec3 a(world[0]);
+  const glm::vec3 b(world[1]);
+  const glm::vec3 c(world[2]);
+
+  // Columns of the inverse transpose are the cofactor columns over the
+  // determinant
+  const glm::vec3 bc = glm::cross(b, c);
+  const float det = glm::dot(a, bc);
+  const float invDet = det != 0.f ? 1.f / det : 0.f;
+  normalMatrices[node] = glm::mat3(bc * invDet, glm::cross(c, a) * invDet,
+                                   glm::cross(a, b) * invDet);
+}
+} // namespace ofyaGl
@@ -1,10 +1,18 @@
 #include <ofyaGl/shader.h>
 
+#include <ofyaGl/debug.h>
+#include <ofyaGl/memory.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
 #include <optional>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 std::optional<std::string> readShaderFromFile(const char *filePath) {
   std::cout << "Reading shader file: " << filePath << std::endl;
@@ -20,6 +28,113 @@ std::optional<std::string> readShaderFromFile(const char *filePath) {
 
 namespace ofyaGl {
 
+/**
+ * One shader stage with every `#include` expanded. `#line` directives keep
+ * compiler messages pointing at the original lines, their source string
+ * number indexes `files`.
+ */
+struct ShaderSource {
+  std::string text;
+  std::vector<std::filesystem::path> files;
+};
+
+/**
+ * Matches `#include "name"`, anything else is left to the compiler.
+ */
+static bool parseInclude(const std::string &line, std::string &name) {
+  const size_t at = line.find_first_not_of(" \t");
+  if (at == std::string::npos || line.compare(at, 8, "#include") != 0) {
+    return false;
+  }
+  const size_t open = line.find('"', at + 8);
+  const size_t close =
+      open == std::string::npos ? open : line.find('"', open + 1);
+  if (close == std::string::npos) {
+    return false;
+  }
+  name = line.substr(open + 1, close - open - 1);
+  return true;
+}
+
+static bool expandIncludes(const std::filesystem::path &path,
+                           ShaderSource &source) {
+  const size_t fileIndex = source.files.size();
+  source.files.push_back(path);
+  std::optional<std::string> text = readShaderFromFile(path.string().c_str());
+  if (!text.has_value()) {
+    return false;
+  }
+
+  std::istringstream lines(*text);
+  std::string line;
+  std::string name;
+  for (int lineNumber = 1; std::getline(lines, line); lineNumber++) {
+    if (!parseInclude(line, name)) {
+      source.text += line;
+      source.text += '\n';
+      continue;
+    }
+
+    std::filesystem::path includePath = path.parent_path() / name;
+    if (!std::filesystem::exists(includePath)) {
+      includePath = std::filesystem::path(std::getenv("ICG_SHADER_DIR")) / name;
+    }
+    includePath = includePath.lexically_normal();
+    const auto &files = source.files;
+    if (std::find(files.begin(), files.end(), includePath) != files.end()) {
+      // Included before, keep the line count
+      source.text += '\n';
+      continue;
+    }
+
+    source.text += "#line 1 " + std::to_string(files.size()) + "\n";
+    if (!expandIncludes(includePath, source)) {
+      std::cerr << "  included from " << path.string() << ":" << lineNumber
+                << std::endl;
+      return false;
+    }
+    source.text += "#line " + std::to_string(lineNumber + 1) + " " +
+                   std::to_string(fileIndex) + "\n";
+  }
+  return true;
+}
+
+/**
+ * `#version` has to stay the first directive, so the defines go right after
+ * it.
+ */
+static void insertDefines(std::string &text, const ShaderDefines &defines) {
+  if (defines.empty()) {
+    return;
+  }
+  std::string block;
+  for (const auto &[name, value] : defines) {
+    block += "#define " + name + " " + value + "\n";
+  }
+
+  size_t at = 0;
+  const size_t version = text.find("#version");
+  if (version != std::string::npos) {
+    at = text.find('\n', version);
+    at = at == std::string::npos ? text.size() : at + 1;
+  }
+  const auto lineCount = std::count(text.begin(), text.begin() + at, '\n');
+  block += "#line " + std::to_string(lineCount + 1) + " 0\n";
+  text.insert(at, block);
+}
+
+Shader::Shader(Shader &&other) noexcept
+    : programId(std::exchange(other.programId, 0)),
+      sourceBytes(std::exchange(other.sourceBytes, 0)),
+      uniformToPos(std::move(other.uniformToPos)) {}
+
+Shader &Shader::operator=(Shader &&other) noexcept {
+  std::swap(programId, other.programId);
+  std::swap(sourceBytes, other.sourceBytes);
+  std::swap(uniformToPos, other.uniformToPos);
+  return *this;
+}
+
 GLuint Shader::createShader(const char *src, const GLuint shaderType) {
   const GLuint shader = glCreateShader(shaderType);
   GL_CALL(glShaderSource(shader, 1, &src, NULL));
@@ -32,18 +147,21 @@ GLuint Shader::createShader(const char *src, const GLuint shaderType) {
     GLchar buffer[2048];
     GL_CALL(glGetShaderInfoLog(shader, 2048, &log_length, buffer));
     std::cerr << "Error compiling shader: " << buffer << std::endl;
+    GL_CALL(glDeleteShader(shader));
     return 0;
   }
   return shader;
 }
 
-Shader Shader::fromSrc(const char *vertSrc, const char *fragSrc) {
+Shader Shader::fromSrc(const char *vertSrc, const char *fragSrc,
+                       const std::string &label) {
   const GLuint vertShaderId = createShader(vertSrc, GL_VERTEX_SHADER);
   if (vertShaderId == 0) {
     return Shader(0);
   }
   const GLuint fragShaderId = createShader(fragSrc, GL_FRAGMENT_SHADER);
   if (fragShaderId == 0) {
+    GL_CALL(glDeleteShader(vertShaderId));
     return Shader(0);
   }
 
@@ -52,6 +170,13 @@ Shader Shader::fromSrc(const char *vertSrc, const char *fragSrc) {
   GL_CALL(glAttachShader(program, fragShaderId));
   GL_CALL(glLinkProgram(program));
 
+  // The program keeps the linked code, the stage objects would only hold on
+  // to their source and binaries until the program goes away
+  GL_CALL(glDetachShader(program, vertShaderId));
+  GL_CALL(glDetachShader(program, fragShaderId));
+  GL_CALL(glDeleteShader(vertShaderId));
+  GL_CALL(glDeleteShader(fragShaderId));
+
   GLint linkStatus;
   GL_CALL(glGetProgramiv(program, GL_LINK_STATUS, &linkStatus));
   if (linkStatus != GL_TRUE) {
@@ -59,25 +184,47 @@ Shader Shader::fromSrc(const char *vertSrc, const char *fragSrc) {
     GLchar buffer[2048];
     GL_CALL(glGetProgramInfoLog(program, 2048, &logLength, buffer));
     std::cerr << "Error linking shader program: " << buffer << std::endl;
+    GL_CALL(glDeleteProgram(program));
     return Shader(0);
   }
 
-  return Shader(program);
-}
+  if (!label.empty()) {
+    GlDebug::shared().label(GL_PROGRAM, program, label);
+  }
 
-Shader Shader::fromFile(const char *vertFile, const char *fragFile) {
-  std::string shaderDir = std::getenv("ICG_SHADER_DIR");
+  const size_t sourceBytes = std::strlen(vertSrc) + std::strlen(fragSrc);
+  MemoryTracker::shared().add(MemoryCategory::Shader, sourceBytes);
+  return Shader(program, sourceBytes);
+}
 
-  std::string vertFilePath = shaderDir + "/" + vertFile;
-  std::string fragFilePath = shaderDir + "/" + fragFile;
+Shader Shader::fromFile(const char *vertFile, const char *fragFile,
+                        const ShaderDefines &defines) {
+  const std::filesystem::path shaderDir = std::getenv("ICG_SHADER_DIR");
 
-  std::optional<std::string> vertSrc = readShaderFromFile(vertFilePath.c_str());
-  std::optional<std::string> fragSrc = readShaderFromFile(fragFilePath.c_str());
-  if (!vertSrc.has_value() || !fragSrc.has_value()) {
+  ShaderSource vertSrc;
+  ShaderSource fragSrc;
+  if (!expandIncludes(shaderDir / vertFile, vertSrc) ||
+      !expandIncludes(shaderDir / fragFile, fragSrc)) {
     return Shader(0);
   }
+  insertDefines(vertSrc.text, defines);
+  insertDefines(fragSrc.text, defines);
 
-  return Shader::fromSrc(vertSrc->c_str(), fragSrc->c_str());
+  std::string label = std::string(vertFile) + " + " + fragFile;
+  for (const auto &[name, value] : defines) {
+    label += " " + name + (value.empty() ? "" : "=" + value);
+  }
+  Shader shader =
+      Shader::fromSrc(vertSrc.text.c_str(), fragSrc.text.c_str(), label);
+  if (!shader.isValid()) {
+    for (const ShaderSource *source : {&vertSrc, &fragSrc}) {
+      for (size_t i = 1; i < source->files.size(); i++) {
+        std::cerr << "  source string " << i << " is "
+                  << source->files[i].string() << std::endl;
+      }
+    }
+  }
+  return shader;
 }
 
 GLuint Shader::getUniformPosition(const char *uniformName) {
@@ -91,6 +238,17 @@ GLuint Shader::getUniformPosition(const char *uniformName) {
   return uniformPosition;
 }
 
+void Shader::destroy() {
+  if (programId == 0) {
+    return;
+  }
+  GL_CALL(glDeleteProgram(programId));
+  MemoryTracker::shared().remove(MemoryCategory::Shader, sourceBytes);
+  programId = 0;
+  sourceBytes = 0;
+  uniformToPos.clear();
+}
+
 void Shader::setUniform(const GLuint uniformPosition,
                         const glm::mat4 mat4) const {
   GL_CALL(
@@ -125,4 +283,42 @@ void Shader::setUniform(const char *uniformName, const glm::vec3 vec3) {
   GL_CALL(glUniform3fv(uniformPosition, 1, glm::value_ptr(vec3)));
 }
 
+void Shader::setUniform(const GLuint uniformPosition,
+                        const glm::vec2 vec2) const {
+  GL_CALL(glUniform2fv(uniformPosition, 1, glm::value_ptr(vec2)));
+}
+
+void Shader::setUniform(const char *uniformName, const glm::vec2 vec2) {
+  GLuint uniformPosition = getUniformPosition(uniformName);
+  GL_CALL(glUniform2fv(uniformPosition, 1, glm::value_ptr(vec2)));
+}
+
+void Shader::setUniform(const GLuint uniformPosition,
+                        const glm::ivec3 ivec3) const {
+  GL_CALL(glUniform3iv(uniformPosition, 1, glm::value_ptr(ivec3)));
+}
+
+void Shader::setUniform(const char *uniformName, const glm::ivec3 ivec3) {
+  GLuint uniformPosition = getUniformPosition(uniformName);
+  GL_CALL(glUniform3iv(uniformPosition, 1, glm::value_ptr(ivec3)));
+}
+
+void Shader::setUniform(const GLuint uniformPosition, const float value) const {
+  GL_CALL(glUniform1f(uniformPosition, value));
+}
+
+void Shader::setUniform(const char *uniformName, const float value) {
+  GLuint uniformPosition = getUniformPosition(uniformName);
+  GL_CALL(glUniform1f(uniformPosition, value));
+}
+
+void Shader::setUniform(const GLuint uniformPosition, const int value) const {
+  GL_CALL(glUniform1i(uniformPosition, value));
+}
+
+void Shader::setUniform(const char *uniformName, const int value) {
+  GLuint uniformPosition = getUniformPosition(uniformName);
+  GL_CALL(glUniform1i(uniformPosition, value));
+}
+
 } // namespace ofyaGl
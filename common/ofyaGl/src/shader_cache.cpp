@@ -0,0 +1,50 @@
+#include <ofyaGl/shader_cache.h>
+
+#include <ofyaGl/hash.h>
+
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+namespace ofyaGl {
+
+uint64_t ShaderCache::getKey(const char *vertFile, const char *fragFile,
+                             const ShaderDefines &defines) {
+  // Every part ends in a '\0' so "a" + "bc" and "ab" + "c" differ
+  uint64_t key = hashBytes(vertFile, std::strlen(vertFile) + 1);
+  key = hashBytes(fragFile, std::strlen(fragFile) + 1, key);
+  for (const auto &[name, value] : defines) {
+    key = hashBytes(name.c_str(), name.size() + 1, key);
+    key = hashBytes(value.c_str(), value.size() + 1, key);
+  }
+  return key;
+}
+
+Shader &ShaderCache::get(const char *vertFile, const char *fragFile,
+                         const ShaderDefines &defines) {
+  const uint64_t key = getKey(vertFile, fragFile, defines);
+  auto found = permutations.find(key);
+  if (found != permutations.end()) {
+    stats.hits++;
+    return found->second;
+  }
+
+  using Clock = std::chrono::steady_clock;
+  const auto start = Clock::now();
+  Shader shader = Shader::fromFile(vertFile, fragFile, defines);
+  stats.compileSeconds +=
+      std::chrono::duration<double>(Clock::now() - start).count();
+  stats.compiles++;
+  if (!shader.isValid()) {
+    stats.failures++;
+  }
+  return permutations.emplace(key, std::move(shader)).first->second;
+}
+
+void ShaderCache::destroy() {
+  for (auto &[key, shader] : permutations) {
+    shader.destroy();
+  }
+  permutations.clear();
+}
+} // namespace ofyaGl
@@ -0,0 +1,230 @@
+#include <ofyaGl/stream_buffer.h>
+
+#include <ofyaGl/gl.h>
+#include <ofyaGl/memory.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <utility>
+
+// ARB_buffer_storage is core in 4.4 only
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+namespace ofyaGl {
+
+/**
+ * How long one `glClientWaitSync` blocks before checking again.
+ */
+constexpr GLuint64 FENCE_WAIT_NANOSECONDS = 1000000;
+
+using BufferStorageFn = void(GLAD_API_PTR *)(GLenum target, GLsizeiptr size,
+                                             const void *data,
+                                             GLbitfield flags);
+
+static inline size_t alignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+static BufferStorageFn loadBufferStorage(GLADloadfunc load) {
+  if (load == nullptr) {
+    return nullptr;
+  }
+  GLint major = 0;
+  GLint minor = 0;
+  GL_CALL(glGetIntegerv(GL_MAJOR_VERSION, &major));
+  GL_CALL(glGetIntegerv(GL_MINOR_VERSION, &minor));
+  if (major < 4 || (major == 4 && minor < 4)) {
+    static const bool extensionSupported =
+        hasGlExtension("GL_ARB_buffer_storage");
+    if (!extensionSupported) {
+      return nullptr;
+    }
+  }
+  return reinterpret_cast<BufferStorageFn>(load("glBufferStorage"));
+}
+
+StreamBuffer::StreamBuffer(StreamBuffer &&other) noexcept
+    : buffer(std::exchange(other.buffer, 0)), target(other.target),
+      regionSize(std::exchange(other.regionSize, 0)),
+      regionCount(std::exchange(other.regionCount, 0)),
+      alignment(other.alignment), persistent(other.persistent),
+      mapped(std::exchange(other.mapped, nullptr)),
+      staging(std::move(other.staging)),
+      region(std::exchange(other.region, 0)),
+      cursor(std::exchange(other.cursor, 0)), stats(other.stats) {
+  for (int i = 0; i < MAX_REGIONS; i++) {
+    fences[i] = std::exchange(other.fences[i], nullptr);
+  }
+}
+
+StreamBuffer &StreamBuffer::operator=(StreamBuffer &&other) noexcept {
+  std::swap(buffer, other.buffer);
+  std::swap(target, other.target);
+  std::swap(regionSize, other.regionSize);
+  std::swap(regionCount, other.regionCount);
+  std::swap(alignment, other.alignment);
+  std::swap(persistent, other.persistent);
+  std::swap(mapped, other.mapped);
+  std::swap(staging, other.staging);
+  std::swap(fences, other.fences);
+  std::swap(region, other.region);
+  std::swap(cursor, other.cursor);
+  std::swap(stats, other.stats);
+  return *this;
+}
+
+StreamBuffer StreamBuffer::allocate(GLenum target, size_t regionSize,
+                                    int regionCount, GLADloadfunc load) {
+  if (regionSize == 0 || regionCount < 1) {
+    std::cerr << "Stream buffer needs at least one non empty region\n";
+    return StreamBuffer();
+  }
+  regionCount = std::min(regionCount, MAX_REGIONS);
+
+  // Region starts must satisfy the target's offset alignment too
+  size_t alignment = 1;
+  if (target == GL_UNIFORM_BUFFER) {
+    GLint uniformAlignment = 1;
+    GL_CALL(glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT,
+                          &uniformAlignment));
+    alignment = std::max<size_t>(uniformAlignment, 1);
+  }
+  regionSize = alignUp(regionSize, alignment);
+
+  // Set up through the copy target so a bound VAO's element buffer or an
+  // indexed binding point isn't disturbed
+  GLuint buffer;
+  GL_CALL(glGenBuffers(1, &buffer));
+  GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, buffer));
+
+  void *mapped = nullptr;
+  const BufferStorageFn bufferStorage = loadBufferStorage(load);
+  if (bufferStorage != nullptr) {
+    const GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const GLsizeiptr totalSize = regionSize * regionCount;
+    GL_CALL(bufferStorage(GL_COPY_WRITE_BUFFER, totalSize, nullptr, flags));
+    mapped = GL_CALL(
+        glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalSize, flags));
+    if (mapped == nullptr) {
+      // Immutable storage can't be respecified, start over for the fallback
+      GL_CALL(glDeleteBuffers(1, &buffer));
+      GL_CALL(glGenBuffers(1, &buffer));
+      GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, buffer));
+    }
+  }
+  if (mapped == nullptr) {
+    regionCount = 1;
+    GL_CALL(glBufferData(GL_COPY_WRITE_BUFFER, regionSize, nullptr,
+                         GL_STREAM_DRAW));
+  }
+  GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+
+  MemoryTracker::shared().add(MemoryCategory::OtherBuffer,
+                              regionSize * regionCount);
+
+  StreamBuffer streamBuffer(buffer, target, regionSize, regionCount,
+                            alignment, mapped != nullptr);
+  streamBuffer.mapped = static_cast<uint8_t *>(mapped);
+  if (!streamBuffer.persistent) {
+    streamBuffer.staging.resize(regionSize);
+  }
+  return streamBuffer;
+}
+
+void StreamBuffer::beginFrame() {
+  cursor = 0;
+  stats.frameBytes = 0;
+
+  GLsync &fence = fences[region];
+  if (fence == nullptr) {
+    return;
+  }
+  GLenum status = GL_CALL(glClientWaitSync(fence, 0, 0));
+  if (status == GL_TIMEOUT_EXPIRED) {
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    do {
+      status = GL_CALL(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                        FENCE_WAIT_NANOSECONDS));
+    } while (status == GL_TIMEOUT_EXPIRED);
+    stats.stalls++;
+    stats.stallSeconds +=
+        std::chrono::duration<double>(Clock::now() - start).count();
+  }
+  GL_CALL(glDeleteSync(fence));
+  fence = nullptr;
+}
+
+std::optional<StreamRange> StreamBuffer::acquire(size_t size,
+                                                 size_t alignment) {
+  const size_t offset =
+      alignUp(cursor, std::max<size_t>(alignment, this->alignment));
+  if (offset + size > regionSize) {
+    stats.overflows++;
+    return {};
+  }
+  cursor = offset + size;
+  stats.frameBytes = cursor;
+
+  uint8_t *base = persistent ? mapped + getRegionOffset() : staging.data();
+  return StreamRange{base + offset,
+                     static_cast<GLintptr>(getRegionOffset() + offset),
+                     static_cast<GLsizeiptr>(size)};
+}
+
+void StreamBuffer::commit() {
+  if (persistent || cursor == 0) {
+    // Coherent mappings need no flush
+    return;
+  }
+  // Orphan, draws already queued keep reading the old storage
+  GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, buffer));
+  GL_CALL(glBufferData(GL_COPY_WRITE_BUFFER, regionSize, nullptr,
+                       GL_STREAM_DRAW));
+  GL_CALL(glBufferSubData(GL_COPY_WRITE_BUFFER, 0, cursor, staging.data()));
+  GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+}
+
+void StreamBuffer::endFrame() {
+  if (!persistent) {
+    return;
+  }
+  fences[region] = GL_CALL(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+  region = (region + 1) % regionCount;
+}
+
+void StreamBuffer::bindRange(GLuint index, const StreamRange &range) const {
+  GL_CALL(glBindBufferRange(target, index, buffer, range.offset, range.size));
+}
+
+void StreamBuffer::destroy() {
+  if (buffer == 0) {
+    return;
+  }
+  for (GLsync &fence : fences) {
+    if (fence != nullptr) {
+      GL_CALL(glDeleteSync(fence));
+      fence = nullptr;
+    }
+  }
+  if (mapped != nullptr) {
+    GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, buffer));
+    GL_CALL(glUnmapBuffer(GL_COPY_WRITE_BUFFER));
+    GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+    mapped = nullptr;
+  }
+  GL_CALL(glDeleteBuffers(1, &buffer));
+  MemoryTracker::shared().remove(MemoryCategory::OtherBuffer,
+                                 regionSize * regionCount);
+  buffer = 0;
+  staging.clear();
+  staging.shrink_to_fit();
+}
+} // namespace ofyaGl
@@ -0,0 +1,358 @@
+#include <ofyaGl/texture.h>
+
+#include <ofyaGl/debug.h>
+#include <ofyaGl/memory.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <utility>
+
+// S3TC is an extension in a 3.3 core context, glad doesn't carry its enums
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace ofyaGl {
+
+/**
+ * Layout of a cache file: the header, one `CacheLevel` per mip level, then
+ * the level data, each level starting at a multiple of `CACHE_ALIGNMENT`.
+ * Everything is little endian, which is all this code runs on.
+ */
+struct CacheHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t format;
+  uint32_t filter;
+  uint32_t levelCount;
+  uint32_t reserved;
+  uint64_t sourceSize;
+  int64_t sourceTime;
+};
+
+struct CacheLevel {
+  uint32_t width;
+  uint32_t height;
+  uint64_t offset;
+  uint64_t size;
+};
+
+constexpr char CACHE_MAGIC[4] = {'O', 'F', 'T', 'X'};
+constexpr uint32_t CACHE_VERSION = 1;
+constexpr size_t CACHE_ALIGNMENT = 16;
+
+static const char *getFormatName(TextureFormat format) {
+  switch (format) {
+  case TextureFormat::BC1:
+    return "bc1";
+  case TextureFormat::BC3:
+    return "bc3";
+  case TextureFormat::BC5:
+    return "bc5";
+  case TextureFormat::RGBA8:
+    break;
+  }
+  return "rgba8";
+}
+
+size_t TextureData::getByteSize() const {
+  size_t size = 0;
+  for (const TextureLevel &level : levels) {
+    size += level.size;
+  }
+  return size;
+}
+
+/**
+ * Checks a cache file image against what the caller expects and fills
+ * `levels` with pointers into it.
+ */
+static bool parseCache(const uint8_t *bytes, size_t size,
+                       const CacheHeader &expected,
+                       std::vector<TextureLevel> &levels) {
+  CacheHeader header;
+  if (size < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, bytes, sizeof(header));
+  if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+      header.version != CACHE_VERSION || header.format != expected.format ||
+      header.filter != expected.filter ||
+      header.sourceSize != expected.sourceSize ||
+      header.sourceTime != expected.sourceTime || header.levelCount == 0 ||
+      header.levelCount > 32 ||
+      size < sizeof(header) + header.levelCount * sizeof(CacheLevel)) {
+    return false;
+  }
+
+  const TextureFormat format = static_cast<TextureFormat>(header.format);
+  levels.clear();
+  for (uint32_t i = 0; i < header.levelCount; i++) {
+    CacheLevel level;
+    std::memcpy(&level, bytes + sizeof(header) + i * sizeof(CacheLevel),
+                sizeof(level));
+    if (level.width == 0 || level.height == 0 || level.width > (1 << 16) ||
+        level.height > (1 << 16) ||
+        level.size != getLevelSize(format, level.width, level.height) ||
+        level.offset > size || level.size > size - level.offset) {
+      return false;
+    }
+    levels.push_back(TextureLevel{static_cast<int>(level.width),
+                                  static_cast<int>(level.height),
+                                  bytes + level.offset,
+                                  static_cast<size_t>(level.size)});
+  }
+  return true;
+}
+
+/**
+ * Serializes encoded levels into the cache file layout.
+ */
+static std::vector<uint8_t>
+buildCache(const CacheHeader &header, const std::vector<Image> &mips,
+           const std::vector<std::vector<uint8_t>> &encoded) {
+  auto align = [](size_t offset) {
+    return (offset + CACHE_ALIGNMENT - 1) & ~(CACHE_ALIGNMENT - 1);
+  };
+
+  std::vector<CacheLevel> table(mips.size());
+  size_t offset = align(sizeof(header) + table.size() * sizeof(CacheLevel));
+  for (size_t i = 0; i < mips.size(); i++) {
+    table[i] = CacheLevel{static_cast<uint32_t>(mips[i].width),
+                          static_cast<uint32_t>(mips[i].height), offset,
+                          encoded[i].size()};
+    offset = align(offset + encoded[i].size());
+  }
+
+  std::vector<uint8_t> bytes(offset, 0);
+  std::memcpy(bytes.data(), &header, sizeof(header));
+  std::memcpy(bytes.data() + sizeof(header), table.data(),
+              table.size() * sizeof(CacheLevel));
+  for (size_t i = 0; i < mips.size(); i++) {
+    std::memcpy(bytes.data() + table[i].offset, encoded[i].data(),
+                encoded[i].size());
+  }
+  return bytes;
+}
+
+static void writeCache(const std::filesystem::path &path,
+                       const std::vector<uint8_t> &bytes) {
+  std::error_code error;
+  std::filesystem::create_directories(path.parent_path(), error);
+
+  // Write next to it and rename, so a concurrent reader never sees half a
+  // file
+  std::filesystem::path temporary = path;
+  temporary += ".tmp";
+  std::FILE *file = std::fopen(temporary.string().c_str(), "wb");
+  if (file == nullptr) {
+    std::cerr << "Failed to write texture cache '" << path.string() << "'\n";
+    return;
+  }
+  size_t written = std::fwrite(bytes.data(), 1, bytes.size(), file);
+  std::fclose(file);
+  if (written != bytes.size()) {
+    std::cerr << "Failed to write texture cache '" << path.string() << "'\n";
+    std::filesystem::remove(temporary, error);
+    return;
+  }
+  std::filesystem::rename(temporary, path, error);
+}
+
+std::optional<TextureData> loadTextureData(const char *fileName,
+                                           TextureFormat format,
+                                           MipFilter filter,
+                                           JobSystem &jobSystem) {
+  std::string textureDir = std::getenv("ICG_TEXTURE_DIR");
+  std::filesystem::path fullFilePath = textureDir + "/" + fileName;
+
+  std::error_code error;
+  const uintmax_t sourceSize = std::filesystem::file_size(fullFilePath, error);
+  const auto sourceTime = std::filesystem::last_write_time(fullFilePath, error);
+  if (error) {
+    std::cerr << "Failed to open file '" << fullFilePath.string() << "'\n";
+    return {};
+  }
+
+  CacheHeader header{};
+  std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  header.version = CACHE_VERSION;
+  header.format = static_cast<uint32_t>(format);
+  header.filter = static_cast<uint32_t>(filter);
+  header.sourceSize = sourceSize;
+  header.sourceTime =
+      static_cast<int64_t>(sourceTime.time_since_epoch().count());
+
+  TextureData data;
+  data.format = format;
+
+  std::filesystem::path cachePath;
+  if (const char *cacheDir = std::getenv("ICG_CACHE_DIR")) {
+    std::string cacheName = fileName;
+    for (char &c : cacheName) {
+      c = c == '/' || c == '\\' ? '_' : c;
+    }
+    cacheName += std::string(".") + getFormatName(format) +
+                 (filter == MipFilter::Kaiser ? ".kaiser" : ".box") + ".oftx";
+    cachePath = std::filesystem::path(cacheDir) / cacheName;
+
+    std::optional<MappedFile> file =
+        MappedFile::open(cachePath.string().c_str());
+    if (file.has_value() &&
+        parseCache(file->data(), file->getSize(), header, data.levels)) {
+      std::cout << "Loading texture from cache '" << cachePath.string()
+                << "'\n";
+      data.mapping = std::move(*file);
+      return data;
+    }
+  }
+
+  std::cout << "Loading texture from file '" << fullFilePath.string() << "'\n";
+  std::optional<Image> image = loadImageFromFile(fileName);
+  if (!image.has_value()) {
+    return {};
+  }
+
+  std::vector<Image> mips =
+      generateMipChain(std::move(*image), filter, jobSystem);
+  std::vector<std::vector<uint8_t>> encoded;
+  encoded.reserve(mips.size());
+  for (const Image &mip : mips) {
+    encoded.push_back(compressImage(mip, format, jobSystem));
+  }
+  header.levelCount = static_cast<uint32_t>(mips.size());
+
+  data.storage = buildCache(header, mips, encoded);
+  parseCache(data.storage.data(), data.storage.size(), header, data.levels);
+  if (!cachePath.empty()) {
+    writeCache(cachePath, data.storage);
+  }
+  return data;
+}
+
+static GLenum getInternalFormat(TextureFormat format) {
+  switch (format) {
+  case TextureFormat::BC1:
+    return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  case TextureFormat::BC3:
+    return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+  case TextureFormat::BC5:
+    return GL_COMPRESSED_RG_RGTC2;
+  case TextureFormat::RGBA8:
+    break;
+  }
+  return GL_RGBA8;
+}
+
+Texture::Texture(Texture &&other) noexcept
+    : id(std::exchange(other.id, 0)), width(std::exchange(other.width, 0)),
+      height(std::exchange(other.height, 0)),
+      levelCount(std::exchange(other.levelCount, 0)), format(other.format),
+      byteSize(std::exchange(other.byteSize, 0)) {}
+
+Texture &Texture::operator=(Texture &&other) noexcept {
+  std::swap(id, other.id);
+  std::swap(width, other.width);
+  std::swap(height, other.height);
+  std::swap(levelCount, other.levelCount);
+  std::swap(format, other.format);
+  std::swap(byteSize, other.byteSize);
+  return *this;
+}
+
+bool Texture::isFormatSupported(TextureFormat format) {
+  if (format == TextureFormat::RGBA8 || format == TextureFormat::BC5) {
+    // RGTC is core since 3.0
+    return true;
+  }
+
+  static const bool s3tcSupported =
+      hasGlExtension("GL_EXT_texture_compression_s3tc");
+  return s3tcSupported;
+}
+
+Texture Texture::allocate(TextureFormat format, int width, int height,
+                          int levelCount) {
+  GLuint id;
+  GL_CALL(glGenTextures(1, &id));
+  GL_CALL(glBindTexture(GL_TEXTURE_2D, id));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                          levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR
+                                         : GL_LINEAR));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                          std::max(levelCount - 1, 0)));
+  GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+
+  // Levels add their bytes as they're uploaded
+  MemoryTracker::shared().add(MemoryCategory::Texture, 0);
+
+  return Texture(id, width, height, levelCount, format);
+}
+
+Texture Texture::fromData(const TextureData &data) {
+  const std::vector<TextureLevel> &levels = data.getLevels();
+  if (levels.empty()) {
+    return Texture();
+  }
+  Texture texture = allocate(data.getFormat(), levels[0].width,
+                             levels[0].height, static_cast<int>(levels.size()));
+  for (size_t i = 0; i < levels.size(); i++) {
+    texture.uploadLevel(static_cast<int>(i), levels[i]);
+  }
+  return texture;
+}
+
+void Texture::uploadLevel(int level, const TextureLevel &data) {
+  GL_CALL(glBindTexture(GL_TEXTURE_2D, id));
+
+  size_t levelBytes;
+  if (format != TextureFormat::RGBA8 && isFormatSupported(format)) {
+    GL_CALL(glCompressedTexImage2D(GL_TEXTURE_2D, level,
+                                   getInternalFormat(format), data.width,
+                                   data.height, 0,
+                                   static_cast<GLsizei>(data.size), data.data));
+    levelBytes = data.size;
+  } else if (format != TextureFormat::RGBA8) {
+    Image expanded =
+        decompressImage(data.data, data.width, data.height, format);
+    GL_CALL(glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, data.width,
+                         data.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                         expanded.pixels.data()));
+    levelBytes = expanded.pixels.size();
+  } else {
+    GL_CALL(glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, data.width,
+                         data.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data.data));
+    levelBytes = data.size;
+  }
+  byteSize += levelBytes;
+  MemoryTracker::shared().add(MemoryCategory::Texture, levelBytes, 0);
+
+  GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+}
+
+void Texture::setLabel(const std::string &label) const {
+  GlDebug::shared().label(GL_TEXTURE, id, label);
+}
+
+void Texture::destroy() {
+  if (id == 0) {
+    return;
+  }
+  GL_CALL(glDeleteTextures(1, &id));
+  MemoryTracker::shared().remove(MemoryCategory::Texture, byteSize);
+  id = 0;
+  byteSize = 0;
+}
+} // namespace ofyaGl
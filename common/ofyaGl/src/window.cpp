@@ -1,12 +1,26 @@
 #include <ofyaGl/window.h>
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
+#include <ofyaGl/debug.h>
 #include <ofyaGl/gl.h>
+#include <thread>
 
 namespace ofyaGl {
 
-Window::Window(int width, int height, const char *title) {
+/**
+ * The limiter stops sleeping this long before the deadline and spins.
+ */
+constexpr std::chrono::microseconds SPIN_MARGIN(1500);
+
+/**
+ * Weight of the newest frame in the smoothed frame time.
+ */
+constexpr double SMOOTHING = 0.1;
+
+Window::Window(int width, int height, const char *title)
+    : frameTimes(FRAME_HISTORY), inputLatencies(FRAME_HISTORY) {
 
   if (!glfwInit()) {
     std::cerr << "Failed to initialze GLFW\n";
@@ -20,6 +34,9 @@ Window::Window(int width, int height, const char *title) {
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef DEBUG
+  glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+#endif
   window = glfwCreateWindow(width, height, title, NULL, NULL);
 
   if (!window) {
@@ -32,10 +49,15 @@ Window::Window(int width, int height, const char *title) {
 
   glfwSetKeyCallback(window, [](GLFWwindow *window, int key, int scancode,
                                 int action, int mods) {
+    markInput(window);
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
       glfwSetWindowShouldClose(window, GLFW_TRUE);
     }
   });
+  glfwSetMouseButtonCallback(
+      window, [](GLFWwindow *window, int, int, int) { markInput(window); });
+  glfwSetCursorPosCallback(
+      window, [](GLFWwindow *window, double, double) { markInput(window); });
 
   glfwSetWindowSizeCallback(window, [](GLFWwindow *window, int, int) {
     WindowData &data = *(WindowData *)glfwGetWindowUserPointer(window);
@@ -56,12 +78,146 @@ Window::Window(int width, int height, const char *title) {
   std::cout << "Loaded OpenGL " << GLAD_VERSION_MAJOR(version) << "."
             << GLAD_VERSION_MINOR(version) << std::endl;
 
+#ifdef DEBUG
+  // The callback reports errors without syncing on every call, keep
+  // glGetError only where KHR_debug is missing
+  GlDebug &debug = GlDebug::shared();
+  if (debug.enableOutput(glfwGetProcAddress)) {
+    debug.setErrorCheckMode(ErrorCheckMode::Off);
+  }
+#endif
+
+  // Drivers differ in their default, don't leave it to them
+  setSwapMode(SwapMode::VSync);
+
   glfwGetFramebufferSize(window, &width, &height);
   GL_CALL(glViewport(0, 0, width, height));
   windowData.width = width;
   windowData.height = height;
 }
 
+void Window::markInput(GLFWwindow *window) {
+  WindowData &data = *(WindowData *)glfwGetWindowUserPointer(window);
+  if (!data.inputPending) {
+    data.inputPending = true;
+    data.inputTime = Clock::now();
+  }
+}
+
+bool Window::setSwapMode(SwapMode mode) {
+  bool available = true;
+  if (mode == SwapMode::Adaptive &&
+      !glfwExtensionSupported("WGL_EXT_swap_control_tear") &&
+      !glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+    mode = SwapMode::VSync;
+    available = false;
+  }
+
+  switch (mode) {
+  case SwapMode::VSync:
+    glfwSwapInterval(1);
+    break;
+  case SwapMode::Adaptive:
+    glfwSwapInterval(-1);
+    break;
+  case SwapMode::Uncapped:
+    glfwSwapInterval(0);
+    break;
+  }
+  swapMode = mode;
+  return available;
+}
+
+void Window::setFrameLimit(double framesPerSecond) {
+  if (framesPerSecond <= 0.0) {
+    framePeriod = Clock::duration::zero();
+    return;
+  }
+  framePeriod = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(1.0 / framesPerSecond));
+  nextFrame = Clock::now() + framePeriod;
+}
+
+void Window::waitForNextFrame(Clock::time_point now) {
+  if (nextFrame - now > SPIN_MARGIN) {
+    std::this_thread::sleep_until(nextFrame - SPIN_MARGIN);
+  }
+  while (Clock::now() < nextFrame) {
+    std::this_thread::yield();
+  }
+}
+
+void Window::swapBuffers() {
+  glfwSwapBuffers(window);
+
+  Clock::time_point now = Clock::now();
+  if (windowData.inputPending) {
+    const double latency =
+        std::chrono::duration<double>(now - windowData.inputTime).count();
+    inputLatencies[inputLatencyCount % FRAME_HISTORY] =
+        static_cast<float>(latency);
+    inputLatencyCount++;
+    windowData.inputPending = false;
+  }
+
+  if (framePeriod > Clock::duration::zero()) {
+    if (now < nextFrame) {
+      waitForNextFrame(now);
+      now = Clock::now();
+      nextFrame += framePeriod;
+    } else {
+      // Running behind, don't try to catch up with a burst of short frames
+      nextFrame = now + framePeriod;
+    }
+  }
+
+  if (hasSwapped) {
+    const double frameTime =
+        std::chrono::duration<double>(now - lastSwap).count();
+    frameTimes[frameTimeCount % FRAME_HISTORY] = static_cast<float>(frameTime);
+    frameTimeCount++;
+    smoothedFrameTime = frameTimeCount == 1
+                            ? frameTime
+                            : smoothedFrameTime +
+                                  (frameTime - smoothedFrameTime) * SMOOTHING;
+  }
+  lastSwap = now;
+  hasSwapped = true;
+
+  GlDebug::shared().endFrame();
+}
+
+FrameStats Window::getFrameStats() const {
+  FrameStats stats{};
+  stats.smoothed = smoothedFrameTime;
+
+  stats.frameCount = std::min(frameTimeCount, FRAME_HISTORY);
+  if (stats.frameCount > 0) {
+    std::vector<float> sorted(frameTimes.begin(),
+                              frameTimes.begin() + stats.frameCount);
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (float frameTime : sorted) {
+      sum += frameTime;
+    }
+    stats.average = sum / stats.frameCount;
+    stats.min = sorted.front();
+    stats.max = sorted.back();
+    stats.p99 = sorted[(stats.frameCount - 1) * 99 / 100];
+  }
+
+  stats.inputCount = std::min(inputLatencyCount, FRAME_HISTORY);
+  for (size_t i = 0; i < stats.inputCount; i++) {
+    stats.averageInputLatency += inputLatencies[i];
+    stats.maxInputLatency =
+        std::max<double>(stats.maxInputLatency, inputLatencies[i]);
+  }
+  if (stats.inputCount > 0) {
+    stats.averageInputLatency /= stats.inputCount;
+  }
+  return stats;
+}
+
 void Window::terminate() {
   glfwDestroyWindow(window);
   glfwTerminate();
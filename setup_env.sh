@@ -1,2 +1,4 @@
 export ICG_OBJ_DIR="$(pwd)/objs"
 export ICG_SHADER_DIR="$(pwd)/shaders"
+export ICG_TEXTURE_DIR="$(pwd)/textures"
+export ICG_CACHE_DIR="$(pwd)/.cache"
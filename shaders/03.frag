@@ -3,25 +3,27 @@
 layout(location=0) out vec4 color;
 
 in vec3 vNormal;
+in vec2 vTexCoord;
+#ifdef BAKED_AO
+in float vAmbientOcclusion;
+#endif
 
 uniform vec3 light_dir;
 uniform vec3 camera_forward_dir;
 
-vec3 ambientColor = vec3(0.0215, 0.1745, 0.0215);
-vec3 diffuseColor = vec3(0.07568, 0.61424, 0.07568);
-vec3 specularColor = vec3(0.633, 0.727811, 0.633);
-float shininess = 40;
-
-float ambientIntensity = 1;
-float intensity = 0.7;
+#include "material.glsl"
 
 vec4 calculateAmbientColor() {
+#ifdef BAKED_AO
+  return vec4(vAmbientOcclusion * ambientIntensity * ambientColor, 1.0);
+#else
   return vec4(ambientIntensity * ambientColor, 1.0);
+#endif
 }
 
 vec4 calculateDiffuseColor() {
   float geometryTerm = max(0, dot(vNormal, -light_dir));
-  return geometryTerm * vec4(diffuseColor, 1.0);
+  return geometryTerm * vec4(getDiffuseColor(vTexCoord), 1.0);
 }
 
 vec4 calculatePhongSpecularColor() {
@@ -38,7 +40,13 @@ vec4 calculateBlinnSpecularColor() {
   return specularFactor * vec4(specularColor, 1.0);
 }
 
+// Phong unless the program is built with BLINN defined
+#ifdef BLINN
+#define calculateSpecularColor calculateBlinnSpecularColor
+#else
+#define calculateSpecularColor calculatePhongSpecularColor
+#endif
+
 void main(){
-  color = intensity * (calculatePhongSpecularColor() + calculateDiffuseColor()) + calculateAmbientColor();
-  //color = intensity * (calculateBlinnSpecularColor() + calculateDiffuseColor()) + calculateAmbientColor();
+  color = intensity * (calculateSpecularColor() + calculateDiffuseColor()) + calculateAmbientColor();
 }
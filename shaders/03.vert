@@ -5,10 +5,22 @@ layout(location=1) in vec3 texCoord;
 layout(location=2) in vec3 normal;
 
 out vec3 vNormal;
+out vec2 vTexCoord;
+#ifdef BAKED_AO
+// ofyaGl::AMBIENT_OCCLUSION_ATTRIBUTE, 1 on meshes without a bake
+layout(location=3) in float ambientOcclusion;
+out float vAmbientOcclusion;
+#endif
 uniform mat4 mvp;
 uniform mat3 mv_n;
 
+invariant gl_Position;
+
 void main(){
   gl_Position = mvp * vec4(pos, 1.0);
   vNormal = normalize(mv_n * normal);
+  vTexCoord = texCoord.xy;
+#ifdef BAKED_AO
+  vAmbientOcclusion = ambientOcclusion;
+#endif
 }
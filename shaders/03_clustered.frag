@@ -0,0 +1,86 @@
+#version 330 core
+
+layout(location=0) out vec4 color;
+
+in vec3 vNormal;
+in vec3 vViewPos;
+in vec2 vTexCoord;
+#ifdef BAKED_AO
+in float vAmbientOcclusion;
+#endif
+
+uniform vec3 light_dir;
+uniform vec3 camera_forward_dir;
+
+// See ofyaGl::ClusteredLighting for the layout
+uniform samplerBuffer lights;
+uniform usamplerBuffer cluster_ranges;
+uniform usamplerBuffer light_indices;
+uniform ivec3 cluster_dims;
+uniform vec2 cluster_tile_size;
+uniform vec2 cluster_z_params;
+
+#include "material.glsl"
+
+const int LIGHT_TYPE_SPOT = 1;
+
+vec3 shade(vec3 toLight, vec3 normal, vec3 toEye, vec3 radiance,
+           vec3 diffuse) {
+  float geometryTerm = max(0, dot(normal, toLight));
+  // Phong unless the program is built with BLINN defined, like 03.frag
+#ifdef BLINN
+  vec3 halfVector = normalize(toLight + toEye);
+  float specAngle = max(0, dot(halfVector, normal));
+#else
+  vec3 reflectionDir = reflect(-toLight, normal);
+  float specAngle = max(0, dot(reflectionDir, toEye));
+#endif
+  float specularFactor = pow(specAngle, shininess);
+  return radiance * (geometryTerm * diffuse + specularFactor * specularColor);
+}
+
+int clusterIndex() {
+  ivec2 tile = ivec2(gl_FragCoord.xy / cluster_tile_size);
+  int slice = int(log(-vViewPos.z) * cluster_z_params.x + cluster_z_params.y);
+  tile = clamp(tile, ivec2(0), cluster_dims.xy - 1);
+  slice = clamp(slice, 0, cluster_dims.z - 1);
+  return tile.x + cluster_dims.x * (tile.y + cluster_dims.y * slice);
+}
+
+void main(){
+  vec3 normal = normalize(vNormal);
+  vec3 toEye = normalize(-vViewPos);
+
+  vec3 diffuse = getDiffuseColor(vTexCoord);
+  vec3 lit = shade(-light_dir, normal, -camera_forward_dir, vec3(1.0), diffuse);
+
+  uvec2 range = texelFetch(cluster_ranges, clusterIndex()).xy;
+  for (uint i = 0u; i < range.y; i++) {
+    int light = int(texelFetch(light_indices, int(range.x + i)).r) * 4;
+    vec4 positionRadius = texelFetch(lights, light);
+    vec4 colorType = texelFetch(lights, light + 1);
+
+    vec3 toLight = positionRadius.xyz - vViewPos;
+    float distance = length(toLight);
+    toLight /= distance;
+
+    // Smooth window so the light reaches exactly zero at its radius
+    float falloff = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+    float attenuation = falloff * falloff / (distance * distance + 1.0);
+
+    if (int(colorType.w) == LIGHT_TYPE_SPOT) {
+      vec4 directionCosOuter = texelFetch(lights, light + 2);
+      float cosInner = texelFetch(lights, light + 3).x;
+      float cosAngle = dot(-toLight, directionCosOuter.xyz);
+      attenuation *= smoothstep(directionCosOuter.w, cosInner, cosAngle);
+    }
+
+    lit += shade(toLight, normal, toEye, colorType.rgb * attenuation, diffuse);
+  }
+
+  vec3 ambient = ambientIntensity * ambientColor;
+#ifdef BAKED_AO
+  ambient *= vAmbientOcclusion;
+#endif
+  color = vec4(intensity * lit + ambient, 1.0);
+}
@@ -0,0 +1,12 @@
+#version 330 core
+
+layout(location=0) in vec3 pos;
+
+uniform mat4 mvp;
+
+// Must match the lit pass bit for bit for GL_EQUAL depth testing
+invariant gl_Position;
+
+void main(){
+  gl_Position = mvp * vec4(pos, 1.0);
+}
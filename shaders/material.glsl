@@ -0,0 +1,19 @@
+// Emerald unless the mesh brings its own materials
+uniform vec3 ambientColor = vec3(0.0215, 0.1745, 0.0215);
+uniform vec3 diffuseColor = vec3(0.07568, 0.61424, 0.07568);
+uniform vec3 specularColor = vec3(0.633, 0.727811, 0.633);
+uniform float shininess = 40;
+
+// The material's map_Kd while hasDiffuseMap is 1
+uniform sampler2D diffuseMap;
+uniform int hasDiffuseMap = 0;
+
+vec3 getDiffuseColor(vec2 texCoord) {
+  if (hasDiffuseMap == 0) {
+    return diffuseColor;
+  }
+  return diffuseColor * texture(diffuseMap, texCoord).rgb;
+}
+
+float ambientIntensity = 1;
+float intensity = 0.7;
@@ -0,0 +1,112 @@
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <sstream>
+#include <string>
+
+#include <ofyaGl/arena.h>
+#include <ofyaGl/obj.h>
+
+/**
+ * Heap allocations a warm load may make no matter how long the file is: the
+ * output vectors, the sub mesh with its name and the optional around them.
+ */
+constexpr uint64_t MAX_ALLOCATIONS_PER_LOAD = 16;
+
+static std::atomic<uint64_t> allocationCount{0};
+
+// Replaces the global allocation functions of the whole program, the array
+// forms forward to these
+void *operator new(std::size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size != 0 ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+/**
+ * `size` by `size` quads with positions, texture coordinates and normals,
+ * every face corner `v/vt/vn`.
+ */
+static std::string makeGridObj(uint32_t size) {
+  std::ostringstream obj;
+  for (uint32_t y = 0; y <= size; y++) {
+    for (uint32_t x = 0; x <= size; x++) {
+      obj << "v " << x << " " << y << " 0\n"
+          << "vt " << float(x) / size << " " << float(y) / size << "\n"
+          << "vn 0 0 1\n";
+    }
+  }
+  const uint32_t rowLength = size + 1;
+  for (uint32_t y = 0; y < size; y++) {
+    for (uint32_t x = 0; x < size; x++) {
+      const uint32_t a = y * rowLength + x + 1;
+      const uint32_t b = a + 1;
+      const uint32_t c = a + rowLength;
+      const uint32_t d = c + 1;
+      obj << "f " << a << "/" << a << "/" << a << " " << b << "/" << b << "/"
+          << b << " " << d << "/" << d << "/" << d << "\n"
+          << "f " << a << "/" << a << "/" << a << " " << d << "/" << d << "/"
+          << d << " " << c << "/" << c << "/" << c << "\n";
+    }
+  }
+  return obj.str();
+}
+
+/**
+ * Heap allocations of parsing `obj` with a warm `arena`.
+ */
+static uint64_t countAllocations(const std::string &obj,
+                                 ofyaGl::Arena &arena) {
+  const uint64_t before = allocationCount.load();
+  std::optional<ofyaGl::ObjData> objData =
+      ofyaGl::loadObjDataFromMemory(obj.c_str(), obj.size(), "grid.obj", arena);
+  arena.reset();
+  const uint64_t allocations = allocationCount.load() - before;
+  if (!objData.has_value()) {
+    std::cout << "grid didn't parse\n";
+    std::exit(EXIT_FAILURE);
+  }
+  return allocations;
+}
+
+int main() {
+  const std::string small = makeGridObj(16);
+  const std::string large = makeGridObj(512);
+  ofyaGl::Arena arena;
+  // Grows the arena to what the large grid needs
+  countAllocations(large, arena);
+  const size_t blocks = arena.getStats().upstreamAllocations;
+
+  bool ok = true;
+  std::cout << std::setw(10) << "lines" << std::setw(14) << "allocations"
+            << std::setw(14) << "per line\n";
+  for (const std::string *obj : {&small, &large}) {
+    size_t lines = 0;
+    for (char c : *obj) {
+      lines += c == '\n';
+    }
+    const uint64_t allocations = countAllocations(*obj, arena);
+    std::cout << std::setw(10) << lines << std::setw(14) << allocations
+              << std::setw(14) << double(allocations) / lines << "\n";
+    ok &= allocations <= MAX_ALLOCATIONS_PER_LOAD;
+  }
+  if (arena.getStats().upstreamAllocations != blocks) {
+    std::cout << "the warm arena went back to the heap\n";
+    ok = false;
+  }
+  if (!ok) {
+    std::cout << "more than " << MAX_ALLOCATIONS_PER_LOAD
+              << " allocations in a load\n";
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
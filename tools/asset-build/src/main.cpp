@@ -0,0 +1,602 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <ofyaGl/ambient_occlusion.h>
+#include <ofyaGl/arena.h>
+#include <ofyaGl/hash.h>
+#include <ofyaGl/job.h>
+#include <ofyaGl/mapped_file.h>
+#include <ofyaGl/mesh_codec.h>
+#include <ofyaGl/mesh_optimize.h>
+#include <ofyaGl/obj.h>
+#include <ofyaGl/paged_mesh.h>
+
+#include "timing.h"
+
+namespace fs = std::filesystem;
+
+constexpr const char *MANIFEST_NAME = "manifest.txt";
+constexpr const char *MANIFEST_MAGIC = "ofyaGl-assets";
+constexpr int MANIFEST_VERSION = 1;
+
+struct Options {
+  fs::path input;
+  fs::path output;
+  bool force = false;
+  bool optimize = true;
+  /**
+   * Writes chunked, level of detail `.ofp` files for streaming instead.
+   * Without `ambientOcclusion` they are built straight from the input file,
+   * which is never loaded whole.
+   */
+  bool paged = false;
+  ofyaGl::PagedMeshParams pagedParams;
+  /**
+   * Bakes per-vertex ambient occlusion into `TexCoord::t`.
+   */
+  bool ambientOcclusion = false;
+  ofyaGl::AmbientOcclusionParams ambientOcclusionParams;
+  /**
+   * Prints the loader's `LoadStats` of every built file as JSON.
+   */
+  bool loadStats = false;
+};
+
+/**
+ * Size and modification time, enough to skip reading unchanged inputs.
+ * Missing files have a zero stamp.
+ */
+struct FileStamp {
+  uint64_t size = 0;
+  int64_t time = 0;
+
+  bool operator==(const FileStamp &other) const {
+    return size == other.size && time == other.time;
+  }
+};
+
+/**
+ * A `mtllib` of an input, its materials end up in the output too.
+ */
+struct Dependency {
+  std::string path;
+  FileStamp stamp;
+};
+
+struct ManifestEntry {
+  uint64_t hash = 0;
+  FileStamp stamp;
+  std::vector<Dependency> dependencies;
+};
+
+/**
+ * Keyed by input path relative to the input directory, with '/' separators.
+ */
+using Manifest = std::unordered_map<std::string, ManifestEntry>;
+
+enum class Outcome { UpToDate, Unchanged, Built, Failed };
+
+struct Timings {
+  double hash = 0.0;
+  double parse = 0.0;
+  double ambientOcclusion = 0.0;
+  double optimize = 0.0;
+  double encode = 0.0;
+  double write = 0.0;
+};
+
+struct Job {
+  std::string input;
+  Outcome outcome = Outcome::Failed;
+  ManifestEntry entry;
+  Timings timings;
+  size_t triangleCount = 0;
+  size_t outputBytes = 0;
+  double missRatioBefore = 0.0;
+  double missRatioAfter = 0.0;
+  ofyaGl::LoadStats loadStats{};
+  ofyaGl::AmbientOcclusionStats ambientOcclusionStats{};
+  /**
+   * Set when the paged output was streamed from the input.
+   */
+  std::optional<ofyaGl::PagedBuildStats> pagedStats;
+  std::string error;
+};
+
+static FileStamp getStamp(const fs::path &path) {
+  std::error_code error;
+  const uintmax_t size = fs::file_size(path, error);
+  if (error) {
+    return {};
+  }
+  const auto time = fs::last_write_time(path, error);
+  if (error) {
+    return {};
+  }
+  return FileStamp{size, static_cast<int64_t>(time.time_since_epoch().count())};
+}
+
+static bool readWholeFile(const fs::path &path, std::string &contents) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  std::ostringstream stream;
+  stream << file.rdbuf();
+  contents = stream.str();
+  return true;
+}
+
+/**
+ * Anything that changes the output for the same input.
+ */
+static uint64_t getParameterHash(const Options &options) {
+  std::ostringstream parameters;
+  parameters << "format=" << ofyaGl::MESH_FILE_VERSION
+             << " stride=" << sizeof(ofyaGl::Vertex)
+             << " optimize=" << options.optimize
+             << " cache=" << ofyaGl::VERTEX_CACHE_SIZE;
+  if (options.paged) {
+    parameters << " paged=" << ofyaGl::PAGED_MESH_FILE_VERSION
+               << " chunk=" << options.pagedParams.maxChunkTriangles
+               << " lods=" << options.pagedParams.lodCount
+               << " bucket=" << options.pagedParams.maxBucketTriangles;
+  }
+  if (options.ambientOcclusion) {
+    parameters << " ao=" << options.ambientOcclusionParams.rayCount << ","
+               << options.ambientOcclusionParams.maxDistance;
+  }
+  const std::string text = parameters.str();
+  return ofyaGl::hashBytes(text.data(), text.size());
+}
+
+/**
+ * Reads the manifest of the last build, empty if there is none or it was
+ * built with other parameters.
+ */
+static Manifest readManifest(const fs::path &path, uint64_t parameterHash) {
+  Manifest manifest;
+  std::ifstream file(path);
+  std::string magic;
+  int version = 0;
+  uint64_t hash = 0;
+  if (!(file >> magic >> version >> std::hex >> hash >> std::dec) ||
+      magic != MANIFEST_MAGIC || version != MANIFEST_VERSION ||
+      hash != parameterHash) {
+    return manifest;
+  }
+
+  // "file <hash> <size> <time> <path>", then one "dep <size> <time> <path>"
+  // line per dependency. Paths come last so they may contain spaces
+  ManifestEntry *entry = nullptr;
+  std::string kind;
+  while (file >> kind) {
+    FileStamp stamp;
+    std::string entryPath;
+    if (kind == "file") {
+      file >> std::hex >> hash >> std::dec;
+    }
+    file >> stamp.size >> stamp.time;
+    file.ignore(1);
+    std::getline(file, entryPath);
+    if (!file) {
+      return {};
+    }
+    if (kind == "file") {
+      entry = &manifest[entryPath];
+      *entry = ManifestEntry{hash, stamp, {}};
+    } else if (kind == "dep" && entry != nullptr) {
+      entry->dependencies.push_back(Dependency{entryPath, stamp});
+    } else {
+      return {};
+    }
+  }
+  return manifest;
+}
+
+static bool writeManifest(const fs::path &path, uint64_t parameterHash,
+                          const std::vector<Job> &jobs) {
+  const fs::path temporary = fs::path(path).concat(".tmp");
+  {
+    std::ofstream file(temporary);
+    file << MANIFEST_MAGIC << " " << MANIFEST_VERSION << " " << std::hex
+         << parameterHash << std::dec << "\n";
+    for (const Job &job : jobs) {
+      if (job.outcome == Outcome::Failed) {
+        continue;
+      }
+      const ManifestEntry &entry = job.entry;
+      file << "file " << std::hex << entry.hash << std::dec << " "
+           << entry.stamp.size << " " << entry.stamp.time << " " << job.input
+           << "\n";
+      for (const Dependency &dependency : entry.dependencies) {
+        file << "dep " << dependency.stamp.size << " "
+             << dependency.stamp.time << " " << dependency.path << "\n";
+      }
+    }
+    if (!file) {
+      return false;
+    }
+  }
+  std::error_code error;
+  fs::rename(temporary, path, error);
+  return !error;
+}
+
+static fs::path getOutputPath(const Options &options,
+                              const std::string &input) {
+  fs::path path = options.output / input;
+  return path.replace_extension(options.paged
+                                    ? ofyaGl::PAGED_MESH_FILE_EXTENSION
+                                    : ofyaGl::MESH_FILE_EXTENSION);
+}
+
+/**
+ * `mtllib` names in an obj file, as written.
+ */
+static std::vector<std::string> findMaterialLibraries(std::string_view obj) {
+  std::vector<std::string> libraries;
+  for (size_t at = obj.find("mtllib"); at != std::string_view::npos;
+       at = obj.find("mtllib", at + 6)) {
+    if (at != 0 && obj[at - 1] != '\n') {
+      continue;
+    }
+    size_t begin = obj.find_first_not_of(" \t", at + 6);
+    size_t end = obj.find_first_of("\r\n#", begin);
+    if (begin == std::string_view::npos || begin == end) {
+      continue;
+    }
+    end = obj.find_last_not_of(" \t",
+                               end == std::string_view::npos ? end : end - 1);
+    libraries.emplace_back(obj.substr(begin, end - begin + 1));
+  }
+  return libraries;
+}
+
+static bool isUpToDate(const Options &options, const ManifestEntry &previous,
+                       const FileStamp &stamp, const std::string &input) {
+  if (!(previous.stamp == stamp) ||
+      !fs::exists(getOutputPath(options, input))) {
+    return false;
+  }
+  for (const Dependency &dependency : previous.dependencies) {
+    if (!(getStamp(options.input / dependency.path) == dependency.stamp)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Content hash of the input and its material libraries. The input is mapped
+ * rather than read, so inputs larger than RAM can be hashed too.
+ */
+static bool hashInput(const Options &options, Job &job) {
+  const fs::path inputPath = options.input / job.input;
+  const std::optional<ofyaGl::MappedFile> file =
+      ofyaGl::MappedFile::open(inputPath.string().c_str());
+  std::string_view contents;
+  if (file.has_value()) {
+    contents = std::string_view(reinterpret_cast<const char *>(file->data()),
+                                file->getSize());
+  } else if (std::error_code error; fs::file_size(inputPath, error) != 0) {
+    // Empty files can't be mapped but hash fine
+    job.error = "can't read input";
+    return false;
+  }
+  uint64_t hash = ofyaGl::hashBytes(contents.data(), contents.size());
+
+  job.entry.dependencies.clear();
+  for (const std::string &library : findMaterialLibraries(contents)) {
+    const std::string path =
+        (fs::path(job.input).parent_path() / library).lexically_normal()
+            .generic_string();
+    std::string libraryContents;
+    // A missing library only loses the colours, building it later rebuilds
+    if (readWholeFile(options.input / path, libraryContents)) {
+      hash = ofyaGl::hashCombine(
+          hash, ofyaGl::hashBytes(libraryContents.data(),
+                                  libraryContents.size()));
+    }
+    hash = ofyaGl::hashCombine(hash,
+                               ofyaGl::hashBytes(path.data(), path.size()));
+    job.entry.dependencies.push_back(
+        Dependency{path, getStamp(options.input / path)});
+  }
+  job.entry.hash = hash;
+  return true;
+}
+
+static bool writeOutput(const fs::path &path,
+                        const std::vector<uint8_t> &bytes) {
+  std::error_code error;
+  fs::create_directories(path.parent_path(), error);
+  if (error && !fs::is_directory(path.parent_path())) {
+    return false;
+  }
+  // Readers never see a half written file
+  const fs::path temporary = fs::path(path).concat(".tmp");
+  {
+    std::ofstream file(temporary, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    if (!file) {
+      return false;
+    }
+  }
+  fs::rename(temporary, path, error);
+  return !error;
+}
+
+static void buildFile(const Options &options, const ManifestEntry *previous,
+                      ofyaGl::Arena &arena, Job &job) {
+  const fs::path inputPath = options.input / job.input;
+  job.entry.stamp = getStamp(inputPath);
+  if (!options.force && previous != nullptr &&
+      isUpToDate(options, *previous, job.entry.stamp, job.input)) {
+    job.entry.hash = previous->hash;
+    job.entry.dependencies = previous->dependencies;
+    job.outcome = Outcome::UpToDate;
+    return;
+  }
+
+  auto start = Clock::now();
+  if (!hashInput(options, job)) {
+    return;
+  }
+  job.timings.hash = secondsSince(start);
+  // Touched but not changed, e.g. a fresh checkout
+  const fs::path outputPath = getOutputPath(options, job.input);
+  if (!options.force && previous != nullptr &&
+      previous->hash == job.entry.hash && fs::exists(outputPath)) {
+    job.outcome = Outcome::Unchanged;
+    return;
+  }
+
+  // Streamed from disk, so the mesh is never loaded whole. Baking ambient
+  // occlusion needs all of it at once and takes the in memory path
+  if (options.paged && !options.ambientOcclusion) {
+    start = Clock::now();
+    job.pagedStats = ofyaGl::buildPagedMeshFile(inputPath, outputPath,
+                                                options.pagedParams);
+    job.timings.encode = secondsSince(start);
+    if (!job.pagedStats.has_value()) {
+      job.error = "can't build paged mesh";
+      return;
+    }
+    job.triangleCount = job.pagedStats->triangleCount;
+    job.outputBytes = job.pagedStats->fileBytes;
+    job.outcome = Outcome::Built;
+    return;
+  }
+
+  start = Clock::now();
+  std::optional<ofyaGl::ObjData> objData =
+      ofyaGl::loadObjDataFromPath(inputPath, arena,
+                                  options.loadStats ? &job.loadStats : nullptr);
+  ofyaGl::recycleLoadArena(arena);
+  job.timings.parse = secondsSince(start);
+  if (!objData.has_value()) {
+    job.error = "can't parse input";
+    return;
+  }
+  job.triangleCount = objData->indicies.size() / 3;
+
+  // Before any reordering, so paged levels of detail average baked values
+  if (options.ambientOcclusion) {
+    start = Clock::now();
+    job.ambientOcclusionStats = ofyaGl::bakeAmbientOcclusion(
+        *objData, options.ambientOcclusionParams);
+    job.timings.ambientOcclusion = secondsSince(start);
+  }
+
+  start = Clock::now();
+  job.missRatioBefore = ofyaGl::getAverageCacheMissRatio(*objData);
+  // Paged builds optimize every page on their own
+  if (options.optimize && !options.paged) {
+    ofyaGl::optimizeVertexCache(*objData);
+    ofyaGl::optimizeVertexFetch(*objData);
+  }
+  job.missRatioAfter = ofyaGl::getAverageCacheMissRatio(*objData);
+  job.timings.optimize = secondsSince(start);
+
+  start = Clock::now();
+  const std::vector<uint8_t> encoded =
+      options.paged ? ofyaGl::buildPagedMesh(*objData, options.pagedParams)
+                    : ofyaGl::encodeMesh(*objData);
+  job.timings.encode = secondsSince(start);
+  job.outputBytes = encoded.size();
+
+  start = Clock::now();
+  if (!writeOutput(outputPath, encoded)) {
+    job.error = "can't write output";
+    return;
+  }
+  job.timings.write = secondsSince(start);
+  job.outcome = Outcome::Built;
+}
+
+static void printJob(const Options &options, const Job &job) {
+  if (job.outcome == Outcome::Failed) {
+    std::cout << "failed " << job.input << ": " << job.error << "\n";
+    return;
+  }
+  const Timings &t = job.timings;
+  if (job.pagedStats.has_value()) {
+    const ofyaGl::PagedBuildStats &paged = *job.pagedStats;
+    std::cout << "built  " << job.input << "\n       " << job.triangleCount
+              << " tris, " << job.outputBytes / 1024 << " KiB, "
+              << paged.bucketCount << " buckets of at most "
+              << paged.largestBucket << " tris, ms: hash "
+              << t.hash * 1000.0 << " build " << t.encode * 1000.0 << "\n";
+    return;
+  }
+  std::cout << "built  " << job.input << "\n       " << job.triangleCount
+            << " tris, " << job.outputBytes / 1024 << " KiB, ACMR "
+            << job.missRatioBefore << " -> " << job.missRatioAfter
+            << ", ms: hash " << t.hash * 1000.0 << " parse "
+            << t.parse * 1000.0 << " optimize " << t.optimize * 1000.0
+            << " encode " << t.encode * 1000.0 << " write "
+            << t.write * 1000.0 << "\n";
+  if (options.ambientOcclusion) {
+    const ofyaGl::AmbientOcclusionStats &ao = job.ambientOcclusionStats;
+    std::cout << "       ao: " << ao.rays << " rays, " << ao.bvhNodes
+              << " BVH nodes, ms: build " << ao.buildSeconds * 1000.0
+              << " trace " << ao.traceSeconds * 1000.0 << ", "
+              << ao.getRaysPerSecond() / 1e6 << " Mrays/s\n";
+  }
+  if (options.loadStats) {
+    job.loadStats.writeJson(std::cout);
+  }
+}
+
+static void printUsage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " <input dir> <output dir> [--force] [--no-optimize]"
+            << " [--paged [chunk tris]] [--ao [rays]] [--stats]\n"
+            << "  Converts every .obj below the input directory into an "
+            << ofyaGl::MESH_FILE_EXTENSION << " file\n"
+            << "  at the same relative path, skipping unchanged inputs.\n"
+            << "  --paged writes " << ofyaGl::PAGED_MESH_FILE_EXTENSION
+            << " files for out of core streaming instead,\n"
+            << "  streamed from the input unless --ao needs it in memory.\n"
+            << "  --ao bakes ambient occlusion per vertex, "
+            << ofyaGl::AmbientOcclusionParams{}.rayCount
+            << " rays by default.\n"
+            << "  --stats prints what loading each input cost as JSON.\n";
+}
+
+int main(int argc, char *argv[]) {
+  Options options;
+  std::vector<std::string> positional;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--force") == 0) {
+      options.force = true;
+    } else if (std::strcmp(argv[i], "--no-optimize") == 0) {
+      options.optimize = false;
+    } else if (std::strcmp(argv[i], "--stats") == 0) {
+      options.loadStats = true;
+    } else if (std::strcmp(argv[i], "--paged") == 0) {
+      options.paged = true;
+      if (i + 1 < argc &&
+          std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+        options.pagedParams.maxChunkTriangles =
+            static_cast<uint32_t>(std::max(std::atoi(argv[++i]), 1));
+      }
+    } else if (std::strcmp(argv[i], "--ao") == 0) {
+      options.ambientOcclusion = true;
+      if (i + 1 < argc &&
+          std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+        options.ambientOcclusionParams.rayCount =
+            static_cast<uint32_t>(std::max(std::atoi(argv[++i]), 1));
+      }
+    } else if (argv[i][0] == '-') {
+      printUsage(argv[0]);
+      return EXIT_FAILURE;
+    } else {
+      positional.push_back(argv[i]);
+    }
+  }
+  if (positional.size() != 2) {
+    printUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  options.input = positional[0];
+  options.output = positional[1];
+  if (!fs::is_directory(options.input)) {
+    std::cerr << "'" << options.input.string() << "' is not a directory\n";
+    return EXIT_FAILURE;
+  }
+
+  const auto buildStart = Clock::now();
+  std::vector<Job> jobs;
+  std::error_code error;
+  for (fs::recursive_directory_iterator it(
+           options.input, fs::directory_options::skip_permission_denied,
+           error);
+       !error && it != fs::recursive_directory_iterator();
+       it.increment(error)) {
+    if (it->is_regular_file() && it->path().extension() == ".obj") {
+      Job job;
+      job.input = it->path().lexically_relative(options.input).generic_string();
+      jobs.push_back(std::move(job));
+    }
+  }
+  if (error) {
+    std::cerr << "Failed to scan '" << options.input.string()
+              << "': " << error.message() << "\n";
+    return EXIT_FAILURE;
+  }
+  std::sort(jobs.begin(), jobs.end(), [](const Job &a, const Job &b) {
+    return a.input < b.input;
+  });
+  const double scanSeconds = secondsSince(buildStart);
+
+  const fs::path manifestPath = options.output / MANIFEST_NAME;
+  const uint64_t parameterHash = getParameterHash(options);
+  const Manifest previous = readManifest(manifestPath, parameterHash);
+
+  ofyaGl::JobSystem &jobSystem = ofyaGl::JobSystem::shared();
+  jobSystem.parallelFor(0, jobs.size(), 1, [&](size_t begin, size_t end) {
+    thread_local ofyaGl::Arena arena(4 << 20);
+    for (size_t i = begin; i < end; i++) {
+      const auto found = previous.find(jobs[i].input);
+      buildFile(options, found != previous.end() ? &found->second : nullptr,
+                arena, jobs[i]);
+    }
+  });
+
+  // Outputs of inputs that are gone
+  size_t removedCount = 0;
+  for (const auto &[input, entry] : previous) {
+    const auto found = std::lower_bound(
+        jobs.begin(), jobs.end(), input,
+        [](const Job &job, const std::string &path) {
+          return job.input < path;
+        });
+    const bool exists = found != jobs.end() && found->input == input;
+    if (!exists && fs::remove(getOutputPath(options, input), error)) {
+      removedCount++;
+    }
+  }
+
+  fs::create_directories(options.output, error);
+  if (!writeManifest(manifestPath, parameterHash, jobs)) {
+    std::cerr << "Failed to write '" << manifestPath.string() << "'\n";
+    return EXIT_FAILURE;
+  }
+
+  size_t counts[4] = {};
+  std::cout << std::fixed << std::setprecision(2);
+  for (const Job &job : jobs) {
+    counts[static_cast<int>(job.outcome)]++;
+    if (job.outcome == Outcome::Built || job.outcome == Outcome::Failed) {
+      printJob(options, job);
+    }
+  }
+  std::cout << jobs.size() << " inputs: "
+            << counts[static_cast<int>(Outcome::Built)] << " built, "
+            << counts[static_cast<int>(Outcome::UpToDate)] << " up to date, "
+            << counts[static_cast<int>(Outcome::Unchanged)]
+            << " unchanged after hashing, "
+            << counts[static_cast<int>(Outcome::Failed)] << " failed, "
+            << removedCount << " removed\n"
+            << "scan " << scanSeconds * 1000.0 << " ms, total "
+            << secondsSince(buildStart) * 1000.0 << " ms on "
+            << jobSystem.getWorkerCount() + 1 << " threads\n";
+
+  return counts[static_cast<int>(Outcome::Failed)] == 0 ? EXIT_SUCCESS
+                                                         : EXIT_FAILURE;
+}
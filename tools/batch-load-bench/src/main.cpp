@@ -0,0 +1,124 @@
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <ofyaGl/batch_load.h>
+#include <ofyaGl/mesh_codec.h>
+#include <ofyaGl/obj.h>
+
+#include "timing.h"
+
+namespace fs = std::filesystem;
+
+struct Totals {
+  size_t loaded = 0;
+  size_t failed = 0;
+  size_t triangles = 0;
+};
+
+static void count(Totals &totals,
+                  const std::optional<ofyaGl::ObjData> &objData) {
+  if (objData.has_value()) {
+    totals.loaded++;
+    totals.triangles += objData->indicies.size() / 3;
+  } else {
+    totals.failed++;
+  }
+}
+
+static void printRun(const char *name, const Totals &totals, size_t bytes,
+                     double seconds) {
+  std::cout << std::setw(10) << name << std::setw(8) << totals.loaded
+            << std::setw(8) << totals.failed << std::setw(12)
+            << totals.triangles << std::setw(10) << seconds * 1000.0
+            << " ms" << std::setw(10) << totals.loaded / seconds
+            << " files/s" << std::setw(10) << bytes / seconds / 1e6
+            << " MB/s\n";
+}
+
+static bool isMeshFile(const fs::path &path) {
+  const fs::path extension = path.extension();
+  if (extension == ".obj" || extension == ofyaGl::MESH_FILE_EXTENSION) {
+    return true;
+  }
+  return (extension == ".gz" || extension == ".zst") &&
+         path.stem().extension() == ".obj";
+}
+
+static void printUsage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " <dir> [--in-flight=N] [--sequential] [--batch]\n"
+            << "  Loads every mesh file below dir one after another, then\n"
+            << "  all at once through ObjBatchLoader. Pick one of the two\n"
+            << "  to time cold reads after dropping the page cache.\n";
+}
+
+int main(int argc, char *argv[]) {
+  fs::path dir;
+  size_t maxInFlight = 64;
+  bool sequential = true;
+  bool batch = true;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], "--in-flight=", 12) == 0) {
+      maxInFlight = std::strtoul(argv[i] + 12, nullptr, 10);
+    } else if (std::strcmp(argv[i], "--sequential") == 0) {
+      batch = false;
+    } else if (std::strcmp(argv[i], "--batch") == 0) {
+      sequential = false;
+    } else if (argv[i][0] == '-' || !dir.empty()) {
+      printUsage(argv[0]);
+      return EXIT_FAILURE;
+    } else {
+      dir = argv[i];
+    }
+  }
+  if (dir.empty() || !fs::is_directory(dir)) {
+    printUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::vector<fs::path> paths;
+  size_t bytes = 0;
+  std::error_code error;
+  for (fs::recursive_directory_iterator it(
+           dir, fs::directory_options::skip_permission_denied, error);
+       !error && it != fs::recursive_directory_iterator();
+       it.increment(error)) {
+    if (it->is_regular_file() && isMeshFile(it->path())) {
+      paths.push_back(it->path());
+      bytes += it->file_size();
+    }
+  }
+  std::cout << paths.size() << " files, " << bytes / 1024 << " KiB\n"
+            << std::fixed << std::setprecision(1) << std::setw(10) << "mode"
+            << std::setw(8) << "loaded" << std::setw(8) << "failed"
+            << std::setw(12) << "triangles\n";
+
+  if (sequential) {
+    Totals totals;
+    const auto start = Clock::now();
+    for (const fs::path &path : paths) {
+      count(totals, ofyaGl::loadObjDataFromPath(path));
+    }
+    printRun("sequential", totals, bytes, secondsSince(start));
+  }
+
+  if (batch) {
+    Totals totals;
+    const auto start = Clock::now();
+    ofyaGl::ObjBatchLoader loader(maxInFlight);
+    for (const fs::path &path : paths) {
+      loader.submit(path);
+    }
+    while (std::optional<ofyaGl::ObjLoadResult> result = loader.wait()) {
+      count(totals, result->objData);
+    }
+    printRun(loader.isUsingIoRing() ? "io_uring" : "jobs", totals, bytes,
+             secondsSince(start));
+  }
+  return EXIT_SUCCESS;
+}
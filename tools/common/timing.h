@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <type_traits>
+
+// Timing shared by the tools
+
+using Clock = std::chrono::steady_clock;
+
+inline double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Fastest of `runs` calls to `fn` in seconds, so a cold cache or a preempted
+ * run doesn't count. If `fn` returns a bool, false stops and returns -1.
+ */
+template <typename Fn> double timeBest(int runs, Fn fn) {
+  double best = 0.0;
+  for (int run = 0; run < runs; run++) {
+    const auto start = Clock::now();
+    if constexpr (std::is_same_v<decltype(fn()), bool>) {
+      if (!fn()) {
+        return -1.0;
+      }
+    } else {
+      fn();
+    }
+    const double seconds = secondsSince(start);
+    if (run == 0 || seconds < best) {
+      best = seconds;
+    }
+  }
+  return best;
+}
@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include <ofyaGl/half_edge.h>
+#include <ofyaGl/obj.h>
+
+#include "timing.h"
+
+using ofyaGl::HalfEdgeMesh;
+
+constexpr int BUILD_RUNS = 5;
+
+/**
+ * `size` by `size` quads, each split in two. Vertices are duplicated along
+ * the middle column like a texture seam, welding must see through it.
+ */
+static ofyaGl::ObjData makeGrid(uint32_t size) {
+  ofyaGl::ObjData objData;
+  const uint32_t seam = size / 2;
+  const uint32_t rowLength = size + 2;
+  for (uint32_t y = 0; y <= size; y++) {
+    for (uint32_t x = 0; x <= size + 1; x++) {
+      const uint32_t column = x <= seam ? x : x - 1;
+      ofyaGl::Vertex vertex{};
+      vertex.pos = {static_cast<float>(column), static_cast<float>(y), 0.f};
+      vertex.texCoord.u = x <= seam ? 0.f : 1.f;
+      objData.verts.push_back(vertex);
+    }
+  }
+  for (uint32_t y = 0; y < size; y++) {
+    for (uint32_t x = 0; x < size; x++) {
+      // Right of the seam the duplicated column is used
+      const uint32_t column = x < seam ? x : x + 1;
+      const uint32_t a = y * rowLength + column;
+      const uint32_t b = a + 1;
+      const uint32_t c = a + rowLength;
+      const uint32_t d = c + 1;
+      objData.indicies.insert(objData.indicies.end(), {a, b, d, a, d, c});
+    }
+  }
+  return objData;
+}
+
+/**
+ * The usual way, a hash map from directed edge to half-edge. Returns the
+ * number of half-edges it found a twin for.
+ */
+static size_t countTwinsWithMap(const HalfEdgeMesh &mesh) {
+  std::unordered_map<uint64_t, uint32_t> edges;
+  edges.reserve(mesh.getHalfEdgeCount());
+  auto getKey = [&](uint32_t from, uint32_t to) {
+    return (uint64_t(mesh.getPoint(from)) << 32) | mesh.getPoint(to);
+  };
+  for (uint32_t h = 0; h < mesh.getHalfEdgeCount(); h++) {
+    edges.emplace(getKey(mesh.getOrigin(h), mesh.getTarget(h)), h);
+  }
+  size_t twinned = 0;
+  for (uint32_t h = 0; h < mesh.getHalfEdgeCount(); h++) {
+    if (edges.count(getKey(mesh.getTarget(h), mesh.getOrigin(h))) != 0) {
+      twinned++;
+    }
+  }
+  return twinned;
+}
+
+/**
+ * Prints the first broken invariant, if any.
+ */
+static bool validate(const HalfEdgeMesh &mesh) {
+  for (uint32_t h = 0; h < mesh.getHalfEdgeCount(); h++) {
+    const uint32_t twin = mesh.getTwin(h);
+    if (twin == HalfEdgeMesh::NONE) {
+      continue;
+    }
+    if (mesh.getTwin(twin) != h ||
+        mesh.getPoint(mesh.getOrigin(twin)) !=
+            mesh.getPoint(mesh.getTarget(h)) ||
+        mesh.getPoint(mesh.getTarget(twin)) !=
+            mesh.getPoint(mesh.getOrigin(h))) {
+      std::cout << "half-edge " << h << " and its twin " << twin
+                << " don't match\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * A closed tetrahedron whose apex is at NaN, split into two vertices with
+ * the same bits. Welding must neither hang on it nor keep the copies apart.
+ */
+static bool checkNonFinite() {
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  ofyaGl::ObjData objData;
+  objData.verts.resize(5);
+  objData.verts[1].pos = {1.f, 0.f, 0.f};
+  objData.verts[2].pos = {0.f, 1.f, 0.f};
+  objData.verts[3].pos = {nan, 0.f, 1.f};
+  objData.verts[4].pos = objData.verts[3].pos;
+  objData.indicies = {0, 2, 1, 0, 1, 3, 1, 2, 4, 2, 0, 3};
+
+  const HalfEdgeMesh mesh = HalfEdgeMesh::build(objData);
+  size_t twins = 0;
+  for (uint32_t h = 0; h < mesh.getHalfEdgeCount(); h++) {
+    twins += mesh.getTwin(h) != HalfEdgeMesh::NONE;
+  }
+  if (mesh.getPoint(4) != 3 || twins != mesh.getHalfEdgeCount() ||
+      !validate(mesh)) {
+    std::cout << "NaN position check failed, " << twins << " of "
+              << mesh.getHalfEdgeCount() << " half-edges twinned\n";
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <file.obj | --grid=N>\n"
+              << "  file.obj is relative to ICG_OBJ_DIR, --grid builds an\n"
+              << "  N by N quad grid instead\n";
+    return EXIT_FAILURE;
+  }
+
+  if (!checkNonFinite()) {
+    return EXIT_FAILURE;
+  }
+
+  std::optional<ofyaGl::ObjData> objData;
+  if (std::strncmp(argv[1], "--grid=", 7) == 0) {
+    objData = makeGrid(static_cast<uint32_t>(
+        std::max(std::strtoul(argv[1] + 7, nullptr, 10), 1ul)));
+  } else {
+    objData = ofyaGl::loadObjDataFromFile(argv[1]);
+  }
+  if (!objData.has_value()) {
+    return EXIT_FAILURE;
+  }
+
+  HalfEdgeMesh mesh;
+  const double buildSeconds =
+      timeBest(BUILD_RUNS, [&] { mesh = HalfEdgeMesh::build(*objData); });
+  std::vector<unsigned int> adjacency;
+  const double adjacencySeconds =
+      timeBest(BUILD_RUNS, [&] { adjacency = mesh.buildAdjacencyIndices(); });
+  size_t mapTwins = 0;
+  const double mapSeconds =
+      timeBest(BUILD_RUNS, [&] { mapTwins = countTwinsWithMap(mesh); });
+
+  size_t twins = 0;
+  size_t edgeCounts[3] = {};
+  for (uint32_t h = 0; h < mesh.getHalfEdgeCount(); h++) {
+    twins += mesh.getTwin(h) != HalfEdgeMesh::NONE;
+    for (int bit = 0; bit < 3; bit++) {
+      edgeCounts[bit] += (mesh.getEdgeFlags(h) >> bit) & 1;
+    }
+  }
+  size_t points = 0;
+  size_t pointCounts[2] = {};
+  for (uint32_t v = 0; v < objData->verts.size(); v++) {
+    if (mesh.getPoint(v) == v &&
+        mesh.getPointHalfEdge(v) != HalfEdgeMesh::NONE) {
+      points++;
+      for (int bit = 0; bit < 2; bit++) {
+        pointCounts[bit] += (mesh.getPointFlags(v) >> bit) & 1;
+      }
+    }
+  }
+
+  const size_t faces = mesh.getFaceCount();
+  std::cout << faces << " triangles, " << objData->verts.size()
+            << " vertices, " << points << " points\n"
+            << "half-edges: " << twins << " twinned, " << edgeCounts[0]
+            << " boundary, " << edgeCounts[1] << " non-manifold, "
+            << edgeCounts[2] << " degenerate\n"
+            << "points: " << pointCounts[0] << " boundary, "
+            << pointCounts[1] << " non-manifold\n"
+            << std::fixed << std::setprecision(2) << "build     "
+            << std::setw(10) << buildSeconds * 1000.0 << " ms"
+            << std::setw(10) << faces / buildSeconds / 1e6 << " Mtris/s\n"
+            << "adjacency " << std::setw(10) << adjacencySeconds * 1000.0
+            << " ms\n"
+            << "map twins " << std::setw(10) << mapSeconds * 1000.0
+            << " ms\n";
+
+  // The map pairs up edges shared by more than two triangles too
+  const bool manifold = edgeCounts[1] == 0 && edgeCounts[2] == 0;
+  if (!validate(mesh) || (manifold && mapTwins != twins) ||
+      adjacency.size() != faces * 6) {
+    std::cout << "validation failed, the map found " << mapTwins
+              << " twins\n";
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
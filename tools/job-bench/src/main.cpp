@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <ofyaGl/job.h>
+
+#include "timing.h"
+
+/**
+ * Submits empty tasks from outside the pool, measures the round trip through
+ * the injection queue.
+ */
+static double measureSubmit(ofyaGl::JobSystem &jobSystem, size_t taskCount) {
+  std::vector<ofyaGl::TaskHandle> handles;
+  handles.reserve(taskCount);
+
+  auto start = Clock::now();
+  for (size_t i = 0; i < taskCount; i++) {
+    handles.push_back(jobSystem.submit([] {}));
+  }
+  jobSystem.waitAll(handles);
+  return secondsSince(start) / taskCount;
+}
+
+/**
+ * Splits a range down to single elements from inside a worker, measures the
+ * spawn and steal path.
+ */
+static double measureFanOut(ofyaGl::JobSystem &jobSystem, size_t pieceCount) {
+  auto start = Clock::now();
+  auto root = jobSystem.submit([&] {
+    jobSystem.parallelFor(0, pieceCount, 1, [](size_t, size_t) {});
+  });
+  jobSystem.wait(root);
+  return secondsSince(start) / pieceCount;
+}
+
+static double measureKernel(ofyaGl::JobSystem &jobSystem,
+                            std::vector<float> &data, float &checksum) {
+  auto start = Clock::now();
+  jobSystem.parallelFor(0, data.size(), 1 << 14, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      float x = data[i];
+      for (int j = 0; j < 16; j++) {
+        x = std::sqrt(x * x + 1.f) - 0.5f;
+      }
+      data[i] = x;
+    }
+  });
+  double seconds = secondsSince(start);
+  checksum += data[data.size() / 2];
+  return seconds;
+}
+
+int main(int argc, char *argv[]) {
+  unsigned maxThreads = 64;
+  if (argc == 2) {
+    maxThreads = std::max(1, std::atoi(argv[1]));
+  }
+
+  constexpr size_t SUBMIT_COUNT = 200000;
+  constexpr size_t FAN_OUT_COUNT = 1 << 20;
+  std::vector<float> data(1 << 24, 1.f);
+  float checksum = 0;
+
+  std::cout << "hardware threads: " << std::thread::hardware_concurrency()
+            << "\n";
+  std::cout << std::setw(8) << "threads" << std::setw(14) << "submit ns"
+            << std::setw(14) << "fan-out ns" << std::setw(14) << "kernel ms"
+            << std::setw(10) << "speedup" << std::setw(10) << "steals"
+            << "\n";
+
+  double baseline = 0;
+  for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+    // The calling thread helps while waiting, so it counts as one. A single
+    // thread has no workers and runs everything itself, the serial baseline
+    ofyaGl::JobSystem jobSystem(threads - 1);
+
+    double submit = measureSubmit(jobSystem, SUBMIT_COUNT);
+    double fanOut = measureFanOut(jobSystem, FAN_OUT_COUNT);
+    double kernel = measureKernel(jobSystem, data, checksum);
+    if (threads == 1) {
+      baseline = kernel;
+    }
+
+    std::cout << std::fixed << std::setprecision(1) << std::setw(8) << threads
+              << std::setw(14) << submit * 1e9 << std::setw(14);
+    // Without workers parallelFor runs inline, there is nothing to fan out
+    if (jobSystem.getWorkerCount() > 0) {
+      std::cout << fanOut * 1e9;
+    } else {
+      std::cout << "-";
+    }
+    std::cout << std::setw(14) << kernel * 1e3
+              << std::setprecision(2) << std::setw(10) << baseline / kernel
+              << std::setw(10) << jobSystem.getStats().stolen << "\n";
+  }
+
+  std::cout << "checksum: " << checksum << "\n";
+  return EXIT_SUCCESS;
+}
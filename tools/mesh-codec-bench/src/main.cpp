@@ -0,0 +1,95 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <ofyaGl/mesh_codec.h>
+#include <ofyaGl/obj.h>
+
+#include "timing.h"
+
+constexpr int DECODE_RUNS = 20;
+
+static void printStream(const char *name, size_t rawBytes,
+                        size_t encodedBytes, double seconds) {
+  std::cout << std::setw(8) << name << std::setw(12) << rawBytes
+            << std::setw(12) << encodedBytes << std::setw(8)
+            << static_cast<double>(rawBytes) / encodedBytes << "x"
+            << std::setw(10) << rawBytes / seconds / 1e9 << " GB/s\n";
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2 || argc > 3) {
+    std::cerr << "Usage: " << argv[0] << " <file.obj> [out.ofm]\n"
+              << "  file.obj is relative to ICG_OBJ_DIR\n";
+    return EXIT_FAILURE;
+  }
+
+  std::optional<ofyaGl::ObjData> objData =
+      ofyaGl::loadObjDataFromFile(argv[1]);
+  if (!objData.has_value()) {
+    return EXIT_FAILURE;
+  }
+  const std::vector<ofyaGl::Vertex> &verts = objData->verts;
+  const std::vector<uint32_t> indices(objData->indicies.begin(),
+                                      objData->indicies.end());
+
+  auto start = Clock::now();
+  const std::vector<uint8_t> vertexData = ofyaGl::encodeVertexBuffer(
+      verts.data(), verts.size(), sizeof(ofyaGl::Vertex));
+  const std::vector<uint8_t> indexData =
+      ofyaGl::encodeIndexBuffer(indices.data(), indices.size());
+  const double encodeSeconds = secondsSince(start);
+
+  std::vector<ofyaGl::Vertex> decodedVerts(verts.size());
+  std::vector<uint32_t> decodedIndices(indices.size());
+  const double vertexSeconds = timeBest(DECODE_RUNS, [&] {
+    return ofyaGl::decodeVertexBuffer(decodedVerts.data(), verts.size(),
+                                      sizeof(ofyaGl::Vertex),
+                                      vertexData.data(), vertexData.size());
+  });
+  const double indexSeconds = timeBest(DECODE_RUNS, [&] {
+    return ofyaGl::decodeIndexBuffer(decodedIndices.data(), indices.size(),
+                                     indexData.data(), indexData.size());
+  });
+  if (vertexSeconds < 0.0 || indexSeconds < 0.0) {
+    std::cerr << "Decoding failed\n";
+    return EXIT_FAILURE;
+  }
+
+  const size_t vertexBytes = verts.size() * sizeof(ofyaGl::Vertex);
+  const size_t indexBytes = indices.size() * sizeof(uint32_t);
+  std::cout << verts.size() << " vertices, " << indices.size()
+            << " indices\n";
+  std::cout << std::fixed << std::setprecision(2) << std::setw(8) << "stream"
+            << std::setw(12) << "raw" << std::setw(12) << "encoded"
+            << std::setw(9) << "ratio" << std::setw(15) << "decode\n";
+  printStream("vertex", vertexBytes, vertexData.size(), vertexSeconds);
+  printStream("index", indexBytes, indexData.size(), indexSeconds);
+  std::cout << "encoded in " << encodeSeconds * 1000.0 << " ms\n";
+
+  const bool vertsMatch =
+      std::memcmp(decodedVerts.data(), verts.data(), vertexBytes) == 0;
+  const bool indicesMatch = decodedIndices == indices;
+  if (!vertsMatch || !indicesMatch) {
+    std::cout << "round trip mismatch in"
+              << (vertsMatch ? "" : " vertices")
+              << (indicesMatch ? "" : " indices") << "\n";
+    return EXIT_FAILURE;
+  }
+
+  if (argc == 3) {
+    const std::vector<uint8_t> mesh = ofyaGl::encodeMesh(*objData);
+    std::ofstream out(argv[2], std::ios::binary);
+    out.write(reinterpret_cast<const char *>(mesh.data()), mesh.size());
+    if (!out) {
+      std::cerr << "Failed to write '" << argv[2] << "'\n";
+      return EXIT_FAILURE;
+    }
+    std::cout << "wrote " << mesh.size() << " bytes to '" << argv[2] << "'\n";
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,142 @@
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <ofyaGl/occlusion.h>
+
+#include "timing.h"
+
+/**
+ * Appends a closed box with outward facing counter clockwise triangles.
+ */
+static void appendBox(const ofyaGl::Bounds &box, std::vector<float> &positions,
+                      std::vector<uint32_t> &indices) {
+  const uint32_t first = static_cast<uint32_t>(positions.size() / 3);
+  for (int corner = 0; corner < 8; corner++) {
+    positions.push_back(corner & 1 ? box.max.x : box.min.x);
+    positions.push_back(corner & 2 ? box.max.y : box.min.y);
+    positions.push_back(corner & 4 ? box.max.z : box.min.z);
+  }
+
+  // Corner bit 1 is x, 2 is y, 4 is z
+  const uint32_t faces[6][4] = {{0, 2, 6, 4}, {1, 3, 7, 5}, {0, 1, 5, 4},
+                                {2, 3, 7, 6}, {0, 1, 3, 2}, {4, 5, 7, 6}};
+  const glm::vec3 normals[6] = {{-1, 0, 0}, {1, 0, 0},  {0, -1, 0},
+                                {0, 1, 0},  {0, 0, -1}, {0, 0, 1}};
+  for (int face = 0; face < 6; face++) {
+    uint32_t quad[4];
+    glm::vec3 p[4];
+    for (int i = 0; i < 4; i++) {
+      quad[i] = first + faces[face][i];
+      p[i] = glm::vec3(positions[quad[i] * 3], positions[quad[i] * 3 + 1],
+                       positions[quad[i] * 3 + 2]);
+    }
+    if (glm::dot(glm::cross(p[1] - p[0], p[2] - p[0]), normals[face]) < 0.f) {
+      std::swap(quad[1], quad[3]);
+    }
+    for (uint32_t index : {quad[0], quad[1], quad[2], quad[0], quad[2],
+                           quad[3]}) {
+      indices.push_back(index);
+    }
+  }
+}
+
+struct Case {
+  const char *name;
+  ofyaGl::Bounds bounds;
+  bool visible;
+};
+
+int main(int argc, char *argv[]) {
+  size_t boxCount = 100000;
+  if (argc == 2) {
+    boxCount = std::max(1, std::atoi(argv[1]));
+  }
+
+  // Camera at the origin looking down -z at a 8x4 wall 10 units away
+  const glm::mat4 projection =
+      glm::perspective(glm::radians(60.f), 2.f, 0.1f, 100.f);
+  const glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, -1.f),
+                                     glm::vec3(0.f, 1.f, 0.f));
+
+  std::vector<float> positions;
+  std::vector<uint32_t> indices;
+  appendBox({glm::vec3(-4.f, -2.f, -10.5f), glm::vec3(4.f, 2.f, -10.f)},
+            positions, indices);
+
+  ofyaGl::OcclusionCuller culler;
+  auto start = Clock::now();
+  culler.beginFrame(projection * view);
+  culler.addOccluder(positions.data(), 3 * sizeof(float), positions.size() / 3,
+                     indices.data(), indices.size(), glm::mat4(1.f));
+  culler.buildHierarchy();
+  const double rasterSeconds = secondsSince(start);
+
+  // The wall covers |x| < 8, |y| < 4 at z = -20
+  const Case cases[] = {
+      {"behind wall", {{-.5f, -.5f, -20.5f}, {.5f, .5f, -19.5f}}, false},
+      {"large behind wall", {{-3.f, -1.5f, -30.f}, {3.f, 1.5f, -25.f}}, false},
+      {"in front of wall", {{-.5f, -.5f, -5.5f}, {.5f, .5f, -4.5f}}, true},
+      {"beside wall", {{11.f, -.5f, -20.5f}, {12.f, .5f, -19.5f}}, true},
+      {"above wall", {{-.5f, 3.f, -20.5f}, {.5f, 6.f, -19.5f}}, true},
+      {"inside wall", {{-.5f, -.5f, -10.4f}, {.5f, .5f, -10.1f}}, false},
+      {"through wall", {{-.5f, -.5f, -12.f}, {.5f, .5f, -8.f}}, true},
+      {"behind camera", {{-.5f, -.5f, 4.5f}, {.5f, .5f, 5.5f}}, false},
+      {"outside frustum", {{99.f, -.5f, -20.5f}, {100.f, .5f, -19.5f}}, false},
+      {"past far plane", {{-.5f, -.5f, -201.f}, {.5f, .5f, -200.f}}, false},
+      {"across near plane", {{-.5f, -.5f, -1.f}, {.5f, .5f, 1.f}}, true},
+  };
+
+  int mismatches = 0;
+  for (const Case &test : cases) {
+    const bool visible = culler.isVisible(test.bounds);
+    const bool ok = visible == test.visible;
+    mismatches += ok ? 0 : 1;
+    std::cout << std::setw(20) << test.name << std::setw(10)
+              << (visible ? "visible" : "hidden") << (ok ? "" : "  MISMATCH")
+              << "\n";
+  }
+
+  // Random unit boxes in the view volume, mostly behind the wall
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> spread(-1.f, 1.f);
+  std::uniform_real_distribution<float> depth(-60.f, -2.f);
+  std::vector<ofyaGl::Bounds> boxes(boxCount);
+  for (auto &box : boxes) {
+    const float z = depth(rng);
+    const glm::vec3 center(spread(rng) * -z, spread(rng) * -z * .5f, z);
+    box = {center - glm::vec3(.5f), center + glm::vec3(.5f)};
+  }
+
+  constexpr int ITERATIONS = 10;
+  std::vector<uint8_t> visible;
+  size_t visibleCount = 0;
+  start = Clock::now();
+  for (int i = 0; i < ITERATIONS; i++) {
+    visibleCount = culler.cull(boxes, visible);
+  }
+  const double cullSeconds = secondsSince(start) / ITERATIONS;
+
+  const ofyaGl::OcclusionCuller::Stats &stats = culler.getStats();
+  std::cout << std::fixed << std::setprecision(3) << "depth buffer "
+            << culler.getWidth() << "x" << culler.getHeight() << ", "
+            << culler.getLevelCount() << " levels, "
+            << stats.rasterizedTriangles << "/" << stats.occluderTriangles
+            << " occluder triangles in " << rasterSeconds * 1e3 << " ms\n";
+  std::cout << "culled " << boxCount - visibleCount << "/" << boxCount
+            << " boxes in " << cullSeconds * 1e3 << " ms ("
+            << std::setprecision(1) << cullSeconds * 1e9 / boxCount
+            << " ns per box)\n";
+
+  if (mismatches > 0) {
+    std::cout << mismatches << " visibility mismatches\n";
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
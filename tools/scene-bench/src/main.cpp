@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <ofyaGl/job.h>
+#include <ofyaGl/scene.h>
+
+#include "timing.h"
+
+constexpr size_t NODE_COUNT = 100000;
+constexpr size_t FRAME_COUNT = 200;
+constexpr double BUDGET_MS = 1.0;
+
+/**
+ * Children per node, gives a hierarchy seven levels deep.
+ */
+constexpr size_t BRANCHING = 8;
+
+/**
+ * Compares every world matrix against the parent's world matrix times the
+ * node's local transform, built with plain glm.
+ */
+static bool validate(const ofyaGl::Scene &scene) {
+  for (ofyaGl::NodeId node = 0; node < scene.size(); node++) {
+    glm::mat4 local = glm::translate(glm::mat4(1.f), scene.getPosition(node)) *
+                      glm::mat4_cast(scene.getRotation(node)) *
+                      glm::scale(glm::mat4(1.f), scene.getScale(node));
+    ofyaGl::NodeId parent = scene.getParent(node);
+    glm::mat4 expected = parent == ofyaGl::NO_PARENT
+                             ? local
+                             : scene.getWorldMatrix(parent) * local;
+    const glm::mat4 &world = scene.getWorldMatrix(node);
+    for (int i = 0; i < 4; i++) {
+      for (int j = 0; j < 4; j++) {
+        if (std::abs(world[i][j] - expected[i][j]) > 1e-4f) {
+          std::cout << "node " << node << " has a wrong world matrix\n";
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * Runs `animate` and `update` for every frame, returns the median update time
+ * in seconds.
+ */
+template <typename Animate>
+static double measure(ofyaGl::Scene &scene, const Animate &animate) {
+  std::vector<double> times;
+  times.reserve(FRAME_COUNT);
+  for (size_t frame = 0; frame < FRAME_COUNT; frame++) {
+    animate(float(frame));
+    auto start = Clock::now();
+    size_t updated = scene.update();
+    times.push_back(secondsSince(start));
+    if (updated != scene.size()) {
+      std::cout << "update touched " << updated << " of " << scene.size()
+                << " nodes\n";
+      std::exit(EXIT_FAILURE);
+    }
+  }
+  std::nth_element(times.begin(), times.begin() + times.size() / 2,
+                   times.end());
+  return times[times.size() / 2];
+}
+
+int main() {
+  ofyaGl::Scene scene;
+  scene.reserve(NODE_COUNT);
+  scene.createNode();
+  for (size_t i = 1; i < NODE_COUNT; i++) {
+    ofyaGl::NodeId node =
+        *scene.createNode(static_cast<ofyaGl::NodeId>((i - 1) / BRANCHING));
+    scene.setPosition(node, glm::vec3(1.f, 0.f, 0.f));
+    scene.setScale(node, glm::vec3(.9f));
+  }
+  if (scene.createNode(static_cast<ofyaGl::NodeId>(NODE_COUNT)).has_value()) {
+    std::cout << "a node was created under a missing parent\n";
+    return EXIT_FAILURE;
+  }
+  scene.update();
+
+  // Only the root moves, every node inherits the change
+  double root = measure(scene, [&](float t) {
+    scene.setRotation(0, glm::angleAxis(t * .01f, glm::vec3(0.f, 1.f, 0.f)));
+  });
+
+  // Every node moves, local matrices are rebuilt as well
+  double all = measure(scene, [&](float t) {
+    for (ofyaGl::NodeId node = 0; node < scene.size(); node++) {
+      scene.setRotation(node, glm::angleAxis(t * .01f + node * 1e-3f,
+                                             glm::vec3(0.f, 0.f, 1.f)));
+    }
+  });
+  if (!validate(scene)) {
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "nodes: " << NODE_COUNT << ", workers: "
+            << ofyaGl::JobSystem::shared().getWorkerCount() << "\n";
+  std::cout << std::setw(16) << "changed" << std::setw(12) << "median ms"
+            << std::setw(12) << "budget ms" << "\n";
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << std::setw(16) << "root only" << std::setw(12) << root * 1e3
+            << std::setw(12) << BUDGET_MS << "\n";
+  std::cout << std::setw(16) << "every node" << std::setw(12) << all * 1e3
+            << std::setw(12) << BUDGET_MS << "\n";
+  if (root * 1e3 > BUDGET_MS || all * 1e3 > BUDGET_MS) {
+    std::cout << "over budget\n";
+  }
+  return EXIT_SUCCESS;
+}